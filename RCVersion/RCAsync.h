@@ -0,0 +1,254 @@
+#pragma once
+#include "RCAsyncFile.h"
+#include "RCFileHandler.h"
+
+// C++20 coroutine interface for build tools that embed the updater:
+//
+//   unsigned error = co_await UpdateFileAsync(context, in, out, -1, -1, build, -1);
+//
+// The file I/O is overlapped, the coroutine is suspended while it runs and
+// resumed on the executor of the context. RCVersion itself is built as C++14,
+// there this header only provides the classes of RCAsyncFile.h.
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <utility>
+
+// What the tasks of a build share, it must outlive them. A logger used by
+// concurrent tasks must be thread safe; cache and pool are. The value names
+// are only read by the tasks, null updates the default values.
+struct RCAsyncContext
+{
+  RCExecutor& executor;
+  ILogger& logger;
+  RCOffsetCache* cache;
+  RCBufferPool* pool;
+  int verbosity;
+  const RCValueNames* valueNames;
+};
+
+// Lazily started task: runs when awaited and resumes its awaiter when done
+template <class T>
+class RCTask
+{
+public:
+  struct promise_type
+  {
+    T value{};
+    std::exception_ptr exception;
+    std::coroutine_handle<> continuation;
+
+    struct FinalAwaiter
+    {
+      bool await_ready() const noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+      {
+        std::coroutine_handle<> next = handle.promise().continuation;
+        return next ? next : std::noop_coroutine();
+      }
+      void await_resume() const noexcept {}
+    };
+
+    RCTask get_return_object() { return RCTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void return_value(T result) { value = std::move(result); }
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+
+  RCTask(RCTask&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+  RCTask& operator=(RCTask&& other) noexcept
+  {
+    if (this != &other)
+    {
+      if (handle)
+      {
+        handle.destroy();
+      }
+      handle = std::exchange(other.handle, {});
+    }
+    return *this;
+  }
+  ~RCTask()
+  {
+    if (handle)
+    {
+      handle.destroy();
+    }
+  }
+
+  RCTask(const RCTask&) = delete;
+  RCTask& operator=(const RCTask&) = delete;
+
+  bool await_ready() const noexcept { return !handle || handle.done(); }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+  {
+    handle.promise().continuation = awaiter;
+    return handle;
+  }
+  T await_resume()
+  {
+    if (handle.promise().exception)
+    {
+      std::rethrow_exception(handle.promise().exception);
+    }
+    return std::move(handle.promise().value);
+  }
+
+protected:
+  explicit RCTask(std::coroutine_handle<promise_type> task) : handle(task) {}
+  std::coroutine_handle<promise_type> handle;
+};
+
+// Coroutine that starts at once and frees itself at the end, for callers that
+// start tasks from plain functions
+struct RCDetachedTask
+{
+  struct promise_type
+  {
+    RCDetachedTask get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+// Suspends while a load or save runs, the completion resumes the coroutine
+// through the executor. Resumes at once when the I/O could not be started.
+class RCFileAwaiter
+{
+public:
+  RCFileAwaiter(RCExecutor& rexecutor, RCAsyncFile& rfiles, RCAsyncOperation& roperation, bool save, size_t loadPadding)
+    : executor(rexecutor), files(rfiles), operation(roperation), write(save), padding(loadPadding)
+  {
+  }
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> awaiter)
+  {
+    handle = awaiter;
+    operation.completion = &Completed;
+    operation.context = this;
+    return write ? files.StartSave(operation) : files.StartLoad(operation, padding);
+  }
+  bool await_resume() const noexcept { return NO_ERROR == operation.request.error; }
+
+protected:
+  static void Completed(RCAsyncOperation& operation)
+  {
+    RCFileAwaiter& self = *static_cast<RCFileAwaiter*>(operation.context);
+    self.executor.Post(&Resume, self.handle.address());
+  }
+  static void Resume(void* address)
+  {
+    std::coroutine_handle<>::from_address(address).resume();
+  }
+
+  RCExecutor& executor;
+  RCAsyncFile& files;
+  RCAsyncOperation& operation;
+  bool write;
+  size_t padding;
+  std::coroutine_handle<> handle;
+};
+
+// ---------------------------------------------------------------------------
+// RCFileHandler::UpdateFile without blocking: returns NO_ERROR or the error
+// ---------------------------------------------------------------------------
+inline RCTask<unsigned> UpdateFileAsync(RCAsyncContext& context, std::wstring inpath, std::wstring outpath, int major, int minor, int build, int revision)
+{
+  RCFileHandler handler{context.logger};
+  handler.Verbosity(context.verbosity);
+  handler.Cache(context.cache);
+  handler.ValueNames(context.valueNames);
+  RCAsyncFile files{context.logger};
+  files.Verbosity(context.verbosity);
+  files.Pool(context.pool);
+
+  bool inPlace = 0 == _wcsicmp(inpath.c_str(), outpath.c_str());
+  for (unsigned attempt = 1; ; ++attempt)
+  {
+    RCAsyncOperation operation{};
+    operation.request.path = inpath;
+    if (!co_await RCFileAwaiter(context.executor, files, operation, false, 1024))
+    {
+      co_return operation.request.error;
+    }
+
+    bool modified{};
+    bool isUnicode{};
+    size_t outBytes{};
+    std::vector<size_t> offsets;
+    RCFileRequest& request = operation.request;
+    if (!handler.UpdateLoaded(inpath.c_str(), outpath.c_str(), request.buffer, request.size, request.lastWrite, major, minor, build, revision, modified, isUnicode, outBytes, offsets))
+    {
+      co_return handler.Error();
+    }
+    if (!modified)
+    {
+      co_return NO_ERROR;
+    }
+
+    request.path = outpath;
+    request.bytes = outBytes;
+    operation.compare = inPlace;
+    if (!co_await RCFileAwaiter(context.executor, files, operation, true, 0))
+    {
+      if (context.cache)
+      {
+        context.cache->Remove(outpath.c_str());
+      }
+      // The destination was changed by another process since it was read
+      if (ERROR_RETRY == request.error && attempt < RCFileHandler::RetryLimit)
+      {
+        continue;
+      }
+      co_return request.error;
+    }
+
+    handler.StoreOffsets(outpath.c_str(), isUnicode, offsets);
+    co_return NO_ERROR;
+  }
+}
+
+// Waits on the calling thread, for callers outside of coroutines. Must not
+// be called on a thread the executor needs to finish the task.
+template <class T>
+RCDetachedTask RCRunTask(RCTask<T>& task, T& result, std::exception_ptr& exception, std::mutex& lock, std::condition_variable& done, bool& finished)
+{
+  try
+  {
+    result = co_await task;
+  }
+  catch (...)
+  {
+    exception = std::current_exception();
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  finished = true;
+  done.notify_all();
+}
+
+template <class T>
+T RCSyncWait(RCTask<T> task)
+{
+  T result{};
+  std::exception_ptr exception;
+  std::mutex lock;
+  std::condition_variable done;
+  bool finished{false};
+  RCRunTask(task, result, exception, lock, done, finished);
+
+  std::unique_lock<std::mutex> guard(lock);
+  done.wait(guard, [&finished]() { return finished; });
+  if (exception)
+  {
+    std::rethrow_exception(exception);
+  }
+  return result;
+}
+#endif
@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "RCAsyncFile.h"
+#include <memory>
+
+// ---------------------------------------------------------------------------
+// The callback and its context travel together through the thread pool
+// ---------------------------------------------------------------------------
+struct RCPostedWork
+{
+  void (*callback)(void* context);
+  void* context;
+};
+
+static void CALLBACK RunPostedWork(PTP_CALLBACK_INSTANCE, PVOID parameter)
+{
+  std::unique_ptr<RCPostedWork> work(static_cast<RCPostedWork*>(parameter));
+  work->callback(work->context);
+}
+
+void RCThreadPoolExecutor::Post(void (*callback)(void* context), void* context)
+{
+  std::unique_ptr<RCPostedWork> work(new RCPostedWork{callback, context});
+  if (TrySubmitThreadpoolCallback(&RunPostedWork, work.get(), nullptr))
+  {
+    work.release();
+    return;
+  }
+  // Only when the system is out of resources, run it here rather than lose it
+  callback(context);
+}
+
+
+RCAsyncFile::RCAsyncFile(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , pool(nullptr)
+  , output(rlogger)
+{
+}
+
+RCAsyncFile::~RCAsyncFile()
+{
+}
+
+// ---------------------------------------------------------------------------
+// Open the file and take its buffer, then start the read. A pooled buffer is
+// only used when the pool has room: waiting would block an executor thread.
+// ---------------------------------------------------------------------------
+bool RCAsyncFile::StartLoad(RCAsyncOperation& operation, size_t padding)
+{
+  RCFileRequest& request = operation.request;
+  request.error = NO_ERROR;
+  logger.Log(logDetail, L"Reading file [%s]...", request.path.c_str());
+
+  operation.file.reset(CreateFile(request.path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+  if (!operation.file)
+  {
+    return logger.Error(request.error = GetLastError(), L"*** RCAsyncFile::Load: Cannot open input file [%s]", request.path.c_str());
+  }
+
+  BY_HANDLE_FILE_INFORMATION info{};
+  if (!GetFileInformationByHandle(operation.file.get(), &info))
+  {
+    operation.file.reset();
+    return logger.Error(request.error = GetLastError(), L"*** RCAsyncFile::Load: Cannot read input file [%s]", request.path.c_str());
+  }
+
+  ULARGE_INTEGER li{};
+  li.LowPart = info.nFileSizeLow;
+  li.HighPart = info.nFileSizeHigh;
+  request.size = li.QuadPart;
+  request.lastWrite = info.ftLastWriteTime;
+  if (0 != li.HighPart || (0x7FFFFFFF - padding) <= li.LowPart)
+  {
+    operation.file.reset();
+    return logger.Error(request.error = ERROR_FILE_CORRUPT, L"*** RCAsyncFile::Load: File too large [%s]", request.path.c_str());
+  }
+
+  size_t totalSize = li.LowPart + padding;
+  request.buffer = pool ? pool->Acquire(totalSize, false) : RCBuffer();
+  if (request.buffer.empty())
+  {
+    request.buffer = RCBuffer::Allocate(totalSize);
+  }
+  if (!request.buffer.resize(totalSize))
+  {
+    operation.file.reset();
+    return logger.Error(request.error = ERROR_OUTOFMEMORY, L"*** RCAsyncFile::Load: File too large [%s]", request.path.c_str());
+  }
+
+  request.bytes = li.LowPart;
+  operation.padding = padding;
+  operation.write = false;
+  return Start(operation, false);
+}
+
+bool RCAsyncFile::StartSave(RCAsyncOperation& operation)
+{
+  RCFileRequest& request = operation.request;
+  request.error = NO_ERROR;
+  logger.Log(logDetail, L"Writing file [%s]...", request.path.c_str());
+
+  operation.file.reset(output.Open(request.path.c_str(), FILE_FLAG_OVERLAPPED, request.temp, request.error));
+  if (!operation.file)
+  {
+    return false;
+  }
+
+  operation.padding = 0;
+  operation.write = true;
+  return Start(operation, true);
+}
+
+// ---------------------------------------------------------------------------
+// Once the I/O is issued the completion may already run on another thread
+// and free the operation, nothing here may touch it afterwards
+// ---------------------------------------------------------------------------
+bool RCAsyncFile::Start(RCAsyncOperation& operation, bool write)
+{
+  RCFileRequest& request = operation.request;
+  operation.owner = this;
+  operation.overlapped = OVERLAPPED{};
+  operation.io = CreateThreadpoolIo(operation.file.get(), &Completed, &operation, nullptr);
+  if (!operation.io)
+  {
+    operation.file.reset();
+    return logger.Error(request.error = GetLastError(), L"*** RCAsyncFile: Cannot bind [%s] to the thread pool", request.path.c_str());
+  }
+
+  PTP_IO io = operation.io;
+  StartThreadpoolIo(io);
+  BOOL ok = write
+    ? WriteFile(operation.file.get(), request.buffer.data(), DWORD(request.bytes), nullptr, &operation.overlapped)
+    : ReadFile(operation.file.get(), request.buffer.data(), DWORD(request.bytes), nullptr, &operation.overlapped);
+  DWORD error = ok ? NO_ERROR : GetLastError();
+  if (ok || ERROR_IO_PENDING == error)
+  {
+    return true;
+  }
+
+  // Failed without queueing a completion
+  CancelThreadpoolIo(io);
+  CloseThreadpoolIo(io);
+  operation.io = nullptr;
+  operation.file.reset();
+  if (write)
+  {
+    output.Discard(request.temp);
+  }
+  return logger.Error(request.error = error, write ? L"*** RCAsyncFile::Save: Cannot write output file [%s]" : L"*** RCAsyncFile::Load: Cannot read input file [%s]", request.path.c_str());
+}
+
+// ---------------------------------------------------------------------------
+// Thread pool I/O callback: close the file, finish the buffer or put the
+// written file in place, report
+// ---------------------------------------------------------------------------
+void CALLBACK RCAsyncFile::Completed(PTP_CALLBACK_INSTANCE, PVOID context, PVOID, ULONG result, ULONG_PTR bytes, PTP_IO io)
+{
+  RCAsyncOperation& operation = *static_cast<RCAsyncOperation*>(context);
+  RCFileRequest& request = operation.request;
+  operation.file.reset();
+  CloseThreadpoolIo(io);
+  operation.io = nullptr;
+
+  if (NO_ERROR != result)
+  {
+    operation.owner->logger.Error(request.error = result, L"*** RCAsyncFile: I/O failed for [%s]", request.path.c_str());
+  }
+  else if (operation.write && bytes != request.bytes)
+  {
+    operation.owner->logger.Error(request.error = ERROR_WRITE_FAULT, L"*** RCAsyncFile::Save: Cannot write output file [%s]", request.path.c_str());
+  }
+  else if (!operation.write)
+  {
+    request.bytes = size_t(bytes);
+    memset(request.buffer.data() + bytes, 0, request.buffer.size() - bytes);
+  }
+
+  RCOutputFiles::FileState loaded{request.size, request.lastWrite};
+  if (operation.write && NO_ERROR != request.error)
+  {
+    operation.owner->output.Discard(request.temp);
+  }
+  else if (operation.write && !operation.owner->output.Replace(request.path, request.temp, operation.compare ? &loaded : nullptr))
+  {
+    request.error = operation.owner->output.Error();
+  }
+
+  operation.completion(operation);
+}
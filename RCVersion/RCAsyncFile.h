@@ -0,0 +1,73 @@
+#pragma once
+#include "Logger.h"
+#include "RCBatchIO.h"
+#include "RCOutputFiles.h"
+#include <windows.h>
+#include "wil/resource.h"
+
+// Runs a callback on some thread. Async operations resume their callers
+// through it, so callers decide which threads run the version updates.
+class RCExecutor
+{
+public:
+  virtual ~RCExecutor() {}
+  virtual void Post(void (*callback)(void* context), void* context) = 0;
+};
+
+// Executor on the Windows thread pool
+class RCThreadPoolExecutor : public RCExecutor
+{
+public:
+  void Post(void (*callback)(void* context), void* context) override;
+};
+
+class RCAsyncFile;
+
+// One overlapped load or save of a whole file. The completion runs on a
+// thread pool I/O thread once the file is closed again; no thread waits
+// while the I/O is in flight. A save writes a temporary file that replaces
+// the destination on that thread before the completion is called.
+struct RCAsyncOperation
+{
+  OVERLAPPED overlapped;
+  RCFileRequest request;
+  void (*completion)(RCAsyncOperation& operation);
+  void* context;
+  // A save only replaces the destination still as it was loaded
+  bool compare;
+
+  // Set while the operation runs
+  RCAsyncFile* owner;
+  wil::unique_hfile file;
+  PTP_IO io;
+  size_t padding;
+  bool write;
+};
+
+class RCAsyncFile
+{
+public:
+  RCAsyncFile(ILogger &rlogger);
+  virtual ~RCAsyncFile();
+
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); output.Verbosity(value); }
+  void Pool(RCBufferPool* value) { pool = value; }
+
+  // False when the operation failed before it was started, request.error
+  // tells why and the completion is not called. After true the operation
+  // must not be touched until the completion runs.
+  bool StartLoad(RCAsyncOperation& operation, size_t padding);
+  bool StartSave(RCAsyncOperation& operation);
+
+protected:
+  bool Start(RCAsyncOperation& operation, bool write);
+  static void CALLBACK Completed(PTP_CALLBACK_INSTANCE instance, PVOID context, PVOID overlapped, ULONG result, ULONG_PTR bytes, PTP_IO io);
+
+  ILogger &ilogger;
+  Logger logger;
+  RCBufferPool* pool;
+  RCOutputFiles output;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
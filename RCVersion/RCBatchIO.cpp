@@ -0,0 +1,510 @@
+#include "stdafx.h"
+#include "RCBatchIO.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+// The I/O ring headers come with Windows SDK 10.0.22621, writes need Windows 11 22H2
+#if defined(__has_include)
+#if __has_include(<ioringapi.h>)
+#include <ioringapi.h>
+#if defined(NTDDI_WIN10_NI) && NTDDI_VERSION >= NTDDI_WIN10_NI
+#define RCVERSION_IORING 1
+#endif
+#endif
+#endif
+
+RCBatchIO::RCBatchIO(ILogger &rlogger, RCBufferPool& bufferPool, unsigned size)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , pool(bufferPool)
+  , batchSize(size)
+  , stats{}
+  , output(nullptr)
+{
+}
+
+RCBatchIO::~RCBatchIO()
+{
+}
+
+HANDLE RCBatchIO::OpenForLoad(RCFileRequest& request, size_t padding, bool wait, DWORD flags)
+{
+  request.error = NO_ERROR;
+  wil::unique_hfile hFile(CreateFile(request.path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, flags, nullptr));
+  if (!hFile)
+  {
+    logger.Error(request.error = GetLastError(), L"*** RCBatchIO::Load: Cannot open input file [%s]", request.path.c_str());
+    return INVALID_HANDLE_VALUE;
+  }
+
+  BY_HANDLE_FILE_INFORMATION info{};
+  if (!GetFileInformationByHandle(hFile.get(), &info))
+  {
+    logger.Error(request.error = GetLastError(), L"*** RCBatchIO::Load: Cannot read input file [%s]", request.path.c_str());
+    return INVALID_HANDLE_VALUE;
+  }
+
+  ULARGE_INTEGER li{};
+  li.LowPart = info.nFileSizeLow;
+  li.HighPart = info.nFileSizeHigh;
+  request.size = li.QuadPart;
+  request.lastWrite = info.ftLastWriteTime;
+  request.bytes = li.LowPart;
+  if (0 != li.HighPart || (0x7FFFFFFF - padding) <= li.LowPart)
+  {
+    logger.Error(request.error = ERROR_FILE_CORRUPT, L"*** RCBatchIO::Load: File too large [%s]", request.path.c_str());
+    return INVALID_HANDLE_VALUE;
+  }
+
+  request.buffer = pool.Acquire(li.LowPart + padding, wait);
+  if (!request.buffer.resize(li.LowPart + padding))
+  {
+    request.error = wait ? ERROR_OUTOFMEMORY : ERROR_RETRY;
+    if (wait)
+    {
+      logger.Error(request.error, L"*** RCBatchIO::Load: File too large [%s]", request.path.c_str());
+    }
+    return INVALID_HANDLE_VALUE;
+  }
+
+  return hFile.release();
+}
+
+HANDLE RCBatchIO::OpenForSave(RCFileRequest& request, DWORD flags)
+{
+  request.error = NO_ERROR;
+  if (output)
+  {
+    return output->Open(request.path.c_str(), flags, request.temp, request.error);
+  }
+
+  HANDLE hFile = CreateFile(request.path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, flags, nullptr);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    logger.Error(request.error = GetLastError(), L"*** RCBatchIO::Save: Cannot open output file [%s]", request.path.c_str());
+  }
+  return hFile;
+}
+
+void RCBatchIO::Loaded(RCFileRequest& request, DWORD readBytes, size_t padding)
+{
+  request.bytes = readBytes;
+  memset(request.buffer.data() + readBytes, 0, request.buffer.size() - readBytes);
+}
+
+
+// ---------------------------------------------------------------------------
+// Fallback: files are opened for reading on the calling thread, worker
+// threads read them and write the results with blocking calls
+// ---------------------------------------------------------------------------
+class RCThreadBatchIO : public RCBatchIO
+{
+public:
+  RCThreadBatchIO(ILogger &rlogger, RCBufferPool& bufferPool, unsigned threadCount)
+    : RCBatchIO(rlogger, bufferPool, 16 * threadCount)
+    , threads(threadCount)
+  {
+  }
+
+  const wchar_t* Name() const override { return L"thread pool"; }
+
+  void Load(std::vector<RCFileRequest>& requests, size_t padding) override
+  {
+    // Buffers are taken in order and only the first one of a batch may wait,
+    // a batch must never wait for memory it holds itself
+    std::vector<HANDLE> handles(requests.size(), INVALID_HANDLE_VALUE);
+    bool held{false};
+    for (size_t n = 0; n < requests.size(); ++n)
+    {
+      if (!held || ERROR_RETRY != requests[n - 1].error)
+      {
+        handles[n] = OpenForLoad(requests[n], padding, !held, 0);
+        held = held || INVALID_HANDLE_VALUE != handles[n];
+      }
+      else
+      {
+        requests[n].error = ERROR_RETRY;
+      }
+    }
+
+    ForEach(requests.size(), [&](size_t n) {
+      wil::unique_hfile hFile(handles[n]);
+      RCFileRequest& request = requests[n];
+      if (!hFile)
+      {
+        return;
+      }
+      DWORD readBytes{};
+      if (!ReadFile(hFile.get(), request.buffer.data(), DWORD(request.bytes), &readBytes, nullptr) || request.bytes < readBytes)
+      {
+        request.error = (request.bytes < readBytes) ? ERROR_READ_FAULT : GetLastError();
+        logger.Error(request.error, L"*** RCBatchIO::Load: Cannot read input file [%s]", request.path.c_str());
+        request.buffer.release();
+        return;
+      }
+      Loaded(request, readBytes, padding);
+    });
+
+    for (const auto& request : requests)
+    {
+      stats.files += (NO_ERROR == request.error) ? 1 : 0;
+      stats.bytesRead += (NO_ERROR == request.error) ? request.bytes : 0;
+    }
+  }
+
+  void Save(std::vector<RCFileRequest>& requests) override
+  {
+    ForEach(requests.size(), [&](size_t n) {
+      RCFileRequest& request = requests[n];
+      wil::unique_hfile hFile(OpenForSave(request, 0));
+      if (!hFile)
+      {
+        return;
+      }
+      DWORD written{};
+      if (!WriteFile(hFile.get(), request.buffer.data(), DWORD(request.bytes), &written, nullptr) || request.bytes != written)
+      {
+        // A short write sets no error code
+        request.error = (request.bytes == written) ? GetLastError() : ERROR_WRITE_FAULT;
+        logger.Error(request.error, L"*** RCBatchIO::Save: Cannot write output file [%s]", request.path.c_str());
+      }
+    });
+
+    for (const auto& request : requests)
+    {
+      stats.bytesWritten += (NO_ERROR == request.error) ? request.bytes : 0;
+    }
+  }
+
+protected:
+  void ForEach(size_t count, const std::function<void(size_t)>& work)
+  {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+      for (size_t n = next++; n < count; n = next++)
+      {
+        work(n);
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned n = 1; n < threads && n < count; ++n)
+    {
+      workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers)
+    {
+      thread.join();
+    }
+    ++stats.submissions;
+  }
+
+  unsigned threads;
+};
+
+
+#if RCVERSION_IORING
+// ---------------------------------------------------------------------------
+// Windows I/O ring: the reads of a batch go into registered buffers with one
+// submission, then the writes with another. Opening and closing files has no
+// ring operation on Windows and stays on the calling thread.
+// ---------------------------------------------------------------------------
+class RCRingBatchIO : public RCBatchIO
+{
+public:
+  // Resolved at run time, the program must still start where kernelbase.dll
+  // does not export the I/O ring functions
+  struct Api
+  {
+    decltype(&::QueryIoRingCapabilities) QueryIoRingCapabilities;
+    decltype(&::CreateIoRing) CreateIoRing;
+    decltype(&::CloseIoRing) CloseIoRing;
+    decltype(&::IsIoRingOpSupported) IsIoRingOpSupported;
+    decltype(&::BuildIoRingRegisterBuffers) BuildIoRingRegisterBuffers;
+    decltype(&::BuildIoRingReadFile) BuildIoRingReadFile;
+    decltype(&::BuildIoRingWriteFile) BuildIoRingWriteFile;
+    decltype(&::SubmitIoRing) SubmitIoRing;
+    decltype(&::PopIoRingCompletion) PopIoRingCompletion;
+
+    bool Load()
+    {
+      HMODULE module = GetModuleHandle(L"kernelbase.dll");
+      if (!module)
+      {
+        return false;
+      }
+      QueryIoRingCapabilities = reinterpret_cast<decltype(QueryIoRingCapabilities)>(GetProcAddress(module, "QueryIoRingCapabilities"));
+      CreateIoRing = reinterpret_cast<decltype(CreateIoRing)>(GetProcAddress(module, "CreateIoRing"));
+      CloseIoRing = reinterpret_cast<decltype(CloseIoRing)>(GetProcAddress(module, "CloseIoRing"));
+      IsIoRingOpSupported = reinterpret_cast<decltype(IsIoRingOpSupported)>(GetProcAddress(module, "IsIoRingOpSupported"));
+      BuildIoRingRegisterBuffers = reinterpret_cast<decltype(BuildIoRingRegisterBuffers)>(GetProcAddress(module, "BuildIoRingRegisterBuffers"));
+      BuildIoRingReadFile = reinterpret_cast<decltype(BuildIoRingReadFile)>(GetProcAddress(module, "BuildIoRingReadFile"));
+      BuildIoRingWriteFile = reinterpret_cast<decltype(BuildIoRingWriteFile)>(GetProcAddress(module, "BuildIoRingWriteFile"));
+      SubmitIoRing = reinterpret_cast<decltype(SubmitIoRing)>(GetProcAddress(module, "SubmitIoRing"));
+      PopIoRingCompletion = reinterpret_cast<decltype(PopIoRingCompletion)>(GetProcAddress(module, "PopIoRingCompletion"));
+      return QueryIoRingCapabilities && CreateIoRing && CloseIoRing && IsIoRingOpSupported && BuildIoRingRegisterBuffers
+        && BuildIoRingReadFile && SubmitIoRing && PopIoRingCompletion;
+    }
+  };
+
+  static const unsigned QueueSize = 256;
+  static const UINT_PTR RegisterTag = ~UINT_PTR(0);
+
+  static std::unique_ptr<RCBatchIO> Open(ILogger &rlogger, RCBufferPool& bufferPool)
+  {
+    Api api{};
+    if (!api.Load())
+    {
+      return nullptr;
+    }
+
+    IORING_CAPABILITIES capabilities{};
+    if (FAILED(api.QueryIoRingCapabilities(&capabilities)) || capabilities.MaxVersion < IORING_VERSION_1)
+    {
+      return nullptr;
+    }
+
+    IORING_CREATE_FLAGS flags{};
+    HIORING ring{nullptr};
+    if (FAILED(api.CreateIoRing(capabilities.MaxVersion, flags, QueueSize, 2 * QueueSize, &ring)))
+    {
+      return nullptr;
+    }
+
+    return std::unique_ptr<RCBatchIO>(new RCRingBatchIO(rlogger, bufferPool, api, ring));
+  }
+
+  ~RCRingBatchIO()
+  {
+    api.CloseIoRing(ring);
+  }
+
+  const wchar_t* Name() const override { return ringWrites ? L"I/O ring" : L"I/O ring (reads only)"; }
+
+  void Load(std::vector<RCFileRequest>& requests, size_t padding) override
+  {
+    NextBatch();
+    std::vector<wil::unique_hfile> handles(requests.size());
+    std::vector<IORING_BUFFER_INFO> buffers;
+    std::vector<size_t> registered;
+    bool held{false};
+    for (size_t n = 0; n < requests.size(); ++n)
+    {
+      if (held && ERROR_RETRY == requests[n - 1].error)
+      {
+        requests[n].error = ERROR_RETRY;
+        continue;
+      }
+      handles[n].reset(OpenForLoad(requests[n], padding, !held, FILE_FLAG_OVERLAPPED));
+      held = held || handles[n];
+      if (handles[n] && 0 == requests[n].bytes)
+      {
+        Loaded(requests[n], 0, padding);
+        ++stats.files;
+        handles[n].reset();
+      }
+      else if (handles[n])
+      {
+        buffers.push_back(IORING_BUFFER_INFO{requests[n].buffer.data(), UINT32(requests[n].bytes)});
+        registered.push_back(n);
+      }
+    }
+
+    if (registered.empty())
+    {
+      return;
+    }
+
+    // Registration replaces the buffers of the previous batch
+    bool useIndex = SUCCEEDED(api.BuildIoRingRegisterBuffers(ring, UINT32(buffers.size()), buffers.data(), RegisterTag)) &&
+      Submit(requests, std::vector<size_t>(), true, padding, false);
+
+    for (size_t index = 0; index < registered.size(); ++index)
+    {
+      size_t n = registered[index];
+      IORING_BUFFER_REF buffer = useIndex ? IoRingBufferRefFromIndexAndOffset(UINT32(index), 0) : IoRingBufferRefFromPointer(requests[n].buffer.data());
+      HRESULT hr = api.BuildIoRingReadFile(ring, IoRingHandleRefFromHandle(handles[n].get()), buffer, UINT32(requests[n].bytes), 0, Tag(n), IOSQE_FLAGS_NONE);
+      if (FAILED(hr))
+      {
+        logger.Error(requests[n].error = HRESULT_CODE(hr), L"*** RCBatchIO::Load: Cannot queue read of [%s]", requests[n].path.c_str());
+        requests[n].buffer.release();
+        handles[n].reset();
+        registered[index] = SIZE_MAX;
+      }
+    }
+
+    registered.erase(std::remove(registered.begin(), registered.end(), SIZE_MAX), registered.end());
+    Submit(requests, registered, false, padding, true);
+  }
+
+  void Save(std::vector<RCFileRequest>& requests) override
+  {
+    NextBatch();
+    std::vector<wil::unique_hfile> handles(requests.size());
+    std::vector<size_t> queued;
+    for (size_t n = 0; n < requests.size(); ++n)
+    {
+      RCFileRequest& request = requests[n];
+      handles[n].reset(OpenForSave(request, ringWrites ? FILE_FLAG_OVERLAPPED : 0));
+      if (!handles[n])
+      {
+        continue;
+      }
+
+      if (!ringWrites)
+      {
+        DWORD written{};
+        if (!WriteFile(handles[n].get(), request.buffer.data(), DWORD(request.bytes), &written, nullptr) || request.bytes != written)
+        {
+          request.error = (request.bytes == written) ? GetLastError() : ERROR_WRITE_FAULT;
+          logger.Error(request.error, L"*** RCBatchIO::Save: Cannot write output file [%s]", request.path.c_str());
+        }
+        continue;
+      }
+
+      HRESULT hr = api.BuildIoRingWriteFile(ring, IoRingHandleRefFromHandle(handles[n].get()), IoRingBufferRefFromPointer(request.buffer.data()), UINT32(request.bytes), 0, FILE_WRITE_FLAGS_NONE, Tag(n), IOSQE_FLAGS_NONE);
+      if (FAILED(hr))
+      {
+        logger.Error(request.error = HRESULT_CODE(hr), L"*** RCBatchIO::Save: Cannot queue write of [%s]", request.path.c_str());
+        continue;
+      }
+      queued.push_back(n);
+    }
+
+    if (!queued.empty())
+    {
+      Submit(requests, queued, false, 0, false);
+    }
+
+    for (const auto& request : requests)
+    {
+      stats.bytesWritten += (NO_ERROR == request.error) ? request.bytes : 0;
+    }
+  }
+
+protected:
+  RCRingBatchIO(ILogger &rlogger, RCBufferPool& bufferPool, const Api& ringApi, HIORING handle)
+    : RCBatchIO(rlogger, bufferPool, QueueSize - 1)
+    , api(ringApi)
+    , ring(handle)
+    , ringWrites(nullptr != ringApi.BuildIoRingWriteFile && FALSE != ringApi.IsIoRingOpSupported(handle, IORING_OP_WRITE))
+    , batch(0)
+  {
+  }
+
+  // Completions carry the batch in their tag, one left over from an earlier
+  // batch never matches a request of this one
+  void NextBatch() { batch += QueueSize; }
+  UINT_PTR Tag(size_t n) const { return batch + n; }
+
+  // Submit the queued operations, wait for all of them and apply the results.
+  // Every request in 'queued' is failed until its own completion arrives, a
+  // failed submission fails them all.
+  bool Submit(std::vector<RCFileRequest>& requests, const std::vector<size_t>& queued, bool registration, size_t padding, bool reads)
+  {
+    for (size_t n : queued)
+    {
+      requests[n].error = ERROR_IO_INCOMPLETE;
+    }
+
+    unsigned count = unsigned(queued.size()) + (registration ? 1 : 0);
+    UINT32 submitted{};
+    HRESULT hr = api.SubmitIoRing(ring, count, INFINITE, &submitted);
+    ++stats.submissions;
+
+    bool success = SUCCEEDED(hr);
+    bool registered{false};
+    unsigned completed{};
+    IORING_CQE cqe{};
+    while (completed < count && S_OK == api.PopIoRingCompletion(ring, &cqe))
+    {
+      if (RegisterTag == cqe.UserData)
+      {
+        if (registration && !registered)
+        {
+          registered = true;
+          ++completed;
+          success = success && SUCCEEDED(cqe.ResultCode);
+        }
+        continue;
+      }
+
+      size_t n = size_t(cqe.UserData - batch);
+      if (cqe.UserData < batch || requests.size() <= n || ERROR_IO_INCOMPLETE != requests[n].error)
+      {
+        logger.Log(logDetail, L"Completion of an earlier I/O ring batch ignored.");
+        continue;
+      }
+      ++completed;
+
+      RCFileRequest& request = requests[n];
+      if (FAILED(cqe.ResultCode))
+      {
+        logger.Error(request.error = HRESULT_CODE(cqe.ResultCode), L"*** RCBatchIO: I/O failed for [%s]", request.path.c_str());
+        request.buffer.release();
+      }
+      else if (reads)
+      {
+        request.error = NO_ERROR;
+        Loaded(request, DWORD(cqe.Information), padding);
+        ++stats.files;
+        stats.bytesRead += cqe.Information;
+      }
+      else if (request.bytes != cqe.Information)
+      {
+        logger.Error(request.error = ERROR_WRITE_FAULT, L"*** RCBatchIO::Save: Short write of output file [%s]", request.path.c_str());
+      }
+      else
+      {
+        request.error = NO_ERROR;
+      }
+    }
+
+    if (FAILED(hr))
+    {
+      logger.Error(HRESULT_CODE(hr), L"*** RCBatchIO: I/O ring submission failed");
+    }
+    for (size_t n : queued)
+    {
+      RCFileRequest& request = requests[n];
+      if (FAILED(hr) || ERROR_IO_INCOMPLETE == request.error)
+      {
+        request.error = FAILED(hr) ? HRESULT_CODE(hr) : ERROR_OPERATION_ABORTED;
+        logger.Error(request.error, L"*** RCBatchIO: No completion for [%s]", request.path.c_str());
+        request.buffer.release();
+      }
+    }
+    return success && (!registration || registered);
+  }
+
+  Api api;
+  HIORING ring;
+  bool ringWrites;
+  UINT_PTR batch;
+};
+#endif
+
+
+std::unique_ptr<RCBatchIO> RCBatchIO::Create(ILogger &rlogger, RCBufferPool& bufferPool, unsigned threads, Backend backend)
+{
+#if RCVERSION_IORING
+  if (Threads != backend)
+  {
+    std::unique_ptr<RCBatchIO> ring = RCRingBatchIO::Open(rlogger, bufferPool);
+    if (ring)
+    {
+      return ring;
+    }
+  }
+#endif
+
+  if (Ring == backend)
+  {
+    Logger logger{rlogger};
+    logger.Log(logNormal, L"The Windows I/O ring is not available, using a thread pool.");
+  }
+  return std::unique_ptr<RCBatchIO>(new RCThreadBatchIO(rlogger, bufferPool, (0 == threads) ? 1 : threads));
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "Logger.h"
+#include "RCBufferPool.h"
+#include "RCOutputFiles.h"
+#include <windows.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One file of a batch. Load fills the buffer with the file and zero padding
+// like RCFileHandler::LoadFile, Save writes the first 'bytes' of the buffer.
+// With output files Save writes to 'temp' and the caller commits it.
+struct RCFileRequest
+{
+  std::wstring path;
+  std::wstring temp;
+  RCBuffer buffer;
+  size_t bytes;
+  unsigned long long size;
+  FILETIME lastWrite;
+  unsigned error;
+};
+
+// Loads and saves many files at once. The Windows I/O ring submits the reads
+// and writes of a batch together; where it is not available a thread pool
+// runs plain ReadFile and WriteFile calls.
+class RCBatchIO
+{
+public:
+  struct Statistics
+  {
+    unsigned long long files;
+    unsigned long long bytesRead;
+    unsigned long long bytesWritten;
+    unsigned long long submissions;
+  };
+
+  enum Backend {Automatic, Ring, Threads};
+
+  // Requests that did not get a buffer within the memory limit are left with
+  // ERROR_RETRY, the caller runs them in the next batch
+  virtual void Load(std::vector<RCFileRequest>& requests, size_t padding) = 0;
+  virtual void Save(std::vector<RCFileRequest>& requests) = 0;
+  virtual const wchar_t* Name() const = 0;
+
+  Statistics Stats() const { return stats; }
+  unsigned BatchSize() const { return batchSize; }
+  void Output(RCOutputFiles* value) { output = value; }
+
+  virtual ~RCBatchIO();
+
+  static std::unique_ptr<RCBatchIO> Create(ILogger &rlogger, RCBufferPool& pool, unsigned threads, Backend backend = Automatic);
+
+protected:
+  RCBatchIO(ILogger &rlogger, RCBufferPool& pool, unsigned batchSize);
+
+  HANDLE OpenForLoad(RCFileRequest& request, size_t padding, bool wait, DWORD flags);
+  HANDLE OpenForSave(RCFileRequest& request, DWORD flags);
+  void Loaded(RCFileRequest& request, DWORD readBytes, size_t padding);
+
+  ILogger &ilogger;
+  Logger logger;
+  RCBufferPool& pool;
+  unsigned batchSize;
+  Statistics stats;
+  RCOutputFiles* output;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
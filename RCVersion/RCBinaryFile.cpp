@@ -0,0 +1,208 @@
+#include "stdafx.h"
+#include "RCBinaryFile.h"
+#include "RCOutputFiles.h"
+#include "RCPeImage.h"
+#include "RCResFile.h"
+#include "wil/resource.h"
+
+RCBinaryFile::RCBinaryFile(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , valueNames(nullptr)
+{
+}
+
+RCBinaryFile::~RCBinaryFile()
+{
+}
+
+bool RCBinaryFile::IsImage(const wchar_t* path)
+{
+  static const wchar_t* const extensions[] = {L".exe", L".dll", L".sys", L".ocx", L".cpl", L".scr", L".drv", L".mui", L".efi", L".ax"};
+  const wchar_t* dot = path ? wcsrchr(path, L'.') : nullptr;
+  if (!dot || wcschr(dot, L'\\') || wcschr(dot, L'/'))
+  {
+    return false;
+  }
+  for (const wchar_t* extension : extensions)
+  {
+    if (0 == _wcsicmp(dot, extension))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RCBinaryFile::IsResources(const wchar_t* path)
+{
+  const wchar_t* dot = path ? wcsrchr(path, L'.') : nullptr;
+  return dot && 0 == _wcsicmp(dot, L".res");
+}
+
+bool RCBinaryFile::UpdateImage(const wchar_t* inpath, const wchar_t* outpath, int major, int minor, int build, int revision)
+{
+  logger.Log(logDetail, L"UpdateImage(%s,%s)", inpath, outpath);
+
+  if (0 == _wcsicmp(inpath, outpath))
+  {
+    wil::unique_hfile hFile(CreateFile(outpath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+    if (!hFile)
+    {
+      return logger.Error(error = GetLastError(), L"*** RCBinaryFile::UpdateImage: Cannot open file [%s]", outpath);
+    }
+    return PatchMapped(hFile.get(), outpath, major, minor, build, revision);
+  }
+
+  // The copy is patched as a temporary file next to the output and renamed
+  // over it, an image that cannot be patched leaves no output behind
+  RCOutputFiles output{ilogger};
+  output.Verbosity(logger.Verbosity());
+  std::wstring temp;
+  unsigned code{};
+  wil::unique_hfile created(output.Open(outpath, FILE_ATTRIBUTE_NORMAL, temp, code));
+  if (!created)
+  {
+    error = code;
+    return false;
+  }
+  created.reset();
+
+  bool patched{false};
+  if (!CopyFile(inpath, temp.c_str(), FALSE))
+  {
+    logger.Error(error = GetLastError(), L"*** RCBinaryFile::UpdateImage: Cannot copy [%s] to [%s]", inpath, temp.c_str());
+  }
+  else
+  {
+    wil::unique_hfile hFile(CreateFile(temp.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+    if (!hFile)
+    {
+      logger.Error(error = GetLastError(), L"*** RCBinaryFile::UpdateImage: Cannot open file [%s]", temp.c_str());
+    }
+    else
+    {
+      patched = PatchMapped(hFile.get(), outpath, major, minor, build, revision);
+    }
+  }
+
+  if (!patched)
+  {
+    output.Discard(temp);
+    return false;
+  }
+  if (!output.Replace(outpath, temp))
+  {
+    error = output.Error();
+    return false;
+  }
+  return true;
+}
+
+bool RCBinaryFile::PatchMapped(HANDLE hFile, const wchar_t* path, int major, int minor, int build, int revision)
+{
+  LARGE_INTEGER size{};
+  if (!GetFileSizeEx(hFile, &size))
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBinaryFile::UpdateImage: Cannot read file [%s]", path);
+  }
+  if (0 == size.QuadPart || size_t(-1) < static_cast<unsigned long long>(size.QuadPart))
+  {
+    return logger.Error(error = ERROR_BAD_EXE_FORMAT, L"*** RCBinaryFile::UpdateImage: [%s] is not a PE file", path);
+  }
+
+  wil::unique_handle mapping(CreateFileMapping(hFile, nullptr, PAGE_READWRITE, 0, 0, nullptr));
+  if (!mapping)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBinaryFile::UpdateImage: Cannot map file [%s]", path);
+  }
+  wil::unique_mapview_ptr<uint8_t> view(static_cast<uint8_t*>(MapViewOfFile(mapping.get(), FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0)));
+  if (!view)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBinaryFile::UpdateImage: Cannot map file [%s]", path);
+  }
+
+  unsigned changes{};
+  if (!PatchImage(view.get(), size_t(size.QuadPart), path, major, minor, build, revision, changes))
+  {
+    return false;
+  }
+  if (0 == changes)
+  {
+    logger.Log(logNormal, L"File [%s] already has the requested version, not modified.", path);
+    return true;
+  }
+  if (!FlushViewOfFile(view.get(), 0))
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBinaryFile::UpdateImage: Cannot write file [%s]", path);
+  }
+  logger.Log(logNormal, L"%u changes made to [%s].", changes, path);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// RCPeImage builds every new version resource before it writes the first
+// byte, so a file that cannot be patched is left as it was.
+// ---------------------------------------------------------------------------
+bool RCBinaryFile::PatchImage(uint8_t* data, size_t size, const wchar_t* path, int major, int minor, int build, int revision, unsigned& changes)
+{
+  RCPeImage image{data, size};
+  switch (image.UpdateVersion(major, minor, build, revision, Names(), changes))
+  {
+  case RCPeImage::Patched:
+  case RCPeImage::Unchanged:
+    break;
+  case RCPeImage::NotImage:
+    return logger.Error(error = ERROR_BAD_EXE_FORMAT, L"*** RCBinaryFile::UpdateImage: [%s] is not a PE file", path);
+  case RCPeImage::NoVersion:
+    return logger.Error(error = ERROR_RESOURCE_TYPE_NOT_FOUND, L"*** RCBinaryFile::UpdateImage: [%s] has no version resource", path);
+  case RCPeImage::Overflow:
+    return logger.Error(error = ERROR_ARITHMETIC_OVERFLOW, L"*** RCBinaryFile::UpdateImage: A version part of [%s] would be over 65535", path);
+  case RCPeImage::NoRoom:
+    return logger.Error(error = ERROR_INSUFFICIENT_BUFFER, L"*** RCBinaryFile::UpdateImage: The version resource of [%s] needs %u more bytes, link it again",
+      path, unsigned(image.Missing()));
+  default:
+    return logger.Error(error = ERROR_FILE_CORRUPT, L"*** RCBinaryFile::UpdateImage: Damaged resources in [%s]", path);
+  }
+
+  if (image.Signed())
+  {
+    logger.Log(logMinimum, L"Warning: [%s] was signed, sign it again.", path);
+  }
+  return true;
+}
+
+bool RCBinaryFile::PatchResources(std::vector<uint8_t>& data, const wchar_t* path, int major, int minor, int build, int revision, unsigned& changes)
+{
+  RCResFile resources{data};
+  switch (resources.UpdateVersion(major, minor, build, revision, Names(), changes))
+  {
+  case RCResFile::Patched:
+    break;
+  case RCResFile::NotResources:
+    return logger.Error(error = ERROR_BAD_FORMAT, L"*** RCBinaryFile::PatchResources: [%s] is not a 32-bit resource file", path);
+  case RCResFile::NoVersion:
+    return logger.Error(error = ERROR_RESOURCE_TYPE_NOT_FOUND, L"*** RCBinaryFile::PatchResources: [%s] has no version resource", path);
+  case RCResFile::Overflow:
+    return logger.Error(error = ERROR_ARITHMETIC_OVERFLOW, L"*** RCBinaryFile::PatchResources: A version part of [%s] would be over 65535", path);
+  default:
+    return logger.Error(error = ERROR_FILE_CORRUPT, L"*** RCBinaryFile::PatchResources: Damaged version resource in [%s]", path);
+  }
+  return true;
+}
+
+std::vector<std::u16string> RCBinaryFile::Names() const
+{
+  if (!valueNames)
+  {
+    return RCVersionInfo::DefaultNames();
+  }
+
+  std::vector<std::u16string> names;
+  for (const std::wstring& name : valueNames->Names())
+  {
+    names.emplace_back(name.begin(), name.end());
+  }
+  return names;
+}
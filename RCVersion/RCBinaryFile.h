@@ -0,0 +1,44 @@
+#pragma once
+#include "Logger.h"
+#include "RCValueNames.h"
+#include <string>
+#include <vector>
+
+// Version resources of compiled files, patched without the resource compiler
+// or the linker. A PE file (.exe, .dll, ...) is mapped and patched in place,
+// an output path other than the input gets a copy that is patched. Loaded
+// files, a .res file or an image found by its content, are patched in their
+// buffer and written like an RC file, see RCFormats. The file formats are
+// handled by plain C++ classes, RCPeImage, RCResFile and RCVersionInfo.
+class RCBinaryFile
+{
+public:
+  RCBinaryFile(ILogger &rlogger);
+  virtual ~RCBinaryFile();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+  // StringFileInfo names to update, nullptr for the default names
+  void ValueNames(const RCValueNames* value) { valueNames = value; }
+
+  // By the extension of the path
+  static bool IsImage(const wchar_t* path);
+  static bool IsResources(const wchar_t* path);
+
+  bool UpdateImage(const wchar_t* inpath, const wchar_t* outpath, int major, int minor, int build, int revision);
+  // The file in memory, 'path' names it in messages
+  bool PatchImage(uint8_t* data, size_t size, const wchar_t* path, int major, int minor, int build, int revision, unsigned& changes);
+  bool PatchResources(std::vector<uint8_t>& data, const wchar_t* path, int major, int minor, int build, int revision, unsigned& changes);
+
+protected:
+  bool PatchMapped(HANDLE hFile, const wchar_t* path, int major, int minor, int build, int revision);
+  std::vector<std::u16string> Names() const;
+
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+  const RCValueNames* valueNames;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
@@ -0,0 +1,250 @@
+#include "stdafx.h"
+#include "RCBufferPool.h"
+#include <new>
+
+RCBuffer::RCBuffer()
+  : pool(nullptr)
+  , block(nullptr)
+  , used(0)
+  , allocated(0)
+{
+}
+
+RCBuffer::RCBuffer(RCBuffer&& other)
+  : pool(other.pool)
+  , block(other.block)
+  , used(other.used)
+  , allocated(other.allocated)
+{
+  other.pool = nullptr;
+  other.block = nullptr;
+  other.used = 0;
+  other.allocated = 0;
+}
+
+RCBuffer& RCBuffer::operator=(RCBuffer&& other)
+{
+  if (this != &other)
+  {
+    release();
+    pool = other.pool;
+    block = other.block;
+    used = other.used;
+    allocated = other.allocated;
+    other.pool = nullptr;
+    other.block = nullptr;
+    other.used = 0;
+    other.allocated = 0;
+  }
+  return *this;
+}
+
+RCBuffer::~RCBuffer()
+{
+  release();
+}
+
+bool RCBuffer::resize(size_t bytes)
+{
+  if (allocated < bytes)
+  {
+    return false;
+  }
+  used = bytes;
+  return true;
+}
+
+void RCBuffer::release()
+{
+  if (pool)
+  {
+    pool->Return(block, allocated);
+  }
+  else
+  {
+    delete[] block;
+  }
+  pool = nullptr;
+  block = nullptr;
+  used = 0;
+  allocated = 0;
+}
+
+RCBuffer RCBuffer::Allocate(size_t bytes)
+{
+  RCBuffer buffer;
+  buffer.block = new (std::nothrow) unsigned char[bytes];
+  if (buffer.block)
+  {
+    buffer.used = buffer.allocated = bytes;
+  }
+  return buffer;
+}
+
+
+RCBufferPool::RCBufferPool(size_t memoryLimit)
+  : cached(ClassIndex(size_t(1) << (sizeof(size_t) * 8 - 1)) + 1)
+  , limit(memoryLimit)
+  , allocatedBytes(0)
+  , usedBytes(0)
+  , stats{}
+{
+}
+
+RCBufferPool::~RCBufferPool()
+{
+  Trim();
+}
+
+size_t RCBufferPool::ClassSize(size_t bytes)
+{
+  size_t size = MinimumClass;
+  while (size < bytes && 0 != (size << 1))
+  {
+    size <<= 1;
+  }
+  return (size < bytes) ? bytes : size;
+}
+
+unsigned RCBufferPool::ClassIndex(size_t bytes)
+{
+  unsigned index{};
+  for (size_t size = MinimumClass; size < bytes && 0 != (size << 1); size <<= 1)
+  {
+    ++index;
+  }
+  return index;
+}
+
+// ---------------------------------------------------------------------------
+// Cached buffer of the size class, or a new one while the limit allows it
+// ---------------------------------------------------------------------------
+RCBuffer RCBufferPool::Acquire(size_t bytes, bool wait)
+{
+  size_t size = ClassSize(bytes);
+  unsigned index = ClassIndex(size);
+
+  RCBuffer buffer;
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;)
+  {
+    auto& blocks = cached[index];
+    if (!blocks.empty())
+    {
+      buffer.block = blocks.back();
+      blocks.pop_back();
+      ++stats.reuses;
+      break;
+    }
+
+    if (allocatedBytes + size <= limit || 0 == usedBytes)
+    {
+      // Over the limit only for one oversized request, make room first
+      while (limit < allocatedBytes + size && DropCached(index))
+      {
+      }
+      buffer.block = new (std::nothrow) unsigned char[size];
+      if (!buffer.block)
+      {
+        return buffer;
+      }
+      allocatedBytes += size;
+      ++stats.allocations;
+      break;
+    }
+
+    if (!DropCached(index))
+    {
+      if (!wait)
+      {
+        return buffer;
+      }
+      ++stats.waits;
+      returned.wait(guard);
+    }
+  }
+
+  usedBytes += size;
+  if (stats.peakBytes < allocatedBytes)
+  {
+    stats.peakBytes = allocatedBytes;
+  }
+
+  buffer.pool = this;
+  buffer.allocated = size;
+  buffer.used = bytes;
+  return buffer;
+}
+
+void RCBufferPool::Return(unsigned char* block, size_t bytes)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    usedBytes -= bytes;
+    if (limit < allocatedBytes)
+    {
+      // Left over from an oversized request
+      delete[] block;
+      allocatedBytes -= bytes;
+    }
+    else
+    {
+      cached[ClassIndex(bytes)].push_back(block);
+    }
+  }
+  returned.notify_all();
+}
+
+// Free one cached buffer of another size class, called with the lock held
+bool RCBufferPool::DropCached(unsigned keep)
+{
+  for (unsigned index = unsigned(cached.size()); 0 < index--;)
+  {
+    auto& blocks = cached[index];
+    if (index != keep && !blocks.empty())
+    {
+      delete[] blocks.back();
+      blocks.pop_back();
+      allocatedBytes -= size_t(MinimumClass) << index;
+      return true;
+    }
+  }
+  return false;
+}
+
+void RCBufferPool::Trim()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  for (unsigned index = 0; index < cached.size(); ++index)
+  {
+    for (unsigned char* block : cached[index])
+    {
+      delete[] block;
+      allocatedBytes -= size_t(MinimumClass) << index;
+    }
+    cached[index].clear();
+  }
+}
+
+size_t RCBufferPool::Limit()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return limit;
+}
+
+void RCBufferPool::Limit(size_t bytes)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    limit = bytes;
+  }
+  returned.notify_all();
+}
+
+RCBufferPool::Statistics RCBufferPool::Stats()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  Statistics current = stats;
+  current.currentBytes = allocatedBytes;
+  return current;
+}
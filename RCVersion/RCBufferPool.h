@@ -0,0 +1,85 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+class RCBufferPool;
+
+// Memory block from a buffer pool, returned to the pool when destroyed.
+// The contents are not initialized.
+class RCBuffer
+{
+public:
+  RCBuffer();
+  RCBuffer(RCBuffer&& other);
+  RCBuffer& operator=(RCBuffer&& other);
+  ~RCBuffer();
+
+  RCBuffer(const RCBuffer&) = delete;
+  RCBuffer& operator=(const RCBuffer&) = delete;
+
+  unsigned char* data() const { return block; }
+  size_t size() const { return used; }
+  size_t capacity() const { return allocated; }
+  bool empty() const { return 0 == used; }
+  bool resize(size_t bytes);
+  void release();
+
+  // Without a pool, for callers that load a single file
+  static RCBuffer Allocate(size_t bytes);
+
+protected:
+  friend class RCBufferPool;
+  RCBufferPool* pool;
+  unsigned char* block;
+  size_t used;
+  size_t allocated;
+};
+
+// Buffers in power of two size classes, reused across files and threads.
+// The memory held by the pool, in use or cached, stays below the limit:
+// Acquire first drops cached buffers of other sizes, then waits until a
+// buffer is returned. A single request larger than the limit is served
+// once no other buffer is in use.
+class RCBufferPool
+{
+public:
+  struct Statistics
+  {
+    unsigned long long allocations;
+    unsigned long long reuses;
+    unsigned long long waits;
+    size_t currentBytes;
+    size_t peakBytes;
+  };
+
+  static const size_t DefaultLimit = 256 * 1024 * 1024;
+  static const size_t MinimumClass = 4096;
+
+  RCBufferPool(size_t memoryLimit = DefaultLimit);
+  virtual ~RCBufferPool();
+
+  // Without waiting the buffer is empty when the limit does not allow it now
+  RCBuffer Acquire(size_t bytes, bool wait = true);
+  void Trim();
+
+  size_t Limit();
+  void Limit(size_t bytes);
+  Statistics Stats();
+
+  static size_t ClassSize(size_t bytes);
+
+protected:
+  friend class RCBuffer;
+  void Return(unsigned char* block, size_t bytes);
+  bool DropCached(unsigned keep);
+  static unsigned ClassIndex(size_t bytes);
+
+  std::mutex lock;
+  std::condition_variable returned;
+  std::vector<std::vector<unsigned char*>> cached;
+  size_t limit;
+  size_t allocatedBytes;
+  size_t usedBytes;
+  Statistics stats;
+};
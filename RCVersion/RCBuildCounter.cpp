@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "RCBuildCounter.h"
+#include "wil/resource.h"
+#include <stdlib.h>
+
+static const char CounterMagic[8] = {'R', 'C', 'V', 'B', 'U', 'I', 'L', 'D'};
+
+RCBuildCounter::RCBuildCounter(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+{
+}
+
+RCBuildCounter::~RCBuildCounter()
+{
+}
+
+bool RCBuildCounter::Next(const wchar_t* path, int& build)
+{
+  wil::unique_hfile hFile(CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+  if (!hFile)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBuildCounter::Next: Cannot open counter file [%s]", path);
+  }
+
+  OVERLAPPED range{};
+  if (!LockFileEx(hFile.get(), LOCKFILE_EXCLUSIVE_LOCK, 0, sizeof(Layout), 0, &range))
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBuildCounter::Next: Cannot lock counter file [%s]", path);
+  }
+
+  bool taken = Take(hFile.get(), path, build);
+  UnlockFileEx(hFile.get(), 0, sizeof(Layout), 0, &range);
+  return taken;
+}
+
+bool RCBuildCounter::Peek(const wchar_t* path, int& build)
+{
+  Layout layout{};
+  unsigned long long size{};
+  wil::unique_hfile hFile(CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+  if (hFile)
+  {
+    LARGE_INTEGER fileSize{};
+    DWORD readBytes{};
+    if (!GetFileSizeEx(hFile.get(), &fileSize) || !ReadFile(hFile.get(), &layout, sizeof(Layout), &readBytes, nullptr))
+    {
+      return logger.Error(error = GetLastError(), L"*** RCBuildCounter::Peek: Cannot read counter file [%s]", path);
+    }
+    size = fileSize.QuadPart;
+  }
+  else if (ERROR_FILE_NOT_FOUND != GetLastError())
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBuildCounter::Peek: Cannot open counter file [%s]", path);
+  }
+
+  if (0 != memcmp(layout.magic, CounterMagic, sizeof(CounterMagic)) && !Initialize(layout, size, path))
+  {
+    return false;
+  }
+
+  LONG next = layout.last + 1;
+  if (next <= 0 || MaxBuild < next)
+  {
+    return logger.Error(error = ERROR_ARITHMETIC_OVERFLOW, L"*** RCBuildCounter::Peek: Build number %ld from [%s] is out of range, reset the counter", long(next), path);
+  }
+
+  build = int(next);
+  logger.Log(logNormal, L"Build number %d from [%s], the counter is not advanced.", build, path);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Runs under the file lock. Mapping a shorter file extends it with zeros.
+// ---------------------------------------------------------------------------
+bool RCBuildCounter::Take(HANDLE hFile, const wchar_t* path, int& build)
+{
+  LARGE_INTEGER size{};
+  if (!GetFileSizeEx(hFile, &size))
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBuildCounter::Next: Cannot read counter file [%s]", path);
+  }
+
+  wil::unique_handle mapping(CreateFileMapping(hFile, nullptr, PAGE_READWRITE, 0, sizeof(Layout), nullptr));
+  if (!mapping)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBuildCounter::Next: Cannot map counter file [%s]", path);
+  }
+  wil::unique_mapview_ptr<Layout> layout(static_cast<Layout*>(MapViewOfFile(mapping.get(), FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(Layout))));
+  if (!layout)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCBuildCounter::Next: Cannot map counter file [%s]", path);
+  }
+
+  if (0 != memcmp(layout.get()->magic, CounterMagic, sizeof(CounterMagic)) && !Initialize(*layout.get(), size.QuadPart, path))
+  {
+    return false;
+  }
+
+  LONG next = InterlockedIncrement(&layout.get()->last);
+  if (next <= 0 || MaxBuild < next)
+  {
+    return logger.Error(error = ERROR_ARITHMETIC_OVERFLOW, L"*** RCBuildCounter::Next: Build number %ld from [%s] is out of range, reset the counter", long(next), path);
+  }
+
+  build = int(next);
+  logger.Log(logNormal, L"Build number %d from [%s].", build, path);
+  return true;
+}
+
+// A new file starts at 0, a short text file at the number it holds
+bool RCBuildCounter::Initialize(Layout& layout, unsigned long long size, const wchar_t* path)
+{
+  char text[sizeof(Layout) + 1]{};
+  memcpy(text, &layout, sizeof(Layout));
+
+  char* tail{text};
+  unsigned long last = strtoul(text, &tail, 10);
+  while (' ' == *tail || '\t' == *tail || '\r' == *tail || '\n' == *tail)
+  {
+    ++tail;
+  }
+  if (sizeof(Layout) < size || 0 != *tail || static_cast<unsigned long>(MaxBuild) < last)
+  {
+    return logger.Error(error = ERROR_INVALID_DATA, L"*** RCBuildCounter::Next: [%s] is not a build counter file", path);
+  }
+
+  memset(&layout, 0, sizeof(Layout));
+  layout.last = LONG(last);
+  memcpy(layout.magic, CounterMagic, sizeof(CounterMagic));
+  logger.Log(logInfo, L"Build counter [%s] started after %lu.", path, last);
+  return true;
+}
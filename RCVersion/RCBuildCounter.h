@@ -0,0 +1,44 @@
+#pragma once
+#include "Logger.h"
+#include <windows.h>
+
+// Build numbers for builds without a source control revision, /b:@<file>.
+// All RCVersion processes of the machine share the counter file: each maps
+// it and takes the next number with an interlocked increment while it holds
+// a lock on the file, which also guards the creation of the file. The file
+// holds the last number given out; a new file or one holding just a number
+// as text, for example made with 'echo 1000 > build.counter', continues
+// after that number.
+class RCBuildCounter
+{
+public:
+  static const int MaxBuild = 65535;
+
+  RCBuildCounter(ILogger &rlogger);
+  virtual ~RCBuildCounter();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+
+  bool Next(const wchar_t* path, int& build);
+  // The number Next would give out, the file is neither created nor changed
+  bool Peek(const wchar_t* path, int& build);
+
+protected:
+  struct Layout
+  {
+    char magic[8];
+    volatile LONG last;
+    LONG reserved;
+  };
+
+  bool Take(HANDLE hFile, const wchar_t* path, int& build);
+  bool Initialize(Layout& layout, unsigned long long size, const wchar_t* path);
+
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
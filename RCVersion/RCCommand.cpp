@@ -0,0 +1,295 @@
+#include "stdafx.h"
+#include "RCCommand.h"
+#include "RCBuildCounter.h"
+#include "RCContentGroups.h"
+#include "RCDiffWriter.h"
+#include "RCFileHandler.h"
+#include "RCFileSet.h"
+#include "RCHeaderWriter.h"
+#include "RCIncludeGraph.h"
+#include "RCOutputCache.h"
+#include "RCPipeline.h"
+#include "RCResWriter.h"
+#include "RCValueNames.h"
+#include "RCWatcher.h"
+#include <thread>
+
+RCCommand::RCCommand(ILogger &rlogger, RCOffsetCache* offsetCache, RCBufferPool* bufferPool, RCIncludeCache* includes)
+  : ilogger(rlogger)
+  , cache(offsetCache)
+  , pool(bufferPool)
+  , includeCache(includes)
+{
+}
+
+RCCommand::~RCCommand()
+{
+}
+
+unsigned RCCommand::Execute(const RCVersionOptions& options)
+{
+  RCFileHandler handler{ilogger};
+  handler.Verbosity(options.verbosity);
+  handler.Cache(cache);
+
+  RCValueNames names{ilogger};
+  names.Verbosity(options.verbosity);
+  bool named{true};
+  for (const auto& name : options.valueNames)
+  {
+    named = names.Add(name) && named;
+  }
+  for (const auto& file : options.valueFiles)
+  {
+    named = names.AddFile(file.c_str()) && named;
+  }
+  if (!named)
+  {
+    return names.Error();
+  }
+  handler.ValueNames(&names);
+
+  RCDiffWriter diff{ilogger};
+  diff.Verbosity(options.verbosity);
+  if (options.diff)
+  {
+    if (!diff.Open(options.diffFile.c_str()))
+    {
+      return diff.Error();
+    }
+    handler.Diff(&diff);
+  }
+
+  RCOutputCache outputs{ilogger};
+  outputs.Verbosity(options.verbosity);
+  if (!options.cacheDirectory.empty())
+  {
+    if (!outputs.Open(options.cacheDirectory.c_str()))
+    {
+      return outputs.Error();
+    }
+    handler.OutputCache(&outputs);
+  }
+
+  // Explicit options override the parts of the version file
+  int major{options.majorVersion};
+  int minor{options.minorVersion};
+  int build{options.buildNumber};
+  int revision{options.revision};
+  if (!options.buildCounter.empty())
+  {
+    RCBuildCounter counter{ilogger};
+    counter.Verbosity(options.verbosity);
+    // A diff only shows the change, it does not use up a build number
+    if (!(options.diff ? counter.Peek(options.buildCounter.c_str(), build) : counter.Next(options.buildCounter.c_str(), build)))
+    {
+      return counter.Error();
+    }
+  }
+  if (!options.versionFile.empty() && !options.watch)
+  {
+    int source[4] = {-1, -1, -1, -1};
+    if (!handler.ReadVersion(options.versionFile.c_str(), source[0], source[1], source[2], source[3]))
+    {
+      return handler.Error();
+    }
+    major = (major < 0) ? source[0] : major;
+    minor = (minor < 0) ? source[1] : minor;
+    build = (build < 0) ? source[2] : build;
+    revision = (revision < 0) ? source[3] : revision;
+  }
+
+  RCIncludeGraph graph{ilogger};
+  graph.Verbosity(options.verbosity);
+  graph.Cache(includeCache);
+  graph.Directories(options.includeDirectories);
+
+  if (!options.MultiFile())
+  {
+    // The input file goes to the output file, included files are updated in place
+    std::vector<std::wstring> included;
+    if (options.includes)
+    {
+      included = graph.Resolve({options.inputFile});
+    }
+    if (options.diff)
+    {
+      std::vector<std::wstring> named{options.inputFile};
+      named.insert(named.end(), included.begin(), included.end());
+      diff.Root(named);
+    }
+    bool input = included.empty() || included[0] == options.inputFile;
+    if (input && !handler.UpdateFile(options.inputFile.c_str(), options.outputFile.c_str(), major, minor, build, revision))
+    {
+      return handler.Error();
+    }
+    // Without a version block of its own the input still becomes the output file
+    if (!input && 0 != _wcsicmp(options.inputFile.c_str(), options.outputFile.c_str()))
+    {
+      std::vector<unsigned char> content;
+      if (!handler.LoadFile(options.inputFile.c_str(), 0, content) ||
+        !handler.SaveFile(options.outputFile.c_str(), content.data(), size_t(handler.LoadedSize())))
+      {
+        return handler.Error();
+      }
+    }
+    std::wstring versioned = input ? options.outputFile : included[0];
+    if (input && !included.empty())
+    {
+      included.erase(included.begin());
+    }
+    unsigned result = included.empty() ? NO_ERROR : Update(options, handler, names, included, major, minor, build, revision);
+
+    // The resource is compiled from the file holding the version block
+    if (NO_ERROR == result && !options.resFile.empty())
+    {
+      RCResWriter writer{ilogger};
+      writer.Verbosity(options.verbosity);
+      if (!writer.Write(versioned.c_str(), options.resFile.c_str()))
+      {
+        return writer.Error();
+      }
+    }
+    if (NO_ERROR == result && !options.headerFile.empty())
+    {
+      RCHeaderWriter writer{ilogger};
+      writer.Verbosity(options.verbosity);
+      if (!writer.Write(versioned.c_str(), options.headerFile.c_str()))
+      {
+        return writer.Error();
+      }
+    }
+    return result;
+  }
+
+  RCFileSet files{ilogger};
+  files.Verbosity(options.verbosity);
+  bool listed{true};
+  if (!options.inputFile.empty())
+  {
+    listed = files.AddFile(options.inputFile.c_str()) && listed;
+  }
+  for (const auto& list : options.listFiles)
+  {
+    listed = files.AddListFile(list.c_str()) && listed;
+  }
+  for (const auto& directory : options.searchDirectories)
+  {
+    listed = files.AddDirectory(directory.c_str()) && listed;
+  }
+  if (listed && 0 != options.shardCount)
+  {
+    listed = files.Shard(options.shardIndex, options.shardCount, options.shardBySize);
+  }
+
+  if (!listed)
+  {
+    return files.Error();
+  }
+
+  std::vector<std::wstring> paths = files.Paths();
+  if (options.includes)
+  {
+    paths = graph.Resolve(paths);
+  }
+  if (options.diff)
+  {
+    diff.Root(paths);
+  }
+
+  if (options.watch)
+  {
+    RCWatcher watcher{ilogger};
+    watcher.Verbosity(options.verbosity);
+    watcher.ValueNames(&names);
+    if (!watcher.Run(paths, options.versionFile.c_str(), major, minor, build, revision, options.watchDelay))
+    {
+      return watcher.Error();
+    }
+    return NO_ERROR;
+  }
+
+  return Update(options, handler, names, paths, major, minor, build, revision);
+}
+
+// ---------------------------------------------------------------------------
+// Files updated in place, in a pipeline or in batches
+// ---------------------------------------------------------------------------
+unsigned RCCommand::Update(const RCVersionOptions& options, RCFileHandler& handler, const RCValueNames& names, const std::vector<std::wstring>& paths,
+  int major, int minor, int build, int revision)
+{
+  // Without a shared pool one buffer is reused for all files of this run
+  RCBufferPool local{options.memoryLimit};
+  RCBufferPool* buffers = pool ? pool : &local;
+  handler.Pool(buffers);
+
+  Logger logger{ilogger};
+  logger.Verbosity(options.verbosity);
+  int statsLevel = options.stats ? 1 : 5;
+
+  // Copies of one content share its update, within the memory of the run
+  std::unique_ptr<RCContentGroups> contents;
+  if (options.dedup)
+  {
+    contents = std::make_unique<RCContentGroups>(options.memoryLimit);
+  }
+  handler.ContentGroups(contents.get());
+
+  bool updated{};
+  unsigned error{};
+  if (options.pipeline)
+  {
+    RCPipeline pipeline{ilogger};
+    pipeline.Verbosity(options.verbosity);
+    pipeline.Cache(cache);
+    pipeline.ValueNames(&names);
+    pipeline.Diff(handler.Diff());
+    pipeline.OutputCache(handler.OutputCache());
+    pipeline.ContentGroups(contents.get());
+    pipeline.Pool(buffers);
+    pipeline.Transaction(options.transaction);
+    pipeline.Workers(options.pipelineWorkers[0], options.pipelineWorkers[1], options.pipelineWorkers[2]);
+
+    updated = pipeline.Run(paths, major, minor, build, revision);
+    error = pipeline.Error();
+
+    for (int stage = 0; stage < RCPipeline::StageCount; ++stage)
+    {
+      RCPipeline::StageStatistics pipe = pipeline.Stats(RCPipeline::Stage(stage));
+      logger.Log(statsLevel, L"Stage %s: %u threads, %llu files, queue depth max %u average %.1f, waited %llu ms for input, %llu ms for output.",
+        RCPipeline::StageName(RCPipeline::Stage(stage)), pipe.workers, pipe.items, unsigned(pipe.maxDepth), pipe.averageDepth, pipe.inputStall / 1000, pipe.outputStall / 1000);
+    }
+  }
+  else
+  {
+    unsigned threads = max(2u, std::thread::hardware_concurrency());
+    std::unique_ptr<RCBatchIO> batchIO = RCBatchIO::Create(ilogger, *buffers, threads, RCBatchIO::Backend(options.ioBackend));
+    handler.BatchIO(batchIO.get());
+    handler.Transaction(options.transaction);
+
+    updated = handler.UpdateFiles(paths, major, minor, build, revision);
+    error = handler.Error();
+
+    RCBatchIO::Statistics io = batchIO->Stats();
+    logger.Log(statsLevel, L"I/O: %s, %llu files, %llu bytes read, %llu bytes written, %llu submissions.", batchIO->Name(), io.files, io.bytesRead, io.bytesWritten, io.submissions);
+  }
+
+  RCBufferPool::Statistics stats = buffers->Stats();
+  logger.Log(statsLevel, L"Buffers: %llu allocated, %llu reused, %llu waits, peak %llu KB.", stats.allocations, stats.reuses, stats.waits, (unsigned long long)stats.peakBytes / 1024);
+
+  if (handler.OutputCache())
+  {
+    RCOutputCache::Statistics outputs = handler.OutputCache()->Stats();
+    double rate = outputs.lookups ? 100.0 * double(outputs.hits) / double(outputs.lookups) : 0.0;
+    logger.Log(options.stats ? 1 : 3, L"Output cache: %llu lookups, %llu hits (%.1f%%), %llu stored.", outputs.lookups, outputs.hits, rate, outputs.stores);
+  }
+  if (contents)
+  {
+    RCContentGroups::Statistics groups = contents->Stats();
+    logger.Log(options.stats ? 1 : 3, L"Duplicates: %llu unique contents, %llu copies reused, %llu KB kept.", groups.unique, groups.copies,
+      (unsigned long long)groups.bytes / 1024);
+    handler.ContentGroups(nullptr);
+  }
+
+  return updated ? NO_ERROR : error;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "ILogger.h"
+#include "RCVersionOptions.h"
+#include "RCOffsetCache.h"
+#include "RCBufferPool.h"
+#include "RCIncludeCache.h"
+#include "RCFileHandler.h"
+#include "RCValueNames.h"
+
+// Runs one validated command line, in process or in the server for a client
+class RCCommand
+{
+protected:
+  ILogger &ilogger;
+  RCOffsetCache* cache;
+  RCBufferPool* pool;
+  RCIncludeCache* includeCache;
+
+public:
+  RCCommand(ILogger &rlogger, RCOffsetCache* offsetCache = nullptr, RCBufferPool* bufferPool = nullptr, RCIncludeCache* includes = nullptr);
+  virtual ~RCCommand();
+
+  unsigned Execute(const RCVersionOptions& options);
+
+protected:
+  unsigned Update(const RCVersionOptions& options, RCFileHandler& handler, const RCValueNames& names, const std::vector<std::wstring>& paths,
+    int major, int minor, int build, int revision);
+};
@@ -0,0 +1,88 @@
+#include "stdafx.h"
+#include "RCContentGroups.h"
+
+RCContentGroups::RCContentGroups(size_t limit)
+  : byteLimit(limit)
+  , stats{}
+{
+}
+
+RCContentGroups::~RCContentGroups()
+{
+}
+
+uint64_t RCContentGroups::Hash(const unsigned char* data, size_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t n = 0; n < size; ++n)
+  {
+    hash ^= data[n];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+const RCContentGroups::Content* RCContentGroups::Match(uint64_t hash, const unsigned char* input, size_t size, const std::string& arguments) const
+{
+  auto range = contents.equal_range(hash);
+  for (auto entry = range.first; entry != range.second; ++entry)
+  {
+    const Content& content = entry->second;
+    if (content.input.size() == size && content.arguments == arguments && 0 == memcmp(content.input.data(), input, size))
+    {
+      return &content;
+    }
+  }
+  return nullptr;
+}
+
+bool RCContentGroups::Find(const unsigned char* input, size_t size, const std::string& arguments, RCBuffer& buffer, size_t& bytes,
+  std::vector<size_t>& offsets)
+{
+  uint64_t hash = Hash(input, size);
+  std::lock_guard<std::mutex> guard(lock);
+  const Content* content = Match(hash, input, size, arguments);
+  if (!content)
+  {
+    return false;
+  }
+
+  size_t needed = content->output.size() + 2;
+  if (buffer.capacity() < needed)
+  {
+    buffer = RCBuffer::Allocate(needed);
+  }
+  if (!buffer.resize(max(buffer.size(), needed)))
+  {
+    return false;
+  }
+  memcpy(buffer.data(), content->output.data(), content->output.size());
+  memset(buffer.data() + content->output.size(), 0, 2);
+  bytes = content->output.size();
+  offsets = content->offsets;
+  ++stats.copies;
+  return true;
+}
+
+void RCContentGroups::Add(const unsigned char* input, size_t size, const std::string& arguments, const unsigned char* output, size_t bytes,
+  const std::vector<size_t>& offsets)
+{
+  uint64_t hash = Hash(input, size);
+  std::lock_guard<std::mutex> guard(lock);
+  // Another parser may have updated the same content at the same time
+  if (byteLimit < stats.bytes + size + bytes || Match(hash, input, size, arguments))
+  {
+    return;
+  }
+
+  Content content{arguments, std::vector<unsigned char>(input, input + size), std::vector<unsigned char>(output, output + bytes), offsets};
+  contents.emplace(hash, std::move(content));
+  stats.bytes += size + bytes;
+  ++stats.unique;
+}
+
+RCContentGroups::Statistics RCContentGroups::Stats()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return stats;
+}
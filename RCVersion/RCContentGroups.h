@@ -0,0 +1,55 @@
+#pragma once
+#include "RCBufferPool.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+// Byte-identical inputs of a multi-file run, /dedup: the first file with a
+// content is updated, every copy loaded after it takes the output and the
+// version offsets from here instead of being parsed again. A content is
+// matched by its hash and then compared byte by byte, together with the
+// format and the version arguments, which decide the output as much as the
+// bytes do. Shared by the parser threads of a pipeline.
+//
+// The inputs and outputs kept here are limited to 'byteLimit', files beyond
+// it are updated on their own.
+class RCContentGroups
+{
+public:
+  struct Statistics
+  {
+    unsigned long long unique;
+    unsigned long long copies;
+    size_t bytes;
+  };
+
+  RCContentGroups(size_t byteLimit = RCBufferPool::DefaultLimit);
+  virtual ~RCContentGroups();
+
+  // The output replaces the input in 'buffer', followed by two zero bytes
+  bool Find(const unsigned char* input, size_t size, const std::string& arguments, RCBuffer& buffer, size_t& bytes, std::vector<size_t>& offsets);
+  void Add(const unsigned char* input, size_t size, const std::string& arguments, const unsigned char* output, size_t bytes, const std::vector<size_t>& offsets);
+
+  Statistics Stats();
+
+  // 64-bit FNV-1a
+  static uint64_t Hash(const unsigned char* data, size_t size);
+
+protected:
+  struct Content
+  {
+    std::string arguments;
+    std::vector<unsigned char> input;
+    std::vector<unsigned char> output;
+    std::vector<size_t> offsets;
+  };
+
+  const Content* Match(uint64_t hash, const unsigned char* input, size_t size, const std::string& arguments) const;
+
+  std::mutex lock;
+  std::unordered_multimap<uint64_t, Content> contents;
+  size_t byteLimit;
+  Statistics stats;
+};
@@ -0,0 +1,313 @@
+#include "stdafx.h"
+#include "RCDiffWriter.h"
+#include "RCUpdater.h"
+#include <algorithm>
+
+RCDiffWriter::RCDiffWriter(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , output(INVALID_HANDLE_VALUE)
+  , files(0)
+{
+}
+
+RCDiffWriter::~RCDiffWriter()
+{
+}
+
+bool RCDiffWriter::Open(const wchar_t* path)
+{
+  wchar_t current[MAX_PATH]{};
+  DWORD chars = GetCurrentDirectory(MAX_PATH, current);
+  directory = (0 < chars && chars < MAX_PATH) ? current : L"";
+
+  if (!path || !*path)
+  {
+    output = GetStdHandle(STD_OUTPUT_HANDLE);
+    return true;
+  }
+
+  file.reset(CreateFile(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+  if (!file)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCDiffWriter::Open: Cannot create diff file [%s]", path);
+  }
+  output = file.get();
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// git apply takes no absolute path and no '..', a file outside the current
+// directory moves the root of the patch up to a directory holding all files
+// ---------------------------------------------------------------------------
+void RCDiffWriter::Root(const std::vector<std::wstring>& paths)
+{
+  for (const auto& path : paths)
+  {
+    std::string name = PatchPath(path.c_str(), directory.c_str());
+    if (std::string::npos != name.find(':') || 0 == name.find('/'))
+    {
+      std::wstring common = CommonDirectory(paths);
+      if (common.empty())
+      {
+        logger.Log(logMinimum, L"Warning: The files have no directory in common, the diff names them by their full paths.");
+        return;
+      }
+      directory = common;
+      logger.Log(logNormal, L"Paths in the diff are relative to [%s], apply it there.", directory.c_str());
+      return;
+    }
+  }
+}
+
+bool RCDiffWriter::Add(const wchar_t* path, const unsigned char* before, size_t beforeBytes, const unsigned char* after, size_t afterBytes, bool isUnicode,
+  const std::vector<size_t>& offsets)
+{
+  std::string hunks = isUnicode
+    ? Hunks(reinterpret_cast<const wchar_t*>(before), beforeBytes / sizeof(wchar_t), reinterpret_cast<const wchar_t*>(after), afterBytes / sizeof(wchar_t), offsets)
+    : Hunks(reinterpret_cast<const char*>(before), beforeBytes, reinterpret_cast<const char*>(after), afterBytes, offsets);
+  if (hunks.empty())
+  {
+    logger.Log(logInfo, L"No lines of [%s] changed.", path);
+    return true;
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  std::string name = PatchPath(path, directory.c_str());
+  std::string text = "diff --git a/" + name + " b/" + name + "\n--- a/" + name + "\n+++ b/" + name + "\n" + hunks;
+  DWORD written{};
+  if (!WriteFile(output, text.data(), DWORD(text.size()), &written, nullptr) || text.size() != written)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCDiffWriter::Add: Cannot write the diff of [%s]", path);
+  }
+  ++files;
+  logger.Log(logDetail, L"Diff of [%s] written.", path);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Lines as they go into the diff
+// ---------------------------------------------------------------------------
+static void AppendText(std::string& out, const char* text, size_t chars)
+{
+  out.append(text, chars);
+}
+
+static void AppendText(std::string& out, const wchar_t* text, size_t chars)
+{
+  if (0 < chars && 0xFEFF == *text)
+  {
+    ++text;
+    --chars;
+  }
+  int bytes = WideCharToMultiByte(CP_UTF8, 0, text, int(chars), nullptr, 0, nullptr, nullptr);
+  if (0 < bytes)
+  {
+    size_t start = out.size();
+    out.resize(start + size_t(bytes));
+    WideCharToMultiByte(CP_UTF8, 0, text, int(chars), &out[start], bytes, nullptr, nullptr);
+  }
+}
+
+template <class CharT>
+static size_t LineStart(const CharT* text, size_t pos)
+{
+  while (0 < pos && '\n' != text[pos - 1])
+  {
+    --pos;
+  }
+  return pos;
+}
+
+template <class CharT>
+static size_t LineEnd(const CharT* text, size_t pos, size_t chars)
+{
+  while (pos < chars && '\n' != text[pos++])
+  {
+  }
+  return pos;
+}
+
+template <class CharT>
+static void AppendLine(std::string& out, char prefix, const CharT* text, size_t start, size_t end)
+{
+  out += prefix;
+  AppendText(out, text + start, end - start);
+  if (start == end || '\n' != text[end - 1])
+  {
+    out += "\n\\ No newline at end of file\n";
+  }
+}
+
+// ---------------------------------------------------------------------------
+// The changed lines are found from the offsets alone: the text between the
+// versions is the same before and after, so the start of a line in the old
+// text is its start in the new one less the growth of the versions before it
+// ---------------------------------------------------------------------------
+template <class CharT>
+static std::string MakeHunks(const CharT* before, size_t beforeChars, const CharT* after, size_t afterChars, const std::vector<size_t>& offsets)
+{
+  struct Line
+  {
+    size_t number;
+    size_t before;
+    size_t after;
+  };
+
+  std::vector<Line> lines;
+  size_t number{1};
+  size_t counted{};
+  ptrdiff_t grown{};
+  for (size_t offset : offsets)
+  {
+    size_t old = size_t(ptrdiff_t(offset) - grown);
+    if (afterChars <= offset || beforeChars <= old)
+    {
+      break;
+    }
+
+    size_t start = LineStart(after, offset);
+    for (; counted < start; ++counted)
+    {
+      number += ('\n' == after[counted]) ? 1 : 0;
+    }
+    if (lines.empty() || lines.back().number != number)
+    {
+      lines.push_back(Line{number, size_t(ptrdiff_t(start) - grown), start});
+    }
+
+    CharT* newTail{nullptr};
+    CharT* oldTail{nullptr};
+    int parts[4]{};
+    if (!RCUpdater<CharT>::parse(const_cast<CharT*>(after + offset), &newTail, parts[0], parts[1], parts[2], parts[3]) ||
+        !RCUpdater<CharT>::parse(const_cast<CharT*>(before + old), &oldTail, parts[0], parts[1], parts[2], parts[3]))
+    {
+      break;
+    }
+    grown += (newTail - (after + offset)) - (oldTail - (before + old));
+  }
+
+  // A version replaced by the same digits leaves its line alone
+  std::vector<Line> changed;
+  for (const Line& line : lines)
+  {
+    size_t oldEnd = LineEnd(before, line.before, beforeChars);
+    size_t newEnd = LineEnd(after, line.after, afterChars);
+    if (oldEnd - line.before != newEnd - line.after || !std::equal(before + line.before, before + oldEnd, after + line.after))
+    {
+      changed.push_back(line);
+    }
+  }
+
+  std::string hunks;
+  size_t next{};
+  while (next < changed.size())
+  {
+    // Changes closer than twice the context share a hunk
+    size_t last = next;
+    while (last + 1 < changed.size() && changed[last + 1].number - changed[last].number <= 2 * RCDiffWriter::Context + 1)
+    {
+      ++last;
+    }
+
+    size_t first = changed[next].number;
+    size_t b = changed[next].before;
+    size_t a = changed[next].after;
+    for (unsigned n = 0; n < RCDiffWriter::Context && 1 < first; ++n, --first)
+    {
+      b = LineStart(before, b - 1);
+      a = LineStart(after, a - 1);
+    }
+
+    std::string body;
+    std::string removed;
+    std::string added;
+    size_t count{};
+    size_t k = next;
+    for (size_t line = first; b < beforeChars && (k <= last || line <= changed[last].number + RCDiffWriter::Context); ++line, ++count)
+    {
+      size_t oldEnd = LineEnd(before, b, beforeChars);
+      size_t newEnd = LineEnd(after, a, afterChars);
+      if (k <= last && changed[k].number == line)
+      {
+        AppendLine(removed, '-', before, b, oldEnd);
+        AppendLine(added, '+', after, a, newEnd);
+        ++k;
+      }
+      else
+      {
+        body += removed + added;
+        removed.clear();
+        added.clear();
+        AppendLine(body, ' ', before, b, oldEnd);
+      }
+      b = oldEnd;
+      a = newEnd;
+    }
+    body += removed + added;
+
+    char header[128];
+    _snprintf_s(header, _TRUNCATE, "@@ -%zu,%zu +%zu,%zu @@\n", first, count, first, count);
+    hunks += header + body;
+    next = last + 1;
+  }
+  return hunks;
+}
+
+std::string RCDiffWriter::Hunks(const char* before, size_t beforeChars, const char* after, size_t afterChars, const std::vector<size_t>& offsets)
+{
+  return MakeHunks(before, beforeChars, after, afterChars, offsets);
+}
+
+std::string RCDiffWriter::Hunks(const wchar_t* before, size_t beforeChars, const wchar_t* after, size_t afterChars, const std::vector<size_t>& offsets)
+{
+  return MakeHunks(before, beforeChars, after, afterChars, offsets);
+}
+
+std::wstring RCDiffWriter::CommonDirectory(const std::vector<std::wstring>& paths)
+{
+  if (paths.empty())
+  {
+    return std::wstring();
+  }
+  // Up to the last separator of the first path all paths share
+  std::wstring common = paths[0].substr(0, paths[0].find_last_of(L"\\/") + 1);
+  for (const auto& path : paths)
+  {
+    size_t length = 0;
+    while (length < common.size() && length < path.size() && towlower(common[length]) == towlower(path[length]))
+    {
+      ++length;
+    }
+    common.erase(common.find_last_of(L"\\/", length ? length - 1 : 0) + 1);
+  }
+  while (!common.empty() && (L'\\' == common.back() || L'/' == common.back()))
+  {
+    common.pop_back();
+  }
+  if (!common.empty() && L':' == common.back())
+  {
+    common += L'\\';
+  }
+  return common;
+}
+
+std::string RCDiffWriter::PatchPath(const wchar_t* path, const wchar_t* directory)
+{
+  std::wstring name = path ? path : L"";
+  size_t length = directory ? wcslen(directory) : 0;
+  while (0 < length && (L'\\' == directory[length - 1] || L'/' == directory[length - 1]))
+  {
+    --length;
+  }
+  if (0 < length && length < name.size() && 0 == _wcsnicmp(name.c_str(), directory, length) && (L'\\' == name[length] || L'/' == name[length]))
+  {
+    name.erase(0, length + 1);
+  }
+  std::replace(name.begin(), name.end(), L'\\', L'/');
+
+  std::string text;
+  AppendText(text, name.c_str(), name.size());
+  return text;
+}
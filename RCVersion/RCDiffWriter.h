@@ -0,0 +1,62 @@
+#pragma once
+#include "Logger.h"
+#include <windows.h>
+#include "wil/resource.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+// /diff mode: the updated files are not written, the changed lines go to a
+// unified diff instead, to stdout or a file, ready for git apply. The hunks
+// come from the offsets of the versions that were replaced, the text is not
+// compared. A version never spans lines, so every line keeps its number and
+// only the lines holding a changed version differ.
+//
+// Paths are relative to the current directory with forward slashes, or to the
+// deepest directory holding all files when one lies outside it. Lines of
+// UTF-16 files are written as UTF-8, git applies those only to files it
+// checks out with working-tree-encoding=UTF-16LE.
+class RCDiffWriter
+{
+public:
+  static const unsigned Context = 3;
+
+  RCDiffWriter(ILogger &rlogger);
+  virtual ~RCDiffWriter();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+  // Files with at least one hunk
+  unsigned Files() const { return files; }
+
+  // An empty path writes to stdout
+  bool Open(const wchar_t* path);
+  // The files of the run, before the first Add
+  void Root(const std::vector<std::wstring>& paths);
+
+  // The text of 'path' as loaded and after the update, 'offsets' are those
+  // of the versions in the updated text. Called from any thread, each file
+  // is written in one piece.
+  bool Add(const wchar_t* path, const unsigned char* before, size_t beforeBytes, const unsigned char* after, size_t afterBytes, bool isUnicode,
+    const std::vector<size_t>& offsets);
+
+  static std::string Hunks(const char* before, size_t beforeChars, const char* after, size_t afterChars, const std::vector<size_t>& offsets);
+  static std::string Hunks(const wchar_t* before, size_t beforeChars, const wchar_t* after, size_t afterChars, const std::vector<size_t>& offsets);
+  // 'path' relative to 'directory', as it is named in a patch
+  static std::string PatchPath(const wchar_t* path, const wchar_t* directory);
+  // The deepest directory holding all 'paths', empty when there is none
+  static std::wstring CommonDirectory(const std::vector<std::wstring>& paths);
+
+protected:
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+  std::mutex lock;
+  wil::unique_hfile file;
+  HANDLE output;
+  std::wstring directory;
+  unsigned files;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
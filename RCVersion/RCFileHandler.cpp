@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include "RCFileHandler.h"
+#include "RCBinaryFile.h"
+#include "RCFileLock.h"
 #include "RCUpdater.h"
 #include "wil/resource.h"
 
@@ -7,6 +9,18 @@ RCFileHandler::RCFileHandler(ILogger &rlogger)
   : ilogger(rlogger)
   , logger(rlogger)
   , error(0)
+  , cache(nullptr)
+  , loadedSize(0)
+  , loadedWriteTime{}
+  , skipUnchanged(false)
+  , pool(nullptr)
+  , batchIO(nullptr)
+  , transaction(false)
+  , valueNames(nullptr)
+  , formats(&RCFormats::Default())
+  , diff(nullptr)
+  , outputCache(nullptr)
+  , contents(nullptr)
 {
 }
 
@@ -18,27 +32,167 @@ bool RCFileHandler::UpdateFile(const wchar_t *inpath, const wchar_t *outpath, in
 {
   logger.Log(logDetail, L"UpdateFile(%s,%s)", NN(inpath), NN(outpath));
 
-  std::vector<unsigned char> buffer;
+  const RCFormat& format = formats->ByPath(inpath);
+  if (format.Mapped())
+  {
+    if (diff)
+    {
+      logger.Log(logNormal, L"Binary file [%s] left out of the diff.", NN(inpath));
+      return true;
+    }
+    RCBinaryFile binary{ilogger};
+    binary.Verbosity(logger.Verbosity());
+    binary.ValueNames(valueNames);
+    if (!format.UpdateMapped(binary, inpath, outpath, major, minor, build, revision))
+    {
+      error = binary.Error();
+      return false;
+    }
+    return true;
+  }
 
-  if (!LoadFile(inpath, 1024, buffer))
+  bool inPlace = inpath && outpath && 0 == _wcsicmp(inpath, outpath);
+  for (unsigned attempt = 1; ; ++attempt)
   {
-    return false;
+    RCFileLock fileLock{ilogger};
+    fileLock.Verbosity(logger.Verbosity());
+    if (inPlace && RetryLimit <= attempt && !fileLock.Acquire(outpath))
+    {
+      error = fileLock.Error();
+      return false;
+    }
+
+    RCBuffer buffer;
+
+    if (!LoadFile(inpath, 1024, buffer))
+    {
+      return false;
+    }
+
+    bool modified{};
+    bool isUnicode{};
+    size_t outBytes{};
+    std::vector<size_t> offsets;
+    if (!UpdateLoaded(inpath, outpath, buffer, loadedSize, loadedWriteTime, major, minor, build, revision, modified, isUnicode, outBytes, offsets))
+    {
+      return false;
+    }
+
+    if (!modified)
+    {
+      return true;
+    }
+
+    RCOutputFiles::FileState loaded{loadedSize, loadedWriteTime};
+    if (SaveFile(outpath, buffer.data(), outBytes, nullptr, 0, inPlace ? &loaded : nullptr))
+    {
+      StoreOffsets(outpath, isUnicode, offsets);
+      return true;
+    }
+
+    if (cache)
+    {
+      cache->Remove(outpath);
+    }
+    if (ERROR_RETRY != error || RetryLimit <= attempt)
+    {
+      return false;
+    }
+    logger.Log(logNormal, L"Updating [%s] again, attempt %u.", outpath, attempt + 1);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Update the versions of a loaded file in its buffer. 'modified' is false when
+// the file already has the requested version and need not be written. The
+// format comes from the loaded bytes, so a file is read once whatever it is.
+// ---------------------------------------------------------------------------
+bool RCFileHandler::UpdateLoaded(const wchar_t* inpath, const wchar_t* outpath, RCBuffer& buffer, unsigned long long size, const FILETIME& lastWrite,
+  int major, int minor, int build, int revision, bool& modified, bool& isUnicode, size_t& outBytes, std::vector<size_t>& offsets)
+{
+  const RCFormat& format = formats->Detect(inpath, buffer.data(), size_t(size));
+  logger.Log(logDetail, L"Format of [%s]: %s", NN(inpath), format.Name());
+
+  if (!format.Text() && diff)
+  {
+    logger.Log(logNormal, L"Binary file [%s] left out of the diff.", NN(inpath));
+    modified = false;
+    return true;
   }
 
   int flags = IS_TEXT_UNICODE_UNICODE_MASK;
-  bool isUnicode = 0 != IsTextUnicode(buffer.data(), int(min(buffer.size(), size_t{256})), &flags);
+  isUnicode = format.Text() && 0 != IsTextUnicode(buffer.data(), int(min(buffer.size(), size_t{256})), &flags);
 
-  unsigned changes;
-  if (isUnicode)
+  offsets.clear();
+  if (format.Text() && cache && cache->Find(inpath, size, lastWrite, isUnicode, offsets, NamesKey()))
+  {
+    logger.Log(logDetail, L"Using %u cached version offsets for [%s].", unsigned(offsets.size()), NN(inpath));
+  }
+
+  std::vector<unsigned char> original;
+  if (skipUnchanged || diff || contents)
+  {
+    original.assign(buffer.data(), buffer.data() + size_t(size));
+  }
+
+  std::string arguments;
+  if (outputCache || contents)
   {
-    changes = UpdateBuffer(reinterpret_cast<wchar_t*>(buffer.data()), buffer.size() / sizeof(wchar_t), major, minor, build, revision);
+    arguments = std::to_string(major) + "." + std::to_string(minor) + "." + std::to_string(build) + "." + std::to_string(revision) +
+      " names " + std::to_string(NamesKey()) + " format ";
+    for (const wchar_t* name = format.Name(); *name; ++name)
+    {
+      arguments += char(*name);
+    }
+  }
+
+  // A copy of an input updated earlier in this run takes its output and offsets
+  if (contents && contents->Find(original.data(), size_t(size), arguments, buffer, outBytes, offsets))
+  {
+    logger.Log(logNormal, L"[%s] has the content of an earlier file, its update is reused for [%s].", NN(inpath), NN(outpath));
+    return Finish(format, inpath, outpath, original, buffer, size, lastWrite, isUnicode, outBytes, offsets, modified);
+  }
+
+  // The same bytes updated with the same arguments before, by this or another run
+  std::wstring cacheKey;
+  if (outputCache && !diff)
+  {
+    cacheKey = outputCache->Key(buffer.data(), size_t(size), arguments);
+    if (outputCache->Find(cacheKey, buffer, outBytes))
+    {
+      offsets.clear();
+      modified = !(skipUnchanged && 0 == _wcsicmp(inpath, outpath) && outBytes == size && 0 == memcmp(original.data(), buffer.data(), outBytes));
+      logger.Log(logNormal, modified ? L"Output for [%s] found in the cache, writing file [%s]." : L"Output for [%s] found in the cache, file [%s] not modified.",
+        NN(inpath), NN(outpath));
+      return true;
+    }
+  }
+
+  unsigned changes{};
+  if (!format.Text())
+  {
+    outBytes = size_t(size);
+    if (!PatchLoaded(format, inpath, buffer, outBytes, major, minor, build, revision, changes))
+    {
+      return false;
+    }
+    if (0 == changes && 0 == _wcsicmp(inpath, outpath))
+    {
+      logger.Log(logNormal, L"File [%s] already has the requested version, not modified.", NN(outpath));
+      modified = false;
+      return true;
+    }
+  }
+  else if (isUnicode)
+  {
+    changes = UpdateBuffer(reinterpret_cast<wchar_t*>(buffer.data()), buffer.size() / sizeof(wchar_t), offsets, major, minor, build, revision, &format);
   }
   else
   {
-    changes = UpdateBuffer(reinterpret_cast<char*>(buffer.data()), buffer.size() / sizeof(char), major, minor, build, revision);
+    changes = UpdateBuffer(reinterpret_cast<char*>(buffer.data()), buffer.size() / sizeof(char), offsets, major, minor, build, revision, &format);
   }
 
-  if (0 == changes)
+  if (0 == changes && format.Text())
   {
     logger.Log(logNormal, L"No changes made to [%s], file [%s] not modified.", NN(inpath), NN(outpath));
     error = ERROR_FILE_CORRUPT;
@@ -46,21 +200,365 @@ bool RCFileHandler::UpdateFile(const wchar_t *inpath, const wchar_t *outpath, in
   }
 
   logger.Log(logNormal, L"%u changes made to [%s], writing file [%s].", changes, NN(inpath), NN(outpath));
-  unsigned outBytes = unsigned(isUnicode ? wcslen(reinterpret_cast<wchar_t*>(buffer.data()))*sizeof(wchar_t) : strlen(reinterpret_cast<char*>(buffer.data()))*sizeof(char));
+  if (format.Text())
+  {
+    outBytes = isUnicode ? wcslen(reinterpret_cast<wchar_t*>(buffer.data()))*sizeof(wchar_t) : strlen(reinterpret_cast<char*>(buffer.data()))*sizeof(char);
+  }
+
+  if (outputCache)
+  {
+    outputCache->Store(cacheKey, buffer.data(), outBytes);
+  }
+  if (contents)
+  {
+    contents->Add(original.data(), size_t(size), arguments, buffer.data(), outBytes, offsets);
+  }
+
+  return Finish(format, inpath, outpath, original, buffer, size, lastWrite, isUnicode, outBytes, offsets, modified);
+}
+
+// An updated buffer goes to the diff or is written, unless it is unchanged
+bool RCFileHandler::Finish(const RCFormat& format, const wchar_t* inpath, const wchar_t* outpath, const std::vector<unsigned char>& original, RCBuffer& buffer,
+  unsigned long long size, const FILETIME& lastWrite, bool isUnicode, size_t outBytes, const std::vector<size_t>& offsets, bool& modified)
+{
+  modified = true;
+
+  if (diff)
+  {
+    modified = false;
+    if (!diff->Add(inpath, original.data(), size_t(size), buffer.data(), outBytes, isUnicode, offsets))
+    {
+      error = diff->Error();
+      return false;
+    }
+    return true;
+  }
+
+  // Rewriting identical content would only wake up file watchers and builds
+  if (skipUnchanged && 0 == _wcsicmp(inpath, outpath) && outBytes == size && 0 == memcmp(original.data(), buffer.data(), outBytes))
+  {
+    logger.Log(logNormal, L"File [%s] already has the requested version, not modified.", NN(outpath));
+    if (cache && format.Text())
+    {
+      cache->Store(outpath, size, lastWrite, isUnicode, offsets, NamesKey());
+    }
+    modified = false;
+  }
+
+  return true;
+}
+
+// The version resources of a binary format in the loaded bytes
+bool RCFileHandler::PatchLoaded(const RCFormat& format, const wchar_t* inpath, RCBuffer& buffer, size_t& bytes, int major, int minor, int build, int revision,
+  unsigned& changes)
+{
+  RCBinaryFile binary{ilogger};
+  binary.Verbosity(logger.Verbosity());
+  binary.ValueNames(valueNames);
+  if (!format.Patch(binary, inpath, buffer, bytes, major, minor, build, revision, changes))
+  {
+    error = (0 != binary.Error()) ? binary.Error() : ERROR_OUTOFMEMORY;
+    return false;
+  }
+  return true;
+}
+
+// Offsets of a file just written, for the next run over the same file
+void RCFileHandler::StoreOffsets(const wchar_t* outpath, bool isUnicode, const std::vector<size_t>& offsets)
+{
+  if (!cache || offsets.empty())
+  {
+    return;
+  }
+
+  WIN32_FILE_ATTRIBUTE_DATA data{};
+  if (GetFileAttributesEx(outpath, GetFileExInfoStandard, &data))
+  {
+    ULARGE_INTEGER size{};
+    size.LowPart = data.nFileSizeLow;
+    size.HighPart = data.nFileSizeHigh;
+    cache->Store(outpath, size.QuadPart, data.ftLastWriteTime, isUnicode, offsets, NamesKey());
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Update files in place, keep going after a failure, report the first error.
+// The files written in batches are committed together at the end, in a
+// transaction only when none of them failed.
+// ---------------------------------------------------------------------------
+bool RCFileHandler::UpdateFiles(const std::vector<std::wstring>& paths, int major, int minor, int build, int revision)
+{
+  logger.Log(logDetail, L"UpdateFiles(%u files)", unsigned(paths.size()));
+
+  // A transaction stages its files also without batch I/O
+  if (transaction && !batchIO)
+  {
+    RCBufferPool ownPool;
+    std::unique_ptr<RCBatchIO> threadIO = RCBatchIO::Create(ilogger, pool ? *pool : ownPool, 1, RCBatchIO::Threads);
+    batchIO = threadIO.get();
+    bool updated = UpdateFiles(paths, major, minor, build, revision);
+    batchIO = nullptr;
+    return updated;
+  }
+
+  unsigned failed{};
+  unsigned firstError{};
+  if (batchIO)
+  {
+    RCOutputFiles output{ilogger};
+    output.Verbosity(logger.Verbosity());
+    output.Transaction(transaction);
+    batchIO->Output(&output);
+    std::vector<Written> written;
+
+    // Images patched where they are mapped follow once the loaded files are
+    // committed; a transaction loads and stages them with the other files
+    std::vector<std::wstring> staged;
+    std::vector<std::wstring> mapped;
+    for (const auto& path : paths)
+    {
+      (!transaction && formats->ByPath(path.c_str()).Mapped() ? mapped : staged).push_back(path);
+    }
+
+    size_t next{};
+    while (next < staged.size())
+    {
+      std::vector<RCFileRequest> requests;
+      for (; next < staged.size() && requests.size() < batchIO->BatchSize(); ++next)
+      {
+        requests.emplace_back();
+        requests.back().path = staged[next];
+      }
+
+      batchIO->Load(requests, 1024);
+
+      // Files that did not fit into the memory limit start the next batch
+      size_t loaded{};
+      while (loaded < requests.size() && ERROR_RETRY != requests[loaded].error)
+      {
+        ++loaded;
+      }
+      next -= requests.size() - loaded;
+      requests.resize(loaded);
+
+      failed += UpdateBatch(requests, major, minor, build, revision, output, written, firstError);
+    }
+
+    batchIO->Output(nullptr);
+    if (transaction && 0 != failed)
+    {
+      output.Abort();
+      error = firstError;
+      logger.Log(logInfo, L"%u of %u files failed, transaction rolled back, no file changed.", failed, unsigned(paths.size()));
+      return false;
+    }
+
+    std::vector<std::wstring> changed;
+    bool committed = output.Commit([&](size_t tag, unsigned code) {
+      if (ERROR_RETRY == code && !transaction)
+      {
+        changed.push_back(written[tag].path);
+        return;
+      }
+      if (NO_ERROR != code)
+      {
+        ++failed;
+        firstError = (0 == firstError) ? code : firstError;
+        if (cache)
+        {
+          cache->Remove(written[tag].path.c_str());
+        }
+        return;
+      }
+      StoreOffsets(written[tag].path.c_str(), written[tag].isUnicode, written[tag].offsets);
+    });
+    if (transaction && !committed)
+    {
+      error = output.Error();
+      logger.Log(logInfo, L"Transaction rolled back, no file changed.");
+      return false;
+    }
+
+    // Files replaced by another process since they were read start over, then
+    // the mapped images are patched
+    changed.insert(changed.end(), mapped.begin(), mapped.end());
+    for (const auto& path : changed)
+    {
+      if (!UpdateFile(path.c_str(), path.c_str(), major, minor, build, revision))
+      {
+        ++failed;
+        firstError = (0 == firstError) ? error : firstError;
+      }
+    }
+  }
+  else
+  {
+    for (const auto& path : paths)
+    {
+      if (!UpdateFile(path.c_str(), path.c_str(), major, minor, build, revision))
+      {
+        ++failed;
+        if (0 == firstError)
+        {
+          firstError = error;
+        }
+      }
+    }
+  }
+
+  error = firstError;
+  logger.Log(logInfo, L"%u files updated, %u failed.", unsigned(paths.size()) - failed, failed);
+  return 0 == failed;
+}
+
+// ---------------------------------------------------------------------------
+// Update the loaded files of a batch in memory and save the changed ones
+// ---------------------------------------------------------------------------
+unsigned RCFileHandler::UpdateBatch(std::vector<RCFileRequest>& requests, int major, int minor, int build, int revision, RCOutputFiles& output,
+  std::vector<Written>& written, unsigned& firstError)
+{
+  unsigned failed{};
+  std::vector<RCFileRequest> writes;
+  std::vector<Written> changed;
+  for (auto& request : requests)
+  {
+    bool modified{};
+    bool isUnicode{};
+    size_t outBytes{};
+    std::vector<size_t> offsets;
+    const wchar_t* path = request.path.c_str();
+    if (NO_ERROR != request.error || !UpdateLoaded(path, path, request.buffer, request.size, request.lastWrite, major, minor, build, revision, modified, isUnicode, outBytes, offsets))
+    {
+      ++failed;
+      firstError = (0 == firstError) ? ((NO_ERROR != request.error) ? request.error : error) : firstError;
+      continue;
+    }
+
+    if (modified)
+    {
+      request.bytes = outBytes;
+      writes.push_back(std::move(request));
+      changed.push_back(Written{writes.back().path, isUnicode, std::move(offsets)});
+    }
+  }
 
-  if (!SaveFile(outpath, buffer.data(), outBytes))
+  batchIO->Save(writes);
+
+  for (size_t n = 0; n < writes.size(); ++n)
+  {
+    if (NO_ERROR != writes[n].error)
+    {
+      ++failed;
+      firstError = (0 == firstError) ? writes[n].error : firstError;
+      output.Discard(writes[n].temp);
+      if (cache)
+      {
+        cache->Remove(writes[n].path.c_str());
+      }
+      continue;
+    }
+    RCOutputFiles::FileState loaded{writes[n].size, writes[n].lastWrite};
+    output.Written(writes[n].path, writes[n].temp, written.size(), &loaded);
+    written.push_back(std::move(changed[n]));
+  }
+
+  return failed;
+}
+
+// ---------------------------------------------------------------------------
+// Version source file: the FILEVERSION of an RC file, otherwise the first
+// four part version in the text, for example "1.2.3.4" or "1, 2, 3, 4"
+// ---------------------------------------------------------------------------
+template <class CharT>
+static bool FindFirstVersion(const RCFormat& format, RCUpdater<CharT>& updater, CharT* buffer, int& major, int& minor, int& build, int& revision)
+{
+  CharT* tail{nullptr};
+  std::vector<size_t> offsets;
+  if (format.Find(updater, buffer, offsets))
+  {
+    return updater.parse(buffer + offsets[0], &tail, major, minor, build, revision);
+  }
+
+  for (CharT* p = buffer; *p; ++p)
+  {
+    bool start = (L'0' <= *p && *p <= L'9') && (p == buffer || !(L'0' <= p[-1] && p[-1] <= L'9'));
+    if (start && updater.parse(p, &tail, major, minor, build, revision))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RCFileHandler::ReadVersion(const wchar_t* path, int& major, int& minor, int& build, int& revision)
+{
+  logger.Log(logDetail, L"ReadVersion(%s)", NN(path));
+
+  std::vector<unsigned char> buffer;
+  if (!LoadFile(path, 2, buffer))
   {
     return false;
   }
 
+  return ParseVersion(path, buffer, major, minor, build, revision);
+}
+
+// The buffer holds the text with at least two zero bytes after it
+bool RCFileHandler::ParseVersion(const wchar_t* name, std::vector<unsigned char>& buffer, int& major, int& minor, int& build, int& revision)
+{
+  int flags = IS_TEXT_UNICODE_UNICODE_MASK;
+  bool isUnicode = 0 != IsTextUnicode(buffer.data(), int(min(buffer.size(), size_t{256})), &flags);
+
+  const RCFormat& format = formats->Detect(name, buffer.data(), buffer.size());
+  bool found;
+  if (isUnicode)
+  {
+    RCUpdater<wchar_t> updater{ilogger};
+    found = FindFirstVersion(format, updater, reinterpret_cast<wchar_t*>(buffer.data()), major, minor, build, revision);
+  }
+  else
+  {
+    RCUpdater<char> updater{ilogger};
+    found = FindFirstVersion(format, updater, reinterpret_cast<char*>(buffer.data()), major, minor, build, revision);
+  }
+
+  if (!found)
+  {
+    return logger.Error(error = ERROR_INVALID_DATA, L"*** RCFileHandler::ReadVersion: No version found in [%s]", NN(name));
+  }
+
+  logger.Log(logInfo, L"Version source [%s]: %d.%d.%d.%d", NN(name), major, minor, build, revision);
   return true;
 }
 
+unsigned RCFileHandler::UpdateBuffer(char* buffer, size_t chars, std::vector<size_t>& offsets, int major, int minor, int build, int revision, const RCFormat* format) const
+{
+  logger.Log(logDetail, L"UpdateBuffer<char>(...,%u,%u offsets)", unsigned(chars), unsigned(offsets.size()));
+  RCUpdater<char> updater{ilogger};
+  updater.verbosity = logger.Verbosity();
+  updater.valueNames = valueNames ? &valueNames->Narrow() : nullptr;
+  // Without a format the text is an RC file, the default format
+  const RCFormat& text = format ? *format : RCFormats::Default().ByPath(nullptr);
+  return text.Update(updater, buffer, chars, offsets, major, minor, build, revision);
+}
+
+unsigned RCFileHandler::UpdateBuffer(wchar_t* buffer, size_t chars, std::vector<size_t>& offsets, int major, int minor, int build, int revision, const RCFormat* format) const
+{
+  logger.Log(logDetail, L"UpdateBuffer<wchar>(...,%u,%u offsets)", unsigned(chars), unsigned(offsets.size()));
+  RCUpdater<wchar_t> updater{ilogger};
+  updater.verbosity = logger.Verbosity();
+  updater.valueNames = valueNames ? &valueNames->Wide() : nullptr;
+  // Without a format the text is an RC file, the default format
+  const RCFormat& text = format ? *format : RCFormats::Default().ByPath(nullptr);
+  return text.Update(updater, buffer, chars, offsets, major, minor, build, revision);
+}
+
 unsigned RCFileHandler::RCFileHandler::UpdateBuffer(char* buffer, size_t chars, int major, int minor, int build, int revision) const
 {
   logger.Log(logDetail, L"UpdateBuffer<char>(...,%u)", unsigned(chars));
   RCUpdater<char> updater{ilogger};
   updater.verbosity = logger.Verbosity();
+  updater.valueNames = valueNames ? &valueNames->Narrow() : nullptr;
   unsigned changes = updater.UpdateVersion(buffer, chars, major, minor, build, revision);
   return changes;
 }
@@ -70,32 +568,75 @@ unsigned RCFileHandler::RCFileHandler::UpdateBuffer(wchar_t* buffer, size_t char
   logger.Log(logDetail, L"UpdateBuffer<wchar>(...,%u)", unsigned(chars));
   RCUpdater<wchar_t> updater{ilogger};
   updater.verbosity = logger.Verbosity();
+  updater.valueNames = valueNames ? &valueNames->Wide() : nullptr;
   unsigned changes = updater.UpdateVersion(buffer, chars, major, minor, build, revision);
   return changes;
 }
 
 // ---------------------------------------------------------------------------
-// 
+// Open the input file, check and record its size and last write time
 // ---------------------------------------------------------------------------
-bool RCFileHandler::LoadFile(const wchar_t* path, size_t padding, std::vector<unsigned char>& buffer)
+HANDLE RCFileHandler::OpenInput(const wchar_t* path, size_t padding, DWORD& bytes)
 {
   logger.Log(logDetail, L"Reading file [%s]...", path);
   if (!path || !*path)
   {
-    return logger.Error(error = ERROR_INVALID_PARAMETER, L"*** RCFileUpdater::Load: Input file path must not be empty");
+    logger.Error(error = ERROR_INVALID_PARAMETER, L"*** RCFileUpdater::Load: Input file path must not be empty");
+    return INVALID_HANDLE_VALUE;
   }
 
   wil::unique_hfile hFile(CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr));
   if (!hFile)
   {
-    return logger.Error(error = GetLastError(), L"*** RCFileUpdater::Load: Cannot open input file", path);
+    logger.Error(error = GetLastError(), L"*** RCFileUpdater::Load: Cannot open input file", path);
+    return INVALID_HANDLE_VALUE;
+  }
+
+  BY_HANDLE_FILE_INFORMATION info{};
+  if (!GetFileInformationByHandle(hFile.get(), &info))
+  {
+    logger.Error(error = GetLastError(), L"*** RCFileUpdater::Load: Cannot read input file", path);
+    return INVALID_HANDLE_VALUE;
   }
 
   ULARGE_INTEGER li{};
-  li.LowPart = GetFileSize(hFile.get(), &li.HighPart);
+  li.LowPart = info.nFileSizeLow;
+  li.HighPart = info.nFileSizeHigh;
+  loadedSize = li.QuadPart;
+  loadedWriteTime = info.ftLastWriteTime;
   if (0 != li.HighPart || (0x7FFFFFFF - padding) <= li.LowPart)
   {
-    return logger.Error(error = ERROR_FILE_CORRUPT, L"*** RCFileUpdater::Load: File too large", path);
+    logger.Error(error = ERROR_FILE_CORRUPT, L"*** RCFileUpdater::Load: File too large", path);
+    return INVALID_HANDLE_VALUE;
+  }
+
+  bytes = li.LowPart;
+  return hFile.release();
+}
+
+// ---------------------------------------------------------------------------
+// Read the whole file, the padding after the text is zero filled
+// ---------------------------------------------------------------------------
+bool RCFileHandler::ReadInput(const wchar_t* path, HANDLE hFile, unsigned char* buffer, DWORD bytes, size_t totalSize)
+{
+  DWORD readBytes{};
+  BOOL ok = ReadFile(hFile, buffer, bytes, &readBytes, nullptr);
+  if (!ok || bytes < readBytes)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCFileUpdater::Load: Cannot read input file", path);
+  }
+
+  memset(buffer + readBytes, 0, totalSize - readBytes);
+  return true;
+}
+
+bool RCFileHandler::LoadFile(const wchar_t* path, size_t padding, std::vector<unsigned char>& buffer)
+{
+  DWORD bytes{};
+  wil::unique_hfile hFile(OpenInput(path, padding, bytes));
+  if (!hFile)
+  {
+    return false;
   }
 
   if (padding < 2)
@@ -103,7 +644,7 @@ bool RCFileHandler::LoadFile(const wchar_t* path, size_t padding, std::vector<un
     padding = 2;
   }
 
-  size_t totalSize = li.LowPart + padding;
+  size_t totalSize = bytes + padding;
   try
   {
     buffer.resize(totalSize);
@@ -113,23 +654,52 @@ bool RCFileHandler::LoadFile(const wchar_t* path, size_t padding, std::vector<un
     return logger.Error(error = ERROR_OUTOFMEMORY, L"*** RCFileUpdater::Load: File too large", path);
   }
 
-  DWORD readBytes{};
-  BOOL ok = ReadFile(hFile.get(), buffer.data(), DWORD(li.LowPart), &readBytes, nullptr);
-  if (!ok || li.LowPart < readBytes)
+  if (!ReadInput(path, hFile.get(), buffer.data(), bytes, totalSize))
   {
     buffer.clear();
-    return logger.Error(error = GetLastError(), L"*** RCFileUpdater::Load: Cannot read input file", path);
+    return false;
   }
+  return true;
+}
 
-  buffer[readBytes] = 0;
-  buffer[readBytes + 1] = 0;
+// ---------------------------------------------------------------------------
+// Pooled buffer, not zero filled before the read overwrites it
+// ---------------------------------------------------------------------------
+bool RCFileHandler::LoadFile(const wchar_t* path, size_t padding, RCBuffer& buffer)
+{
+  DWORD bytes{};
+  wil::unique_hfile hFile(OpenInput(path, padding, bytes));
+  if (!hFile)
+  {
+    return false;
+  }
+
+  if (padding < 2)
+  {
+    padding = 2;
+  }
+
+  size_t totalSize = bytes + padding;
+  buffer = pool ? pool->Acquire(totalSize) : RCBuffer::Allocate(totalSize);
+  if (!buffer.resize(totalSize))
+  {
+    return logger.Error(error = ERROR_OUTOFMEMORY, L"*** RCFileUpdater::Load: File too large", path);
+  }
+
+  if (!ReadInput(path, hFile.get(), buffer.data(), bytes, totalSize))
+  {
+    buffer.release();
+    return false;
+  }
   return true;
 }
 
 // ---------------------------------------------------------------------------
-// 
+// The file is written to a temporary file that replaces the destination once
+// it is complete. With 'output' that happens when the caller commits it.
 // ---------------------------------------------------------------------------
-bool RCFileHandler::SaveFile(const wchar_t* path, void* buffer, size_t bytes)
+bool RCFileHandler::SaveFile(const wchar_t* path, void* buffer, size_t bytes, RCOutputFiles* output, size_t tag,
+  const RCOutputFiles::FileState* expected)
 {
   logger.Log(logDetail, L"Writing file [%s]...", path);
   if (!path || !*path)
@@ -137,18 +707,38 @@ bool RCFileHandler::SaveFile(const wchar_t* path, void* buffer, size_t bytes)
     return logger.Error(error = ERROR_INVALID_PARAMETER, L"*** RCFileUpdater::Save: Output file path must not be empty.");
   }
 
-  wil::unique_hfile hFile(CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, 0, nullptr));
+  RCOutputFiles local{ilogger};
+  local.Verbosity(logger.Verbosity());
+  RCOutputFiles& files = output ? *output : local;
+
+  std::wstring temp;
+  wil::unique_hfile hFile(files.Open(path, 0, temp, error));
   if (!hFile)
   {
-    return logger.Error(error = GetLastError(), L"*** RCFileUpdater::Save: Cannot open output file [%s]", path);
+    return false;
   }
 
   DWORD writeBytes{};
   BOOL ok = WriteFile(hFile.get(), buffer, DWORD(bytes), &writeBytes, nullptr);
   if (!ok || bytes != writeBytes)
   {
-    return logger.Error(error = GetLastError(), L"*** RCFileUpdater::Save: Cannot write output file [%s]", path);
+    error = ok ? ERROR_WRITE_FAULT : GetLastError();
+    hFile.reset();
+    files.Discard(temp);
+    return logger.Error(error, L"*** RCFileUpdater::Save: Cannot write output file [%s]", path);
   }
+  hFile.reset();
 
+  if (output)
+  {
+    output->Written(path, temp, tag, expected);
+    return true;
+  }
+
+  if (!local.Replace(path, temp, expected))
+  {
+    error = local.Error();
+    return false;
+  }
   return true;
 }
@@ -1,6 +1,16 @@
 #pragma once
 #include "Logger.h"
+#include "RCOffsetCache.h"
+#include "RCBufferPool.h"
+#include "RCBatchIO.h"
+#include "RCOutputFiles.h"
+#include "RCValueNames.h"
+#include "RCFormats.h"
+#include "RCDiffWriter.h"
+#include "RCOutputCache.h"
+#include "RCContentGroups.h"
 #include <vector>
+#include <string>
 
 class RCFileHandler
 {
@@ -8,25 +18,92 @@ protected:
    ILogger &ilogger;
    Logger logger;
    unsigned error;
+   RCOffsetCache* cache;
+   unsigned long long loadedSize;
+   FILETIME loadedWriteTime;
+   bool skipUnchanged;
+   RCBufferPool* pool;
+   RCBatchIO* batchIO;
+   bool transaction;
+   const RCValueNames* valueNames;
+   const RCFormats* formats;
+   RCDiffWriter* diff;
+   RCOutputCache* outputCache;
+   RCContentGroups* contents;
 
    enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
 
 public:
+   static const unsigned RetryLimit = 4;
+
    RCFileHandler(ILogger &rlogger);
    virtual ~RCFileHandler();
 
    unsigned Error() const { return error; }
    int Verbosity() const { return logger.Verbosity(); }
    void Verbosity(int value) { logger.Verbosity(value); }
+   void Cache(RCOffsetCache* value) { cache = value; }
+   void SkipUnchanged(bool value) { skipUnchanged = value; }
+   void Pool(RCBufferPool* value) { pool = value; }
+   void BatchIO(RCBatchIO* value) { batchIO = value; }
+   // UpdateFiles through BatchIO changes all files or none
+   void Transaction(bool value) { transaction = value; }
+   // StringFileInfo names to update, nullptr for the default names
+   void ValueNames(const RCValueNames* value) { valueNames = value; }
+   // The file types to update, nullptr for RCFormats::Default
+   void Formats(const RCFormats* value) { formats = value ? value : &RCFormats::Default(); }
+   const RCFormats& Formats() const { return *formats; }
+   // Changes go to 'diff' instead of the files, nullptr to write them
+   void Diff(RCDiffWriter* value) { diff = value; }
+   RCDiffWriter* Diff() const { return diff; }
+   // Outputs of earlier runs by the loaded bytes, nullptr to always update
+   void OutputCache(RCOutputCache* value) { outputCache = value; }
+   RCOutputCache* OutputCache() const { return outputCache; }
+   // Byte-identical inputs updated once, nullptr to update every file
+   void ContentGroups(RCContentGroups* value) { contents = value; }
+   RCContentGroups* ContentGroups() const { return contents; }
+   unsigned long long LoadedSize() const { return loadedSize; }
+   FILETIME LoadedWriteTime() const { return loadedWriteTime; }
 
    bool LoadFile(const wchar_t* path, size_t padding, std::vector<unsigned char>& buffer);
-   bool SaveFile(const wchar_t* path, void* buffer, size_t bytes);
+   bool LoadFile(const wchar_t* path, size_t padding, RCBuffer& buffer);
+   bool SaveFile(const wchar_t* path, void* buffer, size_t bytes, RCOutputFiles* output = nullptr, size_t tag = 0,
+      const RCOutputFiles::FileState* expected = nullptr);
 
+   // A file changed by another process while it was updated in place is read
+   // and updated again. The last of RetryLimit attempts holds the lock of the
+   // file from the read to the rename, so it cannot lose to another job.
    bool UpdateFile(const wchar_t *inpath, const wchar_t *outpath, int major, int minor, int build, int revision);
+   bool UpdateFiles(const std::vector<std::wstring>& paths, int major, int minor, int build, int revision);
+   bool UpdateLoaded(const wchar_t* inpath, const wchar_t* outpath, RCBuffer& buffer, unsigned long long size, const FILETIME& lastWrite,
+      int major, int minor, int build, int revision, bool& modified, bool& isUnicode, size_t& outBytes, std::vector<size_t>& offsets);
+   void StoreOffsets(const wchar_t* outpath, bool isUnicode, const std::vector<size_t>& offsets);
+   bool ReadVersion(const wchar_t* path, int& major, int& minor, int& build, int& revision);
+   bool ParseVersion(const wchar_t* name, std::vector<unsigned char>& buffer, int& major, int& minor, int& build, int& revision);
 
    unsigned UpdateBuffer(char* buffer, size_t chars, int major, int minor, int build, int revision) const;
    unsigned UpdateBuffer(wchar_t* buffer, size_t chars, int major, int minor, int build, int revision) const;
+   // The versions as a text 'format' finds them, nullptr for an RC file
+   unsigned UpdateBuffer(char* buffer, size_t chars, std::vector<size_t>& offsets, int major, int minor, int build, int revision, const RCFormat* format = nullptr) const;
+   unsigned UpdateBuffer(wchar_t* buffer, size_t chars, std::vector<size_t>& offsets, int major, int minor, int build, int revision, const RCFormat* format = nullptr) const;
 
    static const wchar_t* NN(const wchar_t* ptr) { return ptr ? ptr : L"(null)"; }
+
+protected:
+   // A file saved by UpdateFiles, its offsets are stored once it is committed
+   struct Written
+   {
+      std::wstring path;
+      bool isUnicode;
+      std::vector<size_t> offsets;
+   };
+
+   unsigned UpdateBatch(std::vector<RCFileRequest>& requests, int major, int minor, int build, int revision, RCOutputFiles& output, std::vector<Written>& written, unsigned& firstError);
+   uint64_t NamesKey() const { return valueNames ? valueNames->Key() : 0; }
+   bool Finish(const RCFormat& format, const wchar_t* inpath, const wchar_t* outpath, const std::vector<unsigned char>& original, RCBuffer& buffer,
+      unsigned long long size, const FILETIME& lastWrite, bool isUnicode, size_t outBytes, const std::vector<size_t>& offsets, bool& modified);
+   bool PatchLoaded(const RCFormat& format, const wchar_t* inpath, RCBuffer& buffer, size_t& bytes, int major, int minor, int build, int revision, unsigned& changes);
+   HANDLE OpenInput(const wchar_t* path, size_t padding, DWORD& bytes);
+   bool ReadInput(const wchar_t* path, HANDLE hFile, unsigned char* buffer, DWORD bytes, size_t totalSize);
 };
 
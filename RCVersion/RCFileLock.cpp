@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include "RCFileLock.h"
+#include "RCFileSet.h"
+
+RCFileLock::RCFileLock(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , owned(false)
+{
+}
+
+RCFileLock::~RCFileLock()
+{
+  Release();
+}
+
+// Paths differing only in case or in relative parts name the same lock
+std::wstring RCFileLock::Name(const wchar_t* path)
+{
+  std::wstring key = RCFileSet::FullPath(path);
+  for (auto& c : key)
+  {
+    c = towupper(c);
+  }
+
+  wchar_t name[64]{};
+  _snwprintf_s(name, _TRUNCATE, L"Local\\RCVersion.%016llx", (unsigned long long)RCFileSet::KeyHash(key));
+  return name;
+}
+
+bool RCFileLock::Acquire(const wchar_t* path, DWORD timeout)
+{
+  Release();
+
+  std::wstring name = Name(path);
+  mutex.reset(CreateMutex(nullptr, FALSE, name.c_str()));
+  if (!mutex)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCFileLock::Acquire: Cannot create lock [%s] for [%s]", name.c_str(), path);
+  }
+
+  DWORD wait = WaitForSingleObject(mutex.get(), timeout);
+  if (WAIT_OBJECT_0 != wait && WAIT_ABANDONED != wait)
+  {
+    error = (WAIT_TIMEOUT == wait) ? ERROR_TIMEOUT : GetLastError();
+    mutex.reset();
+    return logger.Error(error, L"*** RCFileLock::Acquire: Cannot lock [%s]", path);
+  }
+
+  if (WAIT_ABANDONED == wait)
+  {
+    logger.Log(logNormal, L"Lock of [%s] was left by a terminated process.", path);
+  }
+  logger.Log(logVerbose, L"Locked [%s] as [%s].", path, name.c_str());
+  owned = true;
+  return true;
+}
+
+void RCFileLock::Release()
+{
+  if (owned)
+  {
+    ReleaseMutex(mutex.get());
+    owned = false;
+  }
+  mutex.reset();
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Logger.h"
+#include "wil/resource.h"
+#include <windows.h>
+#include <string>
+
+// Serializes the replacement of one destination file across processes, for
+// parallel build jobs stamping the same file. Only the check that the file
+// is still the one that was read and the rename hold the lock; reading and
+// updating run without it. The lock is a named mutex of the session named
+// after a hash of the full path, so it does not depend on the spelling of
+// the path and never blocks other access to the file.
+class RCFileLock
+{
+public:
+  static const DWORD DefaultTimeout = 60000;
+
+  RCFileLock(ILogger &rlogger);
+  virtual ~RCFileLock();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+
+  // Waits up to 'timeout' ms, a lock left by a terminated process is taken
+  bool Acquire(const wchar_t* path, DWORD timeout = DefaultTimeout);
+  void Release();
+
+  static std::wstring Name(const wchar_t* path);
+
+protected:
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+  wil::unique_handle mutex;
+  bool owned;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
@@ -0,0 +1,410 @@
+#include "stdafx.h"
+#include "RCFileSet.h"
+#include "RCFileHandler.h"
+#include <algorithm>
+
+RCFileSet::RCFileSet(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+{
+}
+
+RCFileSet::~RCFileSet()
+{
+}
+
+std::vector<std::wstring> RCFileSet::Paths() const
+{
+  std::vector<std::wstring> paths;
+  paths.reserve(files.size());
+  for (const auto& entry : files)
+  {
+    paths.push_back(entry.path);
+  }
+  return paths;
+}
+
+// ---------------------------------------------------------------------------
+// Path keys are lower case, backslash separated and relative to the list file
+// or search directory, so that all build agents compute the same hash.
+// ---------------------------------------------------------------------------
+std::wstring RCFileSet::NormalizeKey(const wchar_t* path)
+{
+  std::wstring key;
+  if (!path)
+  {
+    return key;
+  }
+
+  while (L' ' == *path || L'\t' == *path)
+  {
+    ++path;
+  }
+
+  for (const wchar_t* p = path; *p; ++p)
+  {
+    wchar_t c = (L'/' == *p) ? L'\\' : wchar_t(towlower(*p));
+    if (L'\\' == c && !key.empty() && L'\\' == key.back())
+    {
+      continue;
+    }
+    key.push_back(c);
+  }
+
+  while (!key.empty() && (L' ' == key.back() || L'\t' == key.back() || L'\r' == key.back()))
+  {
+    key.pop_back();
+  }
+
+  // Drop ".\" segments, they do not change the file
+  size_t pos{};
+  while (0 == key.compare(0, 2, L".\\"))
+  {
+    key.erase(0, 2);
+  }
+  while (std::wstring::npos != (pos = key.find(L"\\.\\")))
+  {
+    key.erase(pos, 2);
+  }
+
+  return key;
+}
+
+// ---------------------------------------------------------------------------
+// 64-bit FNV-1a over UTF-16 code units
+// ---------------------------------------------------------------------------
+uint64_t RCFileSet::KeyHash(const std::wstring& key)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (wchar_t c : key)
+  {
+    uint16_t unit = uint16_t(c);
+    hash = (hash ^ (unit & 0xFF)) * 1099511628211ULL;
+    hash = (hash ^ (unit >> 8)) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::wstring RCFileSet::FullPath(const wchar_t* path, const wchar_t* baseDir)
+{
+  if (!path || !*path)
+  {
+    return std::wstring();
+  }
+
+  std::wstring combined;
+  bool relative = !(L'\\' == path[0] || L'/' == path[0] || (iswalpha(path[0]) && L':' == path[1]));
+  if (relative && baseDir && *baseDir)
+  {
+    combined = baseDir;
+    if (L'\\' != combined.back() && L'/' != combined.back())
+    {
+      combined.push_back(L'\\');
+    }
+  }
+  combined.append(path);
+
+  wchar_t full[1024]{};
+  DWORD length = GetFullPathName(combined.c_str(), _countof(full), full, nullptr);
+  if (0 == length || _countof(full) <= length)
+  {
+    return combined;
+  }
+  return full;
+}
+
+void RCFileSet::Add(const std::wstring& path, const std::wstring& key, unsigned long long size)
+{
+  std::wstring identity = NormalizeKey(path.c_str());
+  if (!seen.insert(identity).second)
+  {
+    logger.Log(logDetail, L"Duplicate input file [%s] ignored.", path.c_str());
+    return;
+  }
+
+  Entry entry{path, key, size, KeyHash(key)};
+  files.push_back(entry);
+}
+
+bool RCFileSet::AddFile(const wchar_t* path, const wchar_t* key)
+{
+  if (!path || !*path)
+  {
+    return logger.Error(error = ERROR_INVALID_PARAMETER, L"*** RCFileSet::AddFile: File path must not be empty");
+  }
+
+  std::wstring full = FullPath(path);
+  WIN32_FILE_ATTRIBUTE_DATA data{};
+  if (!GetFileAttributesEx(full.c_str(), GetFileExInfoStandard, &data))
+  {
+    return logger.Error(error = GetLastError(), L"*** RCFileSet::AddFile: Cannot access input file [%s]", path);
+  }
+
+  ULARGE_INTEGER size{};
+  size.LowPart = data.nFileSizeLow;
+  size.HighPart = data.nFileSizeHigh;
+  Add(full, NormalizeKey(key ? key : path), size.QuadPart);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Lines of a UTF-16 or UTF-8 text file, trimmed, without empty lines and
+// comment lines starting with '#' or ';'
+// ---------------------------------------------------------------------------
+std::vector<std::wstring> RCFileSet::TextLines(const std::vector<unsigned char>& buffer)
+{
+  std::wstring text;
+  int flags = IS_TEXT_UNICODE_UNICODE_MASK;
+  if (IsTextUnicode(buffer.data(), int(min(buffer.size(), size_t{256})), &flags))
+  {
+    text = reinterpret_cast<const wchar_t*>(buffer.data());
+  }
+  else
+  {
+    const char* utf8 = reinterpret_cast<const char*>(buffer.data());
+    int chars = MultiByteToWideChar(CP_UTF8, 0, utf8, -1, nullptr, 0);
+    if (0 < chars)
+    {
+      text.resize(size_t(chars));
+      MultiByteToWideChar(CP_UTF8, 0, utf8, -1, &text[0], chars);
+      text.resize(wcslen(text.c_str()));
+    }
+  }
+
+  if (!text.empty() && L'\xFEFF' == text[0])
+  {
+    text.erase(0, 1);
+  }
+
+  std::vector<std::wstring> lines;
+  size_t start{};
+  while (start < text.size())
+  {
+    size_t end = text.find(L'\n', start);
+    if (std::wstring::npos == end)
+    {
+      end = text.size();
+    }
+
+    std::wstring line = text.substr(start, end - start);
+    start = end + 1;
+
+    size_t first = line.find_first_not_of(L" \t\r");
+    if (std::wstring::npos == first)
+    {
+      continue;
+    }
+    size_t last = line.find_last_not_of(L" \t\r");
+    line = line.substr(first, last - first + 1);
+    if (L'#' == line[0] || L';' == line[0])
+    {
+      continue;
+    }
+    lines.push_back(line);
+  }
+
+  return lines;
+}
+
+// ---------------------------------------------------------------------------
+// List file: one path per line, relative paths are relative to the list file,
+// empty lines and lines starting with '#' or ';' are ignored.
+// ---------------------------------------------------------------------------
+bool RCFileSet::AddListFile(const wchar_t* path)
+{
+  logger.Log(logDetail, L"Reading list file [%s]...", RCFileHandler::NN(path));
+
+  RCFileHandler reader{ilogger};
+  reader.Verbosity(logger.Verbosity());
+  std::vector<unsigned char> buffer;
+  if (!reader.LoadFile(path, 2, buffer))
+  {
+    error = reader.Error();
+    return false;
+  }
+
+  std::wstring full = FullPath(path);
+  std::wstring baseDir = full.substr(0, full.find_last_of(L"\\/") + 1);
+
+  bool success{true};
+  for (const auto& line : TextLines(buffer))
+  {
+    std::wstring file = FullPath(line.c_str(), baseDir.c_str());
+    if (!AddFile(file.c_str(), line.c_str()))
+    {
+      success = false;
+    }
+  }
+
+  logger.Log(logInfo, L"List file [%s]: %u input files.", path, unsigned(files.size()));
+  return success;
+}
+
+bool RCFileSet::AddDirectory(const wchar_t* path, const std::vector<const wchar_t*>& suffixes)
+{
+  if (!path || !*path)
+  {
+    return logger.Error(error = ERROR_INVALID_PARAMETER, L"*** RCFileSet::AddDirectory: Directory path must not be empty");
+  }
+
+  std::wstring root = FullPath(path);
+  while (!root.empty() && (L'\\' == root.back() || L'/' == root.back()))
+  {
+    root.pop_back();
+  }
+
+  size_t first = files.size();
+  if (!ScanDirectory(root, std::wstring(), suffixes))
+  {
+    return false;
+  }
+
+  // Directory enumeration order depends on the file system, sort by key
+  std::sort(files.begin() + first, files.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+
+  logger.Log(logInfo, L"Directory [%s]: %u input files.", path, unsigned(files.size() - first));
+  return true;
+}
+
+bool RCFileSet::ScanDirectory(const std::wstring& root, const std::wstring& relative, const std::vector<const wchar_t*>& suffixes)
+{
+  std::wstring directory = relative.empty() ? root : root + L"\\" + relative;
+  std::wstring pattern = directory + L"\\*";
+
+  WIN32_FIND_DATA data{};
+  wil::unique_hfind hFind(FindFirstFileEx(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH));
+  if (!hFind)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCFileSet::ScanDirectory: Cannot read directory [%s]", directory.c_str());
+  }
+
+  do
+  {
+    const wchar_t* name = data.cFileName;
+    if (L'.' == name[0] && (0 == name[1] || (L'.' == name[1] && 0 == name[2])))
+    {
+      continue;
+    }
+
+    std::wstring child = relative.empty() ? std::wstring(name) : relative + L"\\" + name;
+
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+    {
+      // Do not follow junctions and symbolic links, they may form cycles
+      if (0 == (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && !ScanDirectory(root, child, suffixes))
+      {
+        return false;
+      }
+      continue;
+    }
+
+    size_t nameLength = wcslen(name);
+    bool matched{};
+    for (const wchar_t* suffix : suffixes)
+    {
+      size_t suffixLength = wcslen(suffix);
+      matched = matched || (suffixLength <= nameLength && 0 == _wcsicmp(name + nameLength - suffixLength, suffix));
+    }
+    if (!matched)
+    {
+      continue;
+    }
+
+    ULARGE_INTEGER size{};
+    size.LowPart = data.nFileSizeLow;
+    size.HighPart = data.nFileSizeHigh;
+    Add(root + L"\\" + child, NormalizeKey(child.c_str()), size.QuadPart);
+  }
+  while (FindNextFile(hFind.get(), &data));
+
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// The low bits of FNV-1a depend only on the low bits of every code unit, keys
+// that differ in digits alone would mostly land in one shard. The high bits
+// are folded in first (MurmurHash3 finalizer).
+// ---------------------------------------------------------------------------
+static uint64_t MixHash(uint64_t hash)
+{
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// ---------------------------------------------------------------------------
+// Select shard <index> of <count>, index is one-based. Without weighting a file
+// belongs to shard (mixed hash % count) regardless of the other files in the set.
+// With size weighting all agents must see the same file set; files are dealt
+// largest first to the least loaded shard.
+// ---------------------------------------------------------------------------
+bool RCFileSet::Shard(unsigned index, unsigned count, bool bySize)
+{
+  if (0 == count || 0 == index || count < index)
+  {
+    return logger.Error(error = ERROR_INVALID_PARAMETER, L"*** RCFileSet::Shard: Invalid shard %u/%u", index, count);
+  }
+
+  // Per-file overhead expressed in bytes, so that many tiny files still spread out
+  const unsigned long long fileCost = 4096;
+
+  std::vector<bool> selected(files.size(), false);
+  if (!bySize)
+  {
+    for (size_t n = 0; n < files.size(); ++n)
+    {
+      selected[n] = (index - 1) == MixHash(files[n].hash) % count;
+    }
+  }
+  else
+  {
+    std::vector<size_t> order(files.size());
+    for (size_t n = 0; n < order.size(); ++n)
+    {
+      order[n] = n;
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+      const Entry& ea = files[a];
+      const Entry& eb = files[b];
+      if (ea.size != eb.size)
+        return eb.size < ea.size;
+      if (ea.hash != eb.hash)
+        return ea.hash < eb.hash;
+      return ea.key < eb.key;
+    });
+
+    std::vector<unsigned long long> load(count, 0);
+    for (size_t n : order)
+    {
+      unsigned target{};
+      for (unsigned s = 1; s < count; ++s)
+      {
+        if (load[s] < load[target])
+          target = s;
+      }
+      load[target] += files[n].size + fileCost;
+      selected[n] = (index - 1) == target;
+    }
+  }
+
+  std::vector<Entry> shard;
+  unsigned long long totalBytes{};
+  unsigned long long shardBytes{};
+  for (size_t n = 0; n < files.size(); ++n)
+  {
+    totalBytes += files[n].size;
+    if (selected[n])
+    {
+      shardBytes += files[n].size;
+      shard.push_back(files[n]);
+    }
+  }
+
+  logger.Log(logInfo, L"Shard %u/%u: %u of %u files, %llu of %llu bytes.", index, count, unsigned(shard.size()), unsigned(files.size()), shardBytes, totalBytes);
+  files.swap(shard);
+  return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "Logger.h"
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <stdint.h>
+
+// Set of input files for a multi-file run, with deterministic sharding
+class RCFileSet
+{
+protected:
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+
+public:
+  struct Entry
+  {
+    std::wstring path;        // full path used for reading and writing
+    std::wstring key;         // normalized path relative to the list file or search directory
+    unsigned long long size;  // file size in bytes, used for weighted sharding
+    uint64_t hash;            // hash of the key, same on every build agent
+  };
+
+  std::vector<Entry> files;
+
+  RCFileSet(ILogger &rlogger);
+  virtual ~RCFileSet();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+
+  size_t Count() const { return files.size(); }
+  std::vector<std::wstring> Paths() const;
+
+  void Add(const std::wstring& path, const std::wstring& key, unsigned long long size);
+  bool AddFile(const wchar_t* path, const wchar_t* key = nullptr);
+  bool AddListFile(const wchar_t* path);
+  // Files whose names end with one of 'suffixes', by default RC files and the
+  // AssemblyInfo.cs files of C# projects
+  bool AddDirectory(const wchar_t* path, const std::vector<const wchar_t*>& suffixes = {L".rc", L"AssemblyInfo.cs"});
+
+  bool Shard(unsigned index, unsigned count, bool bySize);
+
+  static std::wstring NormalizeKey(const wchar_t* path);
+  static uint64_t KeyHash(const std::wstring& key);
+  static std::wstring FullPath(const wchar_t* path, const wchar_t* baseDir = nullptr);
+  static std::vector<std::wstring> TextLines(const std::vector<unsigned char>& buffer);
+
+protected:
+  std::unordered_set<std::wstring> seen;
+
+  bool ScanDirectory(const std::wstring& root, const std::wstring& relative, const std::vector<const wchar_t*>& suffixes);
+};
@@ -0,0 +1,443 @@
+#include "stdafx.h"
+#include "RCFormats.h"
+#include "RCBinaryFile.h"
+#include "RCPeImage.h"
+#include "RCResFile.h"
+#include <string.h>
+
+static bool HasExtension(const wchar_t* path, const wchar_t* extension)
+{
+  const wchar_t* dot = path ? wcsrchr(path, L'.') : nullptr;
+  return dot && 0 == _wcsicmp(dot, extension);
+}
+
+// Text formats tell by the first bytes of the file: 'what' in ANSI or UTF-8
+// text, or in UTF-16 text
+static bool StartContains(const unsigned char* data, size_t size, const char* what)
+{
+  const size_t limit = 4096;
+  size = min(size, limit);
+  size_t length = strlen(what);
+  for (size_t n = 0; n + length <= size; ++n)
+  {
+    if (0 == memcmp(data + n, what, length))
+    {
+      return true;
+    }
+  }
+  for (size_t n = 0; n + 2 * length <= size; ++n)
+  {
+    size_t c = 0;
+    while (c < length && what[c] == char(data[n + 2 * c]) && 0 == data[n + 2 * c + 1])
+    {
+      ++c;
+    }
+    if (length == c)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// C# assembly attributes with a version, with and without the Attribute suffix
+template <class CharT>
+static const CharT** GetAttributeTable() { return nullptr; }
+
+template <>
+inline const wchar_t** GetAttributeTable<wchar_t>()
+{
+  const static wchar_t *names[] =
+  {
+    L"AssemblyVersion",
+    L"AssemblyFileVersion",
+    L"AssemblyInformationalVersion",
+    L"AssemblyVersionAttribute",
+    L"AssemblyFileVersionAttribute",
+    L"AssemblyInformationalVersionAttribute",
+    nullptr
+  };
+  return names;
+}
+
+template <>
+inline const char** GetAttributeTable<char>()
+{
+  const static char *names[] =
+  {
+    "AssemblyVersion",
+    "AssemblyFileVersion",
+    "AssemblyInformationalVersion",
+    "AssemblyVersionAttribute",
+    "AssemblyFileVersionAttribute",
+    "AssemblyInformationalVersionAttribute",
+    nullptr
+  };
+  return names;
+}
+
+// Offsets of the versions of [assembly: AssemblyVersion("1.2.3.4")] and the
+// other version attributes. A version the compiler completes, like "1.0.*",
+// is left alone.
+template <class CharT>
+static void FindAssemblyVersions(RCUpdater<CharT>& updater, CharT *buffer, std::vector<size_t> &offsets)
+{
+  typedef RCUpdater<CharT> Updater;
+  typedef std::char_traits<CharT> Traits;
+  static const CharT space[] = { ' ', '\t', 0 };
+  static const CharT assembly[] = { 'a', 's', 's', 'e', 'm', 'b', 'l', 'y', 0 };
+  static const RCNameTrie<CharT> attributes{GetAttributeTable<CharT>()};
+  size_t length = Traits::length(assembly);
+
+  CharT *line = buffer;
+  while (*line)
+  {
+    line = Updater::SkipAllComments(line);
+    CharT *start = line;
+    line = Updater::NextLine(line);
+
+    if ('[' != *start)
+      continue;
+    CharT *p = Updater::LTrim(start + 1, space);
+    if (0 != Traits::compare(assembly, p, length))
+      continue;
+    p = Updater::LTrim(p + length, space);
+    if (':' != *p)
+      continue;
+    p = Updater::LTrim(p + 1, space);
+
+    size_t chars{};
+    if (RCNameTrie<CharT>::NotFound == attributes.Match(p, chars))
+      continue;
+    p = Updater::LTrim(p + chars, space);
+    if ('(' != *p)
+      continue;
+    p = Updater::LTrim(p + 1, space);
+    if ('\"' != *p)
+      continue;
+    p = Updater::LTrim(p + 1, space);
+
+    CharT *tail{nullptr};
+    int major{-1}, minor{-1}, build{-1}, revision{-1};
+    if (!Updater::parse(p, &tail, major, minor, build, revision))
+    {
+      if (6 <= updater.verbosity)
+      {
+        wchar_t msg[1024]{};
+        _snwprintf_s(msg, _TRUNCATE, L"SKIPPED: [%s] offset=%u", MessageBuffer(std::basic_string<CharT>(start, p).c_str()).message(), unsigned(p - buffer));
+        updater.logger.Log(msg);
+      }
+      continue;
+    }
+
+    if (6 <= updater.verbosity)
+    {
+      wchar_t msg[1024]{};
+      _snwprintf_s(msg, _TRUNCATE, L"FOUND ATTRIBUTE: [%s] offset=%u", MessageBuffer(std::basic_string<CharT>(start, p).c_str()).message(), unsigned(p - buffer));
+      updater.logger.Log(msg);
+    }
+    offsets.push_back(p - buffer);
+  }
+}
+
+// Offsets of the version attributes of the assemblyIdentity elements of an
+// application manifest, found in one pass over the XML without building a
+// tree. The identities of the assemblies under <dependency> keep their
+// versions; comments, CDATA sections and the XML declaration are skipped.
+template <class CharT>
+static void FindManifestVersions(RCUpdater<CharT>& updater, CharT *buffer, std::vector<size_t> &offsets)
+{
+  typedef RCUpdater<CharT> Updater;
+  typedef std::char_traits<CharT> Traits;
+  static const CharT white[] = { ' ', '\t', '\r', '\n', 0 };
+  static const CharT stopper[] = { ' ', '\t', '\r', '\n', '/', '>', 0 };
+  static const CharT separator[] = { ' ', '\t', '\r', '\n', '/', '>', '=', 0 };
+  static const CharT identity[] = { 'a', 's', 's', 'e', 'm', 'b', 'l', 'y', 'I', 'd', 'e', 'n', 't', 'i', 't', 'y', 0 };
+  static const CharT dependency[] = { 'd', 'e', 'p', 'e', 'n', 'd', 'e', 'n', 'c', 'y', 0 };
+  static const CharT version[] = { 'v', 'e', 'r', 's', 'i', 'o', 'n', 0 };
+  static const CharT endComment[] = { '-', '-', '>', 0 };
+  static const CharT endCData[] = { ']', ']', '>', 0 };
+  static const CharT endDeclaration[] = { '?', '>', 0 };
+  static const CharT endTag[] = { '>', 0 };
+
+  int dependencies{};
+  CharT *p = buffer;
+  while (*p)
+  {
+    if ('<' != *p++)
+      continue;
+
+    if ('!' == *p || '?' == *p)
+    {
+      const CharT *end = ('?' == *p) ? endDeclaration : ('-' == p[1]) ? endComment : ('[' == p[1]) ? endCData : endTag;
+      CharT *next = Updater::strfind(p, end);
+      if (nullptr == next)
+        break;
+      p = next + Traits::length(end);
+      continue;
+    }
+
+    bool closing = '/' == *p;
+    if (closing)
+      ++p;
+
+    // The name without a namespace prefix
+    CharT *name = p;
+    p = Updater::LSkipTo(p, stopper);
+    for (CharT *c = name; c < p; ++c)
+    {
+      if (':' == *c)
+        name = c + 1;
+    }
+    size_t length = p - name;
+
+    // An attribute value cannot hold a '<', other tags are skipped by it
+    if (Traits::length(dependency) == length && 0 == Traits::compare(name, dependency, length))
+    {
+      CharT *end = Updater::LSkipTo(p, endTag);
+      if (!*end || '/' != end[-1])
+        dependencies += closing ? -1 : 1;
+      continue;
+    }
+    if (closing || 0 != dependencies || Traits::length(identity) != length || 0 != Traits::compare(name, identity, length))
+      continue;
+
+    // Attributes up to the end of the tag, a '>' in a value does not end it
+    while (*p && '>' != *p)
+    {
+      p = Updater::LTrim(p, white);
+      CharT *attribute = p;
+      p = Updater::LSkipTo(p, separator);
+      size_t chars = p - attribute;
+      p = Updater::LTrim(p, white);
+      if ('=' != *p)
+      {
+        if ('/' == *p)
+          ++p;
+        continue;
+      }
+
+      p = Updater::LTrim(p + 1, white);
+      CharT quote = *p;
+      if ('\"' != quote && '\'' != quote)
+        break;
+      CharT *value = ++p;
+      while (*p && quote != *p)
+        ++p;
+
+      if (Traits::length(version) == chars && 0 == Traits::compare(attribute, version, chars))
+      {
+        CharT *tail{nullptr};
+        int major{-1}, minor{-1}, build{-1}, revision{-1};
+        if (Updater::parse(value, &tail, major, minor, build, revision))
+        {
+          if (6 <= updater.verbosity)
+          {
+            wchar_t msg[1024]{};
+            _snwprintf_s(msg, _TRUNCATE, L"FOUND IDENTITY: offset=%u", unsigned(value - buffer));
+            updater.logger.Log(msg);
+          }
+          offsets.push_back(value - buffer);
+        }
+      }
+      if (*p)
+        ++p;
+    }
+  }
+}
+
+template <class CharT>
+static unsigned UpdateText(const RCFormat& format, RCUpdater<CharT>& updater, CharT* text, size_t chars, std::vector<size_t>& offsets,
+  int major, int minor, int build, int revision)
+{
+  if (!offsets.empty() && !updater.ValidOffsets(text, chars, offsets))
+  {
+    offsets.clear();
+  }
+
+  if (offsets.empty() && !format.Find(updater, text, offsets))
+  {
+    updater.error = ERROR_FILE_CORRUPT;
+    return 0;
+  }
+
+  updater.dotted = format.Dotted();
+  return updater.UpdateVersion(text, chars, offsets, major, minor, build, revision);
+}
+
+unsigned RCFormat::Update(RCUpdater<char>& updater, char* text, size_t chars, std::vector<size_t>& offsets, int major, int minor, int build, int revision) const
+{
+  return UpdateText(*this, updater, text, chars, offsets, major, minor, build, revision);
+}
+
+unsigned RCFormat::Update(RCUpdater<wchar_t>& updater, wchar_t* text, size_t chars, std::vector<size_t>& offsets, int major, int minor, int build, int revision) const
+{
+  return UpdateText(*this, updater, text, chars, offsets, major, minor, build, revision);
+}
+
+// ---------------------------------------------------------------------------
+// VERSIONINFO blocks of resource scripts, the default for any text
+// ---------------------------------------------------------------------------
+class RCScriptFormat : public RCFormat
+{
+public:
+  const wchar_t* Name() const override { return L"RC"; }
+  bool MatchPath(const wchar_t* path) const override { return HasExtension(path, L".rc") || HasExtension(path, L".rc2"); }
+};
+
+// ---------------------------------------------------------------------------
+// [assembly: AssemblyVersion("1.2.3.4")] and the other version attributes
+// ---------------------------------------------------------------------------
+class RCCSharpFormat : public RCFormat
+{
+public:
+  const wchar_t* Name() const override { return L"C#"; }
+  bool MatchPath(const wchar_t* path) const override { return HasExtension(path, L".cs"); }
+  bool MatchContent(const unsigned char* data, size_t size) const override { return StartContains(data, size, "[assembly:"); }
+  bool Find(RCUpdater<char>& updater, char* text, std::vector<size_t>& offsets) const override { return Found(updater, text, offsets); }
+  bool Find(RCUpdater<wchar_t>& updater, wchar_t* text, std::vector<size_t>& offsets) const override { return Found(updater, text, offsets); }
+  bool Dotted() const override { return true; }
+
+protected:
+  template <class CharT>
+  static bool Found(RCUpdater<CharT>& updater, CharT* text, std::vector<size_t>& offsets)
+  {
+    FindAssemblyVersions(updater, text, offsets);
+    updater.error = offsets.empty() ? ERROR_FILE_CORRUPT : NO_ERROR;
+    return !offsets.empty();
+  }
+};
+
+// ---------------------------------------------------------------------------
+// <assemblyIdentity version="1.2.3.4"> of side-by-side and application
+// manifests, only the digits of the attribute are replaced
+// ---------------------------------------------------------------------------
+class RCManifestFormat : public RCFormat
+{
+public:
+  const wchar_t* Name() const override { return L"Manifest"; }
+  bool MatchPath(const wchar_t* path) const override { return HasExtension(path, L".manifest"); }
+  bool MatchContent(const unsigned char* data, size_t size) const override { return StartContains(data, size, "urn:schemas-microsoft-com:asm.v"); }
+  bool Find(RCUpdater<char>& updater, char* text, std::vector<size_t>& offsets) const override { return Found(updater, text, offsets); }
+  bool Find(RCUpdater<wchar_t>& updater, wchar_t* text, std::vector<size_t>& offsets) const override { return Found(updater, text, offsets); }
+  bool Dotted() const override { return true; }
+
+protected:
+  template <class CharT>
+  static bool Found(RCUpdater<CharT>& updater, CharT* text, std::vector<size_t>& offsets)
+  {
+    FindManifestVersions(updater, text, offsets);
+    updater.error = offsets.empty() ? ERROR_FILE_CORRUPT : NO_ERROR;
+    return !offsets.empty();
+  }
+};
+
+// ---------------------------------------------------------------------------
+// PE images, mapped when the extension tells, patched in the buffer when only
+// the content does
+// ---------------------------------------------------------------------------
+class RCImageFormat : public RCFormat
+{
+public:
+  const wchar_t* Name() const override { return L"PE"; }
+  bool MatchPath(const wchar_t* path) const override { return RCBinaryFile::IsImage(path); }
+  bool MatchContent(const unsigned char* data, size_t size) const override { return RCPeImage::IsImage(data, size); }
+  bool Text() const override { return false; }
+  bool Mapped() const override { return true; }
+
+  bool Patch(RCBinaryFile& binary, const wchar_t* path, RCBuffer& buffer, size_t& bytes, int major, int minor, int build, int revision,
+    unsigned& changes) const override
+  {
+    return binary.PatchImage(buffer.data(), bytes, path, major, minor, build, revision, changes);
+  }
+
+  bool UpdateMapped(RCBinaryFile& binary, const wchar_t* inpath, const wchar_t* outpath, int major, int minor, int build, int revision) const override
+  {
+    return binary.UpdateImage(inpath, outpath, major, minor, build, revision);
+  }
+};
+
+// ---------------------------------------------------------------------------
+// Compiled resources, the version resource may grow into the buffer padding
+// ---------------------------------------------------------------------------
+class RCResourcesFormat : public RCFormat
+{
+public:
+  const wchar_t* Name() const override { return L"RES"; }
+  bool MatchPath(const wchar_t* path) const override { return RCBinaryFile::IsResources(path); }
+  bool MatchContent(const unsigned char* data, size_t size) const override { return RCResFile::IsResources(data, size); }
+  bool Text() const override { return false; }
+
+  bool Patch(RCBinaryFile& binary, const wchar_t* path, RCBuffer& buffer, size_t& bytes, int major, int minor, int build, int revision,
+    unsigned& changes) const override
+  {
+    std::vector<uint8_t> data(buffer.data(), buffer.data() + bytes);
+    if (!binary.PatchResources(data, path, major, minor, build, revision, changes))
+    {
+      return false;
+    }
+    if (buffer.capacity() < data.size())
+    {
+      buffer = RCBuffer::Allocate(data.size());
+    }
+    if (!buffer.resize(max(buffer.size(), data.size())))
+    {
+      return false;
+    }
+    memcpy(buffer.data(), data.data(), data.size());
+    bytes = data.size();
+    return true;
+  }
+};
+
+RCFormats::RCFormats()
+{
+}
+
+RCFormats::~RCFormats()
+{
+}
+
+void RCFormats::Register(std::unique_ptr<RCFormat> format)
+{
+  formats.push_back(std::move(format));
+}
+
+const RCFormat& RCFormats::ByPath(const wchar_t* path) const
+{
+  for (const auto& format : formats)
+  {
+    if (format->MatchPath(path))
+    {
+      return *format;
+    }
+  }
+  return *formats.front();
+}
+
+const RCFormat& RCFormats::Detect(const wchar_t* path, const unsigned char* data, size_t size) const
+{
+  for (const auto& format : formats)
+  {
+    if (format->MatchContent(data, size))
+    {
+      return *format;
+    }
+  }
+  return ByPath(path);
+}
+
+const RCFormats& RCFormats::Default()
+{
+  static const std::unique_ptr<RCFormats> defaults = [] {
+    auto formats = std::make_unique<RCFormats>();
+    // Binary formats first, the content of an image may quote a text format
+    formats->Register(std::make_unique<RCScriptFormat>());
+    formats->Register(std::make_unique<RCImageFormat>());
+    formats->Register(std::make_unique<RCResourcesFormat>());
+    formats->Register(std::make_unique<RCCSharpFormat>());
+    formats->Register(std::make_unique<RCManifestFormat>());
+    return formats;
+  }();
+  return *defaults;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "RCBufferPool.h"
+#include "RCUpdater.h"
+#include <memory>
+#include <vector>
+
+class RCBinaryFile;
+
+// A kind of file that carries a version. A format claims a file by its path
+// before it is read and by its first bytes once it is loaded, so every file
+// is read once and the type comes from the buffer already in memory.
+//
+// Text formats find the versions in their own syntax, keep them as offsets
+// and replace them there with RCUpdater; they share the offset cache, the
+// buffer pool, batch I/O and the pipeline. Binary formats patch the
+// version resource of the loaded bytes. A mapped format is patched where the
+// file lies instead of being loaded, a large image is not copied to change a
+// few bytes.
+class RCFormat
+{
+public:
+  virtual ~RCFormat() {}
+
+  virtual const wchar_t* Name() const = 0;
+  // By the extension or the name of the file
+  virtual bool MatchPath(const wchar_t* path) const = 0;
+  // By the loaded bytes, false when they do not tell
+  virtual bool MatchContent(const unsigned char* data, size_t size) const { return false; }
+
+  virtual bool Text() const { return true; }
+  // Text formats: the offsets of the versions in the text, false when there
+  // are none. The default finds the VERSIONINFO blocks of an RC file.
+  virtual bool Find(RCUpdater<char>& updater, char* text, std::vector<size_t>& offsets) const { return updater.FindVersion(text, offsets); }
+  virtual bool Find(RCUpdater<wchar_t>& updater, wchar_t* text, std::vector<size_t>& offsets) const { return updater.FindVersion(text, offsets); }
+  // Versions are written as 1.2.3.4 instead of 1, 2, 3, 4
+  virtual bool Dotted() const { return false; }
+
+  // Replaces the versions at the offsets of an earlier run while they still
+  // hold versions, else where Find puts them. On return the offsets match the
+  // new text. The number of versions replaced, 0 when it failed.
+  unsigned Update(RCUpdater<char>& updater, char* text, size_t chars, std::vector<size_t>& offsets, int major, int minor, int build, int revision) const;
+  unsigned Update(RCUpdater<wchar_t>& updater, wchar_t* text, size_t chars, std::vector<size_t>& offsets, int major, int minor, int build, int revision) const;
+
+  // Binary formats: the first 'bytes' of 'buffer' patched, 'bytes' is the new size
+  virtual bool Patch(RCBinaryFile& binary, const wchar_t* path, RCBuffer& buffer, size_t& bytes, int major, int minor, int build, int revision,
+    unsigned& changes) const { return false; }
+
+  virtual bool Mapped() const { return false; }
+  virtual bool UpdateMapped(RCBinaryFile& binary, const wchar_t* inpath, const wchar_t* outpath, int major, int minor, int build, int revision) const { return false; }
+};
+
+// The formats RCVersion knows, in the order they are tried. The first one
+// registered is the default for files no format claims.
+class RCFormats
+{
+public:
+  RCFormats();
+  virtual ~RCFormats();
+
+  void Register(std::unique_ptr<RCFormat> format);
+
+  // Before the file is read
+  const RCFormat& ByPath(const wchar_t* path) const;
+  // A loaded file: the first format that knows the bytes, else by the path
+  const RCFormat& Detect(const wchar_t* path, const unsigned char* data, size_t size) const;
+
+  // RC files, C# source, manifests, PE images and .res files
+  static const RCFormats& Default();
+
+protected:
+  std::vector<std::unique_ptr<RCFormat>> formats;
+};
@@ -0,0 +1,96 @@
+#include "stdafx.h"
+#include "RCHeaderWriter.h"
+#include "RCFileHandler.h"
+
+RCHeaderWriter::RCHeaderWriter(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , changed(false)
+{
+}
+
+RCHeaderWriter::~RCHeaderWriter()
+{
+}
+
+bool RCHeaderWriter::Write(const wchar_t* versionPath, const wchar_t* headerPath)
+{
+  logger.Log(logDetail, L"RCHeaderWriter::Write(%s,%s)", versionPath, headerPath);
+
+  RCFileHandler files{ilogger};
+  files.Verbosity(logger.Verbosity());
+  int major{-1}, minor{-1}, build{-1}, revision{-1};
+  if (!files.ReadVersion(versionPath, major, minor, build, revision))
+  {
+    error = files.Error();
+    return false;
+  }
+  return Write(headerPath, major, minor, build, revision);
+}
+
+// ---------------------------------------------------------------------------
+// Compared with the header on disk, written only when it differs
+// ---------------------------------------------------------------------------
+bool RCHeaderWriter::Write(const wchar_t* headerPath, int major, int minor, int build, int revision)
+{
+  changed = false;
+  error = 0;
+  std::string text = Text(major, minor, build, revision);
+
+  RCFileHandler files{ilogger};
+  files.Verbosity(logger.Verbosity());
+  if (INVALID_FILE_ATTRIBUTES != GetFileAttributes(headerPath))
+  {
+    // LoadFile adds two zero bytes of padding
+    std::vector<unsigned char> existing;
+    if (files.LoadFile(headerPath, 2, existing) && existing.size() == text.size() + 2 &&
+        0 == memcmp(existing.data(), text.data(), text.size()))
+    {
+      logger.Log(logInfo, L"Version header [%s] is up to date.", headerPath);
+      return true;
+    }
+  }
+
+  logger.Log(logNormal, L"Version %d.%d.%d.%d written to [%s].", major, minor, build, revision, headerPath);
+  if (!files.SaveFile(headerPath, &text[0], text.size()))
+  {
+    error = files.Error();
+    return false;
+  }
+  changed = true;
+  return true;
+}
+
+std::string RCHeaderWriter::Text(int major, int minor, int build, int revision)
+{
+  char text[1024];
+  _snprintf_s(text, _TRUNCATE,
+    "// Generated by RCVersion, do not edit.\r\n"
+    "#pragma once\r\n"
+    "\r\n"
+    "#define VERSION_MAJOR %d\r\n"
+    "#define VERSION_MINOR %d\r\n"
+    "#define VERSION_BUILD %d\r\n"
+    "#define VERSION_REVISION %d\r\n"
+    "// For FILEVERSION and PRODUCTVERSION\r\n"
+    "#define VERSION_NUMBERS %d,%d,%d,%d\r\n"
+    "#define VERSION_STRING \"%d.%d.%d.%d\"\r\n"
+    "\r\n"
+    "#ifndef RC_INVOKED\r\n"
+    "struct VersionNumbers\r\n"
+    "{\r\n"
+    "  unsigned short major;\r\n"
+    "  unsigned short minor;\r\n"
+    "  unsigned short build;\r\n"
+    "  unsigned short revision;\r\n"
+    "};\r\n"
+    "\r\n"
+    "constexpr VersionNumbers Version{%d, %d, %d, %d};\r\n"
+    "#endif\r\n",
+    major, minor, build, revision,
+    major, minor, build, revision,
+    major, minor, build, revision,
+    major, minor, build, revision);
+  return text;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Logger.h"
+#include <string>
+
+// The version as a C++ header, /header:<file>: macros for the preprocessor
+// and the resource compiler and a constexpr struct for code. The header is
+// only written when its text changes, an unchanged version keeps the time
+// stamp and nothing that includes it is compiled again.
+class RCHeaderWriter
+{
+public:
+  RCHeaderWriter(ILogger &rlogger);
+  virtual ~RCHeaderWriter();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+
+  // The version of the file 'versionPath' into 'headerPath'
+  bool Write(const wchar_t* versionPath, const wchar_t* headerPath);
+  bool Write(const wchar_t* headerPath, int major, int minor, int build, int revision);
+  // False when the last Write found the header up to date
+  bool Changed() const { return changed; }
+
+  static std::string Text(int major, int minor, int build, int revision);
+
+protected:
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+  bool changed;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
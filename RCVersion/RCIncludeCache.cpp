@@ -0,0 +1,76 @@
+#include "stdafx.h"
+#include "RCIncludeCache.h"
+#include "RCFileSet.h"
+
+RCIncludeCache::RCIncludeCache(size_t maxEntries)
+  : maxEntries(maxEntries)
+  , hits(0)
+  , misses(0)
+{
+}
+
+RCIncludeCache::~RCIncludeCache()
+{
+}
+
+bool RCIncludeCache::Find(const wchar_t* path, unsigned long long size, const FILETIME& lastWrite, Entry& entry)
+{
+  std::wstring key = RCFileSet::NormalizeKey(path);
+  std::lock_guard<std::mutex> guard(lock);
+
+  auto iter = entries.find(key);
+  if (entries.end() == iter)
+  {
+    ++misses;
+    return false;
+  }
+
+  if (iter->second.size != size || 0 != CompareFileTime(&iter->second.lastWrite, &lastWrite))
+  {
+    entries.erase(iter);
+    ++misses;
+    return false;
+  }
+
+  entry = iter->second;
+  ++hits;
+  return true;
+}
+
+void RCIncludeCache::Store(const wchar_t* path, const Entry& entry)
+{
+  std::wstring key = RCFileSet::NormalizeKey(path);
+  std::lock_guard<std::mutex> guard(lock);
+
+  // Simple bound on memory use, a long running server starts over
+  if (maxEntries <= entries.size() && entries.end() == entries.find(key))
+  {
+    entries.clear();
+  }
+
+  entries[key] = entry;
+}
+
+void RCIncludeCache::Clear()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  entries.clear();
+}
+
+size_t RCIncludeCache::Count()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return entries.size();
+}
+
+unsigned long long RCIncludeCache::Hits()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return hits;
+}
+
+unsigned long long RCIncludeCache::Misses()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return misses;
+}
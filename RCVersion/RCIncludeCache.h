@@ -0,0 +1,44 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+// #include directives of files read earlier, shared by server worker threads.
+// An entry is used only while the file size and last write time are unchanged.
+class RCIncludeCache
+{
+public:
+  struct Include
+  {
+    std::wstring name;
+    bool quoted;              // "name", otherwise <name>
+  };
+
+  struct Entry
+  {
+    unsigned long long size;
+    FILETIME lastWrite;
+    bool version;             // the file has a VERSIONINFO block
+    std::vector<Include> includes;
+  };
+
+  RCIncludeCache(size_t maxEntries = 65536);
+  virtual ~RCIncludeCache();
+
+  bool Find(const wchar_t* path, unsigned long long size, const FILETIME& lastWrite, Entry& entry);
+  void Store(const wchar_t* path, const Entry& entry);
+  void Clear();
+
+  size_t Count();
+  unsigned long long Hits();
+  unsigned long long Misses();
+
+protected:
+  std::mutex lock;
+  std::unordered_map<std::wstring, Entry> entries;
+  size_t maxEntries;
+  unsigned long long hits;
+  unsigned long long misses;
+};
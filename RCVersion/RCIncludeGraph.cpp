@@ -0,0 +1,281 @@
+#include "stdafx.h"
+#include "RCIncludeGraph.h"
+#include "RCFileHandler.h"
+#include "RCFileSet.h"
+#include "RCUpdater.h"
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+// Files are read on several threads, their errors are logged afterwards
+class QuietLogger : public ILogger
+{
+public:
+  void Log(const wchar_t*) override
+  {
+  }
+};
+
+RCIncludeGraph::RCIncludeGraph(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , cache(nullptr)
+{
+}
+
+RCIncludeGraph::~RCIncludeGraph()
+{
+}
+
+// ---------------------------------------------------------------------------
+// #include "name" and #include <name>, one per line
+// ---------------------------------------------------------------------------
+void RCIncludeGraph::ParseIncludes(const wchar_t* text, std::vector<RCIncludeCache::Include>& includes)
+{
+  if (text && 0xFEFF == *text)
+  {
+    ++text;
+  }
+  const wchar_t* next{nullptr};
+  for (const wchar_t* line = text; line && *line; line = next)
+  {
+    const wchar_t* end = wcschr(line, L'\n');
+    next = end ? end + 1 : nullptr;
+
+    const wchar_t* p = line;
+    while (L' ' == *p || L'\t' == *p)
+    {
+      ++p;
+    }
+    if (L'#' != *p++)
+    {
+      continue;
+    }
+    while (L' ' == *p || L'\t' == *p)
+    {
+      ++p;
+    }
+    if (0 != wcsncmp(p, L"include", 7))
+    {
+      continue;
+    }
+    p += 7;
+    while (L' ' == *p || L'\t' == *p)
+    {
+      ++p;
+    }
+
+    wchar_t close = (L'"' == *p) ? L'"' : (L'<' == *p) ? L'>' : 0;
+    if (0 == close)
+    {
+      continue;
+    }
+
+    const wchar_t* name = ++p;
+    while (*p && close != *p && L'\n' != *p)
+    {
+      ++p;
+    }
+    if (close == *p && name != p)
+    {
+      includes.push_back(RCIncludeCache::Include{std::wstring(name, p), L'"' == close});
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Runs on a scanner thread, must not log
+// ---------------------------------------------------------------------------
+void RCIncludeGraph::Scan(Node& node)
+{
+  WIN32_FILE_ATTRIBUTE_DATA data{};
+  if (cache && GetFileAttributesEx(node.path.c_str(), GetFileExInfoStandard, &data))
+  {
+    ULARGE_INTEGER size{};
+    size.LowPart = data.nFileSizeLow;
+    size.HighPart = data.nFileSizeHigh;
+    if (cache->Find(node.path.c_str(), size.QuadPart, data.ftLastWriteTime, node.entry))
+    {
+      return;
+    }
+  }
+
+  QuietLogger quiet;
+  RCFileHandler reader{quiet};
+  std::vector<unsigned char> buffer;
+  if (!reader.LoadFile(node.path.c_str(), 2, buffer))
+  {
+    node.error = reader.Error();
+    return;
+  }
+
+  std::wstring text;
+  int flags = IS_TEXT_UNICODE_UNICODE_MASK;
+  if (IsTextUnicode(buffer.data(), int(min(buffer.size(), size_t{256})), &flags))
+  {
+    text = reinterpret_cast<const wchar_t*>(buffer.data());
+  }
+  else
+  {
+    // A UTF-8 byte order mark would hide a directive on the first line
+    const char* ansi = reinterpret_cast<const char*>(buffer.data());
+    UINT codePage = CP_ACP;
+    if (3 <= reader.LoadedSize() && 0 == memcmp(ansi, "\xEF\xBB\xBF", 3))
+    {
+      ansi += 3;
+      codePage = CP_UTF8;
+    }
+    int chars = MultiByteToWideChar(codePage, 0, ansi, -1, nullptr, 0);
+    if (0 < chars)
+    {
+      text.resize(size_t(chars));
+      MultiByteToWideChar(codePage, 0, ansi, -1, &text[0], chars);
+      text.resize(wcslen(text.c_str()));
+    }
+  }
+
+  node.entry.size = reader.LoadedSize();
+  node.entry.lastWrite = reader.LoadedWriteTime();
+  node.entry.version = !text.empty() && 0 != RCUpdater<wchar_t>::FindStartOfVersion(&text[0]);
+  node.entry.includes.clear();
+  ParseIncludes(text.c_str(), node.entry.includes);
+
+  if (cache)
+  {
+    cache->Store(node.path.c_str(), node.entry);
+  }
+}
+
+std::wstring RCIncludeGraph::Locate(const RCIncludeCache::Include& include, const std::wstring& from) const
+{
+  std::vector<const std::wstring*> search;
+  if (include.quoted)
+  {
+    search.push_back(&from);
+  }
+  for (const auto& directory : directories)
+  {
+    search.push_back(&directory);
+  }
+
+  for (const std::wstring* directory : search)
+  {
+    std::wstring path = RCFileSet::FullPath(include.name.c_str(), directory->c_str());
+    DWORD attributes = GetFileAttributes(path.c_str());
+    if (INVALID_FILE_ATTRIBUTES != attributes && 0 == (attributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+      return path;
+    }
+  }
+  return std::wstring();
+}
+
+// ---------------------------------------------------------------------------
+// The graph is read level by level: all files of a level are read in
+// parallel, their includes not seen before make the next level. A file that
+// cannot be read stays in the list, updating it reports the error.
+// ---------------------------------------------------------------------------
+std::vector<std::wstring> RCIncludeGraph::Resolve(const std::vector<std::wstring>& roots)
+{
+  std::vector<Node> nodes;
+  std::unordered_map<std::wstring, size_t> seen;
+  std::vector<size_t> level;
+  for (const auto& root : roots)
+  {
+    std::wstring key = RCFileSet::NormalizeKey(RCFileSet::FullPath(root.c_str()).c_str());
+    if (seen.emplace(key, nodes.size()).second)
+    {
+      level.push_back(nodes.size());
+      nodes.push_back(Node{root, NO_ERROR, RCIncludeCache::Entry{}, {}});
+    }
+  }
+  size_t rootCount = nodes.size();
+
+  while (!level.empty())
+  {
+    std::atomic<size_t> next{0};
+    auto scan = [&]() {
+      for (size_t n = next++; n < level.size(); n = next++)
+      {
+        Scan(nodes[level[n]]);
+      }
+    };
+    std::vector<std::thread> scanners;
+    for (size_t n = 1; n < 16 && n < level.size(); ++n)
+    {
+      scanners.emplace_back(scan);
+    }
+    scan();
+    for (auto& thread : scanners)
+    {
+      thread.join();
+    }
+
+    std::vector<size_t> following;
+    for (size_t index : level)
+    {
+      if (NO_ERROR != nodes[index].error)
+      {
+        logger.Log(logDetail, L"Includes of [%s] not read, error %u.", nodes[index].path.c_str(), nodes[index].error);
+        continue;
+      }
+
+      std::wstring full = RCFileSet::FullPath(nodes[index].path.c_str());
+      std::wstring from = full.substr(0, full.find_last_of(L"\\/") + 1);
+      for (size_t n = 0; n < nodes[index].entry.includes.size(); ++n)
+      {
+        RCIncludeCache::Include include = nodes[index].entry.includes[n];
+        std::wstring path = Locate(include, from);
+        if (path.empty())
+        {
+          logger.Log(logVerbose, L"Include [%s] of [%s] not found.", include.name.c_str(), nodes[index].path.c_str());
+          continue;
+        }
+
+        auto found = seen.emplace(RCFileSet::NormalizeKey(path.c_str()), nodes.size());
+        if (found.second)
+        {
+          logger.Log(logDetail, L"Include [%s] of [%s] is [%s].", include.name.c_str(), nodes[index].path.c_str(), path.c_str());
+          following.push_back(nodes.size());
+          nodes.push_back(Node{path, NO_ERROR, RCIncludeCache::Entry{}, {}});
+        }
+        nodes[index].children.push_back(found.first->second);
+      }
+    }
+    level.swap(following);
+  }
+
+  std::vector<std::wstring> result;
+  for (size_t n = 0; n < nodes.size(); ++n)
+  {
+    bool update = nodes[n].entry.version || NO_ERROR != nodes[n].error;
+    if (!update && n < rootCount)
+    {
+      // Does any file the root includes have a version
+      std::vector<bool> visited(nodes.size());
+      std::vector<size_t> pending(nodes[n].children);
+      bool included{false};
+      while (!pending.empty() && !included)
+      {
+        size_t child = pending.back();
+        pending.pop_back();
+        if (visited[child])
+        {
+          continue;
+        }
+        visited[child] = true;
+        included = nodes[child].entry.version;
+        pending.insert(pending.end(), nodes[child].children.begin(), nodes[child].children.end());
+      }
+      update = !included;
+    }
+    if (update)
+    {
+      result.push_back(nodes[n].path);
+    }
+  }
+
+  logger.Log(logInfo, L"Include graph: %u input files, %u included files, %u files to update.",
+    unsigned(rootCount), unsigned(nodes.size() - rootCount), unsigned(result.size()));
+  return result;
+}
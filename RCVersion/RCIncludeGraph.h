@@ -0,0 +1,50 @@
+#pragma once
+#include "Logger.h"
+#include "RCIncludeCache.h"
+#include <string>
+#include <vector>
+
+// Files reached through #include from the input files, /include and
+// /i:<directory>. A "name" is looked for in the directory of the including
+// file first and then in the include directories, a <name> only in the
+// include directories; names not found there, like SDK headers, are skipped.
+// Every file is read once however many files include it, the files of one
+// level of the graph are read in parallel, and the directives of unchanged
+// files come from the cache.
+class RCIncludeGraph
+{
+public:
+  RCIncludeGraph(ILogger &rlogger);
+  virtual ~RCIncludeGraph();
+
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+  void Cache(RCIncludeCache* value) { cache = value; }
+  void Directories(const std::vector<std::wstring>& value) { directories = value; }
+
+  // The files to update for 'roots': every file of the graph with a
+  // VERSIONINFO block, each once. A root without one is left out when a file
+  // it includes has one, otherwise it stays so that its error is reported.
+  std::vector<std::wstring> Resolve(const std::vector<std::wstring>& roots);
+
+  static void ParseIncludes(const wchar_t* text, std::vector<RCIncludeCache::Include>& includes);
+
+protected:
+  struct Node
+  {
+    std::wstring path;
+    unsigned error;
+    RCIncludeCache::Entry entry;
+    std::vector<size_t> children;
+  };
+
+  void Scan(Node& node);
+  std::wstring Locate(const RCIncludeCache::Include& include, const std::wstring& from) const;
+
+  ILogger &ilogger;
+  Logger logger;
+  RCIncludeCache* cache;
+  std::vector<std::wstring> directories;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
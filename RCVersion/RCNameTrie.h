@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Names matched at a position of the text, the longest name wins. Every node
+// keeps its edges sorted by character, so a match takes one step per
+// character of the text however many names there are. Names are only looked
+// for where a keyword or a VALUE name must start, so the trie needs no
+// failure links of a full Aho-Corasick automaton.
+template <class CharT>
+class RCNameTrie
+{
+public:
+   static const unsigned NotFound = ~0u;
+
+   RCNameTrie()
+      : nodes(1)
+   {
+   }
+
+   // Names from a table ending with nullptr, their ids are the table indexes.
+   // The first 'skip' characters of every entry are not part of the name.
+   RCNameTrie(const CharT* const* table, size_t skip = 0)
+      : nodes(1)
+   {
+      for (unsigned id = 0; table && table[id]; ++id)
+         Add(std::basic_string<CharT>(table[id] + skip), id);
+   }
+
+   void Add(const std::basic_string<CharT> &name, unsigned id)
+   {
+      unsigned node = 0;
+      for (CharT c : name)
+      {
+         std::vector<Edge> &edges = nodes[node].edges;
+         auto edge = std::lower_bound(edges.begin(), edges.end(), c, Less);
+         if (edges.end() != edge && c == edge->c)
+         {
+            node = edge->next;
+            continue;
+         }
+
+         unsigned next = unsigned(nodes.size());
+         edges.insert(edge, Edge{c, next});
+         nodes.emplace_back();
+         node = next;
+      }
+      nodes[node].id = id;
+   }
+
+   // Id of the longest name at the start of 'text' and its length, NotFound if none
+   unsigned Match(const CharT *text, size_t &length) const
+   {
+      unsigned found = NotFound;
+      unsigned node = 0;
+      for (size_t n = 0; text[n]; ++n)
+      {
+         const std::vector<Edge> &edges = nodes[node].edges;
+         auto edge = std::lower_bound(edges.begin(), edges.end(), text[n], Less);
+         if (edges.end() == edge || text[n] != edge->c)
+            break;
+
+         node = edge->next;
+         if (NotFound != nodes[node].id)
+         {
+            found = nodes[node].id;
+            length = n + 1;
+         }
+      }
+      return found;
+   }
+
+protected:
+   struct Edge
+   {
+      CharT c;
+      unsigned next;
+   };
+
+   struct Node
+   {
+      Node() : id(NotFound) {}
+      std::vector<Edge> edges;
+      unsigned id;
+   };
+
+   static bool Less(const Edge &edge, CharT c) { return edge.c < c; }
+
+   std::vector<Node> nodes;
+};
@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "RCOffsetCache.h"
+#include "RCFileSet.h"
+
+RCOffsetCache::RCOffsetCache(size_t maxEntries)
+  : maxEntries(maxEntries)
+  , hits(0)
+  , misses(0)
+{
+}
+
+RCOffsetCache::~RCOffsetCache()
+{
+}
+
+bool RCOffsetCache::Find(const wchar_t* path, unsigned long long size, const FILETIME& lastWrite, bool unicode, std::vector<size_t>& offsets, uint64_t names)
+{
+  std::wstring key = RCFileSet::NormalizeKey(path);
+  std::lock_guard<std::mutex> guard(lock);
+
+  auto iter = entries.find(key);
+  if (entries.end() == iter)
+  {
+    ++misses;
+    return false;
+  }
+
+  const Entry& entry = iter->second;
+  if (entry.size != size || entry.unicode != unicode || entry.names != names || 0 != CompareFileTime(&entry.lastWrite, &lastWrite))
+  {
+    entries.erase(iter);
+    ++misses;
+    return false;
+  }
+
+  offsets = entry.offsets;
+  ++hits;
+  return true;
+}
+
+void RCOffsetCache::Store(const wchar_t* path, unsigned long long size, const FILETIME& lastWrite, bool unicode, const std::vector<size_t>& offsets, uint64_t names)
+{
+  std::wstring key = RCFileSet::NormalizeKey(path);
+  std::lock_guard<std::mutex> guard(lock);
+
+  // Simple bound on memory use, a long running server starts over
+  if (maxEntries <= entries.size() && entries.end() == entries.find(key))
+  {
+    entries.clear();
+  }
+
+  Entry& entry = entries[key];
+  entry.size = size;
+  entry.lastWrite = lastWrite;
+  entry.unicode = unicode;
+  entry.names = names;
+  entry.offsets = offsets;
+}
+
+// True if the file still has the size and time it had when it was stored
+bool RCOffsetCache::Current(const wchar_t* path, unsigned long long size, const FILETIME& lastWrite)
+{
+  std::wstring key = RCFileSet::NormalizeKey(path);
+  std::lock_guard<std::mutex> guard(lock);
+
+  auto iter = entries.find(key);
+  return entries.end() != iter && iter->second.size == size && 0 == CompareFileTime(&iter->second.lastWrite, &lastWrite);
+}
+
+void RCOffsetCache::Remove(const wchar_t* path)
+{
+  std::wstring key = RCFileSet::NormalizeKey(path);
+  std::lock_guard<std::mutex> guard(lock);
+  entries.erase(key);
+}
+
+void RCOffsetCache::Clear()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  entries.clear();
+}
+
+size_t RCOffsetCache::Count()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return entries.size();
+}
+
+unsigned long long RCOffsetCache::Hits()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return hits;
+}
+
+unsigned long long RCOffsetCache::Misses()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return misses;
+}
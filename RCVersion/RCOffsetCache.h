@@ -0,0 +1,43 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <stdint.h>
+
+// Version string offsets of files written earlier, shared by server worker threads.
+// An entry is used only while the file size and last write time are unchanged
+// and for the same StringFileInfo value names, see RCValueNames::Key.
+class RCOffsetCache
+{
+public:
+  struct Entry
+  {
+    unsigned long long size;
+    FILETIME lastWrite;
+    bool unicode;
+    uint64_t names;
+    std::vector<size_t> offsets;
+  };
+
+  RCOffsetCache(size_t maxEntries = 65536);
+  virtual ~RCOffsetCache();
+
+  bool Find(const wchar_t* path, unsigned long long size, const FILETIME& lastWrite, bool unicode, std::vector<size_t>& offsets, uint64_t names = 0);
+  void Store(const wchar_t* path, unsigned long long size, const FILETIME& lastWrite, bool unicode, const std::vector<size_t>& offsets, uint64_t names = 0);
+  bool Current(const wchar_t* path, unsigned long long size, const FILETIME& lastWrite);
+  void Remove(const wchar_t* path);
+  void Clear();
+
+  size_t Count();
+  unsigned long long Hits();
+  unsigned long long Misses();
+
+protected:
+  std::mutex lock;
+  std::unordered_map<std::wstring, Entry> entries;
+  size_t maxEntries;
+  unsigned long long hits;
+  unsigned long long misses;
+};
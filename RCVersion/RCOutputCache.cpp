@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "RCOutputCache.h"
+#include "RCFileHandler.h"
+
+#pragma comment(lib, "bcrypt.lib")
+
+// A new build of RCVersion may update differently, its entries are its own
+static const char ToolBuild[] = "RCVersion " __DATE__ " " __TIME__;
+
+static const ULONG HashBytes = 32;
+
+RCOutputCache::RCOutputCache(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , algorithm(nullptr)
+  , lookups(0)
+  , hits(0)
+  , stores(0)
+{
+}
+
+RCOutputCache::~RCOutputCache()
+{
+  if (algorithm)
+  {
+    BCryptCloseAlgorithmProvider(algorithm, 0);
+  }
+}
+
+bool RCOutputCache::Open(const wchar_t* path)
+{
+  directory = path ? path : L"";
+  while (!directory.empty() && (L'\\' == directory.back() || L'/' == directory.back()))
+  {
+    directory.pop_back();
+  }
+  if (directory.empty())
+  {
+    return logger.Error(error = ERROR_INVALID_PARAMETER, L"*** RCOutputCache::Open: Cache directory must not be empty");
+  }
+
+  if (!CreateDirectory(directory.c_str(), nullptr) && ERROR_ALREADY_EXISTS != GetLastError())
+  {
+    return logger.Error(error = GetLastError(), L"*** RCOutputCache::Open: Cannot create cache directory [%s]", directory.c_str());
+  }
+
+  NTSTATUS status = BCryptOpenAlgorithmProvider(&algorithm, BCRYPT_SHA256_ALGORITHM, nullptr, 0);
+  if (!BCRYPT_SUCCESS(status))
+  {
+    algorithm = nullptr;
+    return logger.Error(error = ERROR_NOT_SUPPORTED, L"*** RCOutputCache::Open: SHA-256 not available, status 0x%08X", unsigned(status));
+  }
+  logger.Log(logDetail, L"Output cache [%s]", directory.c_str());
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// The arguments and the build of RCVersion go before the bytes, each ended
+// by a zero so they cannot run into each other
+// ---------------------------------------------------------------------------
+std::wstring RCOutputCache::Key(const unsigned char* data, size_t size, const std::string& arguments) const
+{
+  if (!algorithm)
+  {
+    return std::wstring();
+  }
+
+  BCRYPT_HASH_HANDLE hash{nullptr};
+  if (!BCRYPT_SUCCESS(BCryptCreateHash(algorithm, &hash, nullptr, 0, nullptr, 0, 0)))
+  {
+    return std::wstring();
+  }
+
+  bool hashed = BCRYPT_SUCCESS(BCryptHashData(hash, reinterpret_cast<PUCHAR>(const_cast<char*>(ToolBuild)), ULONG(sizeof(ToolBuild)), 0)) &&
+    BCRYPT_SUCCESS(BCryptHashData(hash, reinterpret_cast<PUCHAR>(const_cast<char*>(arguments.c_str())), ULONG(arguments.size() + 1), 0));
+  // ULONG sized pieces, files may be larger
+  for (size_t done = 0; hashed && done < size; )
+  {
+    ULONG piece = ULONG(min(size - done, size_t{0x40000000}));
+    hashed = BCRYPT_SUCCESS(BCryptHashData(hash, const_cast<PUCHAR>(data + done), piece, 0));
+    done += piece;
+  }
+
+  unsigned char digest[HashBytes]{};
+  hashed = hashed && BCRYPT_SUCCESS(BCryptFinishHash(hash, digest, HashBytes, 0));
+  BCryptDestroyHash(hash);
+  if (!hashed)
+  {
+    return std::wstring();
+  }
+
+  static const wchar_t hex[] = L"0123456789abcdef";
+  std::wstring key;
+  for (unsigned char byte : digest)
+  {
+    key += hex[byte >> 4];
+    key += hex[byte & 0x0F];
+  }
+  return key;
+}
+
+bool RCOutputCache::Find(const std::wstring& key, RCBuffer& buffer, size_t& bytes)
+{
+  ++lookups;
+  std::wstring path = EntryPath(key);
+  if (key.empty() || INVALID_FILE_ATTRIBUTES == GetFileAttributes(path.c_str()))
+  {
+    return false;
+  }
+
+  RCFileHandler files{ilogger};
+  files.Verbosity(logger.Verbosity());
+  RCBuffer entry;
+  if (!files.LoadFile(path.c_str(), 2, entry))
+  {
+    return false;
+  }
+
+  bytes = size_t(files.LoadedSize());
+  buffer = std::move(entry);
+  ++hits;
+  logger.Log(logDetail, L"Output cache hit [%s]", key.c_str());
+  return true;
+}
+
+// An entry is complete once it has its name, a concurrent writer of the
+// same key writes the same bytes
+void RCOutputCache::Store(const std::wstring& key, const unsigned char* data, size_t bytes)
+{
+  if (key.empty())
+  {
+    return;
+  }
+
+  RCFileHandler files{ilogger};
+  files.Verbosity(logger.Verbosity());
+  std::wstring path = EntryPath(key);
+  if (files.SaveFile(path.c_str(), const_cast<unsigned char*>(data), bytes))
+  {
+    ++stores;
+  }
+}
+
+RCOutputCache::Statistics RCOutputCache::Stats() const
+{
+  return Statistics{lookups.load(), hits.load(), stores.load()};
+}
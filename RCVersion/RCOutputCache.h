@@ -0,0 +1,57 @@
+#pragma once
+#include "Logger.h"
+#include "RCBufferPool.h"
+#include <windows.h>
+#include <bcrypt.h>
+#include <atomic>
+#include <string>
+
+// Updated files kept in a directory, /cache:<dir>, under the SHA-256 of the
+// loaded bytes, the version arguments and the build of RCVersion. A tree
+// stamped again with the same arguments, by another configuration or on
+// another platform, takes its output from there without parsing it. Entries
+// are written once and never change, so several processes may share the
+// directory; nothing is evicted, the directory may be deleted at any time.
+class RCOutputCache
+{
+public:
+  struct Statistics
+  {
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long stores;
+  };
+
+  RCOutputCache(ILogger &rlogger);
+  virtual ~RCOutputCache();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+
+  // Creates the directory when it does not exist
+  bool Open(const wchar_t* path);
+
+  // Hex key of 'data' updated with 'arguments', empty when it cannot be hashed
+  std::wstring Key(const unsigned char* data, size_t size, const std::string& arguments) const;
+  // The output stored for 'key' replaces 'buffer', followed by two zero bytes
+  bool Find(const std::wstring& key, RCBuffer& buffer, size_t& bytes);
+  void Store(const std::wstring& key, const unsigned char* data, size_t bytes);
+
+  // Safe to call while other threads use the cache
+  Statistics Stats() const;
+
+protected:
+  std::wstring EntryPath(const std::wstring& key) const { return directory + L"\\" + key; }
+
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+  std::wstring directory;
+  BCRYPT_ALG_HANDLE algorithm;
+  std::atomic<unsigned long long> lookups;
+  std::atomic<unsigned long long> hits;
+  std::atomic<unsigned long long> stores;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
@@ -0,0 +1,439 @@
+#include "stdafx.h"
+#include "RCOutputFiles.h"
+#include "RCFileLock.h"
+#include "wil/resource.h"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+
+RCOutputFiles::RCOutputFiles(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , transaction(false)
+  , stats{}
+{
+}
+
+// Files never committed keep their old content
+RCOutputFiles::~RCOutputFiles()
+{
+  for (const auto& file : pending)
+  {
+    Discard(file.temp);
+  }
+}
+
+// The temporary file must be on the volume of the destination for the rename
+static std::wstring DirectoryOf(const std::wstring& path)
+{
+  size_t separator = path.find_last_of(L"\\/");
+  return (std::wstring::npos == separator) ? std::wstring(L".") : path.substr(0, separator + 1);
+}
+
+HANDLE RCOutputFiles::Open(const wchar_t* path, DWORD flags, std::wstring& temp, unsigned& code)
+{
+  wchar_t name[MAX_PATH]{};
+  if (0 == GetTempFileName(DirectoryOf(path).c_str(), L"rcv", 0, name))
+  {
+    logger.Error(code = GetLastError(), L"*** RCOutputFiles::Open: Cannot create a temporary file for [%s]", path);
+    return INVALID_HANDLE_VALUE;
+  }
+
+  HANDLE hFile = CreateFile(name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, flags, nullptr);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    logger.Error(code = GetLastError(), L"*** RCOutputFiles::Open: Cannot open temporary file [%s]", name);
+    DeleteFile(name);
+    return INVALID_HANDLE_VALUE;
+  }
+
+  logger.Log(logVerbose, L"Writing [%s] to [%s].", path, name);
+  code = NO_ERROR;
+  temp = name;
+  return hFile;
+}
+
+void RCOutputFiles::Discard(const std::wstring& temp)
+{
+  if (!temp.empty() && !DeleteFile(temp.c_str()))
+  {
+    logger.Log(logNormal, L"Cannot delete temporary file [%s], error %u.", temp.c_str(), GetLastError());
+  }
+}
+
+void RCOutputFiles::Written(const std::wstring& path, const std::wstring& temp, size_t tag, const FileState* expected)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  pending.push_back(Pending{path, temp, tag, NO_ERROR, nullptr != expected, expected ? *expected : FileState{}});
+}
+
+bool RCOutputFiles::Commit(const std::function<void(size_t tag, unsigned code)>& done)
+{
+  std::vector<Pending> files;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    files.swap(pending);
+  }
+  if (files.empty())
+  {
+    return true;
+  }
+
+  size_t volumeFlushed = Flush(files);
+
+  bool success{true};
+  if (transaction)
+  {
+    success = CommitAll(files);
+  }
+  else
+  {
+    for (auto& file : files)
+    {
+      file.error = (NO_ERROR == file.error) ? Install(file) : file.error;
+      if (NO_ERROR != file.error)
+      {
+        Discard(file.temp);
+        error = success ? file.error : error;
+        success = false;
+      }
+    }
+  }
+
+  for (const auto& file : files)
+  {
+    ++stats.files;
+    if (done)
+    {
+      done(file.tag, file.error);
+    }
+  }
+
+  logger.Log(logDetail, L"Committed %u files, %u flushed by volume.", unsigned(files.size()), unsigned(volumeFlushed));
+  return success;
+}
+
+void RCOutputFiles::Abort()
+{
+  std::vector<Pending> files;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    files.swap(pending);
+  }
+  for (const auto& file : files)
+  {
+    Discard(file.temp);
+  }
+  logger.Log(logDetail, L"Discarded %u written files.", unsigned(files.size()));
+}
+
+// ---------------------------------------------------------------------------
+// Flushing a volume writes the data of all its files with one request, but
+// needs administrator rights. Files on other volumes are flushed one by one
+// by several threads, so their waits overlap.
+// ---------------------------------------------------------------------------
+size_t RCOutputFiles::Flush(std::vector<Pending>& files)
+{
+  std::map<std::wstring, std::vector<size_t>> volumes;
+  for (size_t n = 0; n < files.size(); ++n)
+  {
+    wchar_t volume[MAX_PATH]{};
+    if (!GetVolumePathName(files[n].temp.c_str(), volume, MAX_PATH))
+    {
+      volume[0] = 0;
+    }
+    volumes[volume].push_back(n);
+  }
+
+  std::vector<size_t> unflushed;
+  for (const auto& volume : volumes)
+  {
+    if (volume.first.empty() || !FlushVolume(volume.first))
+    {
+      unflushed.insert(unflushed.end(), volume.second.begin(), volume.second.end());
+    }
+  }
+
+  std::atomic<size_t> next{0};
+  auto flush = [&]() {
+    for (size_t n = next++; n < unflushed.size(); n = next++)
+    {
+      files[unflushed[n]].error = FlushFile(files[unflushed[n]].temp);
+    }
+  };
+  std::vector<std::thread> flushers;
+  for (size_t n = 1; n < 16 && n < unflushed.size(); ++n)
+  {
+    flushers.emplace_back(flush);
+  }
+  flush();
+  for (auto& thread : flushers)
+  {
+    thread.join();
+  }
+  stats.fileFlushes += unflushed.size();
+  return files.size() - unflushed.size();
+}
+
+// ---------------------------------------------------------------------------
+// All or none: the old data of every destination is kept in a link before
+// the first rename. After a failure the renamed files get their links back
+// and the others keep theirs untouched.
+// ---------------------------------------------------------------------------
+bool RCOutputFiles::CommitAll(std::vector<Pending>& files)
+{
+  size_t failed{files.size()};
+  for (size_t n = 0; n < files.size() && files.size() == failed; ++n)
+  {
+    failed = (NO_ERROR != files[n].error) ? n : failed;
+  }
+
+  // All destinations stay locked until the end. Locks are taken in the order
+  // of their names, so two transactions over the same files cannot deadlock.
+  std::vector<std::pair<std::wstring, size_t>> order;
+  for (size_t n = 0; n < files.size(); ++n)
+  {
+    order.emplace_back(RCFileLock::Name(files[n].path.c_str()), n);
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<std::unique_ptr<RCFileLock>> locks;
+  for (size_t n = 0; n < order.size() && files.size() == failed; ++n)
+  {
+    if (0 < n && order[n].first == order[n - 1].first)
+    {
+      continue;
+    }
+    Pending& file = files[order[n].second];
+    locks.push_back(std::make_unique<RCFileLock>(ilogger));
+    locks.back()->Verbosity(logger.Verbosity());
+    if (!locks.back()->Acquire(file.path.c_str()))
+    {
+      file.error = locks.back()->Error();
+      failed = order[n].second;
+    }
+  }
+
+  std::vector<std::wstring> backups(files.size());
+  std::vector<bool> moved(files.size(), false);
+  for (size_t n = 0; n < files.size() && files.size() == failed; ++n)
+  {
+    files[n].error = Compare(files[n]);
+    if (NO_ERROR != files[n].error)
+    {
+      failed = n;
+      continue;
+    }
+
+    // A new file has nothing to keep
+    if (INVALID_FILE_ATTRIBUTES == GetFileAttributes(files[n].path.c_str()))
+    {
+      continue;
+    }
+
+    bool renamed{};
+    files[n].error = Preserve(files[n].path, files[n].path + L".rcbak", renamed);
+    if (NO_ERROR != files[n].error)
+    {
+      failed = n;
+      continue;
+    }
+    backups[n] = files[n].path + L".rcbak";
+    moved[n] = renamed;
+  }
+
+  size_t replaced{};
+  while (files.size() == failed && replaced < files.size())
+  {
+    files[replaced].error = Rename(files[replaced].path, files[replaced].temp);
+    if (NO_ERROR != files[replaced].error)
+    {
+      failed = replaced;
+      break;
+    }
+    ++replaced;
+  }
+
+  if (files.size() == failed)
+  {
+    for (const auto& backup : backups)
+    {
+      if (!backup.empty() && !DeleteFile(backup.c_str()))
+      {
+        logger.Log(logNormal, L"Cannot delete backup link [%s], error %u.", backup.c_str(), GetLastError());
+      }
+    }
+    logger.Log(logDetail, L"Transaction of %u files committed.", unsigned(files.size()));
+    return true;
+  }
+
+  error = files[failed].error;
+  for (size_t n = 0; n < files.size(); ++n)
+  {
+    Pending& file = files[n];
+    if (replaced <= n)
+    {
+      Discard(file.temp);
+    }
+
+    if (!backups[n].empty() && (n < replaced || moved[n]))
+    {
+      if (!MoveFileEx(backups[n].c_str(), file.path.c_str(), MOVEFILE_REPLACE_EXISTING))
+      {
+        logger.Error(GetLastError(), L"*** RCOutputFiles::Commit: Cannot restore [%s] from [%s]", file.path.c_str(), backups[n].c_str());
+      }
+    }
+    else if (!backups[n].empty())
+    {
+      DeleteFile(backups[n].c_str());
+    }
+    else if (n < replaced)
+    {
+      DeleteFile(file.path.c_str());
+    }
+
+    file.error = (NO_ERROR == file.error) ? ERROR_CANCELLED : file.error;
+  }
+
+  logger.Log(logNormal, L"Transaction of %u files rolled back, no file changed.", unsigned(files.size()));
+  return false;
+}
+
+bool RCOutputFiles::Replace(const std::wstring& path, const std::wstring& temp, const FileState* expected)
+{
+  Pending file{path, temp, 0, NO_ERROR, nullptr != expected, expected ? *expected : FileState{}};
+  unsigned code = FlushFile(temp);
+  code = (NO_ERROR == code) ? Install(file) : code;
+  if (NO_ERROR != code)
+  {
+    Discard(temp);
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  ++stats.fileFlushes;
+  ++stats.files;
+  error = (NO_ERROR != code) ? code : error;
+  return NO_ERROR == code;
+}
+
+bool RCOutputFiles::FlushVolume(const std::wstring& path)
+{
+  wchar_t name[MAX_PATH]{};
+  if (!GetVolumeNameForVolumeMountPoint(path.c_str(), name, MAX_PATH))
+  {
+    return false;
+  }
+
+  // The volume itself is opened without the trailing backslash
+  size_t length = wcslen(name);
+  if (0 < length && L'\\' == name[length - 1])
+  {
+    name[length - 1] = 0;
+  }
+
+  wil::unique_hfile hVolume(CreateFile(name, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr));
+  if (!hVolume || !FlushFileBuffers(hVolume.get()))
+  {
+    logger.Log(logVerbose, L"Cannot flush volume [%s], error %u, flushing files.", path.c_str(), GetLastError());
+    return false;
+  }
+
+  ++stats.volumeFlushes;
+  return true;
+}
+
+// Flushing through any handle writes all cached data of the file
+unsigned RCOutputFiles::FlushFile(const std::wstring& temp)
+{
+  wil::unique_hfile hFile(CreateFile(temp.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr));
+  if (!hFile || !FlushFileBuffers(hFile.get()))
+  {
+    unsigned code = GetLastError();
+    logger.Error(code, L"*** RCOutputFiles::Commit: Cannot flush temporary file [%s]", temp.c_str());
+    return code;
+  }
+  return NO_ERROR;
+}
+
+unsigned RCOutputFiles::Rename(const std::wstring& path, const std::wstring& temp)
+{
+  if (!MoveFileEx(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+  {
+    unsigned code = GetLastError();
+    logger.Error(code, L"*** RCOutputFiles::Commit: Cannot replace output file [%s]", path.c_str());
+    return code;
+  }
+  return NO_ERROR;
+}
+
+// The check and the rename hold the lock of the destination, no other
+// RCVersion replaces it in between
+unsigned RCOutputFiles::Install(const Pending& file)
+{
+  RCFileLock fileLock{ilogger};
+  fileLock.Verbosity(logger.Verbosity());
+  if (!fileLock.Acquire(file.path.c_str()))
+  {
+    return fileLock.Error();
+  }
+
+  unsigned code = Compare(file);
+  return (NO_ERROR == code) ? Rename(file.path, file.temp) : code;
+}
+
+// A file updated in place must still be the one that was read
+unsigned RCOutputFiles::Compare(const Pending& file)
+{
+  if (!file.compare)
+  {
+    return NO_ERROR;
+  }
+
+  WIN32_FILE_ATTRIBUTE_DATA data{};
+  if (GetFileAttributesEx(file.path.c_str(), GetFileExInfoStandard, &data))
+  {
+    ULARGE_INTEGER size{};
+    size.LowPart = data.nFileSizeLow;
+    size.HighPart = data.nFileSizeHigh;
+    if (size.QuadPart == file.expected.size && 0 == CompareFileTime(&data.ftLastWriteTime, &file.expected.lastWrite))
+    {
+      return NO_ERROR;
+    }
+  }
+
+  logger.Log(logNormal, L"File [%s] was changed by another process after it was read.", file.path.c_str());
+  return ERROR_RETRY;
+}
+
+// A hard link keeps the destination in place. Where the file system has no
+// links the destination itself is renamed, it is missing until the commit.
+unsigned RCOutputFiles::Preserve(const std::wstring& path, const std::wstring& backup, bool& moved)
+{
+  moved = false;
+  if (CreateHardLink(backup.c_str(), path.c_str(), nullptr))
+  {
+    return NO_ERROR;
+  }
+
+  unsigned code = GetLastError();
+  if (ERROR_INVALID_FUNCTION == code || ERROR_NOT_SUPPORTED == code)
+  {
+    if (MoveFileEx(path.c_str(), backup.c_str(), 0))
+    {
+      moved = true;
+      return NO_ERROR;
+    }
+    code = GetLastError();
+  }
+
+  if (ERROR_ALREADY_EXISTS == code || ERROR_FILE_EXISTS == code)
+  {
+    logger.Error(code, L"*** RCOutputFiles::Commit: [%s] is left from an interrupted transaction, restore or delete it", backup.c_str());
+    return code;
+  }
+  logger.Error(code, L"*** RCOutputFiles::Commit: Cannot keep the old data of [%s]", path.c_str());
+  return code;
+}
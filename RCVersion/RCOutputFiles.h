@@ -0,0 +1,105 @@
+#pragma once
+#include "Logger.h"
+#include <windows.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Output files are written to a temporary file in the directory of the
+// destination and renamed over it once their data is on disk, so a crash or
+// a killed build leaves either the old or the new file, never a truncated
+// one. Files of a run are committed together: the data is flushed once per
+// volume where the process may do that, otherwise the files are flushed in
+// parallel, and the renames follow.
+//
+// In a transaction the files of a run are committed all or none. Before the
+// renames every existing destination gets a hard link '<path>.rcbak' to its
+// old data, so both the commit and the rollback take one rename per file and
+// no copy. The links are removed when all renames succeeded; after a crash
+// during the commit they still hold the old files.
+//
+// A file updated in place may be replaced by another process between the
+// read and the rename. Such a file is renamed under RCFileLock and only
+// while the destination still has the size and time it had when it was
+// read, otherwise it reports ERROR_RETRY and must be read again.
+class RCOutputFiles
+{
+public:
+  struct Statistics
+  {
+    unsigned long long files;
+    unsigned long long volumeFlushes;
+    unsigned long long fileFlushes;
+  };
+
+  // A destination as it was read
+  struct FileState
+  {
+    unsigned long long size;
+    FILETIME lastWrite;
+  };
+
+  RCOutputFiles(ILogger &rlogger);
+  virtual ~RCOutputFiles();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+  Statistics Stats() const { return stats; }
+  void Transaction(bool value) { transaction = value; }
+  bool Transaction() const { return transaction; }
+
+  // Creates the temporary file for 'path' and returns it open for writing,
+  // INVALID_HANDLE_VALUE with 'code' set when it cannot be created
+  HANDLE Open(const wchar_t* path, DWORD flags, std::wstring& temp, unsigned& code);
+  void Discard(const std::wstring& temp);
+
+  // A completely written file waits for Commit, 'tag' identifies it there.
+  // With 'expected' it only replaces the destination still in that state.
+  // May be called from several threads.
+  void Written(const std::wstring& path, const std::wstring& temp, size_t tag, const FileState* expected = nullptr);
+
+  // Flushes and renames the written files. 'done' is called for every file
+  // with its tag and NO_ERROR or the error; false when any of them failed.
+  // In a transaction a failure restores all files and every other file
+  // reports ERROR_CANCELLED, Error() has the cause.
+  bool Commit(const std::function<void(size_t tag, unsigned code)>& done = nullptr);
+
+  // Discards all written files, for a run that failed before its commit
+  void Abort();
+
+  // One file on its own: flush and rename at once. May be called from
+  // several threads.
+  bool Replace(const std::wstring& path, const std::wstring& temp, const FileState* expected = nullptr);
+
+protected:
+  struct Pending
+  {
+    std::wstring path;
+    std::wstring temp;
+    size_t tag;
+    unsigned error;
+    bool compare;
+    FileState expected;
+  };
+
+  size_t Flush(std::vector<Pending>& files);
+  bool CommitAll(std::vector<Pending>& files);
+  bool FlushVolume(const std::wstring& path);
+  unsigned FlushFile(const std::wstring& temp);
+  unsigned Rename(const std::wstring& path, const std::wstring& temp);
+  unsigned Install(const Pending& file);
+  unsigned Compare(const Pending& file);
+  unsigned Preserve(const std::wstring& path, const std::wstring& backup, bool& moved);
+
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+  bool transaction;
+  Statistics stats;
+  std::mutex lock;
+  std::vector<Pending> pending;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
@@ -0,0 +1,272 @@
+#include "stdafx.h"
+#include "RCPeImage.h"
+#include <string.h>
+
+RCPeImage::RCPeImage(uint8_t* data, size_t size)
+  : data(data)
+  , size(size)
+  , checksumOffset(0)
+  , isSigned(false)
+  , missing(0)
+  , resourceRva(0)
+  , resourceSize(0)
+  , resourceOffset(0)
+{
+}
+
+// ---------------------------------------------------------------------------
+// All version resources are patched or none: the new blocks are built before
+// the first byte of the image changes.
+// ---------------------------------------------------------------------------
+RCPeImage::Result RCPeImage::UpdateVersion(int major, int minor, int build, int revision, const std::vector<std::u16string>& names, unsigned& changes)
+{
+  changes = 0;
+  missing = 0;
+  if (!ReadHeaders())
+  {
+    return NotImage;
+  }
+  if (0 == resourceRva)
+  {
+    return NoVersion;
+  }
+
+  std::vector<DataEntry> entries;
+  if (0 == (resourceOffset = Offset(resourceRva, 16)) || !CollectData(0, 0, false, entries))
+  {
+    return Corrupt;
+  }
+
+  std::vector<std::pair<const DataEntry*, std::vector<uint8_t>>> patches;
+  for (const DataEntry& entry : entries)
+  {
+    if (entry.version)
+    {
+      patches.emplace_back(&entry, std::vector<uint8_t>());
+      Result result = Patch(entry, entries, major, minor, build, revision, names, changes, patches.back().second);
+      if (Patched != result)
+      {
+        return result;
+      }
+    }
+  }
+  if (patches.empty())
+  {
+    return NoVersion;
+  }
+  // Nothing written, the checksum and the file time stay as they are
+  if (0 == changes)
+  {
+    return Unchanged;
+  }
+
+  for (const auto& patch : patches)
+  {
+    const DataEntry& entry = *patch.first;
+    const std::vector<uint8_t>& bytes = patch.second;
+    uint8_t* target = data + Offset(entry.rva, uint32_t(bytes.size()));
+    memcpy(target, bytes.data(), bytes.size());
+    if (bytes.size() < entry.size)
+    {
+      memset(target + bytes.size(), 0, entry.size - bytes.size());
+    }
+    RCVersionInfo::Write32(data + entry.entryOffset + 4, uint32_t(bytes.size()));
+  }
+
+  if (0 != RCVersionInfo::Read32(data + checksumOffset))
+  {
+    RCVersionInfo::Write32(data + checksumOffset, CheckSum(data, size, checksumOffset));
+  }
+  return Patched;
+}
+
+uint32_t RCPeImage::CheckSum(const uint8_t* data, size_t size, size_t checksumOffset)
+{
+  uint32_t sum{};
+  for (size_t n = 0; n < size; n += 2)
+  {
+    if (n == checksumOffset || n == checksumOffset + 2)
+    {
+      continue;
+    }
+    sum += n + 1 < size ? RCVersionInfo::Read16(data + n) : data[n];
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  return uint32_t((sum & 0xFFFF) + size);
+}
+
+// ---------------------------------------------------------------------------
+// DOS header, PE signature, file header, optional header and section table
+// ---------------------------------------------------------------------------
+bool RCPeImage::IsImage(const uint8_t* data, size_t size)
+{
+  if (size < 0x40 || 'M' != data[0] || 'Z' != data[1])
+  {
+    return false;
+  }
+  size_t pe = RCVersionInfo::Read32(data + 0x3C);
+  return pe <= size && 24 <= size - pe && 0 == memcmp(data + pe, "PE\0\0", 4);
+}
+
+bool RCPeImage::ReadHeaders()
+{
+  using RCV = RCVersionInfo;
+  if (!IsImage(data, size))
+  {
+    return false;
+  }
+  size_t pe = RCV::Read32(data + 0x3C);
+
+  size_t sectionCount = RCV::Read16(data + pe + 6);
+  size_t optionalSize = RCV::Read16(data + pe + 20);
+  size_t optional = pe + 24;
+  if (size - optional < optionalSize || optionalSize < 2)
+  {
+    return false;
+  }
+
+  // PE32 and PE32+ differ in the size of the fields before the directories
+  size_t directories{};
+  switch (RCV::Read16(data + optional))
+  {
+  case 0x10B: directories = 96; break;
+  case 0x20B: directories = 112; break;
+  default: return false;
+  }
+  if (optionalSize < directories)
+  {
+    return false;
+  }
+  checksumOffset = optional + 64;
+
+  size_t directoryCount = RCV::Read32(data + optional + directories - 4);
+  auto directory = [&](size_t index, uint32_t& rva, uint32_t& bytes) {
+    size_t offset = directories + 8 * index;
+    rva = bytes = 0;
+    if (index < directoryCount && offset + 8 <= optionalSize)
+    {
+      rva = RCV::Read32(data + optional + offset);
+      bytes = RCV::Read32(data + optional + offset + 4);
+    }
+  };
+  uint32_t securityOffset{}, securitySize{};
+  directory(SecurityDirectory, securityOffset, securitySize);
+  isSigned = 0 != securitySize;
+  directory(ResourceDirectory, resourceRva, resourceSize);
+
+  size_t table = optional + optionalSize;
+  if ((size - table) / 40 < sectionCount)
+  {
+    return false;
+  }
+  sections.clear();
+  for (size_t n = 0; n < sectionCount; ++n)
+  {
+    const uint8_t* header = data + table + 40 * n;
+    uint32_t virtualSize = RCV::Read32(header + 8);
+    uint32_t rawSize = RCV::Read32(header + 16);
+    // Only what is both in the file and mapped by the loader can be used
+    Section section{RCV::Read32(header + 12), 0 != virtualSize && virtualSize < rawSize ? virtualSize : rawSize, RCV::Read32(header + 20)};
+    if (section.offset <= size && section.size <= size - section.offset)
+    {
+      sections.push_back(section);
+    }
+  }
+  return true;
+}
+
+size_t RCPeImage::Offset(uint32_t rva, uint32_t bytes, uint32_t* room) const
+{
+  for (const Section& section : sections)
+  {
+    if (section.rva <= rva && rva - section.rva < section.size && bytes <= section.size - (rva - section.rva))
+    {
+      if (room)
+      {
+        *room = section.size - (rva - section.rva);
+      }
+      return section.offset + (rva - section.rva);
+    }
+  }
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// The resource tree has three levels, type, name and language, so deeper
+// directories, which could also be loops, mean a damaged image.
+// ---------------------------------------------------------------------------
+bool RCPeImage::CollectData(uint32_t directory, int level, bool version, std::vector<DataEntry>& entries) const
+{
+  using RCV = RCVersionInfo;
+  size_t offset = Offset(resourceRva + directory, 16);
+  if (0 == offset || 2 < level)
+  {
+    return false;
+  }
+
+  size_t count = size_t(RCV::Read16(data + offset + 12)) + RCV::Read16(data + offset + 14);
+  for (size_t n = 0; n < count; ++n)
+  {
+    size_t entry = Offset(uint32_t(resourceRva + directory + 16 + 8 * n), 8);
+    if (0 == entry)
+    {
+      return false;
+    }
+    uint32_t id = RCV::Read32(data + entry);
+    uint32_t target = RCV::Read32(data + entry + 4);
+    bool isVersion = version || (0 == level && ResourceVersion == id);
+    if (0 != (target & 0x80000000))
+    {
+      if (!CollectData(target & 0x7FFFFFFF, level + 1, isVersion, entries))
+      {
+        return false;
+      }
+      continue;
+    }
+
+    size_t dataEntry = Offset(resourceRva + target, 16);
+    if (0 == dataEntry)
+    {
+      return false;
+    }
+    entries.push_back(DataEntry{dataEntry, RCV::Read32(data + dataEntry), RCV::Read32(data + dataEntry + 4), isVersion});
+  }
+  return true;
+}
+
+RCPeImage::Result RCPeImage::Patch(const DataEntry& entry, const std::vector<DataEntry>& entries, int major, int minor, int build, int revision,
+  const std::vector<std::u16string>& names, unsigned& changes, std::vector<uint8_t>& patched)
+{
+  uint32_t room{};
+  size_t offset = Offset(entry.rva, entry.size, &room);
+  RCVersionInfo info;
+  if (0 == offset || !info.Parse(data + offset, entry.size))
+  {
+    return Corrupt;
+  }
+
+  unsigned blockChanges{};
+  switch (info.Update(major, minor, build, revision, names, blockChanges))
+  {
+  case RCVersionInfo::Corrupt: return Corrupt;
+  case RCVersionInfo::Overflow: return Overflow;
+  default: break;
+  }
+  changes += blockChanges;
+  patched = info.Serialize();
+
+  // The padding after the resource is free up to the data of the next one
+  for (const DataEntry& other : entries)
+  {
+    if (entry.rva < other.rva && other.rva - entry.rva < room)
+    {
+      room = other.rva - entry.rva;
+    }
+  }
+  if (room < patched.size())
+  {
+    missing = patched.size() - room;
+    return NoRoom;
+  }
+  return Patched;
+}
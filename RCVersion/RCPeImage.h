@@ -0,0 +1,66 @@
+#pragma once
+#include "RCVersionInfo.h"
+
+// A PE file in memory, 32 or 64 bit. The RT_VERSION resources in its .rsrc
+// section are patched in place: a resource may grow into the padding up to
+// the next resource or the end of the section, nothing in the image moves.
+// The checksum is recomputed when the linker wrote one.
+//
+// Plain C++ without Windows headers, see RCVersionInfo.
+class RCPeImage
+{
+public:
+  enum Result {Patched, Unchanged, NotImage, NoVersion, Corrupt, Overflow, NoRoom};
+
+  RCPeImage(uint8_t* data, size_t size);
+
+  Result UpdateVersion(int major, int minor, int build, int revision, const std::vector<std::u16string>& names, unsigned& changes);
+
+  // Available once UpdateVersion has read the headers
+  bool Signed() const { return isSigned; }
+  // Bytes missing for the version resource that did not fit, for NoRoom
+  size_t Missing() const { return missing; }
+
+  // The DOS header and the PE signature it points to
+  static bool IsImage(const uint8_t* data, size_t size);
+  // The checksum of the image, computed as CheckSumMappedFile does
+  static uint32_t CheckSum(const uint8_t* data, size_t size, size_t checksumOffset);
+
+protected:
+  struct Section
+  {
+    uint32_t rva;
+    uint32_t size;
+    uint32_t offset;
+  };
+
+  struct DataEntry
+  {
+    size_t entryOffset;
+    uint32_t rva;
+    uint32_t size;
+    bool version;
+  };
+
+  bool ReadHeaders();
+  // File offset of 'bytes' at 'rva', 0 if they are not all in one section;
+  // 'room' gets the bytes from 'rva' to the end of the section
+  size_t Offset(uint32_t rva, uint32_t bytes, uint32_t* room = nullptr) const;
+  bool CollectData(uint32_t directory, int level, bool version, std::vector<DataEntry>& entries) const;
+  Result Patch(const DataEntry& entry, const std::vector<DataEntry>& entries, int major, int minor, int build, int revision,
+    const std::vector<std::u16string>& names, unsigned& changes, std::vector<uint8_t>& patched);
+
+  static const uint32_t ResourceVersion = 16;
+  static const size_t ResourceDirectory = 2;
+  static const size_t SecurityDirectory = 4;
+
+  uint8_t* data;
+  size_t size;
+  size_t checksumOffset;
+  bool isSigned;
+  size_t missing;
+  uint32_t resourceRva;
+  uint32_t resourceSize;
+  size_t resourceOffset;
+  std::vector<Section> sections;
+};
@@ -0,0 +1,384 @@
+#include "stdafx.h"
+#include "RCPipeline.h"
+#include "RCFileHandler.h"
+#include <chrono>
+#include <thread>
+
+RCPipeline::RCPipeline(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(ilogger)
+  , error(0)
+  , cache(nullptr)
+  , pool(nullptr)
+  , skipUnchanged(false)
+  , transaction(false)
+  , valueNames(nullptr)
+  , diff(nullptr)
+  , outputCache(nullptr)
+  , contents(nullptr)
+  , workers{}
+  , stats{}
+  , paths(nullptr)
+  , version{-1, -1, -1, -1}
+  , nextPath(0)
+  , readers(0)
+  , parsers(0)
+  , parseQueue(QueueDepth)
+  , writeQueue(QueueDepth)
+  , output(nullptr)
+  , failed(0)
+  , firstFailed(0)
+{
+}
+
+RCPipeline::~RCPipeline()
+{
+}
+
+void RCPipeline::Workers(unsigned read, unsigned parse, unsigned write)
+{
+  workers[Read] = read;
+  workers[Parse] = parse;
+  workers[Write] = write;
+}
+
+const wchar_t* RCPipeline::StageName(Stage stage)
+{
+  static const wchar_t* names[StageCount] = {L"read", L"parse", L"write"};
+  return (0 <= stage && stage < StageCount) ? names[stage] : L"?";
+}
+
+// ---------------------------------------------------------------------------
+// Start the workers of all stages and wait until the last writer is done
+// ---------------------------------------------------------------------------
+bool RCPipeline::Run(const std::vector<std::wstring>& files, int major, int minor, int build, int revision)
+{
+  logger.Log(logDetail, L"RCPipeline::Run(%u files)", unsigned(files.size()));
+
+  // Reads and writes wait for the disk, parsing for the CPU
+  unsigned cores = max(1u, std::thread::hardware_concurrency());
+  unsigned counts[StageCount] = {
+    workers[Read] ? workers[Read] : 4,
+    workers[Parse] ? workers[Parse] : cores,
+    workers[Write] ? workers[Write] : 4,
+  };
+
+  paths = &files;
+  version[0] = major;
+  version[1] = minor;
+  version[2] = build;
+  version[3] = revision;
+  nextPath = 0;
+  readers = counts[Read];
+  parsers = counts[Parse];
+  error = 0;
+  failed = 0;
+  firstFailed = files.size();
+  for (int stage = 0; stage < StageCount; ++stage)
+  {
+    stats[stage] = StageStatistics{};
+    stats[stage].workers = counts[stage];
+  }
+
+  logger.Log(logInfo, L"Pipeline with %u read, %u parse and %u write workers.", counts[Read], counts[Parse], counts[Write]);
+
+  RCOutputFiles outputFiles{ilogger};
+  outputFiles.Verbosity(logger.Verbosity());
+  outputFiles.Transaction(transaction);
+  output = &outputFiles;
+  saved.assign(files.size(), Saved{});
+
+  std::vector<std::thread> threads;
+  for (unsigned n = 0; n < counts[Read]; ++n)
+  {
+    threads.emplace_back(&RCPipeline::ReadWorker, this);
+  }
+  for (unsigned n = 0; n < counts[Parse]; ++n)
+  {
+    threads.emplace_back(&RCPipeline::ParseWorker, this);
+  }
+  for (unsigned n = 0; n < counts[Write]; ++n)
+  {
+    threads.emplace_back(&RCPipeline::WriteWorker, this);
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  output = nullptr;
+  if (transaction && 0 != failed)
+  {
+    outputFiles.Abort();
+    saved.clear();
+    paths = nullptr;
+    logger.Log(logInfo, L"%u of %u files failed, transaction rolled back, no file changed.", failed, unsigned(files.size()));
+    return false;
+  }
+
+  RCFileHandler handler{ilogger};
+  handler.Verbosity(logger.Verbosity());
+  handler.Cache(cache);
+  handler.ValueNames(valueNames);
+  std::vector<size_t> changed;
+  bool committed = outputFiles.Commit([&](size_t index, unsigned code) {
+    const wchar_t* path = (*paths)[index].c_str();
+    if (ERROR_RETRY == code && !transaction)
+    {
+      changed.push_back(index);
+      return;
+    }
+    if (NO_ERROR != code)
+    {
+      Failed(index, code);
+      if (cache)
+      {
+        cache->Remove(path);
+      }
+      return;
+    }
+    handler.StoreOffsets(path, saved[index].isUnicode, saved[index].offsets);
+  });
+
+  // Files replaced by another process since they were read start over, then
+  // the mapped images are patched, once the loaded files are committed. A
+  // transaction staged the images with the other files.
+  if (!transaction)
+  {
+    for (size_t index = 0; index < files.size(); ++index)
+    {
+      if (!diff && handler.Formats().ByPath(files[index].c_str()).Mapped())
+      {
+        changed.push_back(index);
+      }
+    }
+  }
+  for (size_t index : changed)
+  {
+    if (!handler.UpdateFile(files[index].c_str(), files[index].c_str(), major, minor, build, revision))
+    {
+      Failed(index, handler.Error());
+    }
+  }
+
+  saved.clear();
+  paths = nullptr;
+  if (transaction && !committed)
+  {
+    error = outputFiles.Error();
+    logger.Log(logInfo, L"Transaction rolled back, no file changed.");
+    return false;
+  }
+  logger.Log(logInfo, L"%u files updated, %u failed.", unsigned(files.size()) - failed, failed);
+  return 0 == failed;
+}
+
+// ---------------------------------------------------------------------------
+// Read stage: take the next path, load the file into a pooled buffer
+// ---------------------------------------------------------------------------
+void RCPipeline::ReadWorker()
+{
+  RCFileHandler handler{ilogger};
+  handler.Verbosity(logger.Verbosity());
+  handler.Pool(pool);
+
+  Counters counters{};
+  for (size_t index = nextPath++; index < paths->size(); index = nextPath++)
+  {
+    // Images are patched where they are mapped, after the commit; they take
+    // no pooled buffer. A transaction loads them like the other files.
+    const RCFormat& format = handler.Formats().ByPath((*paths)[index].c_str());
+    if (format.Mapped() && !transaction)
+    {
+      if (diff)
+      {
+        logger.Log(logNormal, L"Binary file [%s] left out of the diff.", (*paths)[index].c_str());
+      }
+      continue;
+    }
+
+    Item item{};
+    item.index = index;
+    if (!handler.LoadFile((*paths)[index].c_str(), 1024, item.buffer))
+    {
+      Failed(index, handler.Error());
+      continue;
+    }
+    item.size = handler.LoadedSize();
+    item.lastWrite = handler.LoadedWriteTime();
+
+    ++counters.items;
+    Push(parseQueue, item, counters);
+  }
+
+  Collect(Read, counters);
+  --readers;
+}
+
+// ---------------------------------------------------------------------------
+// Parse stage: update the versions in memory, pass on the changed files
+// ---------------------------------------------------------------------------
+void RCPipeline::ParseWorker()
+{
+  RCFileHandler handler{ilogger};
+  handler.Verbosity(logger.Verbosity());
+  handler.Cache(cache);
+  handler.ValueNames(valueNames);
+  handler.SkipUnchanged(skipUnchanged);
+  handler.Diff(diff);
+  handler.OutputCache(outputCache);
+  handler.ContentGroups(contents);
+
+  Counters counters{};
+  Item item{};
+  while (Pop(parseQueue, readers, item, counters))
+  {
+    ++counters.items;
+    bool modified{};
+    const wchar_t* path = (*paths)[item.index].c_str();
+    if (!handler.UpdateLoaded(path, path, item.buffer, item.size, item.lastWrite, version[0], version[1], version[2], version[3], modified, item.isUnicode, item.bytes, item.offsets))
+    {
+      Failed(item.index, handler.Error());
+      item.buffer.release();
+      continue;
+    }
+
+    if (!modified)
+    {
+      item.buffer.release();
+      continue;
+    }
+
+    Push(writeQueue, item, counters);
+  }
+
+  Collect(Parse, counters);
+  --parsers;
+}
+
+// ---------------------------------------------------------------------------
+// Write stage: save the file, return its buffer, keep its offsets for the
+// commit
+// ---------------------------------------------------------------------------
+void RCPipeline::WriteWorker()
+{
+  RCFileHandler handler{ilogger};
+  handler.Verbosity(logger.Verbosity());
+  handler.Cache(cache);
+  handler.ValueNames(valueNames);
+
+  Counters counters{};
+  Item item{};
+  while (Pop(writeQueue, parsers, item, counters))
+  {
+    ++counters.items;
+    const wchar_t* path = (*paths)[item.index].c_str();
+    RCOutputFiles::FileState loaded{item.size, item.lastWrite};
+    bool written = handler.SaveFile(path, item.buffer.data(), item.bytes, output, item.index, &loaded);
+    item.buffer.release();
+    if (!written)
+    {
+      Failed(item.index, handler.Error());
+      if (cache)
+      {
+        cache->Remove(path);
+      }
+      continue;
+    }
+    saved[item.index] = Saved{item.isUnicode, std::move(item.offsets)};
+  }
+
+  Collect(Write, counters);
+}
+
+// ---------------------------------------------------------------------------
+// Spin briefly, then give up the time slice, then sleep
+// ---------------------------------------------------------------------------
+static void Backoff(unsigned attempt)
+{
+  if (attempt < 16)
+  {
+    std::this_thread::yield();
+  }
+  else
+  {
+    Sleep(attempt < 64 ? 0 : 1);
+  }
+}
+
+static unsigned long long Microseconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Waits while the next stage is behind, the time counts as output stall
+void RCPipeline::Push(RCQueue<Item>& queue, Item& item, Counters& counters)
+{
+  if (queue.TryPush(item))
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned attempt = 0; !queue.TryPush(item); ++attempt)
+  {
+    Backoff(attempt);
+  }
+  counters.outputStall += Microseconds(start);
+}
+
+// Waits for work while the previous stage runs, false once it has finished
+// and the queue is empty. The wait counts as input stall.
+bool RCPipeline::Pop(RCQueue<Item>& queue, const std::atomic<unsigned>& producers, Item& item, Counters& counters)
+{
+  size_t depth = queue.Depth();
+  if (!queue.TryPop(item))
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned attempt = 0; ; ++attempt)
+    {
+      // Producers push before they stop, so one more try sees their last item
+      bool finished = (0 == producers);
+      if (queue.TryPop(item))
+      {
+        break;
+      }
+      if (finished)
+      {
+        counters.inputStall += Microseconds(start);
+        return false;
+      }
+      Backoff(attempt);
+    }
+    counters.inputStall += Microseconds(start);
+    depth = 0;
+  }
+
+  counters.maxDepth = max(counters.maxDepth, depth);
+  counters.depthSum += depth;
+  return true;
+}
+
+// Keep the error of the first failed file in path order, as UpdateFiles does
+void RCPipeline::Failed(size_t index, unsigned code)
+{
+  std::lock_guard<std::mutex> guard(failLock);
+  ++failed;
+  if (index < firstFailed)
+  {
+    firstFailed = index;
+    error = code;
+  }
+}
+
+void RCPipeline::Collect(Stage stage, const Counters& counters)
+{
+  std::lock_guard<std::mutex> guard(failLock);
+  StageStatistics& total = stats[stage];
+  unsigned long long items = total.items + counters.items;
+  total.averageDepth = (0 == items) ? 0.0 : (total.averageDepth * total.items + counters.depthSum) / items;
+  total.items = items;
+  total.maxDepth = max(total.maxDepth, counters.maxDepth);
+  total.inputStall += counters.inputStall;
+  total.outputStall += counters.outputStall;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include "Logger.h"
+#include "RCOffsetCache.h"
+#include "RCBufferPool.h"
+#include "RCOutputFiles.h"
+#include "RCQueue.h"
+#include "RCValueNames.h"
+#include "RCDiffWriter.h"
+#include "RCOutputCache.h"
+#include "RCContentGroups.h"
+#include <windows.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Updates many files in three stages running at the same time: readers load
+// files into pooled buffers, parsers update the versions in memory, writers
+// save the changed files. Bounded queues connect the stages, so a slow stage
+// holds back the ones before it instead of piling up buffers, and the buffer
+// pool limit still caps the memory of all files in flight. The written files
+// are committed together when all stages are done.
+class RCPipeline
+{
+public:
+  enum Stage {Read, Parse, Write, StageCount};
+
+  struct StageStatistics
+  {
+    unsigned workers;
+    unsigned long long items;
+    size_t maxDepth;
+    double averageDepth;
+    unsigned long long inputStall;
+    unsigned long long outputStall;
+  };
+
+  static const size_t QueueDepth = 64;
+
+  RCPipeline(ILogger &rlogger);
+  virtual ~RCPipeline();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+  void Cache(RCOffsetCache* value) { cache = value; }
+  void Pool(RCBufferPool* value) { pool = value; }
+  void SkipUnchanged(bool value) { skipUnchanged = value; }
+  // A run changes all files or none
+  void Transaction(bool value) { transaction = value; }
+  void ValueNames(const RCValueNames* value) { valueNames = value; }
+  // Changes go to 'diff', nothing is written
+  void Diff(RCDiffWriter* value) { diff = value; }
+  void OutputCache(RCOutputCache* value) { outputCache = value; }
+  void ContentGroups(RCContentGroups* value) { contents = value; }
+
+  // Worker threads of each stage, 0 for the default
+  void Workers(unsigned read, unsigned parse, unsigned write);
+
+  // Update files in place, keep going after a failure, report the first error
+  bool Run(const std::vector<std::wstring>& paths, int major, int minor, int build, int revision);
+
+  // Depths are those of the queue the stage takes its work from, none for
+  // the read stage. Stall times in microseconds, summed over the workers.
+  StageStatistics Stats(Stage stage) const { return stats[stage]; }
+  static const wchar_t* StageName(Stage stage);
+
+protected:
+  // Workers log from their own threads
+  class SerialLogger : public ILogger
+  {
+  public:
+    SerialLogger(ILogger& rlogger) : target(rlogger) {}
+    void Log(const wchar_t* message) override
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      target.Log(message);
+    }
+  protected:
+    ILogger& target;
+    std::mutex lock;
+  };
+
+  struct Item
+  {
+    size_t index;
+    RCBuffer buffer;
+    unsigned long long size;
+    FILETIME lastWrite;
+    size_t bytes;
+    bool isUnicode;
+    std::vector<size_t> offsets;
+  };
+
+  // A written file waiting for the commit at the end of the run
+  struct Saved
+  {
+    bool isUnicode;
+    std::vector<size_t> offsets;
+  };
+
+  struct Counters
+  {
+    unsigned long long items;
+    size_t maxDepth;
+    unsigned long long depthSum;
+    unsigned long long inputStall;
+    unsigned long long outputStall;
+  };
+
+  void ReadWorker();
+  void ParseWorker();
+  void WriteWorker();
+
+  void Push(RCQueue<Item>& queue, Item& item, Counters& counters);
+  bool Pop(RCQueue<Item>& queue, const std::atomic<unsigned>& producers, Item& item, Counters& counters);
+  void Failed(size_t index, unsigned code);
+  void Collect(Stage stage, const Counters& counters);
+
+  SerialLogger ilogger;
+  Logger logger;
+  unsigned error;
+  RCOffsetCache* cache;
+  RCBufferPool* pool;
+  bool skipUnchanged;
+  bool transaction;
+  const RCValueNames* valueNames;
+  RCDiffWriter* diff;
+  RCOutputCache* outputCache;
+  RCContentGroups* contents;
+  unsigned workers[StageCount];
+  StageStatistics stats[StageCount];
+
+  // State of one run
+  const std::vector<std::wstring>* paths;
+  int version[4];
+  std::atomic<size_t> nextPath;
+  std::atomic<unsigned> readers;
+  std::atomic<unsigned> parsers;
+  RCQueue<Item> parseQueue;
+  RCQueue<Item> writeQueue;
+  RCOutputFiles* output;
+  std::vector<Saved> saved;
+  std::mutex failLock;
+  unsigned failed;
+  size_t firstFailed;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <memory>
+
+// Bounded multi-producer, multi-consumer queue without locks. Every cell
+// carries a sequence number telling whether it is free for the producer of
+// a position or holds the item for its consumer, so producers and consumers
+// only contend on their own position counter. The capacity is rounded up
+// to a power of two.
+template <class T>
+class RCQueue
+{
+public:
+  explicit RCQueue(size_t capacity)
+    : mask(RoundUp(capacity) - 1)
+    , cells(new Cell[mask + 1])
+    , pushPosition(0)
+    , popPosition(0)
+  {
+    for (size_t n = 0; n <= mask; ++n)
+    {
+      cells[n].sequence.store(n, std::memory_order_relaxed);
+    }
+  }
+
+  RCQueue(const RCQueue&) = delete;
+  RCQueue& operator=(const RCQueue&) = delete;
+
+  size_t Capacity() const { return mask + 1; }
+
+  // Items in the queue, exact only while no other thread uses it
+  size_t Depth() const
+  {
+    size_t pushed = pushPosition.load(std::memory_order_relaxed);
+    size_t popped = popPosition.load(std::memory_order_relaxed);
+    return (pushed < popped) ? 0 : pushed - popped;
+  }
+
+  // False when the queue is full, the item is left unchanged
+  bool TryPush(T& item)
+  {
+    size_t position = pushPosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      Cell& cell = cells[position & mask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      if (sequence == position)
+      {
+        if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          cell.item = std::move(item);
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (sequence < position)
+      {
+        return false;
+      }
+      else
+      {
+        position = pushPosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // False when the queue is empty
+  bool TryPop(T& item)
+  {
+    size_t position = popPosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      Cell& cell = cells[position & mask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      if (sequence == position + 1)
+      {
+        if (popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          item = std::move(cell.item);
+          cell.item = T();
+          cell.sequence.store(position + mask + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (sequence < position + 1)
+      {
+        return false;
+      }
+      else
+      {
+        position = popPosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+protected:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  static size_t RoundUp(size_t capacity)
+  {
+    size_t size = 2;
+    while (size < capacity)
+    {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  const size_t mask;
+  std::unique_ptr<Cell[]> cells;
+
+  // Separate cache lines, producers and consumers do not share one
+  alignas(64) std::atomic<size_t> pushPosition;
+  alignas(64) std::atomic<size_t> popPosition;
+};
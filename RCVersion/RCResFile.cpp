@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "RCResFile.h"
+#include <string.h>
+
+RCResFile::RCResFile(std::vector<uint8_t>& data)
+  : data(data)
+{
+}
+
+// ---------------------------------------------------------------------------
+// The file is copied resource by resource into a new buffer, which replaces
+// the old content only when every version resource could be updated.
+// ---------------------------------------------------------------------------
+RCResFile::Result RCResFile::UpdateVersion(int major, int minor, int build, int revision, const std::vector<std::u16string>& names, unsigned& changes)
+{
+  changes = 0;
+  std::vector<Resource> resources;
+  if (!ReadResources(resources))
+  {
+    return NotResources;
+  }
+
+  std::vector<uint8_t> patched;
+  patched.reserve(data.size() + 256);
+  bool found{};
+  for (const Resource& resource : resources)
+  {
+    const uint8_t* header = data.data() + resource.header;
+    std::vector<uint8_t> bytes(header + resource.headerSize, header + resource.headerSize + resource.dataSize);
+    if (resource.version)
+    {
+      found = true;
+      RCVersionInfo info;
+      if (!info.Parse(bytes.data(), bytes.size()))
+      {
+        return Corrupt;
+      }
+      unsigned blockChanges{};
+      switch (info.Update(major, minor, build, revision, names, blockChanges))
+      {
+      case RCVersionInfo::Corrupt: return Corrupt;
+      case RCVersionInfo::Overflow: return Overflow;
+      default: break;
+      }
+      changes += blockChanges;
+      bytes = info.Serialize();
+    }
+
+    size_t start = patched.size();
+    patched.insert(patched.end(), header, header + resource.headerSize);
+    RCVersionInfo::Write32(&patched[start], uint32_t(bytes.size()));
+    patched.insert(patched.end(), bytes.begin(), bytes.end());
+    patched.resize(RCVersionInfo::Align4(patched.size()));
+  }
+  if (!found)
+  {
+    return NoVersion;
+  }
+
+  data.swap(patched);
+  return Patched;
+}
+
+std::vector<uint8_t> RCResFile::Empty()
+{
+  std::vector<uint8_t> res;
+  Append(res, 0, std::u16string(), 0, 0, 0, std::vector<uint8_t>());
+  return res;
+}
+
+void RCResFile::Append(std::vector<uint8_t>& res, uint16_t type, const std::u16string& name, uint16_t id, uint16_t flags, uint16_t language,
+  const std::vector<uint8_t>& data)
+{
+  size_t start = res.size();
+  res.resize(start + 12);
+  RCVersionInfo::Write16(&res[start + 8], 0xFFFF);
+  RCVersionInfo::Write16(&res[start + 10], type);
+  if (name.empty())
+  {
+    res.push_back(0xFF);
+    res.push_back(0xFF);
+    res.push_back(uint8_t(id));
+    res.push_back(uint8_t(id >> 8));
+  }
+  for (char16_t c : name)
+  {
+    res.push_back(uint8_t(c));
+    res.push_back(uint8_t(c >> 8));
+  }
+  if (!name.empty())
+  {
+    res.resize(res.size() + 2);
+  }
+
+  // DataVersion, MemoryFlags, LanguageId, Version and Characteristics
+  res.resize(RCVersionInfo::Align4(res.size()) + 16);
+  RCVersionInfo::Write32(&res[start], uint32_t(data.size()));
+  RCVersionInfo::Write32(&res[start + 4], uint32_t(res.size() - start));
+  RCVersionInfo::Write16(&res[res.size() - 12], flags);
+  RCVersionInfo::Write16(&res[res.size() - 10], language);
+
+  res.insert(res.end(), data.begin(), data.end());
+  res.resize(RCVersionInfo::Align4(res.size()));
+}
+
+// ---------------------------------------------------------------------------
+// Type and name are either 0xFFFF and a WORD id or a zero terminated UTF-16
+// string. The first resource is the empty one rc.exe writes to mark a 32 bit
+// .res file, which a 16 bit .res or any other file does not start with.
+// ---------------------------------------------------------------------------
+bool RCResFile::IsResources(const uint8_t* data, size_t size)
+{
+  static const uint8_t marker[] = {0, 0, 0, 0, 32, 0, 0, 0, 0xFF, 0xFF, 0, 0, 0xFF, 0xFF, 0, 0};
+  return 32 <= size && 0 == memcmp(data, marker, sizeof(marker));
+}
+
+bool RCResFile::ReadResources(std::vector<Resource>& resources) const
+{
+  using RCV = RCVersionInfo;
+  if (!IsResources(data.data(), data.size()))
+  {
+    return false;
+  }
+
+  size_t pos{};
+  while (pos < data.size())
+  {
+    if (data.size() - pos < 8)
+    {
+      return false;
+    }
+    Resource resource{pos, RCV::Read32(&data[pos + 4]), RCV::Read32(&data[pos]), false};
+    if (resource.headerSize < 24 || data.size() - pos < resource.headerSize || data.size() - pos - resource.headerSize < resource.dataSize)
+    {
+      return false;
+    }
+
+    const uint8_t* type = &data[pos + 8];
+    resource.version = 0xFFFF == RCV::Read16(type) && ResourceVersion == RCV::Read16(type + 2);
+    resources.push_back(resource);
+    pos = RCV::Align4(pos + resource.headerSize + resource.dataSize);
+  }
+  return true;
+}
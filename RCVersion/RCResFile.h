@@ -0,0 +1,41 @@
+#pragma once
+#include "RCVersionInfo.h"
+
+// A .res file as rc.exe writes it: an empty resource marking the format, then
+// one resource after the other, each a header with the sizes, the type, the
+// name and the language, and the data, both padded to a DWORD. The RT_VERSION
+// resources are rebuilt with their new size, so unlike a linked image a
+// version may grow freely.
+//
+// Plain C++ without Windows headers, see RCVersionInfo.
+class RCResFile
+{
+public:
+  enum Result {Patched, NotResources, NoVersion, Corrupt, Overflow};
+
+  RCResFile(std::vector<uint8_t>& data);
+
+  Result UpdateVersion(int major, int minor, int build, int revision, const std::vector<std::u16string>& names, unsigned& changes);
+
+  // The empty resource every 32 bit .res file starts with
+  static std::vector<uint8_t> Empty();
+  static bool IsResources(const uint8_t* data, size_t size);
+  // One resource with an id type, named 'name' or, when it is empty, 'id'
+  static void Append(std::vector<uint8_t>& res, uint16_t type, const std::u16string& name, uint16_t id, uint16_t flags, uint16_t language,
+    const std::vector<uint8_t>& data);
+
+  static const uint16_t ResourceVersion = 16;
+
+protected:
+  struct Resource
+  {
+    size_t header;
+    size_t headerSize;
+    size_t dataSize;
+    bool version;
+  };
+
+  bool ReadResources(std::vector<Resource>& resources) const;
+
+  std::vector<uint8_t>& data;
+};
@@ -0,0 +1,647 @@
+#include "stdafx.h"
+#include "RCResWriter.h"
+#include "RCFileHandler.h"
+#include "RCResFile.h"
+
+// Memory flags rc.exe writes for RT_VERSION, MOVEABLE | PURE
+static const uint16_t VersionFlags = 0x0030;
+// Without a LANGUAGE statement rc.exe uses US English
+static const uint16_t DefaultLanguage = 0x0409;
+
+static const struct { const wchar_t* name; uint32_t value; } Constants[] = {
+  {L"VS_VERSION_INFO", 1},
+  {L"VS_FFI_FILEFLAGSMASK", 0x3F},
+  {L"VS_FF_DEBUG", 0x01},
+  {L"VS_FF_PRERELEASE", 0x02},
+  {L"VS_FF_PATCHED", 0x04},
+  {L"VS_FF_PRIVATEBUILD", 0x08},
+  {L"VS_FF_INFOINFERRED", 0x10},
+  {L"VS_FF_SPECIALBUILD", 0x20},
+  {L"VOS_UNKNOWN", 0},
+  {L"VOS_DOS", 0x10000},
+  {L"VOS_NT", 0x40000},
+  {L"VOS__WINDOWS32", 0x4},
+  {L"VOS_DOS_WINDOWS32", 0x10004},
+  {L"VOS_NT_WINDOWS32", 0x40004},
+  {L"VFT_UNKNOWN", 0},
+  {L"VFT_APP", 1},
+  {L"VFT_DLL", 2},
+  {L"VFT_DRV", 3},
+  {L"VFT_FONT", 4},
+  {L"VFT_VXD", 5},
+  {L"VFT_STATIC_LIB", 7},
+  {L"VFT2_UNKNOWN", 0},
+  {L"LANG_NEUTRAL", 0x00},
+  {L"LANG_CHINESE", 0x04},
+  {L"LANG_GERMAN", 0x07},
+  {L"LANG_ENGLISH", 0x09},
+  {L"LANG_SPANISH", 0x0A},
+  {L"LANG_FRENCH", 0x0C},
+  {L"LANG_ITALIAN", 0x10},
+  {L"LANG_JAPANESE", 0x11},
+  {L"LANG_KOREAN", 0x12},
+  {L"LANG_POLISH", 0x15},
+  {L"LANG_RUSSIAN", 0x19},
+  {L"SUBLANG_NEUTRAL", 0x00},
+  {L"SUBLANG_DEFAULT", 0x01},
+  {L"SUBLANG_SYS_DEFAULT", 0x02},
+  {L"SUBLANG_ENGLISH_US", 0x01},
+  {L"SUBLANG_ENGLISH_UK", 0x02},
+  {L"SUBLANG_GERMAN", 0x01},
+  {L"SUBLANG_FRENCH", 0x01},
+  {L"SUBLANG_SPANISH_MODERN", 0x03},
+  {L"SUBLANG_CHINESE_SIMPLIFIED", 0x02},
+};
+
+static const wchar_t* const Defined[] = {L"RC_INVOKED", L"_WIN32"};
+
+RCResWriter::RCResWriter(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , pos(nullptr)
+  , lineStart(true)
+  , current{Token::End}
+  , path(L"")
+{
+}
+
+RCResWriter::~RCResWriter()
+{
+}
+
+bool RCResWriter::Write(const wchar_t* rcPath, const wchar_t* resPath)
+{
+  logger.Log(logDetail, L"RCResWriter::Write(%s,%s)", rcPath, resPath);
+
+  RCFileHandler files{ilogger};
+  files.Verbosity(logger.Verbosity());
+  std::vector<unsigned char> buffer;
+  if (!files.LoadFile(rcPath, 2, buffer))
+  {
+    error = files.Error();
+    return false;
+  }
+
+  std::wstring text;
+  int flags = IS_TEXT_UNICODE_UNICODE_MASK;
+  if (IsTextUnicode(buffer.data(), int(min(buffer.size(), size_t{256})), &flags))
+  {
+    text = reinterpret_cast<const wchar_t*>(buffer.data());
+  }
+  else
+  {
+    int codePage = CodePage(buffer);
+    const char* ansi = reinterpret_cast<const char*>(buffer.data());
+    int chars = MultiByteToWideChar(UINT(codePage), 0, ansi, -1, nullptr, 0);
+    if (0 < chars)
+    {
+      text.resize(size_t(chars));
+      MultiByteToWideChar(UINT(codePage), 0, ansi, -1, &text[0], chars);
+      text.resize(wcslen(text.c_str()));
+    }
+  }
+  if (!text.empty() && 0xFEFF == text[0])
+  {
+    text.erase(0, 1);
+  }
+
+  std::vector<uint8_t> res;
+  if (!Compile(text, rcPath, res))
+  {
+    return false;
+  }
+
+  logger.Log(logNormal, L"Version resource of [%s] written to [%s].", rcPath, resPath);
+  if (!files.SaveFile(resPath, res.data(), res.size()))
+  {
+    error = files.Error();
+    return false;
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// The whole file is scanned, so the conditions around the resource and the
+// LANGUAGE statements before it are followed as rc.exe follows them
+// ---------------------------------------------------------------------------
+bool RCResWriter::Compile(const std::wstring& text, const wchar_t* name, std::vector<uint8_t>& res)
+{
+  path = name ? name : L"";
+  pos = text.c_str();
+  lineStart = true;
+  conditions.clear();
+  error = 0;
+
+  // Statements are not parsed, a word followed by VERSIONINFO names the resource
+  uint16_t language{DefaultLanguage};
+  std::wstring resourceName;
+  bool scanned = Advance();
+  while (scanned && Token::End != current.kind && resourceName.empty())
+  {
+    if (Is(L"LANGUAGE"))
+    {
+      uint32_t primary{}, secondary{};
+      if (!Advance() || !Expression(primary) || Token::Comma != current.kind || !Advance() || !Expression(secondary))
+      {
+        return 0 != error ? false : Fail(L"LANGUAGE");
+      }
+      language = uint16_t(secondary << 10 | primary);
+      continue;
+    }
+
+    std::wstring word = Token::Word == current.kind ? current.text : std::wstring();
+    scanned = Advance();
+    if (!word.empty() && Is(L"VERSIONINFO"))
+    {
+      resourceName = word;
+    }
+  }
+  if (!scanned)
+  {
+    return false;
+  }
+  if (resourceName.empty())
+  {
+    return logger.Error(error = ERROR_RESOURCE_TYPE_NOT_FOUND, L"*** RCResWriter::Compile: No VERSIONINFO in [%s]", path);
+  }
+
+  RCVersionInfo info;
+  info.root.key = u"VS_VERSION_INFO";
+  info.root.type = 0;
+  if (!Advance() || !Fixed(info.root.value) || !Block(info.root))
+  {
+    return 0 != error ? false : Fail(L"VERSIONINFO");
+  }
+
+  // A number or VS_VERSION_INFO names the resource by id, any other name is upper case
+  std::u16string stringName;
+  uint32_t id{};
+  const wchar_t* digits = resourceName.c_str();
+  wchar_t* tail{};
+  bool isNumber = iswdigit(digits[0]) && (id = wcstoul(digits, &tail, 0), 0 == *tail);
+  if (!isNumber && 0 != wcscmp(resourceName.c_str(), L"VS_VERSION_INFO"))
+  {
+    for (wchar_t c : resourceName)
+    {
+      stringName += char16_t(towupper(c));
+    }
+  }
+  id = isNumber ? id : 1;
+
+  res = RCResFile::Empty();
+  RCResFile::Append(res, RCResFile::ResourceVersion, stringName, uint16_t(id), VersionFlags, language, info.Serialize());
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// The next token of an active line into 'current'; comments and the lines of
+// inactive #if branches are skipped, directives are followed
+// ---------------------------------------------------------------------------
+bool RCResWriter::Advance()
+{
+  for (;;)
+  {
+    while (L' ' == *pos || L'\t' == *pos || L'\r' == *pos || L'\n' == *pos || L'\f' == *pos)
+    {
+      lineStart = lineStart || L'\n' == *pos;
+      ++pos;
+    }
+
+    if (L'/' == pos[0] && L'/' == pos[1])
+    {
+      pos += wcscspn(pos, L"\n");
+      continue;
+    }
+    if (L'/' == pos[0] && L'*' == pos[1])
+    {
+      const wchar_t* end = wcsstr(pos + 2, L"*/");
+      pos = end ? end + 2 : pos + wcslen(pos);
+      continue;
+    }
+    if (lineStart && L'#' == *pos)
+    {
+      size_t length = wcscspn(pos, L"\n");
+      std::wstring line(pos + 1, length - 1);
+      pos += length;
+      if (!Directive(line))
+      {
+        return false;
+      }
+      continue;
+    }
+    lineStart = false;
+    if (!*pos)
+    {
+      current = Token{Token::End};
+      return true;
+    }
+    if (!Active())
+    {
+      pos += wcscspn(pos, L"\n");
+      continue;
+    }
+    break;
+  }
+
+  current = Token{Token::Word};
+  switch (*pos)
+  {
+  case L',':
+    current.kind = Token::Comma;
+    ++pos;
+    return true;
+  case L'|':
+    current.kind = Token::Or;
+    ++pos;
+    return true;
+  case L'{':
+    current.text = L"BEGIN";
+    ++pos;
+    return true;
+  case L'}':
+    current.text = L"END";
+    ++pos;
+    return true;
+  case L'"':
+    break;
+  default:
+    {
+      size_t length = wcscspn(pos, L" \t\r\n\f,|{}\"");
+      current.text.assign(pos, max(length, size_t{1}));
+      pos += current.text.length();
+      return true;
+    }
+  }
+
+  // A quote in a string is doubled, or escaped with a backslash like \n and \t
+  current.kind = Token::String;
+  for (++pos; *pos; ++pos)
+  {
+    if (L'"' == *pos && L'"' == pos[1])
+    {
+      current.text += *++pos;
+      continue;
+    }
+    if (L'"' == *pos)
+    {
+      ++pos;
+      return true;
+    }
+    if (L'\\' == *pos && pos[1])
+    {
+      ++pos;
+      switch (*pos)
+      {
+      case L'n': current.text += L'\n'; break;
+      case L'r': current.text += L'\r'; break;
+      case L't': current.text += L'\t'; break;
+      case L'a': current.text += L'\a'; break;
+      case L'0': current.text += L'\0'; break;
+      default: current.text += *pos; break;
+      }
+      continue;
+    }
+    if (L'\n' == *pos)
+    {
+      break;
+    }
+    current.text += *pos;
+  }
+  return Fail(L"string");
+}
+
+bool RCResWriter::Directive(const std::wstring& line)
+{
+  size_t start = line.find_first_not_of(L" \t");
+  size_t end = line.find_first_of(L" \t\r(", start);
+  std::wstring keyword = std::wstring::npos == start ? std::wstring() : line.substr(start, end - start);
+  std::wstring rest = std::wstring::npos == end ? std::wstring() : line.substr(end);
+  rest = rest.substr(0, min(rest.find(L"//"), rest.find(L"/*")));
+  size_t first = rest.find_first_not_of(L" \t");
+  size_t last = rest.find_last_not_of(L" \t\r");
+  rest = std::wstring::npos == first ? std::wstring() : rest.substr(first, last + 1 - first);
+
+  bool result{};
+  if (L"ifdef" == keyword || L"ifndef" == keyword || L"if" == keyword)
+  {
+    bool isIf = L"if" == keyword;
+    if (Active() && (isIf ? !Evaluate(rest, result) : !Evaluate(L"defined(" + rest + L")", result)))
+    {
+      return Fail(line.c_str());
+    }
+    result = L"ifndef" == keyword ? !result : result;
+    conditions.push_back(Condition{Active(), Active() && result, Active() && result});
+  }
+  else if (L"elif" == keyword || L"else" == keyword)
+  {
+    if (conditions.empty())
+    {
+      return Fail(line.c_str());
+    }
+    Condition& condition = conditions.back();
+    if (condition.outer && !condition.taken && L"elif" == keyword && !Evaluate(rest, result))
+    {
+      return Fail(line.c_str());
+    }
+    result = L"else" == keyword ? true : result;
+    condition.active = condition.outer && !condition.taken && result;
+    condition.taken = condition.taken || condition.active;
+  }
+  else if (L"endif" == keyword)
+  {
+    if (conditions.empty())
+    {
+      return Fail(line.c_str());
+    }
+    conditions.pop_back();
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Numbers and [!]defined(NAME) joined by || and &&, from left to right
+// ---------------------------------------------------------------------------
+bool RCResWriter::Evaluate(const std::wstring& expression, bool& result) const
+{
+  bool first{true};
+  bool isAnd{};
+  for (size_t at = 0; at < expression.length();)
+  {
+    at = expression.find_first_not_of(L" \t", at);
+    if (std::wstring::npos == at)
+    {
+      break;
+    }
+    if (!first)
+    {
+      if (0 == expression.compare(at, 2, L"||") || 0 == expression.compare(at, 2, L"&&"))
+      {
+        isAnd = L'&' == expression[at];
+        at = expression.find_first_not_of(L" \t", at + 2);
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    bool negate{};
+    for (; at < expression.length() && L'!' == expression[at]; ++at)
+    {
+      negate = !negate;
+    }
+
+    bool value{};
+    if (0 == expression.compare(at, 7, L"defined"))
+    {
+      at = expression.find_first_not_of(L" \t(", at + 7);
+      size_t end = expression.find_first_of(L" \t)|&", at);
+      std::wstring name = expression.substr(at, end - at);
+      for (const wchar_t* defined : Defined)
+      {
+        value = value || name == defined;
+      }
+      at = std::wstring::npos == end ? end : expression.find_first_not_of(L" \t)", end);
+    }
+    else if (at < expression.length() && iswdigit(expression[at]))
+    {
+      wchar_t* tail{};
+      value = 0 != wcstoul(expression.c_str() + at, &tail, 0);
+      at = tail - expression.c_str();
+    }
+    else
+    {
+      return false;
+    }
+
+    value = negate ? !value : value;
+    result = first ? value : (isAnd ? result && value : result || value);
+    first = false;
+  }
+  return !first;
+}
+
+bool RCResWriter::Is(const wchar_t* word) const
+{
+  return Token::Word == current.kind && 0 == _wcsicmp(current.text.c_str(), word);
+}
+
+// ---------------------------------------------------------------------------
+// Numbers and constants joined by '|', 'isLong' tells a number with an L
+// suffix, which a VALUE writes as a DWORD
+// ---------------------------------------------------------------------------
+bool RCResWriter::Expression(uint32_t& value, bool* isLong)
+{
+  value = 0;
+  for (;;)
+  {
+    if (Token::Word != current.kind)
+    {
+      return false;
+    }
+
+    const std::wstring& word = current.text;
+    uint32_t part{};
+    bool found{};
+    if (iswdigit(word[0]))
+    {
+      wchar_t* tail{};
+      part = uint32_t(wcstoul(word.c_str(), &tail, 0));
+      bool suffixL = L'L' == towupper(*tail);
+      if (isLong)
+      {
+        *isLong = *isLong || suffixL;
+      }
+      while (L'L' == towupper(*tail) || L'U' == towupper(*tail))
+      {
+        ++tail;
+      }
+      found = 0 == *tail;
+    }
+    for (const auto& constant : Constants)
+    {
+      if (!found && word == constant.name)
+      {
+        part = constant.value;
+        found = true;
+      }
+    }
+    if (!found)
+    {
+      return logger.Error(error = ERROR_INVALID_DATA, L"*** RCResWriter::Compile: Unknown value [%s] in [%s]", word.c_str(), path);
+    }
+
+    value |= part;
+    if (!Advance() || Token::Or != current.kind)
+    {
+      return 0 == error;
+    }
+    if (!Advance())
+    {
+      return false;
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// VS_FIXEDFILEINFO from the statements between VERSIONINFO and BEGIN
+// ---------------------------------------------------------------------------
+bool RCResWriter::Fixed(std::vector<uint8_t>& value)
+{
+  static const wchar_t* const statements[] = {
+    L"FILEVERSION", L"PRODUCTVERSION", L"FILEFLAGSMASK", L"FILEFLAGS", L"FILEOS", L"FILETYPE", L"FILESUBTYPE",
+  };
+
+  value.assign(RCVersionInfo::FixedSize, 0);
+  RCVersionInfo::Write32(&value[0], RCVersionInfo::FixedSignature);
+  RCVersionInfo::Write32(&value[4], 0x00010000);
+  while (Token::Word == current.kind && !Is(L"BEGIN"))
+  {
+    size_t statement = _countof(statements);
+    for (size_t n = 0; n < _countof(statements); ++n)
+    {
+      statement = Is(statements[n]) ? n : statement;
+    }
+    if (_countof(statements) == statement || !Advance())
+    {
+      return false;
+    }
+
+    // The two versions take two DWORDs each, the other statements one
+    if (statement < 2)
+    {
+      uint32_t parts[4]{};
+      for (int part = 0; part < 4; ++part)
+      {
+        if (!Expression(parts[part]) || 0xFFFF < parts[part])
+        {
+          return false;
+        }
+        if (part < 3 && (Token::Comma != current.kind || !Advance()))
+        {
+          break;
+        }
+      }
+      RCVersionInfo::Write32(&value[8 + 8 * statement], parts[0] << 16 | parts[1]);
+      RCVersionInfo::Write32(&value[12 + 8 * statement], parts[2] << 16 | parts[3]);
+    }
+    else
+    {
+      uint32_t number{};
+      if (!Expression(number))
+      {
+        return false;
+      }
+      RCVersionInfo::Write32(&value[24 + 4 * (statement - 2)], number);
+    }
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// BEGIN, the BLOCK and VALUE statements, END. A VALUE is one string, written
+// with its terminating zero, or a list of numbers, written as WORDs or DWORDs.
+// ---------------------------------------------------------------------------
+bool RCResWriter::Block(RCVersionInfo::Block& block)
+{
+  if (!Is(L"BEGIN") || !Advance())
+  {
+    return false;
+  }
+
+  while (Token::Word == current.kind && !Is(L"END"))
+  {
+    bool isBlock = Is(L"BLOCK");
+    if ((!isBlock && !Is(L"VALUE")) || !Advance() || Token::String != current.kind)
+    {
+      return false;
+    }
+
+    RCVersionInfo::Block child;
+    child.key.assign(current.text.begin(), current.text.end());
+    if (!Advance())
+    {
+      return false;
+    }
+    if (isBlock)
+    {
+      if (!Block(child))
+      {
+        return false;
+      }
+      block.children.push_back(child);
+      continue;
+    }
+
+    if (Token::Comma == current.kind && !Advance())
+    {
+      return false;
+    }
+    if (Token::String == current.kind)
+    {
+      for (wchar_t c : current.text)
+      {
+        child.value.push_back(uint8_t(c));
+        child.value.push_back(uint8_t(c >> 8));
+      }
+      child.value.resize(child.value.size() + 2);
+      if (!Advance())
+      {
+        return false;
+      }
+    }
+    else
+    {
+      child.type = 0;
+      while (Token::Word == current.kind && !Is(L"END") && !Is(L"BLOCK") && !Is(L"VALUE"))
+      {
+        uint32_t number{};
+        bool isLong{};
+        if (!Expression(number, &isLong))
+        {
+          return false;
+        }
+        for (size_t n = 0; n < (isLong ? 4u : 2u); ++n)
+        {
+          child.value.push_back(uint8_t(number >> (8 * n)));
+        }
+        if (Token::Comma == current.kind && !Advance())
+        {
+          return false;
+        }
+      }
+    }
+    block.children.push_back(child);
+  }
+
+  return Is(L"END") && Advance();
+}
+
+bool RCResWriter::Fail(const wchar_t* what)
+{
+  if (0 == error)
+  {
+    logger.Error(error = ERROR_INVALID_DATA, L"*** RCResWriter::Compile: Cannot compile [%s] in [%s]", what, path);
+  }
+  return false;
+}
+
+// The code page of an ANSI RC file, from a #pragma code_page before any text
+int RCResWriter::CodePage(const std::vector<unsigned char>& buffer)
+{
+  static const char pragma[] = "#pragma code_page(";
+  if (3 <= buffer.size() && 0xEF == buffer[0] && 0xBB == buffer[1] && 0xBF == buffer[2])
+  {
+    return CP_UTF8;
+  }
+
+  const char* text = reinterpret_cast<const char*>(buffer.data());
+  const char* found = strstr(text, pragma);
+  if (found)
+  {
+    int codePage = atoi(found + sizeof(pragma) - 1);
+    return 0 < codePage ? codePage : CP_ACP;
+  }
+  return CP_ACP;
+}
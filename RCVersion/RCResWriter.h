@@ -0,0 +1,72 @@
+#pragma once
+#include "Logger.h"
+#include "RCVersionInfo.h"
+#include <string>
+#include <vector>
+
+// The VERSIONINFO statement of an RC file compiled into a .res file of its
+// own, /res:<file>, so a build can link a small version resource instead of
+// compiling the whole RC file again. For the layout Visual Studio writes the
+// result is byte for byte what rc.exe makes of it: the resource keeps the
+// name, the language of the last LANGUAGE statement before it and the
+// memory flags rc.exe gives RT_VERSION.
+//
+// There is no real preprocessor: #ifdef, #ifndef, #if, #elif, #else and
+// #endif are followed as rc.exe would for a release build, only RC_INVOKED
+// and _WIN32 are defined and #define or #include are not looked at. Numbers
+// may be combined with '|' and the VS_FF_, VOS_, VFT_, LANG_ and SUBLANG_
+// constants of winver.h and winnt.h that VERSIONINFO blocks use.
+class RCResWriter
+{
+public:
+  RCResWriter(ILogger &rlogger);
+  virtual ~RCResWriter();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+
+  bool Write(const wchar_t* rcPath, const wchar_t* resPath);
+  // The .res file for the first VERSIONINFO of 'text', 'path' names it in messages
+  bool Compile(const std::wstring& text, const wchar_t* path, std::vector<uint8_t>& res);
+
+protected:
+  struct Token
+  {
+    enum Kind {End, Word, String, Comma, Or};
+    Kind kind;
+    std::wstring text;
+  };
+
+  // One #if and its #elif and #else branches
+  struct Condition
+  {
+    bool outer;
+    bool taken;
+    bool active;
+  };
+
+  bool Advance();
+  bool Directive(const std::wstring& line);
+  bool Evaluate(const std::wstring& expression, bool& result) const;
+  bool Active() const { return conditions.empty() || conditions.back().active; }
+  bool Is(const wchar_t* word) const;
+  bool Expression(uint32_t& value, bool* isLong = nullptr);
+  bool Fixed(std::vector<uint8_t>& value);
+  bool Block(RCVersionInfo::Block& block);
+  bool Fail(const wchar_t* what);
+
+  static int CodePage(const std::vector<unsigned char>& buffer);
+
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+
+  const wchar_t* pos;
+  bool lineStart;
+  Token current;
+  std::vector<Condition> conditions;
+  const wchar_t* path;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
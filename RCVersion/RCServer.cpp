@@ -0,0 +1,311 @@
+#include "stdafx.h"
+#include "RCServer.h"
+#include "RCCommand.h"
+#include "RCVersionOptions.h"
+#include <thread>
+
+// Every build has its own pipe and names itself in the handshake, a client
+// never hands its command line to a server built from other sources
+const wchar_t RCServer::DefaultPipeName[] = L"\\\\.\\pipe\\RCVersion " __DATE__ " " __TIME__;
+const wchar_t RCServer::Protocol[] = L"RCVersion/1 " __DATE__ " " __TIME__;
+
+// Collects log output of one request for the client
+class RequestLogger : public ILogger
+{
+public:
+  std::wstring text;
+  void Log(const wchar_t* message) override
+  {
+    text.append(message);
+    text.append(L"\n");
+  }
+};
+
+RCServer::RCServer(ILogger &rlogger, const wchar_t* name)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , pipeName(name)
+  , stopping(false)
+  , live(0)
+{
+}
+
+RCServer::~RCServer()
+{
+}
+
+HANDLE RCServer::CreatePipe(bool first)
+{
+  DWORD openMode = PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+  DWORD pipeMode = PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS;
+  return CreateNamedPipe(pipeName.c_str(), openMode, pipeMode, PIPE_UNLIMITED_INSTANCES, 65536, 65536, 0, nullptr);
+}
+
+// ---------------------------------------------------------------------------
+// Serve requests until a client sends /server:stop
+// ---------------------------------------------------------------------------
+bool RCServer::Run(unsigned threads)
+{
+  if (0 == threads)
+  {
+    threads = 1;
+  }
+
+  // The first instance fails when another server already owns the name
+  wil::unique_hfile first(CreatePipe(true));
+  if (!first)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCServer::Run: Cannot create pipe [%s], is another server running?", pipeName.c_str());
+  }
+
+  logger.Log(logNormal, L"RCVersion server listening on [%s] with %u worker threads.", pipeName.c_str(), threads);
+
+  // A worker counts as live from its start until it leaves Serve
+  std::vector<std::thread> pool;
+  ++live;
+  pool.emplace_back(&RCServer::Serve, this, first.release());
+  for (unsigned n = 1; n < threads; ++n)
+  {
+    HANDLE pipe = CreatePipe(false);
+    if (INVALID_HANDLE_VALUE == pipe)
+    {
+      logger.Error(GetLastError(), L"*** RCServer::Run: Cannot create pipe instance %u", n);
+      break;
+    }
+    ++live;
+    pool.emplace_back(&RCServer::Serve, this, pipe);
+  }
+
+  for (auto& worker : pool)
+  {
+    worker.join();
+  }
+
+  logger.Log(logNormal, L"RCVersion server stopped, %llu offset cache hits, %llu misses.", cache.Hits(), cache.Misses());
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Worker thread, owns one pipe instance and serves one client at a time
+// ---------------------------------------------------------------------------
+void RCServer::Serve(HANDLE handle)
+{
+  wil::unique_hfile pipe(handle);
+  while (!stopping)
+  {
+    if (!ConnectNamedPipe(pipe.get(), nullptr) && ERROR_PIPE_CONNECTED != GetLastError())
+    {
+      logger.Error(GetLastError(), L"*** RCServer::Serve: Cannot connect pipe");
+      break;
+    }
+
+    if (!stopping)
+    {
+      Handle(pipe.get());
+    }
+
+    FlushFileBuffers(pipe.get());
+    DisconnectNamedPipe(pipe.get());
+  }
+  --live;
+}
+
+bool RCServer::Handle(HANDLE pipe)
+{
+  std::vector<unsigned char> message;
+  if (!ReadMessage(pipe, message))
+  {
+    logger.Log(logDetail, L"RCServer: client disconnected, error %u", GetLastError());
+    return false;
+  }
+
+  // Request: protocol name and arguments, each terminated with a zero character
+  std::vector<std::wstring> args;
+  const wchar_t* text = reinterpret_cast<const wchar_t*>(message.data());
+  const wchar_t* end = text + message.size() / sizeof(wchar_t);
+  for (const wchar_t* arg = text; arg < end;)
+  {
+    const wchar_t* zero = std::find(arg, end, L'\0');
+    args.emplace_back(arg, zero);
+    arg = zero + 1;
+  }
+
+  RequestLogger output;
+  DWORD result{};
+  if (args.empty() || args[0] != Protocol)
+  {
+    output.Log(L"*** RCVersion server: unsupported request");
+    result = ERROR_REVISION_MISMATCH;
+  }
+  else
+  {
+    args.erase(args.begin());
+    result = Execute(args, output);
+  }
+
+  std::vector<unsigned char> response(sizeof(DWORD) + output.text.size() * sizeof(wchar_t));
+  memcpy(response.data(), &result, sizeof(DWORD));
+  memcpy(response.data() + sizeof(DWORD), output.text.data(), output.text.size() * sizeof(wchar_t));
+
+  DWORD written{};
+  if (!WriteFile(pipe, response.data(), DWORD(response.size()), &written, nullptr) || response.size() != written)
+  {
+    logger.Log(logDetail, L"RCServer: cannot send response, error %u", GetLastError());
+    return false;
+  }
+
+  if (stopping)
+  {
+    WakeWorkers();
+  }
+  return true;
+}
+
+unsigned RCServer::Execute(const std::vector<std::wstring>& args, ILogger& output)
+{
+  std::vector<const wchar_t*> argv;
+  argv.push_back(L"RCVersion");
+  for (const auto& arg : args)
+  {
+    argv.push_back(arg.c_str());
+  }
+
+  RCVersionOptions options{output};
+  options.CheckVerbosity(int(argv.size()), argv.data());
+  options.Parse(int(argv.size()), argv.data());
+  if (!options.Validate())
+  {
+    return ERROR_INVALID_PARAMETER;
+  }
+
+  if (options.server)
+  {
+    if (!options.serverStop)
+    {
+      output.Log(L"*** RCVersion server is already running.");
+      return ERROR_ALREADY_EXISTS;
+    }
+    logger.Log(logNormal, L"RCVersion server stop requested.");
+    stopping = true;
+    return NO_ERROR;
+  }
+
+  logger.Log(logDetail, L"RCServer: request with %u arguments", unsigned(args.size()));
+  RCCommand command{output, &cache, &pool, &includes};
+  return command.Execute(options);
+}
+
+// ---------------------------------------------------------------------------
+// Workers block in ConnectNamedPipe, a short connection lets them see the
+// stop. A connection may reach a worker that is busy or just leaving, so
+// they are woken until only the calling one is left.
+// ---------------------------------------------------------------------------
+void RCServer::WakeWorkers()
+{
+  while (1 < live)
+  {
+    wil::unique_hfile client(CreateFile(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr));
+    if (!client && (ERROR_PIPE_BUSY != GetLastError() || !WaitNamedPipe(pipeName.c_str(), 100)))
+    {
+      Sleep(10);
+    }
+  }
+}
+
+bool RCServer::ReadMessage(HANDLE pipe, std::vector<unsigned char>& message)
+{
+  const size_t chunk = 65536;
+  const size_t limit = 64 * 1024 * 1024;
+
+  message.clear();
+  while (message.size() < limit)
+  {
+    size_t used = message.size();
+    message.resize(used + chunk);
+    DWORD readBytes{};
+    BOOL ok = ReadFile(pipe, message.data() + used, DWORD(chunk), &readBytes, nullptr);
+    message.resize(used + readBytes);
+    if (ok)
+    {
+      return true;
+    }
+    if (ERROR_MORE_DATA != GetLastError())
+    {
+      return false;
+    }
+  }
+
+  SetLastError(ERROR_INSUFFICIENT_BUFFER);
+  return false;
+}
+
+// ---------------------------------------------------------------------------
+// Client side of the protocol
+// ---------------------------------------------------------------------------
+bool RCServer::Forward(const wchar_t* name, const std::vector<std::wstring>& args, ILogger& output, unsigned& result)
+{
+  wil::unique_hfile pipe;
+  for (int attempt = 0; attempt < 2 && !pipe; ++attempt)
+  {
+    pipe.reset(CreateFile(name, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr));
+    if (!pipe && (ERROR_PIPE_BUSY != GetLastError() || !WaitNamedPipe(name, 2000)))
+    {
+      return false;
+    }
+  }
+
+  DWORD mode = PIPE_READMODE_MESSAGE;
+  if (!pipe || !SetNamedPipeHandleState(pipe.get(), &mode, nullptr, nullptr))
+  {
+    return false;
+  }
+
+  std::wstring request(Protocol);
+  request.push_back(L'\0');
+  for (const auto& arg : args)
+  {
+    request.append(arg);
+    request.push_back(L'\0');
+  }
+
+  // A request that was not sent can still run in process, once it is sent the
+  // server may have changed files and the caller must not fall back
+  DWORD written{};
+  if (!WriteFile(pipe.get(), request.data(), DWORD(request.size() * sizeof(wchar_t)), &written, nullptr))
+  {
+    return false;
+  }
+
+  std::vector<unsigned char> response;
+  if (!ReadMessage(pipe.get(), response) || response.size() < sizeof(DWORD))
+  {
+    result = ERROR_BROKEN_PIPE;
+    output.Log(L"*** RCVersion server did not respond.");
+    return true;
+  }
+
+  DWORD code{};
+  memcpy(&code, response.data(), sizeof(DWORD));
+  // A server of another build did not run the request, it runs in process
+  if (ERROR_REVISION_MISMATCH == code)
+  {
+    return false;
+  }
+  result = code;
+
+  std::wstring text(reinterpret_cast<const wchar_t*>(response.data() + sizeof(DWORD)), (response.size() - sizeof(DWORD)) / sizeof(wchar_t));
+  size_t start{};
+  while (start < text.size())
+  {
+    size_t end = text.find(L'\n', start);
+    if (std::wstring::npos == end)
+    {
+      end = text.size();
+    }
+    output.Log(text.substr(start, end - start).c_str());
+    start = end + 1;
+  }
+
+  return true;
+}
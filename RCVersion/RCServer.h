@@ -0,0 +1,53 @@
+#pragma once
+#include "Logger.h"
+#include "RCOffsetCache.h"
+#include "RCBufferPool.h"
+#include "RCIncludeCache.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Long running server on a local named pipe. Requests are command lines with
+// absolute paths, responses are the error code and the log text. Worker
+// threads, the offset cache and the include cache stay warm between requests.
+class RCServer
+{
+protected:
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+  std::wstring pipeName;
+  RCOffsetCache cache;
+  RCBufferPool pool;
+  RCIncludeCache includes;
+  std::atomic<bool> stopping;
+  std::atomic<unsigned> live;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+
+public:
+  static const wchar_t DefaultPipeName[];
+  static const wchar_t Protocol[];
+
+  RCServer(ILogger &rlogger, const wchar_t* name = DefaultPipeName);
+  virtual ~RCServer();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+  void MemoryLimit(size_t bytes) { pool.Limit(bytes); }
+
+  bool Run(unsigned threads);
+
+  // Client side: false when no server is running and the caller should run in process
+  static bool Forward(const wchar_t* name, const std::vector<std::wstring>& args, ILogger& output, unsigned& result);
+
+protected:
+  HANDLE CreatePipe(bool first);
+  void Serve(HANDLE pipe);
+  bool Handle(HANDLE pipe);
+  unsigned Execute(const std::vector<std::wstring>& args, ILogger& output);
+  void WakeWorkers();
+
+  static bool ReadMessage(HANDLE pipe, std::vector<unsigned char>& message);
+};
@@ -3,6 +3,7 @@
 #include <vector>
 #include "MessageBuffer.h"
 #include "ILogger.h"
+#include "RCNameTrie.h"
 
 template <class CharT>
 const CharT** GetKeywordTable() { return nullptr; }
@@ -23,8 +24,6 @@ inline const wchar_t** GetKeywordTable<wchar_t>()
       L" BLOCK",
       L" END",
       L"+VALUE",
-      L"\"FileVersion\"",
-      L"\"ProductVersion\"",
       nullptr
    };
    return keywords;
@@ -46,11 +45,37 @@ inline const char** GetKeywordTable<char>()
       " BLOCK",
       " END",
       "+VALUE",
+      nullptr
+   };
+   return keywords;
+}
+
+// StringFileInfo values updated unless other names are configured
+template <class CharT>
+const CharT** GetValueNameTable() { return nullptr; }
+
+template <>
+inline const wchar_t** GetValueNameTable<wchar_t>()
+{
+   const static wchar_t *names[] =
+   {
+      L"\"FileVersion\"",
+      L"\"ProductVersion\"",
+      nullptr
+   };
+   return names;
+}
+
+template <>
+inline const char** GetValueNameTable<char>()
+{
+   const static char *names[] =
+   {
       "\"FileVersion\"",
       "\"ProductVersion\"",
       nullptr
    };
-   return keywords;
+   return names;
 }
 
 template<class CharT, class TraitsT = std::char_traits<CharT>>
@@ -61,12 +86,18 @@ public:
    int  verbosity;
    bool debug;
    unsigned error;
+   // Quoted StringFileInfo names to update, nullptr for GetValueNameTable
+   const RCNameTrie<CharT> *valueNames;
+   // Versions are written as 1.2.3.4 instead of 1, 2, 3, 4
+   bool dotted;
 
    RCUpdater(ILogger &rlogger)
       : logger(rlogger)
       , verbosity(1)
       , debug(false)
       , error(0)
+      , valueNames(nullptr)
+      , dotted(false)
    {
    }
 
@@ -174,14 +205,15 @@ public:
       return true;
    }
 
-   static bool format(char*buffer, size_t chars, int major, int minor, int build, int revision)
+   // C# and manifests only accept versions separated by periods
+   static bool format(char*buffer, size_t chars, int major, int minor, int build, int revision, bool dotted = false)
    {
-      return 0 < _snprintf_s(buffer, chars, _TRUNCATE, "%d, %d, %d, %d", major, minor, build, revision);
+      return 0 < _snprintf_s(buffer, chars, _TRUNCATE, dotted ? "%d.%d.%d.%d" : "%d, %d, %d, %d", major, minor, build, revision);
    }
 
-   static bool format(wchar_t*buffer, size_t chars, int major, int minor, int build, int revision)
+   static bool format(wchar_t*buffer, size_t chars, int major, int minor, int build, int revision, bool dotted = false)
    {
-      return 0 < _snwprintf_s(buffer, chars, _TRUNCATE, L"%d, %d, %d, %d", major, minor, build, revision);
+      return 0 < _snwprintf_s(buffer, chars, _TRUNCATE, dotted ? L"%d.%d.%d.%d" : L"%d, %d, %d, %d", major, minor, build, revision);
    }
 
    static bool parse(CharT*xbuffer, CharT**tail, int &major, int &minor, int &build, int &revision)
@@ -250,11 +282,16 @@ public:
       return 0;
    }
 
-   void FindVersionStrings(CharT *buffer, size_t start, std::vector<size_t> &offsets)
+   // Offsets of the version strings of one block, returns the offset of the
+   // first line that does not belong to the block
+   size_t FindVersionStrings(CharT *buffer, size_t start, std::vector<size_t> &offsets)
    {
       static const CharT space[] = { ' ', '\t', 0 };
       static const CharT chaff[] = { ',',  ' ', '\t', 0 };
       static const CharT **keywords = GetKeywordTable<CharT>();
+      static const RCNameTrie<CharT> keywordTrie{keywords, 1};
+      static const RCNameTrie<CharT> defaultNames{GetValueNameTable<CharT>()};
+      const RCNameTrie<CharT> &names = valueNames ? *valueNames : defaultNames;
 
       CharT *line = buffer + start;
       while (*line)
@@ -267,59 +304,43 @@ public:
             continue;
          }
 
-         bool found{false};
+         size_t length{};
+         unsigned ndx = keywordTrie.Match(line, length);
+         if (RCNameTrie<CharT>::NotFound == ndx)
+            break;
+         if (' ' < line[length] && '/' != line[length])
+            break;
 
-         for (unsigned ndx = 0; 0 != keywords[ndx]; ++ndx)
+         const CharT* keyword = keywords[ndx];
+         const CharT code = *keyword++;
+         if (7 <= verbosity || '-'==code && 6 <= verbosity)
          {
-            const CharT* keyword = keywords[ndx];
-            const CharT code = *keyword++;
-            size_t length = TraitsT::length(keyword);
-
-            // This is a STRINGFILEINFO name, not a keyword
-            if ('\"' == code)
-               continue;
-
-            if (0 != TraitsT::compare(keyword, line, length))
-               continue;
-            if (' ' < line[length] && '/' != line[length])
-               continue;
-
-            found = true;
-            if (7 <= verbosity || '-'==code && 6 <= verbosity)
-            {
-               wchar_t msg[1024]{};
-               _snwprintf_s(msg, _TRUNCATE, L"FOUND: [%c]:%s offset=%u", wchar_t(code), MessageBuffer(keyword).message(), unsigned(line - buffer));
-               logger.Log(msg);
-            }
+            wchar_t msg[1024]{};
+            _snwprintf_s(msg, _TRUNCATE, L"FOUND: [%c]:%s offset=%u", wchar_t(code), MessageBuffer(keyword).message(), unsigned(line - buffer));
+            logger.Log(msg);
+         }
 
-            // FIXEDFILEINFO keyword, version follows after space
-            if ('-' == code)
-            {
-               line = SkipComment(line + length);
-               size_t offset = line - buffer;
-               offsets.push_back(offset);
-               break;
-            }
+         // FIXEDFILEINFO keyword, version follows after space
+         if ('-' == code)
+         {
+            line = SkipComment(line + length);
+            size_t offset = line - buffer;
+            offsets.push_back(offset);
+         }
 
-            // STRINGFILEINFO keyword, version may follow after string name
-            if ('+' == code)
+         // STRINGFILEINFO keyword, version may follow after one of the names
+         if ('+' == code)
+         {
+            line = SkipComment(line + length);
+            const CharT* name = line;
+            size_t chars{};
+            if (RCNameTrie<CharT>::NotFound != names.Match(name, chars))
             {
-               line = SkipComment(line + length);
-
-               for (unsigned vx = 0; 0 != keywords[vx]; ++vx)
+               line = SkipComment(line + chars);
+               line = LTrim(line, chaff);
+               line = SkipComment(line);
+               if (CharT(' ') < *line)
                {
-                  const CharT* name = keywords[vx];
-                  const CharT type = *name;
-                  size_t chars = TraitsT::length(name);
-                  if ('\"' != type)
-                     continue;
-                  if (0 != TraitsT::compare(name, line, chars))
-                     continue;
-                  line = SkipComment(line + chars);
-                  line = LTrim(line, chaff);
-                  line = SkipComment(line);
-                  if (*line <= CharT(' '))
-                     continue;
                   if (CharT('\"') == *line)
                      ++line;
 
@@ -327,45 +348,85 @@ public:
                   if (6 <= verbosity)
                   {
                      wchar_t msg[1024]{};
-                     _snwprintf_s(msg, _TRUNCATE, L"FOUND NAME: [%s] offset=%u", MessageBuffer(name).message(), unsigned(line - buffer));
+                     _snwprintf_s(msg, _TRUNCATE, L"FOUND NAME: [%s] offset=%u", MessageBuffer(std::basic_string<CharT>(name, chars).c_str()).message(), unsigned(line - buffer));
                      logger.Log(msg);
                   }
                   size_t offset = line - buffer;
                   offsets.push_back(offset);
-                  break;
                }
-               break;
             }
+         }
 
-            // Expected but not used keyword
-            if (' ' == code)
-            {
-               break;
-            }
+         line = NextLine(line);
+      }
 
-            // When we get here, we have a bad keyword table
-            found = false;
-         }
+      return line - buffer;
+   }
 
-         if (!found)
+
+   // Offsets of all version strings of all VERSIONINFO blocks, false if there
+   // are none. The text is scanned once: the search for the next block starts
+   // where the previous one ended. Other text formats find their versions in
+   // RCFormat::Find.
+   bool FindVersion(CharT *buffer, std::vector<size_t> &offsets)
+   {
+      size_t next = 0;
+      size_t blocks = 0;
+      for (;;)
+      {
+         size_t start = FindStartOfVersion(buffer + next);
+         if (0 == start)
             break;
 
-         line = NextLine(line);
+         next = FindVersionStrings(buffer, next + start, offsets);
+         ++blocks;
       }
+
+      if (2 <= blocks && 6 <= verbosity)
+      {
+         wchar_t msg[1024]{};
+         _snwprintf_s(msg, _TRUNCATE, L"FOUND: %u VERSIONINFO blocks", unsigned(blocks));
+         logger.Log(msg);
+      }
+
+      error = ERROR_FILE_CORRUPT;
+      if (0 == offsets.size())
+         return false;
+
+      error = NO_ERROR;
+      return true;
    }
 
+   // Offsets from an earlier scan are usable only if each one still holds a version
+   static bool ValidOffsets(CharT *buffer, size_t chars, const std::vector<size_t> &offsets)
+   {
+      size_t next{};
+      for (size_t offset : offsets)
+      {
+         if (offset < next || chars <= offset)
+            return false;
+         CharT *tail{nullptr};
+         int major{-1}, minor{-1}, build{-1}, revision{-1};
+         if (!parse(buffer + offset, &tail, major, minor, build, revision))
+            return false;
+         next = tail - buffer;
+      }
+      return 0 != offsets.size();
+   }
 
    unsigned UpdateVersion(CharT *buffer, size_t chars, int xmajor, int xminor, int xbuild, int xrevision)
    {
-      size_t start = FindStartOfVersion(buffer);
-      unsigned replacementsMade{};
-
-      error = ERROR_FILE_CORRUPT;
-      if (0 == start)
+      std::vector<size_t> offsets;
+      if (!FindVersion(buffer, offsets))
          return 0;
 
-      std::vector<size_t> offsets;
-      FindVersionStrings(buffer, start, offsets);
+      return UpdateVersion(buffer, chars, offsets, xmajor, xminor, xbuild, xrevision);
+   }
+
+   // Replace versions at known offsets, on return the offsets match the updated buffer
+   unsigned UpdateVersion(CharT *buffer, size_t chars, std::vector<size_t> &offsets, int xmajor, int xminor, int xbuild, int xrevision)
+   {
+      unsigned replacementsMade{};
 
       error = ERROR_FILE_CORRUPT;
       if (0 == offsets.size())
@@ -374,9 +435,9 @@ public:
       error = NO_ERROR;
       bool success{true};
 
-      for (auto iter = offsets.rbegin(); success && offsets.rend() != iter; ++iter)
+      for (size_t ndx = offsets.size(); success && 0 < ndx--;)
       {
-         size_t offset = *iter;
+         size_t offset = offsets[ndx];
          CharT *tail{nullptr};
          int major{-1}, minor{-1}, build{-1}, revision{-1};
          if (!parse(buffer + offset, &tail, major, minor, build, revision))
@@ -397,7 +458,7 @@ public:
 
          CharT newVersion[256]{};
 
-         if (!format(newVersion, _countof(newVersion), major, minor, build, revision))
+         if (!format(newVersion, _countof(newVersion), major, minor, build, revision, dotted))
          {
             wchar_t msg[1024]{};
             _snwprintf_s(msg, _TRUNCATE, L"Version formatting failed for [%d,%d,%d,%d]", major, minor, build, revision);
@@ -430,6 +491,14 @@ public:
             continue;
          }
 
+         // Versions after this one have moved
+         size_t oldChars = tail - (buffer + offset);
+         size_t newChars = TraitsT::length(newVersion);
+         for (size_t later = ndx + 1; later < offsets.size(); ++later)
+         {
+            offsets[later] = offsets[later] + newChars - oldChars;
+         }
+
          ++replacementsMade;
       }
 
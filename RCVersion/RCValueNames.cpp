@@ -0,0 +1,89 @@
+#include "stdafx.h"
+#include "RCValueNames.h"
+#include "RCFileHandler.h"
+#include "RCFileSet.h"
+#include "RCUpdater.h"
+
+RCValueNames::RCValueNames(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , key(0)
+  , narrow(GetValueNameTable<char>())
+  , wide(GetValueNameTable<wchar_t>())
+{
+  for (const wchar_t** name = GetValueNameTable<wchar_t>(); *name; ++name)
+  {
+    std::wstring quoted{*name};
+    names.push_back(quoted.substr(1, quoted.size() - 2));
+  }
+}
+
+RCValueNames::~RCValueNames()
+{
+}
+
+// ---------------------------------------------------------------------------
+// The narrow trie gets the name in the ANSI code page, the encoding of RC
+// files that are not UTF-16
+// ---------------------------------------------------------------------------
+bool RCValueNames::Add(const std::wstring& name)
+{
+  bool valid = !name.empty();
+  for (wchar_t c : name)
+  {
+    valid = valid && L'"' != c && L' ' <= c;
+  }
+  if (!valid)
+  {
+    return logger.Error(error = ERROR_INVALID_DATA, L"*** RCValueNames::Add: Invalid value name [%s]", name.c_str());
+  }
+
+  if (names.end() != std::find(names.begin(), names.end(), name))
+  {
+    return true;
+  }
+
+  std::wstring quoted = L"\"" + name + L"\"";
+  int bytes = WideCharToMultiByte(CP_ACP, 0, quoted.c_str(), int(quoted.size()), nullptr, 0, nullptr, nullptr);
+  std::string ansi(size_t(max(bytes, 0)), '\0');
+  if (0 < bytes)
+  {
+    WideCharToMultiByte(CP_ACP, 0, quoted.c_str(), int(quoted.size()), &ansi[0], bytes, nullptr, nullptr);
+  }
+
+  unsigned id = unsigned(names.size());
+  wide.Add(quoted, id);
+  narrow.Add(ansi, id);
+  names.push_back(name);
+  key ^= RCFileSet::KeyHash(name);
+
+  logger.Log(logDetail, L"Value name [%s] added.", name.c_str());
+  return true;
+}
+
+bool RCValueNames::AddFile(const wchar_t* path)
+{
+  logger.Log(logDetail, L"Reading value names [%s]...", RCFileHandler::NN(path));
+
+  RCFileHandler reader{ilogger};
+  reader.Verbosity(logger.Verbosity());
+  std::vector<unsigned char> buffer;
+  if (!reader.LoadFile(path, 2, buffer))
+  {
+    error = reader.Error();
+    return false;
+  }
+
+  bool success{true};
+  for (auto& line : RCFileSet::TextLines(buffer))
+  {
+    if (2 <= line.size() && L'"' == line.front() && L'"' == line.back())
+    {
+      line = line.substr(1, line.size() - 2);
+    }
+    success = Add(line) && success;
+  }
+
+  return success;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "Logger.h"
+#include "RCNameTrie.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// StringFileInfo values that hold a version, /value:<name> and
+// /value:@<file>. "FileVersion" and "ProductVersion" are always updated.
+// Each name is added in quotes to one trie per character type when it is
+// configured, so matching the name after VALUE is one pass over the text
+// however many names there are.
+class RCValueNames
+{
+public:
+  RCValueNames(ILogger &rlogger);
+  virtual ~RCValueNames();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+
+  bool Add(const std::wstring& name);
+  // One name per line, optionally in quotes
+  bool AddFile(const wchar_t* path);
+
+  const std::vector<std::wstring>& Names() const { return names; }
+  // Zero for the default names, the same for the same set of names in any order
+  uint64_t Key() const { return key; }
+  const RCNameTrie<char>& Narrow() const { return narrow; }
+  const RCNameTrie<wchar_t>& Wide() const { return wide; }
+
+protected:
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+  std::vector<std::wstring> names;
+  uint64_t key;
+  RCNameTrie<char> narrow;
+  RCNameTrie<wchar_t> wide;
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+};
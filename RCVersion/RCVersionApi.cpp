@@ -0,0 +1,256 @@
+#include "stdafx.h"
+#include "RCVersionApi.h"
+#include "RCFileHandler.h"
+#include <new>
+#include <thread>
+
+// Forwards the messages to the callback of the embedding program
+class RCCallbackLogger : public ILogger
+{
+public:
+  RCCallbackLogger(RCVersionLogCallback logCallback, void* logUser)
+    : callback(logCallback)
+    , user(logUser)
+  {
+  }
+
+  void Log(const wchar_t* message) override
+  {
+    if (callback)
+    {
+      callback(user, message);
+    }
+  }
+
+protected:
+  RCVersionLogCallback callback;
+  void* user;
+};
+
+struct RCVersionContext
+{
+  RCVersionContext(int logVerbosity, RCVersionLogCallback log, void* user)
+    : logger(log, user)
+    , verbosity(logVerbosity)
+    , names(logger)
+  {
+    names.Verbosity(logVerbosity);
+  }
+
+  RCCallbackLogger logger;
+  int verbosity;
+  RCOffsetCache cache;
+  RCBufferPool pool;
+  RCValueNames names;
+};
+
+// ---------------------------------------------------------------------------
+// Calls without a context get a silent handler that keeps nothing. Exceptions
+// must not cross the C interface, they become error codes.
+// ---------------------------------------------------------------------------
+template <class Function>
+static unsigned Guarded(RCVersionContext* context, Function function)
+{
+  try
+  {
+    if (context)
+    {
+      RCFileHandler handler{context->logger};
+      handler.Verbosity(context->verbosity);
+      handler.Cache(&context->cache);
+      handler.Pool(&context->pool);
+      handler.ValueNames(&context->names);
+      return function(handler, context->logger, context->pool);
+    }
+
+    RCCallbackLogger silent{nullptr, nullptr};
+    RCBufferPool pool;
+    RCFileHandler handler{silent};
+    handler.Verbosity(0);
+    handler.Pool(&pool);
+    return function(handler, silent, pool);
+  }
+  catch (const std::bad_alloc&)
+  {
+    return ERROR_NOT_ENOUGH_MEMORY;
+  }
+  catch (...)
+  {
+    return ERROR_INTERNAL_ERROR;
+  }
+}
+
+unsigned RCVERSION_CALL RCVersionApiVersion(void)
+{
+  return RCVERSION_API_VERSION;
+}
+
+RCVersionContext* RCVERSION_CALL RCVersionCreate(int verbosity, RCVersionLogCallback log, void* user)
+{
+  return new (std::nothrow) RCVersionContext(verbosity, log, user);
+}
+
+void RCVERSION_CALL RCVersionDestroy(RCVersionContext* context)
+{
+  delete context;
+}
+
+unsigned RCVERSION_CALL RCVersionAddValueName(RCVersionContext* context, const wchar_t* name)
+{
+  if (!context || !name)
+  {
+    return ERROR_INVALID_PARAMETER;
+  }
+
+  return Guarded(context, [=](RCFileHandler&, ILogger&, RCBufferPool&) -> unsigned {
+    return context->names.Add(name) ? NO_ERROR : context->names.Error();
+  });
+}
+
+unsigned RCVERSION_CALL RCVersionAddValueFile(RCVersionContext* context, const wchar_t* path)
+{
+  if (!context || !path)
+  {
+    return ERROR_INVALID_PARAMETER;
+  }
+
+  return Guarded(context, [=](RCFileHandler&, ILogger&, RCBufferPool&) -> unsigned {
+    return context->names.AddFile(path) ? NO_ERROR : context->names.Error();
+  });
+}
+
+unsigned RCVERSION_CALL RCVersionUpdateFile(RCVersionContext* context, const wchar_t* inpath, const wchar_t* outpath,
+  int major, int minor, int build, int revision)
+{
+  return Guarded(context, [=](RCFileHandler& handler, ILogger&, RCBufferPool&) -> unsigned {
+    if (!handler.UpdateFile(inpath, outpath ? outpath : inpath, major, minor, build, revision))
+    {
+      return handler.Error();
+    }
+    return NO_ERROR;
+  });
+}
+
+static unsigned UpdateFiles(RCVersionContext* context, const wchar_t* const* paths, size_t count, bool transaction,
+  int major, int minor, int build, int revision)
+{
+  if (!paths && 0 != count)
+  {
+    return ERROR_INVALID_PARAMETER;
+  }
+
+  return Guarded(context, [=](RCFileHandler& handler, ILogger& logger, RCBufferPool& pool) -> unsigned {
+    std::vector<std::wstring> files(paths, paths + count);
+    unsigned threads = max(2u, std::thread::hardware_concurrency());
+    std::unique_ptr<RCBatchIO> batchIO = RCBatchIO::Create(logger, pool, threads);
+    handler.BatchIO(batchIO.get());
+    handler.Transaction(transaction);
+
+    if (!handler.UpdateFiles(files, major, minor, build, revision))
+    {
+      return handler.Error();
+    }
+    return NO_ERROR;
+  });
+}
+
+unsigned RCVERSION_CALL RCVersionUpdateFiles(RCVersionContext* context, const wchar_t* const* paths, size_t count,
+  int major, int minor, int build, int revision)
+{
+  return UpdateFiles(context, paths, count, false, major, minor, build, revision);
+}
+
+unsigned RCVERSION_CALL RCVersionUpdateFilesTransacted(RCVersionContext* context, const wchar_t* const* paths, size_t count,
+  int major, int minor, int build, int revision)
+{
+  return UpdateFiles(context, paths, count, true, major, minor, build, revision);
+}
+
+// ---------------------------------------------------------------------------
+// The text is updated in a copy with room to grow like a loaded file, the
+// caller's buffer is only written when the result fits
+// ---------------------------------------------------------------------------
+unsigned RCVERSION_CALL RCVersionUpdateBuffer(RCVersionContext* context, void* buffer, size_t bytes, size_t capacity, size_t* outBytes,
+  int major, int minor, int build, int revision)
+{
+  if (!buffer || !outBytes)
+  {
+    return ERROR_INVALID_PARAMETER;
+  }
+
+  return Guarded(context, [=](RCFileHandler& handler, ILogger& ilogger, RCBufferPool&) -> unsigned {
+    std::vector<unsigned char> text(bytes + 1024 + sizeof(wchar_t), 0);
+    memcpy(text.data(), buffer, bytes);
+
+    int flags = IS_TEXT_UNICODE_UNICODE_MASK;
+    bool isUnicode = 0 != IsTextUnicode(text.data(), int(min(bytes, size_t{256})), &flags);
+
+    unsigned changes;
+    size_t newBytes;
+    if (isUnicode)
+    {
+      wchar_t* chars = reinterpret_cast<wchar_t*>(text.data());
+      changes = handler.UpdateBuffer(chars, text.size() / sizeof(wchar_t), major, minor, build, revision);
+      newBytes = wcslen(chars) * sizeof(wchar_t);
+    }
+    else
+    {
+      char* chars = reinterpret_cast<char*>(text.data());
+      changes = handler.UpdateBuffer(chars, text.size(), major, minor, build, revision);
+      newBytes = strlen(chars);
+    }
+
+    Logger logger{ilogger};
+    logger.Verbosity(handler.Verbosity());
+    if (0 == changes)
+    {
+      logger.Log(2, L"No changes made to the buffer.");
+      return ERROR_FILE_CORRUPT;
+    }
+
+    *outBytes = newBytes;
+    if (capacity < newBytes)
+    {
+      logger.Error(ERROR_INSUFFICIENT_BUFFER, L"*** RCVersionUpdateBuffer: %u bytes needed, the buffer has %u", unsigned(newBytes), unsigned(capacity));
+      return ERROR_INSUFFICIENT_BUFFER;
+    }
+
+    logger.Log(2, L"%u changes made to the buffer.", changes);
+    memcpy(buffer, text.data(), newBytes);
+    return NO_ERROR;
+  });
+}
+
+unsigned RCVERSION_CALL RCVersionReadFile(RCVersionContext* context, const wchar_t* path, int version[4])
+{
+  if (!version)
+  {
+    return ERROR_INVALID_PARAMETER;
+  }
+
+  return Guarded(context, [=](RCFileHandler& handler, ILogger&, RCBufferPool&) -> unsigned {
+    if (!handler.ReadVersion(path, version[0], version[1], version[2], version[3]))
+    {
+      return handler.Error();
+    }
+    return NO_ERROR;
+  });
+}
+
+unsigned RCVERSION_CALL RCVersionReadBuffer(RCVersionContext* context, const void* buffer, size_t bytes, int version[4])
+{
+  if (!buffer || !version)
+  {
+    return ERROR_INVALID_PARAMETER;
+  }
+
+  return Guarded(context, [=](RCFileHandler& handler, ILogger&, RCBufferPool&) -> unsigned {
+    std::vector<unsigned char> text(bytes + sizeof(wchar_t), 0);
+    memcpy(text.data(), buffer, bytes);
+    if (!handler.ParseVersion(L"buffer", text, version[0], version[1], version[2], version[3]))
+    {
+      return handler.Error();
+    }
+    return NO_ERROR;
+  });
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <stddef.h>
+#include <wchar.h>
+
+// ---------------------------------------------------------------------------
+// C interface of the RCVersion library, for build tools that stamp versions
+// in process: RCVersionLib.lib links statically, RCVersionDll.dll exports the
+// same functions for Python ctypes, C# P/Invoke and other languages.
+//
+// The functions return NO_ERROR (0) or a Windows error code. A version part
+// of -1 keeps the part found in the file, as on the command line. Functions
+// never throw; contexts may be used by several threads at once when the log
+// callback is thread safe.
+//
+// Functions are only ever added, existing signatures do not change.
+// RCVersionApiVersion tells which functions a loaded DLL provides.
+// ---------------------------------------------------------------------------
+#if defined(RCVERSION_EXPORTS)
+#define RCVERSION_API __declspec(dllexport)
+#else
+#define RCVERSION_API
+#endif
+#define RCVERSION_CALL __cdecl
+
+#define RCVERSION_API_VERSION 3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct RCVersionContext RCVersionContext;
+typedef void (RCVERSION_CALL *RCVersionLogCallback)(void* user, const wchar_t* message);
+
+RCVERSION_API unsigned RCVERSION_CALL RCVersionApiVersion(void);
+
+// Holds the version offsets of the files written and the file buffers for
+// the following calls. The callback receives the messages up to 'verbosity'
+// (0 errors only, 9 everything); it may be null. Null on out of memory.
+RCVERSION_API RCVersionContext* RCVERSION_CALL RCVersionCreate(int verbosity, RCVersionLogCallback log, void* user);
+RCVERSION_API void RCVERSION_CALL RCVersionDestroy(RCVersionContext* context);
+
+// Version 3: StringFileInfo values the calls with this context update besides
+// "FileVersion" and "ProductVersion", as /value:<name> and /value:@<file> on
+// the command line. Names are added before the context is shared by threads.
+RCVERSION_API unsigned RCVERSION_CALL RCVersionAddValueName(RCVersionContext* context, const wchar_t* name);
+RCVERSION_API unsigned RCVERSION_CALL RCVersionAddValueFile(RCVersionContext* context, const wchar_t* path);
+
+// Functions taking a context also accept null, then nothing is kept between
+// calls and nothing is logged
+RCVERSION_API unsigned RCVERSION_CALL RCVersionUpdateFile(RCVersionContext* context, const wchar_t* inpath, const wchar_t* outpath,
+  int major, int minor, int build, int revision);
+RCVERSION_API unsigned RCVERSION_CALL RCVersionUpdateFiles(RCVersionContext* context, const wchar_t* const* paths, size_t count,
+  int major, int minor, int build, int revision);
+
+// Version 2: all files or none, when one fails no file is changed
+RCVERSION_API unsigned RCVERSION_CALL RCVersionUpdateFilesTransacted(RCVersionContext* context, const wchar_t* const* paths, size_t count,
+  int major, int minor, int build, int revision);
+
+// Updates the RC text of 'bytes' bytes in place, ANSI, UTF-8 or UTF-16. The
+// new length is stored in 'outBytes'. When it exceeds 'capacity' the buffer
+// is left unchanged and ERROR_INSUFFICIENT_BUFFER returned.
+RCVERSION_API unsigned RCVERSION_CALL RCVersionUpdateBuffer(RCVersionContext* context, void* buffer, size_t bytes, size_t capacity, size_t* outBytes,
+  int major, int minor, int build, int revision);
+
+// The first version of the file or text, as /version: reads it
+RCVERSION_API unsigned RCVERSION_CALL RCVersionReadFile(RCVersionContext* context, const wchar_t* path, int version[4]);
+RCVERSION_API unsigned RCVERSION_CALL RCVersionReadBuffer(RCVersionContext* context, const void* buffer, size_t bytes, int version[4]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,242 @@
+#include "stdafx.h"
+#include "RCVersionInfo.h"
+
+static const char16_t StringFileInfoKey[] = u"StringFileInfo";
+
+bool RCVersionInfo::Parse(const uint8_t* data, size_t size)
+{
+  size_t length{};
+  root = Block{};
+  return ParseBlock(data, size, root, length) && FixedSize <= root.value.size() && FixedSignature == Read32(root.value.data());
+}
+
+std::vector<uint8_t> RCVersionInfo::Serialize() const
+{
+  std::vector<uint8_t> out;
+  SerializeBlock(root, out);
+  return out;
+}
+
+std::vector<std::u16string> RCVersionInfo::DefaultNames()
+{
+  return {u"FileVersion", u"ProductVersion"};
+}
+
+RCVersionInfo::Result RCVersionInfo::Update(int major, int minor, int build, int revision, const std::vector<std::u16string>& names, unsigned& changes)
+{
+  changes = 0;
+  Result result = UpdateFixed(root.value, major, minor, build, revision, changes);
+  for (Block& info : root.children)
+  {
+    if (Updated != result || StringFileInfoKey != info.key)
+    {
+      continue;
+    }
+    for (Block& table : info.children)
+    {
+      for (Block& value : table.children)
+      {
+        for (const std::u16string& name : names)
+        {
+          if (Updated == result && name == value.key)
+          {
+            result = UpdateText(value.value, major, minor, build, revision, changes);
+          }
+        }
+      }
+    }
+  }
+  return Updated == result && 0 == changes ? Unchanged : result;
+}
+
+// ---------------------------------------------------------------------------
+// 'length' is the wLength of the block; the caller skips the padding after it
+// ---------------------------------------------------------------------------
+bool RCVersionInfo::ParseBlock(const uint8_t* data, size_t size, Block& block, size_t& length)
+{
+  if (size < 6)
+  {
+    return false;
+  }
+  length = Read16(data);
+  size_t valueLength = Read16(data + 2);
+  block.type = Read16(data + 4);
+  if (length < 6 || size < length)
+  {
+    return false;
+  }
+
+  size_t pos = 6;
+  for (; pos + 2 <= length && 0 != Read16(data + pos); pos += 2)
+  {
+    block.key += char16_t(Read16(data + pos));
+  }
+  if (length < pos + 2)
+  {
+    return false;
+  }
+  pos = Align4(pos + 2);
+
+  size_t valueBytes = 1 == block.type ? 2 * valueLength : valueLength;
+  if (0 != valueBytes)
+  {
+    if (length < pos + valueBytes)
+    {
+      return false;
+    }
+    block.value.assign(data + pos, data + pos + valueBytes);
+    pos = Align4(pos + valueBytes);
+  }
+
+  while (pos < length)
+  {
+    size_t childLength{};
+    block.children.emplace_back();
+    if (!ParseBlock(data + pos, length - pos, block.children.back(), childLength))
+    {
+      return false;
+    }
+    pos = Align4(pos + childLength);
+  }
+  return true;
+}
+
+void RCVersionInfo::SerializeBlock(const Block& block, std::vector<uint8_t>& out)
+{
+  size_t start = out.size();
+  out.resize(start + 6);
+  for (char16_t c : block.key)
+  {
+    out.push_back(uint8_t(c));
+    out.push_back(uint8_t(c >> 8));
+  }
+  out.resize(Align4(out.size() + 2));
+
+  out.insert(out.end(), block.value.begin(), block.value.end());
+  for (const Block& child : block.children)
+  {
+    out.resize(Align4(out.size()));
+    SerializeBlock(child, out);
+  }
+
+  size_t valueLength = 1 == block.type ? block.value.size() / 2 : block.value.size();
+  Write16(&out[start], uint16_t(out.size() - start));
+  Write16(&out[start + 2], uint16_t(valueLength));
+  Write16(&out[start + 4], block.type);
+}
+
+// Every part of a compiled version is a WORD, a build past 65535 cannot be written
+bool RCVersionInfo::NextVersion(int major, int minor, int build, int revision, int (&version)[4])
+{
+  version[0] = major < 0 ? version[0] : major;
+  version[1] = minor < 0 ? version[1] : minor;
+  version[2] = build < 0 ? version[2] + 1 : build;
+  version[3] = revision < 0 ? version[3] : revision;
+  for (int part : version)
+  {
+    if (part < 0 || 0xFFFF < part)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+RCVersionInfo::Result RCVersionInfo::UpdateFixed(std::vector<uint8_t>& value, int major, int minor, int build, int revision, unsigned& changes)
+{
+  if (value.size() < FixedSize || FixedSignature != Read32(value.data()))
+  {
+    return Corrupt;
+  }
+
+  const size_t offsets[] = {FixedFileVersion, FixedProductVersion};
+  for (size_t offset : offsets)
+  {
+    uint8_t* ms = &value[offset];
+    uint8_t* ls = ms + 4;
+    int version[4] = {Read16(ms + 2), Read16(ms), Read16(ls + 2), Read16(ls)};
+    if (!NextVersion(major, minor, build, revision, version))
+    {
+      return Overflow;
+    }
+    uint32_t high = uint32_t(version[0]) << 16 | uint32_t(version[1]);
+    uint32_t low = uint32_t(version[2]) << 16 | uint32_t(version[3]);
+    if (high != Read32(ms) || low != Read32(ls))
+    {
+      Write32(ms, high);
+      Write32(ls, low);
+      ++changes;
+    }
+  }
+  return Updated;
+}
+
+RCVersionInfo::Result RCVersionInfo::UpdateText(std::vector<uint8_t>& value, int major, int minor, int build, int revision, unsigned& changes)
+{
+  std::u16string text;
+  for (size_t n = 0; n + 1 < value.size() && 0 != Read16(&value[n]); n += 2)
+  {
+    text += char16_t(Read16(&value[n]));
+  }
+
+  // Four numbers, any run of dots, commas and blanks between them; the runs
+  // are written back as they were
+  size_t pos = text.find_first_not_of(u" \t");
+  size_t start = pos;
+  int version[4]{};
+  std::u16string separators[4];
+  for (int part = 0; part < 4; ++part)
+  {
+    if (0 < part)
+    {
+      size_t next = text.find_first_not_of(u"., \t", pos);
+      if (std::u16string::npos == next || next == pos)
+      {
+        return Corrupt;
+      }
+      separators[part] = text.substr(pos, next - pos);
+      pos = next;
+    }
+    if (std::u16string::npos == pos || text[pos] < u'0' || u'9' < text[pos])
+    {
+      return Corrupt;
+    }
+    for (; pos < text.length() && u'0' <= text[pos] && text[pos] <= u'9' && version[part] <= 0xFFFF; ++pos)
+    {
+      version[part] = 10 * version[part] + (text[pos] - u'0');
+    }
+  }
+  if (!NextVersion(major, minor, build, revision, version))
+  {
+    return Overflow;
+  }
+
+  std::u16string formatted;
+  for (int part = 0; part < 4; ++part)
+  {
+    if (0 < part)
+    {
+      formatted += separators[part];
+    }
+    for (char c : std::to_string(version[part]))
+    {
+      formatted += char16_t(c);
+    }
+  }
+  if (0 == text.compare(start, pos - start, formatted))
+  {
+    return Updated;
+  }
+  text.replace(start, pos - start, formatted);
+
+  value.clear();
+  for (char16_t c : text)
+  {
+    value.push_back(uint8_t(c));
+    value.push_back(uint8_t(c >> 8));
+  }
+  value.push_back(0);
+  value.push_back(0);
+  ++changes;
+  return Updated;
+}
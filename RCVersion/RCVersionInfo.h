@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// VS_VERSIONINFO, the compiled form of a VERSIONINFO resource, as a tree of
+// blocks. Every block is a length, the length of its value, a type, a UTF-16
+// key, the value and the child blocks, each part starting on a DWORD
+// boundary. The length of a block ends with its last byte; the padding up to
+// the next block belongs to the parent, which is how rc.exe writes them.
+//
+// Plain C++ without Windows headers, so the binary patchers run on the
+// cross-build hosts as well.
+class RCVersionInfo
+{
+public:
+  struct Block
+  {
+    Block() : type(1) {}
+
+    std::u16string key;
+    // 1 for text, whose value length counts characters, 0 for binary data
+    uint16_t type;
+    std::vector<uint8_t> value;
+    std::vector<Block> children;
+  };
+
+  // VS_FIXEDFILEINFO, the value of the root block
+  static const uint32_t FixedSignature = 0xFEEF04BD;
+  static const size_t FixedSize = 52;
+  static const size_t FixedFileVersion = 8;
+  static const size_t FixedProductVersion = 16;
+
+  enum Result {Updated, Unchanged, Corrupt, Overflow};
+
+  Block root;
+
+  bool Parse(const uint8_t* data, size_t size);
+  std::vector<uint8_t> Serialize() const;
+
+  // Sets the versions of VS_FIXEDFILEINFO and of the StringFileInfo values
+  // with one of 'names' the way RCUpdater changes them in an RC file: a
+  // negative part is kept, a negative build incremented. A string keeps its
+  // separators, "1.2.3.4" stays dotted, and any text after the version.
+  Result Update(int major, int minor, int build, int revision, const std::vector<std::u16string>& names, unsigned& changes);
+
+  static std::vector<std::u16string> DefaultNames();
+
+  static uint16_t Read16(const uint8_t* p) { return uint16_t(p[0] | p[1] << 8); }
+  static uint32_t Read32(const uint8_t* p) { return uint32_t(Read16(p)) | uint32_t(Read16(p + 2)) << 16; }
+  static void Write16(uint8_t* p, uint16_t value) { p[0] = uint8_t(value); p[1] = uint8_t(value >> 8); }
+  static void Write32(uint8_t* p, uint32_t value) { Write16(p, uint16_t(value)); Write16(p + 2, uint16_t(value >> 16)); }
+  static size_t Align4(size_t offset) { return (offset + 3) & ~size_t(3); }
+
+protected:
+  static bool ParseBlock(const uint8_t* data, size_t size, Block& block, size_t& length);
+  static void SerializeBlock(const Block& block, std::vector<uint8_t>& out);
+  static bool NextVersion(int major, int minor, int build, int revision, int (&version)[4]);
+  static Result UpdateFixed(std::vector<uint8_t>& value, int major, int minor, int build, int revision, unsigned& changes);
+  static Result UpdateText(std::vector<uint8_t>& value, int major, int minor, int build, int revision, unsigned& changes);
+};
@@ -1,5 +1,8 @@
 #include "stdafx.h"
 #include "RCVersionOptions.h"
+#include "RCFileSet.h"
+#include "RCBufferPool.h"
+#include "RCBatchIO.h"
 
 
 // ---------------------------------------------------------------------------
@@ -10,9 +13,45 @@ L"\nSyntax: RCVersion <resource-file.rc> [<options>]"
 L"\n /m:<major-version> new major version, default: unchanged"
 L"\n /n:<minor-version> new minor version, default: unchanged"
 L"\n /b:<build-number>  new build number, default: increment by one"
+L"\n /b:@<counter-file> take the next build number from <counter-file>, shared by"
+L"\n                    all builds on the machine"
 L"\n /r:<revision>      new revision number, default: unchanged"
 L"\n /o:<output-file>   output file path, default: same as input"
+L"\n /res:<res-file>    also compile the VERSIONINFO of the output file into <res-file>"
+L"\n /header:<h-file>   also write the version as macros and a constexpr struct to"
+L"\n                    <h-file>, only when they change"
+L"\n /l:<list-file>     update every file listed in <list-file>, one path per line"
+L"\n /d:<directory>     update every .rc and AssemblyInfo.cs file in <directory> and below"
+L"\n /include           also update the files included with #include that have a"
+L"\n                    VERSIONINFO block, each once however often it is included"
+L"\n /i:<directory>     search <directory> for included files, implies /include"
+L"\n /shard:<i>/<n>[:size] update only shard <i> of <n> (1..n) of the input files,"
+L"\n                    selected by path hash, ':size' balances shards by file size"
 L"\n /v:{0|1|...|9}     verbosity level, 0=lowest, 9=highest, default: 3"
+L"\n /server            keep running and serve requests from other RCVersion invocations"
+L"\n /server:stop       stop the running server"
+L"\n /local             do not forward the request to a running server"
+L"\n /memory:<MB>       limit for file buffers of all files in flight, default: 256"
+L"\n /io:{ring|threads} file I/O for multiple files, default: I/O ring where available"
+L"\n /pipeline[:<read>,<parse>,<write>] read, update and write multiple files in"
+L"\n                    overlapping stages with the given number of threads each,"
+L"\n                    default: 4 readers, one parser per CPU, 4 writers"
+L"\n /stats             report I/O, pipeline and buffer statistics"
+L"\n /transaction       update multiple files all or none: when any file fails,"
+L"\n                    no file is changed"
+L"\n /dedup             update files with identical content once, write the result"
+L"\n                    to each of them"
+L"\n /cache:<directory> take updated files from <directory> when the same content was"
+L"\n                    updated with the same version before, store them otherwise"
+L"\n /diff[:<file>]     write no file, write a unified diff of the changes to stdout"
+L"\n                    or <file> instead, for git apply; binary files are left out"
+L"\n /value:<name>      also update the StringFileInfo value <name>, besides"
+L"\n                    FileVersion and ProductVersion, may be repeated"
+L"\n /value:@<file>     also update the values named in <file>, one per line"
+L"\n /version:<file>    take the version from <file>, an RC file or a text file"
+L"\n                    containing a version like 1.2.3.4, options above override it"
+L"\n /watch[:<ms>]      keep running and update the files again whenever they or the"
+L"\n                    version file change, after <ms> quiet time, default: 500"
 L"\n"
 L"\n"
 L"\nThis command locates and modifies FILEVERSION and PRODUCTVERSION resources in"
@@ -38,6 +77,23 @@ RCVersionOptions::RCVersionOptions(ILogger &rlogger)
   , revision(-1)
   , verbosity(3)
   , helpOnly(false)
+  , includes(false)
+  , shardIndex(0)
+  , shardCount(0)
+  , shardBySize(false)
+  , server(false)
+  , serverStop(false)
+  , local(false)
+  , watch(false)
+  , watchDelay(500)
+  , memoryLimit(RCBufferPool::DefaultLimit)
+  , ioBackend(RCBatchIO::Automatic)
+  , stats(false)
+  , pipeline(false)
+  , pipelineWorkers{}
+  , transaction(false)
+  , dedup(false)
+  , diff(false)
   , logger(rlogger)
 {
 }
@@ -95,6 +151,101 @@ std::wstring RCVersionOptions::PathOption(const wchar_t* value)
 }
 
 
+// ---------------------------------------------------------------------------
+// Multi-character option name, returns the value after ':' or nullptr
+// ---------------------------------------------------------------------------
+const wchar_t* RCVersionOptions::NamedOption(const wchar_t* arg, const wchar_t* name)
+{
+  size_t length = wcslen(name);
+  if (0 != _wcsnicmp(arg, name, length))
+  {
+    return nullptr;
+  }
+
+  if (L':' == arg[length])
+  {
+    return &arg[length + 1];
+  }
+
+  return (0 == arg[length]) ? &arg[length] : nullptr;
+}
+
+
+// ---------------------------------------------------------------------------
+// /shard:<index>/<count>[:size]
+// ---------------------------------------------------------------------------
+bool RCVersionOptions::ShardOption(const wchar_t* value)
+{
+  wchar_t* tail{nullptr};
+  unsigned long index = wcstoul(value, &tail, 10);
+  unsigned long count{};
+
+  bool valid = (value != tail && L'/' == *tail);
+  if (valid)
+  {
+    const wchar_t* next = tail + 1;
+    count = wcstoul(next, &tail, 10);
+    valid = (next != tail);
+  }
+
+  bool bySize{false};
+  if (valid && L':' == *tail)
+  {
+    bySize = (0 == _wcsicmp(tail + 1, L"size"));
+    valid = bySize;
+  }
+  else if (valid)
+  {
+    valid = (0 == *tail);
+  }
+
+  if (!valid || 0 == count || 0 == index || count < index)
+  {
+    Error(L"*** Invalid shard option: [%s], expected /shard:<i>/<n> with 1 <= i <= n", value);
+    return false;
+  }
+
+  shardIndex = unsigned(index);
+  shardCount = unsigned(count);
+  shardBySize = bySize;
+  return true;
+}
+
+
+// ---------------------------------------------------------------------------
+// /pipeline:<read>,<parse>,<write>, an empty count keeps the default
+// ---------------------------------------------------------------------------
+bool RCVersionOptions::PipelineOption(const wchar_t* value)
+{
+  unsigned counts[3]{};
+  const wchar_t* next = value;
+  bool valid{true};
+  for (int n = 0; n < 3 && valid; ++n)
+  {
+    wchar_t* tail{nullptr};
+    counts[n] = unsigned(wcstoul(next, &tail, 10));
+    valid = (next == tail || (0 < counts[n] && counts[n] <= 256)) && (0 == *tail || (L',' == *tail && n < 2));
+    if (0 == *tail)
+    {
+      break;
+    }
+    next = tail + 1;
+  }
+
+  if (!valid)
+  {
+    Error(L"*** Invalid pipeline option: [%s], expected /pipeline:<read>,<parse>,<write> with 1 to 256 threads each", value);
+    return false;
+  }
+
+  for (int n = 0; n < 3; ++n)
+  {
+    pipelineWorkers[n] = counts[n];
+  }
+  return true;
+}
+
+
 // ---------------------------------------------------------------------------
 // 
 // ---------------------------------------------------------------------------
@@ -134,6 +285,181 @@ bool RCVersionOptions::Parse(int argc, const wchar_t* argv[])
 
     if (L'/' == *arg || L'-' == *arg)
     {
+      if (const wchar_t* shard = NamedOption(arg + 1, L"shard"))
+      {
+        ShardOption(shard);
+        continue;
+      }
+
+      if (const wchar_t* mode = NamedOption(arg + 1, L"server"))
+      {
+        server = true;
+        serverStop = (0 == _wcsicmp(mode, L"stop"));
+        if (*mode && !serverStop)
+        {
+          Error(L"*** Invalid option value: [%s]", arg);
+        }
+        continue;
+      }
+
+      if (const wchar_t* file = NamedOption(arg + 1, L"version"))
+      {
+        versionFile = PathOption(file);
+        if (versionFile.empty())
+        {
+          Error(L"*** Invalid option value: [%s]", arg);
+        }
+        continue;
+      }
+
+      if (const wchar_t* file = NamedOption(arg + 1, L"res"))
+      {
+        resFile = PathOption(file);
+        if (resFile.empty())
+        {
+          Error(L"*** Invalid option value: [%s]", arg);
+        }
+        continue;
+      }
+
+      if (const wchar_t* file = NamedOption(arg + 1, L"header"))
+      {
+        headerFile = PathOption(file);
+        if (headerFile.empty())
+        {
+          Error(L"*** Invalid option value: [%s]", arg);
+        }
+        continue;
+      }
+
+      if (const wchar_t* name = NamedOption(arg + 1, L"value"))
+      {
+        if (L'@' == *name && name[1])
+        {
+          valueFiles.push_back(PathOption(name + 1));
+        }
+        else if (*name && L'@' != *name)
+        {
+          valueNames.push_back(name);
+        }
+        else
+        {
+          Error(L"*** Invalid option value: [%s]", arg);
+        }
+        continue;
+      }
+
+      if (const wchar_t* delay = NamedOption(arg + 1, L"watch"))
+      {
+        watch = true;
+        if (*delay)
+        {
+          int value = NumericOption(delay);
+          watchDelay = (0 <= value) ? unsigned(value) : watchDelay;
+        }
+        continue;
+      }
+
+      if (const wchar_t* megabytes = NamedOption(arg + 1, L"memory"))
+      {
+        int value = NumericOption(megabytes);
+        if (0 < value)
+        {
+          memoryLimit = size_t(value) * 1024 * 1024;
+        }
+        else
+        {
+          Error(L"*** Invalid option value: [%s]", arg);
+        }
+        continue;
+      }
+
+      if (const wchar_t* backend = NamedOption(arg + 1, L"io"))
+      {
+        if (0 == _wcsicmp(backend, L"ring"))
+        {
+          ioBackend = RCBatchIO::Ring;
+        }
+        else if (0 == _wcsicmp(backend, L"threads"))
+        {
+          ioBackend = RCBatchIO::Threads;
+        }
+        else
+        {
+          Error(L"*** Invalid option value: [%s]", arg);
+        }
+        continue;
+      }
+
+      if (const wchar_t* workers = NamedOption(arg + 1, L"pipeline"))
+      {
+        pipeline = true;
+        if (*workers)
+        {
+          PipelineOption(workers);
+        }
+        continue;
+      }
+
+      if (const wchar_t* directory = NamedOption(arg + 1, L"cache"))
+      {
+        cacheDirectory = PathOption(directory);
+        if (cacheDirectory.empty())
+        {
+          Error(L"*** Invalid option value: [%s]", arg);
+        }
+        continue;
+      }
+
+      if (const wchar_t* file = NamedOption(arg + 1, L"diff"))
+      {
+        diff = true;
+        if (*file)
+        {
+          diffFile = PathOption(file);
+          if (diffFile.empty())
+          {
+            Error(L"*** Invalid option value: [%s]", arg);
+          }
+        }
+        continue;
+      }
+
+      const wchar_t* statsValue = NamedOption(arg + 1, L"stats");
+      if (statsValue && !*statsValue)
+      {
+        stats = true;
+        continue;
+      }
+
+      const wchar_t* transactionValue = NamedOption(arg + 1, L"transaction");
+      if (transactionValue && !*transactionValue)
+      {
+        transaction = true;
+        continue;
+      }
+
+      const wchar_t* dedupValue = NamedOption(arg + 1, L"dedup");
+      if (dedupValue && !*dedupValue)
+      {
+        dedup = true;
+        continue;
+      }
+
+      const wchar_t* includeValue = NamedOption(arg + 1, L"include");
+      if (includeValue && !*includeValue)
+      {
+        includes = true;
+        continue;
+      }
+
+      const wchar_t* localValue = NamedOption(arg + 1, L"local");
+      if (localValue && !*localValue)
+      {
+        local = true;
+        continue;
+      }
+
       wchar_t code = towlower(arg[1]);
       bool colon = (0 != code && L':' == arg[2]);
       const wchar_t* value{colon ? &arg[3] : nullptr};
@@ -166,7 +492,15 @@ bool RCVersionOptions::Parse(int argc, const wchar_t* argv[])
         }
         break;
       case L'b':
-        if (*value)
+        if (L'@' == *value)
+        {
+          buildCounter = PathOption(value + 1);
+          if (buildCounter.empty())
+          {
+            Error(L"*** Missing counter file: [%s]", arg);
+          }
+        }
+        else if (*value)
         {
           buildNumber = NumericOption(value);
         }
@@ -180,6 +514,25 @@ bool RCVersionOptions::Parse(int argc, const wchar_t* argv[])
       case L'o':
         outputFile = PathOption(value);
         break;
+      case L'l':
+        if (*value)
+        {
+          listFiles.push_back(PathOption(value));
+        }
+        break;
+      case L'd':
+        if (*value)
+        {
+          searchDirectories.push_back(PathOption(value));
+        }
+        break;
+      case L'i':
+        if (*value)
+        {
+          includes = true;
+          includeDirectories.push_back(PathOption(value));
+        }
+        break;
       case L'v':
         if (*value)
         {
@@ -218,11 +571,47 @@ bool RCVersionOptions::Validate()
     return false;
   }
 
-  if (inputFile.empty())
+  if (server)
+  {
+    return !errorDetected;
+  }
+
+  if (inputFile.empty() && listFiles.empty() && searchDirectories.empty())
   {
     Error(L"*** Missing 'input file' parameter.");
   }
 
+  if (!outputFile.empty() && MultiFile())
+  {
+    Error(L"*** Output file [%s] cannot be used with multiple input files.", outputFile.c_str());
+  }
+
+  if (!resFile.empty() && MultiFile())
+  {
+    Error(L"*** Resource file [%s] cannot be used with multiple input files.", resFile.c_str());
+  }
+
+  if (!headerFile.empty() && MultiFile())
+  {
+    Error(L"*** Header file [%s] cannot be used with multiple input files.", headerFile.c_str());
+  }
+
+  // A diff run changes no file
+  if (diff && !outputFile.empty() && outputFile != inputFile)
+  {
+    Error(L"*** Output file [%s] cannot be used with /diff.", outputFile.c_str());
+  }
+  if (diff && (!resFile.empty() || !headerFile.empty() || watch))
+  {
+    Error(L"*** /diff cannot be used with /res, /header or /watch.");
+  }
+
+  // Without a fixed version every change would increment the build number again
+  if (watch && buildNumber < 0 && buildCounter.empty() && versionFile.empty())
+  {
+    Error(L"*** Watch mode needs a build number (/b:) or a version file (/version:).");
+  }
+
   if (outputFile.empty())
   {
     outputFile = inputFile;
@@ -235,3 +624,169 @@ bool RCVersionOptions::Validate()
 
   return !errorDetected;
 }
+
+
+// ---------------------------------------------------------------------------
+// 
+// ---------------------------------------------------------------------------
+bool RCVersionOptions::MultiFile() const
+{
+  return !listFiles.empty() || !searchDirectories.empty() || 0 != shardCount || watch;
+}
+
+
+// ---------------------------------------------------------------------------
+// Make paths independent of the current directory, before forwarding
+// ---------------------------------------------------------------------------
+void RCVersionOptions::AbsolutePaths()
+{
+  bool sameOutput = (outputFile == inputFile);
+  inputFile = RCFileSet::FullPath(inputFile.c_str());
+  outputFile = sameOutput ? inputFile : RCFileSet::FullPath(outputFile.c_str());
+  for (auto& list : listFiles)
+  {
+    list = RCFileSet::FullPath(list.c_str());
+  }
+  for (auto& directory : searchDirectories)
+  {
+    directory = RCFileSet::FullPath(directory.c_str());
+  }
+  for (auto& names : valueFiles)
+  {
+    names = RCFileSet::FullPath(names.c_str());
+  }
+  for (auto& directory : includeDirectories)
+  {
+    directory = RCFileSet::FullPath(directory.c_str());
+  }
+  versionFile = RCFileSet::FullPath(versionFile.c_str());
+  resFile = RCFileSet::FullPath(resFile.c_str());
+  headerFile = RCFileSet::FullPath(headerFile.c_str());
+  diffFile = RCFileSet::FullPath(diffFile.c_str());
+  cacheDirectory = RCFileSet::FullPath(cacheDirectory.c_str());
+  buildCounter = RCFileSet::FullPath(buildCounter.c_str());
+}
+
+
+// ---------------------------------------------------------------------------
+// Command line equivalent to the parsed options
+// ---------------------------------------------------------------------------
+std::vector<std::wstring> RCVersionOptions::Arguments() const
+{
+  std::vector<std::wstring> args;
+  if (!inputFile.empty())
+  {
+    args.push_back(inputFile);
+  }
+  if (!outputFile.empty() && outputFile != inputFile)
+  {
+    args.push_back(L"/o:" + outputFile);
+  }
+  if (!resFile.empty())
+  {
+    args.push_back(L"/res:" + resFile);
+  }
+  if (!headerFile.empty())
+  {
+    args.push_back(L"/header:" + headerFile);
+  }
+
+  const struct { const wchar_t* option; int value; } numbers[] = {
+    {L"/m:", majorVersion},
+    {L"/n:", minorVersion},
+    {L"/b:", buildNumber},
+    {L"/r:", revision},
+    {L"/v:", int(verbosity)},
+  };
+  for (const auto& number : numbers)
+  {
+    if (0 <= number.value)
+    {
+      args.push_back(number.option + std::to_wstring(number.value));
+    }
+  }
+
+  for (const auto& list : listFiles)
+  {
+    args.push_back(L"/l:" + list);
+  }
+  for (const auto& directory : searchDirectories)
+  {
+    args.push_back(L"/d:" + directory);
+  }
+  if (!buildCounter.empty())
+  {
+    args.push_back(L"/b:@" + buildCounter);
+  }
+  for (const auto& name : valueNames)
+  {
+    args.push_back(L"/value:" + name);
+  }
+  for (const auto& names : valueFiles)
+  {
+    args.push_back(L"/value:@" + names);
+  }
+  if (includes)
+  {
+    args.push_back(L"/include");
+  }
+  for (const auto& directory : includeDirectories)
+  {
+    args.push_back(L"/i:" + directory);
+  }
+  if (!versionFile.empty())
+  {
+    args.push_back(L"/version:" + versionFile);
+  }
+  if (watch)
+  {
+    args.push_back(L"/watch:" + std::to_wstring(watchDelay));
+  }
+  if (RCBatchIO::Ring == ioBackend || RCBatchIO::Threads == ioBackend)
+  {
+    args.push_back(RCBatchIO::Ring == ioBackend ? L"/io:ring" : L"/io:threads");
+  }
+  if (RCBufferPool::DefaultLimit != memoryLimit)
+  {
+    args.push_back(L"/memory:" + std::to_wstring(memoryLimit / (1024 * 1024)));
+  }
+  if (pipeline)
+  {
+    std::wstring workers;
+    for (int n = 0; n < 3; ++n)
+    {
+      workers += (0 == n ? L":" : L",") + (pipelineWorkers[n] ? std::to_wstring(pipelineWorkers[n]) : std::wstring());
+    }
+    args.push_back(L"/pipeline" + (L":,," == workers ? std::wstring() : workers));
+  }
+  if (stats)
+  {
+    args.push_back(L"/stats");
+  }
+  if (transaction)
+  {
+    args.push_back(L"/transaction");
+  }
+  if (dedup)
+  {
+    args.push_back(L"/dedup");
+  }
+  if (!cacheDirectory.empty())
+  {
+    args.push_back(L"/cache:" + cacheDirectory);
+  }
+  if (diff)
+  {
+    args.push_back(diffFile.empty() ? std::wstring(L"/diff") : L"/diff:" + diffFile);
+  }
+  if (0 != shardCount)
+  {
+    args.push_back(L"/shard:" + std::to_wstring(shardIndex) + L"/" + std::to_wstring(shardCount) + (shardBySize ? L":size" : L""));
+  }
+  if (serverStop)
+  {
+    args.push_back(L"/server:stop");
+  }
+
+  return args;
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include "ILogger.h"
+#include <string>
+#include <vector>
 
 
 class RCVersionOptions
@@ -19,6 +21,42 @@ public:
 
   std::wstring inputFile;
   std::wstring outputFile;
+  std::wstring versionFile;
+  std::wstring resFile;
+  std::wstring headerFile;
+  std::wstring buildCounter;
+  std::wstring cacheDirectory;
+
+  std::vector<std::wstring> listFiles;
+  std::vector<std::wstring> searchDirectories;
+  std::vector<std::wstring> valueNames;
+  std::vector<std::wstring> valueFiles;
+
+  bool includes;
+  std::vector<std::wstring> includeDirectories;
+
+  unsigned shardIndex;
+  unsigned shardCount;
+  bool shardBySize;
+
+  bool server;
+  bool serverStop;
+  bool local;
+
+  bool watch;
+  unsigned watchDelay;
+
+  size_t memoryLimit;
+  int ioBackend;
+  bool stats;
+
+  bool pipeline;
+  unsigned pipelineWorkers[3];
+  bool transaction;
+  bool dedup;
+
+  bool diff;
+  std::wstring diffFile;
 
   ILogger &logger;
 
@@ -27,9 +65,15 @@ public:
   void CheckVerbosity(int argc, const wchar_t* argv[]);
   bool Parse(int argc, const wchar_t* argv[]);
   bool Validate();
+  bool MultiFile() const;
+  void AbsolutePaths();
+  std::vector<std::wstring> Arguments() const;
 
   void Error(const wchar_t* format, ...);
 
   int NumericOption(const wchar_t* value);
   static std::wstring PathOption(const wchar_t* value);
+  static const wchar_t* NamedOption(const wchar_t* arg, const wchar_t* name);
+  bool ShardOption(const wchar_t* value);
+  bool PipelineOption(const wchar_t* value);
 };
@@ -0,0 +1,365 @@
+#include "stdafx.h"
+#include "RCWatcher.h"
+#include "RCFileHandler.h"
+#include "RCFileSet.h"
+#include <algorithm>
+
+RCWatcher::RCWatcher(ILogger &rlogger)
+  : ilogger(rlogger)
+  , logger(rlogger)
+  , error(0)
+  , valueNames(nullptr)
+  , port(CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1))
+  , outstanding(0)
+  , options{-1, -1, -1, -1}
+  , version{-1, -1, -1, -1}
+{
+}
+
+RCWatcher::~RCWatcher()
+{
+  Cancel();
+}
+
+std::wstring RCWatcher::DirectoryOf(const std::wstring& path)
+{
+  size_t pos = path.find_last_of(L"\\/");
+  if (std::wstring::npos == pos)
+  {
+    return L".";
+  }
+  // Keep the backslash of a drive root, "C:" alone is the current directory on C:
+  return path.substr(0, (2 == pos && L':' == path[1]) ? pos + 1 : pos);
+}
+
+// ---------------------------------------------------------------------------
+// Update all files once, then again whenever they or the version file change
+// ---------------------------------------------------------------------------
+bool RCWatcher::Run(const std::vector<std::wstring>& paths, const wchar_t* versionPath, int major, int minor, int build, int revision, unsigned delay)
+{
+  if (!port)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCWatcher::Run: Cannot create completion port");
+  }
+
+  options[0] = major;
+  options[1] = minor;
+  options[2] = build;
+  options[3] = revision;
+
+  std::unordered_map<std::wstring, std::wstring> directories;
+  for (const auto& path : paths)
+  {
+    std::wstring full = RCFileSet::FullPath(path.c_str());
+    files[RCFileSet::NormalizeKey(full.c_str())] = full;
+    std::wstring directory = DirectoryOf(full);
+    directories.emplace(RCFileSet::NormalizeKey(directory.c_str()), directory);
+  }
+
+  if (versionPath && *versionPath)
+  {
+    versionFile = RCFileSet::FullPath(versionPath);
+    versionKey = RCFileSet::NormalizeKey(versionFile.c_str());
+    std::wstring directory = DirectoryOf(versionFile);
+    directories.emplace(RCFileSet::NormalizeKey(directory.c_str()), directory);
+  }
+
+  // Watch before the first update so that no edit in between is missed
+  for (const auto& directory : directories)
+  {
+    if (!AddDirectory(directory.second))
+    {
+      Cancel();
+      return false;
+    }
+  }
+
+  bool versionChanged{};
+  if (!LoadVersion(versionChanged))
+  {
+    Cancel();
+    return false;
+  }
+
+  std::unordered_set<std::wstring> all;
+  for (const auto& file : files)
+  {
+    all.insert(file.first);
+  }
+  Update(all, true);
+
+  logger.Log(logNormal, L"Watching %u files in %u directories, press Ctrl+C to stop.", unsigned(files.size()), unsigned(directories.size()));
+
+  std::unordered_set<std::wstring> pending;
+  bool versionPending{false};
+  ULONGLONG first{};
+  ULONGLONG deadline{};
+  bool running{true};
+  while (running)
+  {
+    bool waiting = versionPending || !pending.empty();
+    DWORD timeout = INFINITE;
+    if (waiting)
+    {
+      ULONGLONG now = GetTickCount64();
+      timeout = (deadline <= now) ? 0 : DWORD(deadline - now);
+    }
+
+    DWORD bytes{};
+    ULONG_PTR key{};
+    OVERLAPPED* overlapped{nullptr};
+    BOOL ok = GetQueuedCompletionStatus(port.get(), &bytes, &key, &overlapped, timeout);
+
+    if (!overlapped)
+    {
+      if (!ok && WAIT_TIMEOUT == GetLastError())
+      {
+        // Quiet for the debounce delay, update what has changed
+        versionChanged = false;
+        if (versionPending && !LoadVersion(versionChanged))
+        {
+          logger.Log(logNormal, L"Keeping version %d.%d.%d.%d.", version[0], version[1], version[2], version[3]);
+        }
+        Update(versionChanged ? all : pending, versionChanged);
+        pending.clear();
+        versionPending = false;
+        continue;
+      }
+
+      if (!ok)
+      {
+        logger.Error(error = GetLastError(), L"*** RCWatcher::Run: Cannot wait for changes");
+      }
+      // A packet without overlapped structure is the stop request
+      running = false;
+      continue;
+    }
+
+    --outstanding;
+    Watch& watch = *watches[key - 1];
+    Collect(watch, ok ? bytes : 0, pending, versionPending);
+    if (!Listen(watch))
+    {
+      running = false;
+      continue;
+    }
+
+    // Every change restarts the quiet time, a steady stream of changes
+    // still gets an update after ten delays
+    if (versionPending || !pending.empty())
+    {
+      ULONGLONG now = GetTickCount64();
+      if (!waiting)
+      {
+        first = now;
+      }
+      deadline = min(now + delay, first + 10ULL * delay);
+    }
+  }
+
+  Cancel();
+  logger.Log(logNormal, L"Watch stopped, %llu offset cache hits, %llu misses.", cache.Hits(), cache.Misses());
+  return 0 == error;
+}
+
+void RCWatcher::Stop()
+{
+  PostQueuedCompletionStatus(port.get(), 0, 0, nullptr);
+}
+
+bool RCWatcher::AddDirectory(const std::wstring& directory)
+{
+  logger.Log(logDetail, L"Watching directory [%s]", directory.c_str());
+
+  std::unique_ptr<Watch> watch{new Watch{}};
+  watch->directory = directory;
+  watch->handle.reset(CreateFile(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr));
+  if (!watch->handle)
+  {
+    return logger.Error(error = GetLastError(), L"*** RCWatcher::AddDirectory: Cannot open directory [%s]", directory.c_str());
+  }
+
+  // 64 KB, larger buffers fail for directories on network shares
+  watch->buffer.resize(16384);
+
+  if (!CreateIoCompletionPort(watch->handle.get(), port.get(), ULONG_PTR(watches.size() + 1), 0))
+  {
+    return logger.Error(error = GetLastError(), L"*** RCWatcher::AddDirectory: Cannot watch directory [%s]", directory.c_str());
+  }
+
+  watches.push_back(std::move(watch));
+  return Listen(*watches.back());
+}
+
+bool RCWatcher::Listen(Watch& watch)
+{
+  memset(&watch.overlapped, 0, sizeof(watch.overlapped));
+  const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+  if (!ReadDirectoryChangesW(watch.handle.get(), watch.buffer.data(), DWORD(watch.buffer.size() * sizeof(DWORD)), FALSE, filter, nullptr, &watch.overlapped, nullptr))
+  {
+    return logger.Error(error = GetLastError(), L"*** RCWatcher::Listen: Cannot watch directory [%s]", watch.directory.c_str());
+  }
+
+  ++outstanding;
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Editors save in place or write a temporary file and rename it, both name
+// the watched file. Zero bytes means the notification buffer overflowed.
+// ---------------------------------------------------------------------------
+void RCWatcher::Collect(Watch& watch, DWORD bytes, std::unordered_set<std::wstring>& changed, bool& versionChanged)
+{
+  if (0 == bytes)
+  {
+    logger.Log(logDetail, L"Too many changes in [%s], checking all files.", watch.directory.c_str());
+    std::wstring prefix = RCFileSet::NormalizeKey((watch.directory + L"\\").c_str());
+    for (const auto& file : files)
+    {
+      if (0 == file.first.compare(0, prefix.size(), prefix))
+      {
+        changed.insert(file.first);
+      }
+    }
+    versionChanged = versionChanged || (!versionKey.empty() && 0 == versionKey.compare(0, prefix.size(), prefix));
+    return;
+  }
+
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(watch.buffer.data());
+  for (DWORD offset{}; offset < bytes;)
+  {
+    const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(data + offset);
+    std::wstring name(info->FileName, info->FileNameLength / sizeof(wchar_t));
+    std::wstring key = RCFileSet::NormalizeKey((watch.directory + L"\\" + name).c_str());
+    logger.Log(logVerbose, L"Change %u: [%s]", unsigned(info->Action), name.c_str());
+
+    if (files.end() != files.find(key))
+    {
+      changed.insert(key);
+    }
+    if (key == versionKey)
+    {
+      versionChanged = true;
+    }
+
+    if (0 == info->NextEntryOffset)
+    {
+      break;
+    }
+    offset += info->NextEntryOffset;
+  }
+}
+
+bool RCWatcher::LoadVersion(bool& changed)
+{
+  int next[4] = {options[0], options[1], options[2], options[3]};
+  if (!versionFile.empty())
+  {
+    RCFileHandler reader{ilogger};
+    reader.Verbosity(logger.Verbosity());
+    int source[4] = {-1, -1, -1, -1};
+    if (!reader.ReadVersion(versionFile.c_str(), source[0], source[1], source[2], source[3]))
+    {
+      error = reader.Error();
+      return false;
+    }
+    for (int n = 0; n < 4; ++n)
+    {
+      next[n] = (next[n] < 0) ? source[n] : next[n];
+    }
+  }
+
+  changed = !std::equal(next, next + 4, version);
+  std::copy(next, next + 4, version);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Our own writes come back as change notifications, the offset cache knows
+// the size and time of every file we wrote and those are skipped unless the
+// version changed. Cached offsets spare the scan of unchanged files.
+// ---------------------------------------------------------------------------
+unsigned RCWatcher::Update(const std::unordered_set<std::wstring>& keys, bool force)
+{
+  RCFileHandler handler{ilogger};
+  handler.Verbosity(logger.Verbosity());
+  handler.Cache(&cache);
+  handler.ValueNames(valueNames);
+  handler.Pool(&pool);
+  handler.SkipUnchanged(true);
+
+  unsigned updated{};
+  unsigned failed{};
+  for (const auto& key : keys)
+  {
+    const std::wstring& path = files[key];
+    if (!force)
+    {
+      WIN32_FILE_ATTRIBUTE_DATA data{};
+      if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &data))
+      {
+        logger.Log(logDetail, L"File [%s] is not accessible, error %u.", path.c_str(), GetLastError());
+        continue;
+      }
+
+      ULARGE_INTEGER size{};
+      size.LowPart = data.nFileSizeLow;
+      size.HighPart = data.nFileSizeHigh;
+      if (cache.Current(path.c_str(), size.QuadPart, data.ftLastWriteTime))
+      {
+        logger.Log(logDetail, L"File [%s] not changed since it was updated.", path.c_str());
+        continue;
+      }
+    }
+
+    if (handler.UpdateFile(path.c_str(), path.c_str(), version[0], version[1], version[2], version[3]))
+    {
+      ++updated;
+    }
+    else
+    {
+      ++failed;
+    }
+  }
+
+  if (0 != updated || 0 != failed)
+  {
+    logger.Log(logInfo, L"%u files checked, %u failed.", updated, failed);
+  }
+  return failed;
+}
+
+// ---------------------------------------------------------------------------
+// The notification buffers stay until the cancelled reads have completed
+// ---------------------------------------------------------------------------
+void RCWatcher::Cancel()
+{
+  for (auto& watch : watches)
+  {
+    CancelIoEx(watch->handle.get(), &watch->overlapped);
+  }
+
+  while (0 < outstanding)
+  {
+    DWORD bytes{};
+    ULONG_PTR key{};
+    OVERLAPPED* overlapped{nullptr};
+    BOOL ok = GetQueuedCompletionStatus(port.get(), &bytes, &key, &overlapped, 5000);
+    if (overlapped)
+    {
+      --outstanding;
+    }
+    else if (!ok)
+    {
+      logger.Error(GetLastError(), L"*** RCWatcher::Cancel: %u directory reads did not complete", outstanding);
+      // Leak the buffers rather than free memory the system may still write to
+      for (auto& watch : watches)
+      {
+        watch.release();
+      }
+      break;
+    }
+  }
+
+  watches.clear();
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "Logger.h"
+#include "RCOffsetCache.h"
+#include "RCBufferPool.h"
+#include "RCValueNames.h"
+#include <windows.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "wil/resource.h"
+
+// Watches RC files and an optional version source file for changes and updates
+// the changed files again. Notifications of the directories holding the files
+// arrive on one completion port; a burst of changes is collected until the
+// files have been quiet for the debounce delay.
+class RCWatcher
+{
+protected:
+  ILogger &ilogger;
+  Logger logger;
+  unsigned error;
+  RCOffsetCache cache;
+  RCBufferPool pool;
+  const RCValueNames* valueNames;
+  wil::unique_handle port;
+  unsigned outstanding;
+
+  struct Watch
+  {
+    std::wstring directory;
+    wil::unique_hfile handle;
+    OVERLAPPED overlapped;
+    std::vector<DWORD> buffer;
+  };
+  std::vector<std::unique_ptr<Watch>> watches;
+
+  // Normalized path key to the path as given
+  std::unordered_map<std::wstring, std::wstring> files;
+  std::wstring versionFile;
+  std::wstring versionKey;
+
+  int options[4];
+  int version[4];
+
+  enum LOG_LEVEL {logError=0, logMinimum=1, logNormal=2, logInfo=3, logDetail=5, logVerbose=9};
+
+public:
+  RCWatcher(ILogger &rlogger);
+  virtual ~RCWatcher();
+
+  unsigned Error() const { return error; }
+  int Verbosity() const { return logger.Verbosity(); }
+  void Verbosity(int value) { logger.Verbosity(value); }
+  RCOffsetCache& Cache() { return cache; }
+  void ValueNames(const RCValueNames* value) { valueNames = value; }
+
+  // Explicit version parts override the version file, -1 leaves them to it
+  bool Run(const std::vector<std::wstring>& paths, const wchar_t* versionPath, int major, int minor, int build, int revision, unsigned delay);
+
+  // May be called from any thread, Run returns after the current update
+  void Stop();
+
+protected:
+  bool AddDirectory(const std::wstring& directory);
+  bool Listen(Watch& watch);
+  void Collect(Watch& watch, DWORD bytes, std::unordered_set<std::wstring>& changed, bool& versionChanged);
+  bool LoadVersion(bool& changed);
+  unsigned Update(const std::unordered_set<std::wstring>& keys, bool force);
+  void Cancel();
+
+  static std::wstring DirectoryOf(const std::wstring& path);
+};
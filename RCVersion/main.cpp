@@ -1,16 +1,22 @@
 // RCVersion.cpp : Defines the entry point for the console application.
 #include "stdafx.h"
 #include "RCVersionOptions.h"
-#include "RCFileHandler.h"
+#include "RCCommand.h"
+#include "RCServer.h"
 #include "Logger.h"
+#include <thread>
 
 static const wchar_t szTitle[] = L"RCVersion - Modify version number in a resource RC file";
 
 class ConsoleLogger : public ILogger
 {
+public:
+  // Messages go to stderr while stdout carries a diff
+  bool toStderr{false};
+
   void Log(const wchar_t* message) override
   {
-    wprintf(L"%s\n", message);
+    fwprintf(toStderr ? stderr : stdout, L"%s\n", message);
   }
 };
 
@@ -26,6 +32,7 @@ int _tmain(int argc, const wchar_t* argv[])
   //   wprintf(L"%s\nVersion: %s\n", szTitle, version.displayVersion);
 
   options.Parse(argc, argv);
+  clogger.toStderr = options.diff && options.diffFile.empty();
   if (!options.Validate())
   {
     wprintf(L"\n%s\n", options.Help);
@@ -36,12 +43,36 @@ int _tmain(int argc, const wchar_t* argv[])
     return ERROR_INVALID_PARAMETER;
   }
 
-  RCFileHandler handler{clogger};
-  handler.Verbosity(options.verbosity);
   unsigned error{};
-  if (!handler.UpdateFile(options.inputFile.c_str(), options.outputFile.c_str(), options.majorVersion, options.minorVersion, options.buildNumber, options.revision))
+  if (options.server && !options.serverStop)
+  {
+    RCServer server{clogger};
+    server.Verbosity(options.verbosity);
+    server.MemoryLimit(options.memoryLimit);
+    unsigned threads = max(2u, std::thread::hardware_concurrency());
+    if (!server.Run(threads))
+    {
+      error = server.Error();
+    }
+  }
+  else if (options.server)
   {
-    error = handler.Error();
+    if (!RCServer::Forward(RCServer::DefaultPipeName, options.Arguments(), clogger, error))
+    {
+      logger.Log(2, L"RCVersion server is not running.");
+    }
+  }
+  else
+  {
+    RCVersionOptions remote{options};
+    remote.AbsolutePaths();
+    // Watch mode runs until stopped, it would hold a server worker forever,
+    // a diff goes to the stdout of this process
+    if (options.local || options.watch || options.diff || !RCServer::Forward(RCServer::DefaultPipeName, remote.Arguments(), clogger, error))
+    {
+      RCCommand command{clogger};
+      error = command.Execute(options);
+    }
   }
 
   if (0 < options.verbosity)
@@ -0,0 +1,194 @@
+#include "stdafx.h"
+#include "RCVersionApi.h"
+
+class ApiTests : public ::testing::Test
+{
+protected:
+  void TearDown() override
+  {
+    for (const auto& file : tempFiles)
+    {
+      DeleteFile(file.c_str());
+    }
+  }
+
+  std::wstring CreateTempRCFile(const std::string& content)
+  {
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rcb", 0, tempFile);
+    tempFiles.push_back(tempFile);
+
+    FILE* file = _wfopen(tempFile, L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+    return tempFile;
+  }
+
+  std::string ReadText(const std::wstring& path)
+  {
+    std::string text;
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file)
+    {
+      char chunk[256];
+      size_t read;
+      while (0 < (read = fread(chunk, 1, sizeof(chunk), file)))
+      {
+        text.append(chunk, read);
+      }
+      fclose(file);
+    }
+    return text;
+  }
+
+  static void RCVERSION_CALL Collect(void* user, const wchar_t* message)
+  {
+    static_cast<std::wstring*>(user)->append(message).append(L"\r\n");
+  }
+
+  const std::string rcContent =
+    "VS_VERSION_INFO VERSIONINFO\r\n"
+    " FILEVERSION 1,2,3,4\r\n"
+    " PRODUCTVERSION 1,2,3,4\r\n"
+    "BEGIN\r\n"
+    " VALUE \"FileVersion\", \"1.2.3.4\"\r\n"
+    "END\r\n";
+
+  std::vector<std::wstring> tempFiles;
+};
+
+TEST_F(ApiTests, UpdateFileWithoutContext)
+{
+  EXPECT_EQ(unsigned(RCVERSION_API_VERSION), RCVersionApiVersion());
+
+  std::wstring path = CreateTempRCFile(rcContent);
+  ASSERT_EQ(0u, RCVersionUpdateFile(nullptr, path.c_str(), nullptr, -1, -1, 42, -1));
+  EXPECT_NE(std::string::npos, ReadText(path).find("FILEVERSION 1, 2, 42, 4"));
+
+  int version[4]{};
+  ASSERT_EQ(0u, RCVersionReadFile(nullptr, path.c_str(), version));
+  EXPECT_EQ(42, version[2]);
+
+  EXPECT_NE(0u, RCVersionReadFile(nullptr, L"Z:\\does\\not\\exist.rc", version));
+  EXPECT_EQ(unsigned(ERROR_INVALID_PARAMETER), RCVersionReadFile(nullptr, path.c_str(), nullptr));
+}
+
+TEST_F(ApiTests, UpdateFilesLogsToCallback)
+{
+  std::wstring messages;
+  RCVersionContext* context = RCVersionCreate(2, &Collect, &messages);
+  ASSERT_NE(nullptr, context);
+
+  std::vector<std::wstring> paths{CreateTempRCFile(rcContent), CreateTempRCFile(rcContent), CreateTempRCFile(rcContent)};
+  std::vector<const wchar_t*> names;
+  for (const auto& path : paths)
+  {
+    names.push_back(path.c_str());
+  }
+
+  EXPECT_EQ(0u, RCVersionUpdateFiles(context, names.data(), names.size(), 5, 6, 7, 8)) << messages;
+  for (const auto& path : paths)
+  {
+    EXPECT_NE(std::string::npos, ReadText(path).find("FILEVERSION 5, 6, 7, 8"));
+  }
+  EXPECT_NE(std::wstring::npos, messages.find(L"changes made"));
+
+  // The second run finds the versions at the offsets kept in the context
+  EXPECT_EQ(0u, RCVersionUpdateFile(context, paths[0].c_str(), paths[0].c_str(), 5, 6, 9, 8)) << messages;
+  EXPECT_NE(std::string::npos, ReadText(paths[0]).find("FILEVERSION 5, 6, 9, 8"));
+
+  RCVersionDestroy(context);
+}
+
+TEST_F(ApiTests, UpdateFilesTransacted)
+{
+  std::vector<std::wstring> paths{CreateTempRCFile(rcContent), CreateTempRCFile("no version here\r\n")};
+  const wchar_t* names[] = {paths[0].c_str(), paths[1].c_str()};
+
+  EXPECT_EQ(unsigned(ERROR_FILE_CORRUPT), RCVersionUpdateFilesTransacted(nullptr, names, 2, 5, 6, 7, 8));
+  EXPECT_EQ(rcContent, ReadText(paths[0]));
+
+  EXPECT_EQ(0u, RCVersionUpdateFilesTransacted(nullptr, names, 1, 5, 6, 7, 8));
+  EXPECT_NE(std::string::npos, ReadText(paths[0]).find("FILEVERSION 5, 6, 7, 8"));
+}
+
+TEST_F(ApiTests, UpdateBuffer)
+{
+  std::vector<char> buffer(rcContent.begin(), rcContent.end());
+  buffer.resize(buffer.size() + 64);
+  size_t outBytes{};
+
+  ASSERT_EQ(0u, RCVersionUpdateBuffer(nullptr, buffer.data(), rcContent.size(), buffer.size(), &outBytes, 10, 20, 30, 40));
+  std::string text(buffer.data(), outBytes);
+  EXPECT_NE(std::string::npos, text.find("FILEVERSION 10, 20, 30, 40"));
+  EXPECT_NE(std::string::npos, text.find("\"10, 20, 30, 40\""));
+
+  int version[4]{};
+  ASSERT_EQ(0u, RCVersionReadBuffer(nullptr, buffer.data(), outBytes, version));
+  EXPECT_EQ(10, version[0]);
+  EXPECT_EQ(40, version[3]);
+}
+
+TEST_F(ApiTests, ValueNamesOfContext)
+{
+  std::string content = rcContent + " VALUE \"PrivateBuild\", \"1.2.3.4\"\r\n";
+  std::wstring path = CreateTempRCFile(content);
+  RCVersionContext* context = RCVersionCreate(0, nullptr, nullptr);
+  ASSERT_NE(nullptr, context);
+  EXPECT_EQ(unsigned(ERROR_INVALID_PARAMETER), RCVersionAddValueName(nullptr, L"PrivateBuild"));
+  EXPECT_EQ(unsigned(ERROR_INVALID_PARAMETER), RCVersionAddValueName(context, nullptr));
+  ASSERT_EQ(0u, RCVersionAddValueName(context, L"PrivateBuild"));
+  EXPECT_NE(0u, RCVersionAddValueFile(context, L"Z:\\does\\not\\exist.txt"));
+
+  ASSERT_EQ(0u, RCVersionUpdateFile(context, path.c_str(), nullptr, -1, -1, 42, -1));
+  std::string text = ReadText(path);
+  EXPECT_NE(std::string::npos, text.find("42", text.find("\"PrivateBuild\"")));
+
+  std::vector<char> buffer(content.begin(), content.end());
+  buffer.resize(buffer.size() + 64);
+  size_t outBytes{};
+  ASSERT_EQ(0u, RCVersionUpdateBuffer(context, buffer.data(), content.size(), buffer.size(), &outBytes, 10, 20, 30, 40));
+  EXPECT_NE(std::string::npos, std::string(buffer.data(), outBytes).find("\"PrivateBuild\", \"10, 20, 30, 40\""));
+
+  RCVersionDestroy(context);
+}
+
+TEST_F(ApiTests, UpdateBufferTooSmall)
+{
+  std::vector<char> buffer(rcContent.begin(), rcContent.end());
+  size_t outBytes{};
+
+  EXPECT_EQ(unsigned(ERROR_INSUFFICIENT_BUFFER), RCVersionUpdateBuffer(nullptr, buffer.data(), buffer.size(), buffer.size(), &outBytes, 1000, 2000, 3000, 4000));
+  EXPECT_LT(buffer.size(), outBytes);
+  EXPECT_EQ(rcContent, std::string(buffer.data(), buffer.size()));
+
+  buffer.resize(outBytes);
+  EXPECT_EQ(0u, RCVersionUpdateBuffer(nullptr, buffer.data(), rcContent.size(), buffer.size(), &outBytes, 1000, 2000, 3000, 4000));
+  EXPECT_EQ(buffer.size(), outBytes);
+}
+
+TEST_F(ApiTests, UpdateUnicodeBuffer)
+{
+  std::wstring text = L"\xFEFF" L"VS_VERSION_INFO VERSIONINFO\r\n FILEVERSION 1,2,3,4\r\nBEGIN\r\nEND\r\n";
+  std::vector<wchar_t> buffer(text.begin(), text.end());
+  buffer.resize(buffer.size() + 32);
+  size_t outBytes{};
+
+  ASSERT_EQ(0u, RCVersionUpdateBuffer(nullptr, buffer.data(), text.size() * sizeof(wchar_t), buffer.size() * sizeof(wchar_t), &outBytes, -1, -1, 99, -1));
+  EXPECT_EQ(0u, outBytes % sizeof(wchar_t));
+  EXPECT_NE(std::wstring::npos, std::wstring(buffer.data(), outBytes / sizeof(wchar_t)).find(L"FILEVERSION 1, 2, 99, 4"));
+}
+
+TEST_F(ApiTests, BufferWithoutVersion)
+{
+  char buffer[] = "no version here";
+  size_t outBytes{};
+  int version[4]{};
+  EXPECT_EQ(unsigned(ERROR_FILE_CORRUPT), RCVersionUpdateBuffer(nullptr, buffer, strlen(buffer), sizeof(buffer), &outBytes, 1, 2, 3, 4));
+  EXPECT_EQ(unsigned(ERROR_INVALID_DATA), RCVersionReadBuffer(nullptr, buffer, strlen(buffer), version));
+}
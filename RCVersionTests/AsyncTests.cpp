@@ -0,0 +1,169 @@
+#include "stdafx.h"
+#include "RCAsync.h"
+#include "TestLogger.h"
+#include <atomic>
+#include <mutex>
+
+#if defined(__cpp_impl_coroutine)
+
+// Counts the resumptions and hands them to the thread pool
+class CountingExecutor : public RCThreadPoolExecutor
+{
+public:
+  std::atomic<unsigned> posts{0};
+  void Post(void (*callback)(void* context), void* context) override
+  {
+    ++posts;
+    RCThreadPoolExecutor::Post(callback, context);
+  }
+};
+
+class LockedLogger : public TestLogger
+{
+public:
+  std::mutex lock;
+  void Log(const wchar_t* message) override
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    TestLogger::Log(message);
+  }
+};
+
+class AsyncTests : public ::testing::Test
+{
+protected:
+  void TearDown() override
+  {
+    for (const auto& file : tempFiles)
+    {
+      DeleteFile(file.c_str());
+    }
+  }
+
+  std::wstring CreateTempRCFile(const std::string& content)
+  {
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rca", 0, tempFile);
+    tempFiles.push_back(tempFile);
+
+    FILE* file = _wfopen(tempFile, L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+    return tempFile;
+  }
+
+  std::string ReadText(const std::wstring& path)
+  {
+    TestLogger reader;
+    RCFileHandler handler{reader};
+    std::vector<unsigned char> buffer;
+    handler.LoadFile(path.c_str(), 2, buffer);
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  const std::string rcContent =
+    "VS_VERSION_INFO VERSIONINFO\r\n"
+    " FILEVERSION 1,2,3,4\r\n"
+    " PRODUCTVERSION 1,2,3,4\r\n"
+    "BEGIN\r\n"
+    " VALUE \"FileVersion\", \"1.2.3.4\"\r\n"
+    "END\r\n";
+
+  CountingExecutor executor;
+  LockedLogger logger;
+  std::vector<std::wstring> tempFiles;
+};
+
+TEST_F(AsyncTests, UpdateFileAsync)
+{
+  std::wstring path = CreateTempRCFile(rcContent);
+  RCAsyncContext context{executor, logger, nullptr, nullptr, 1, nullptr};
+
+  EXPECT_EQ(0u, RCSyncWait(UpdateFileAsync(context, path, path, -1, -1, 42, -1))) << logger.messages;
+  EXPECT_NE(std::string::npos, ReadText(path).find("FILEVERSION 1, 2, 42, 4"));
+
+  // Resumed after the load and after the save
+  EXPECT_EQ(2u, executor.posts.load());
+}
+
+TEST_F(AsyncTests, MissingFile)
+{
+  RCAsyncContext context{executor, logger, nullptr, nullptr, 1, nullptr};
+  EXPECT_NE(0u, RCSyncWait(UpdateFileAsync(context, L"Z:\\does\\not\\exist\\missing.rc", L"Z:\\does\\not\\exist\\missing.rc", 1, 2, 3, 4)));
+  EXPECT_EQ(0u, executor.posts.load());
+}
+
+TEST_F(AsyncTests, FileWithoutVersion)
+{
+  std::wstring path = CreateTempRCFile("no version here\r\n");
+  RCAsyncContext context{executor, logger, nullptr, nullptr, 1, nullptr};
+  EXPECT_EQ(unsigned(ERROR_FILE_CORRUPT), RCSyncWait(UpdateFileAsync(context, path, path, 1, 2, 3, 4)));
+}
+
+TEST_F(AsyncTests, ValueNames)
+{
+  std::wstring path = CreateTempRCFile(rcContent + " VALUE \"PrivateBuild\", \"1.2.3.4\"\r\n");
+  RCValueNames names{logger};
+  ASSERT_TRUE(names.Add(L"PrivateBuild"));
+  RCAsyncContext context{executor, logger, nullptr, nullptr, 1, &names};
+
+  EXPECT_EQ(0u, RCSyncWait(UpdateFileAsync(context, path, path, -1, -1, 42, -1))) << logger.messages;
+  std::string text = ReadText(path);
+  EXPECT_NE(std::string::npos, text.find("42", text.find("\"PrivateBuild\"")));
+}
+
+static RCDetachedTask StampAll(RCAsyncContext& context, const std::vector<std::wstring>& paths, std::atomic<unsigned>& failed, std::atomic<unsigned>& pending, std::mutex& lock, std::condition_variable& done)
+{
+  std::vector<RCTask<unsigned>> tasks;
+  for (const auto& path : paths)
+  {
+    tasks.push_back(UpdateFileAsync(context, path, path, -1, -1, 77, -1));
+  }
+  for (auto& task : tasks)
+  {
+    if (NO_ERROR != co_await task)
+    {
+      ++failed;
+    }
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  pending = 0;
+  done.notify_all();
+}
+
+TEST_F(AsyncTests, ManyFilesWithSharedCacheAndPool)
+{
+  std::vector<std::wstring> paths;
+  for (int n = 0; n < 50; ++n)
+  {
+    paths.push_back(CreateTempRCFile(rcContent));
+  }
+
+  RCOffsetCache cache;
+  RCBufferPool pool{64 * 1024};
+  RCAsyncContext context{executor, logger, &cache, &pool, 1, nullptr};
+  std::atomic<unsigned> failed{0};
+  std::atomic<unsigned> pending{1};
+  std::mutex lock;
+  std::condition_variable done;
+
+  StampAll(context, paths, failed, pending, lock, done);
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    ASSERT_TRUE(done.wait_for(guard, std::chrono::seconds(30), [&pending]() { return 0 == pending; }));
+  }
+
+  EXPECT_EQ(0u, failed.load()) << logger.messages;
+  for (const auto& path : paths)
+  {
+    EXPECT_NE(std::string::npos, ReadText(path).find("FILEVERSION 1, 2, 77, 4"));
+  }
+  EXPECT_EQ(0u, pool.Stats().waits);
+}
+
+#endif
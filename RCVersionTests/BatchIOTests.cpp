@@ -0,0 +1,158 @@
+#include "stdafx.h"
+#include "RCBatchIO.h"
+#include "RCFileHandler.h"
+#include "TestLogger.h"
+
+class BatchIOTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+  }
+
+  void TearDown() override
+  {
+    for (const auto& file : tempFiles)
+    {
+      DeleteFile(file.c_str());
+    }
+  }
+
+  std::wstring CreateTempRCFile(const std::string& content)
+  {
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rcb", 0, tempFile);
+    tempFiles.push_back(tempFile);
+
+    FILE* file = _wfopen(tempFile, L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+    return tempFile;
+  }
+
+  std::string ReadText(const std::wstring& path)
+  {
+    RCFileHandler reader{*logger};
+    std::vector<unsigned char> buffer;
+    reader.LoadFile(path.c_str(), 2, buffer);
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  const std::string rcContent =
+    "VS_VERSION_INFO VERSIONINFO\r\n"
+    " FILEVERSION 1,2,3,4\r\n"
+    " PRODUCTVERSION 1,2,3,4\r\n"
+    "BEGIN\r\n"
+    " VALUE \"FileVersion\", \"1.2.3.4\"\r\n"
+    "END\r\n";
+
+  const RCBatchIO::Backend backends[2] = {RCBatchIO::Automatic, RCBatchIO::Threads};
+
+  std::unique_ptr<TestLogger> logger;
+  std::vector<std::wstring> tempFiles;
+};
+
+TEST_F(BatchIOTests, LoadMatchesLoadFile)
+{
+  std::wstring path = CreateTempRCFile(rcContent);
+  for (auto backend : backends)
+  {
+    RCBufferPool pool;
+    auto batchIO = RCBatchIO::Create(*logger, pool, 4, backend);
+
+    std::vector<RCFileRequest> requests(2);
+    requests[0].path = path;
+    requests[1].path = L"Z:\\does\\not\\exist\\missing.rc";
+    batchIO->Load(requests, 100);
+
+    ASSERT_EQ(0u, requests[0].error) << batchIO->Name() << logger->messages;
+    EXPECT_EQ(rcContent.length(), requests[0].bytes);
+    EXPECT_EQ(rcContent.length() + 100, requests[0].buffer.size());
+    EXPECT_EQ(rcContent, std::string(reinterpret_cast<const char*>(requests[0].buffer.data())));
+    EXPECT_NE(0u, requests[1].error);
+    EXPECT_EQ(1u, batchIO->Stats().files);
+  }
+}
+
+TEST_F(BatchIOTests, UpdateFilesInBatches)
+{
+  for (auto backend : backends)
+  {
+    std::vector<std::wstring> paths;
+    for (int n = 0; n < 40; ++n)
+    {
+      paths.push_back(CreateTempRCFile(rcContent));
+    }
+
+    // Small enough that a batch does not fit and is split
+    RCBufferPool pool{64 * 1024};
+    auto batchIO = RCBatchIO::Create(*logger, pool, 4, backend);
+    RCFileHandler handler{*logger};
+    handler.Pool(&pool);
+    handler.BatchIO(batchIO.get());
+
+    ASSERT_TRUE(handler.UpdateFiles(paths, -1, -1, 42, -1)) << batchIO->Name() << logger->messages;
+    for (const auto& path : paths)
+    {
+      EXPECT_NE(std::string::npos, ReadText(path).find("FILEVERSION 1, 2, 42, 4"));
+    }
+
+    RCBatchIO::Statistics stats = batchIO->Stats();
+    EXPECT_EQ(40u, stats.files);
+    EXPECT_EQ(40u * rcContent.length(), stats.bytesRead);
+    EXPECT_LT(stats.bytesRead, stats.bytesWritten);
+    EXPECT_GE(64u * 1024u, pool.Stats().peakBytes);
+  }
+}
+
+TEST_F(BatchIOTests, FailedFileDoesNotStopBatch)
+{
+  std::vector<std::wstring> paths{CreateTempRCFile("no version here\r\n"), CreateTempRCFile(rcContent)};
+  RCBufferPool pool;
+  auto batchIO = RCBatchIO::Create(*logger, pool, 2, RCBatchIO::Threads);
+  RCFileHandler handler{*logger};
+  handler.Pool(&pool);
+  handler.BatchIO(batchIO.get());
+
+  EXPECT_FALSE(handler.UpdateFiles(paths, -1, -1, 7, -1));
+  EXPECT_EQ(unsigned(ERROR_FILE_CORRUPT), handler.Error());
+  EXPECT_NE(std::string::npos, ReadText(paths[1]).find("FILEVERSION 1, 2, 7, 4"));
+}
+
+TEST_F(BatchIOTests, TransactionChangesNoFileOnFailure)
+{
+  std::vector<std::wstring> paths{CreateTempRCFile(rcContent), CreateTempRCFile("no version here\r\n"), CreateTempRCFile(rcContent)};
+  RCBufferPool pool;
+  auto batchIO = RCBatchIO::Create(*logger, pool, 2, RCBatchIO::Threads);
+  RCFileHandler handler{*logger};
+  handler.Pool(&pool);
+  handler.BatchIO(batchIO.get());
+  handler.Transaction(true);
+
+  EXPECT_FALSE(handler.UpdateFiles(paths, -1, -1, 7, -1));
+  EXPECT_EQ(unsigned(ERROR_FILE_CORRUPT), handler.Error());
+  EXPECT_EQ(rcContent, ReadText(paths[0]));
+  EXPECT_EQ(rcContent, ReadText(paths[2]));
+
+  // Without the failing file all of them are committed
+  paths.erase(paths.begin() + 1);
+  ASSERT_TRUE(handler.UpdateFiles(paths, -1, -1, 7, -1)) << logger->messages;
+  for (const auto& path : paths)
+  {
+    EXPECT_NE(std::string::npos, ReadText(path).find("FILEVERSION 1, 2, 7, 4"));
+    EXPECT_EQ(INVALID_FILE_ATTRIBUTES, GetFileAttributes((path + L".rcbak").c_str()));
+  }
+}
+
+TEST_F(BatchIOTests, ForcedThreadsBackend)
+{
+  RCBufferPool pool;
+  auto batchIO = RCBatchIO::Create(*logger, pool, 2, RCBatchIO::Threads);
+  EXPECT_STREQ(L"thread pool", batchIO->Name());
+}
@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "RCBufferPool.h"
+#include "RCFileHandler.h"
+#include "TestLogger.h"
+#include <atomic>
+#include <thread>
+
+TEST(RCBufferPool, ClassSizes)
+{
+  EXPECT_EQ(4096u, RCBufferPool::ClassSize(0));
+  EXPECT_EQ(4096u, RCBufferPool::ClassSize(4096));
+  EXPECT_EQ(8192u, RCBufferPool::ClassSize(4097));
+  EXPECT_EQ(1024u * 1024u, RCBufferPool::ClassSize(1000 * 1000));
+}
+
+TEST(RCBufferPool, BuffersAreReused)
+{
+  RCBufferPool pool;
+  unsigned char* first{nullptr};
+  {
+    RCBuffer buffer = pool.Acquire(5000);
+    ASSERT_NE(nullptr, buffer.data());
+    EXPECT_EQ(5000u, buffer.size());
+    EXPECT_EQ(8192u, buffer.capacity());
+    first = buffer.data();
+  }
+
+  for (int n = 0; n < 100; ++n)
+  {
+    RCBuffer buffer = pool.Acquire(6000 + n);
+    EXPECT_EQ(first, buffer.data());
+  }
+
+  RCBufferPool::Statistics stats = pool.Stats();
+  EXPECT_EQ(1u, stats.allocations);
+  EXPECT_EQ(100u, stats.reuses);
+  EXPECT_EQ(8192u, stats.peakBytes);
+}
+
+TEST(RCBufferPool, LimitDropsCachedBuffers)
+{
+  RCBufferPool pool{64 * 1024};
+  {
+    RCBuffer large = pool.Acquire(40 * 1024);
+  }
+  RCBuffer small = pool.Acquire(30 * 1024);
+  ASSERT_NE(nullptr, small.data());
+
+  RCBufferPool::Statistics stats = pool.Stats();
+  EXPECT_EQ(32u * 1024u, stats.currentBytes);
+  EXPECT_EQ(0u, stats.waits);
+}
+
+TEST(RCBufferPool, LimitAppliesBackpressure)
+{
+  RCBufferPool pool{16 * 1024};
+  RCBuffer held = pool.Acquire(12 * 1024);
+
+  std::atomic<bool> acquired{false};
+  std::thread other([&]() {
+    RCBuffer buffer = pool.Acquire(12 * 1024);
+    acquired = true;
+  });
+
+  Sleep(50);
+  EXPECT_FALSE(acquired);
+  held.release();
+  other.join();
+  EXPECT_TRUE(acquired);
+
+  RCBufferPool::Statistics stats = pool.Stats();
+  EXPECT_LE(1u, stats.waits);
+  EXPECT_GE(16u * 1024u, stats.peakBytes);
+}
+
+TEST(RCBufferPool, OversizedRequestServedAlone)
+{
+  RCBufferPool pool{16 * 1024};
+  {
+    RCBuffer buffer = pool.Acquire(100 * 1024);
+    ASSERT_NE(nullptr, buffer.data());
+    EXPECT_EQ(100u * 1024u, buffer.size());
+  }
+  EXPECT_EQ(0u, pool.Stats().currentBytes);
+}
+
+TEST(RCBufferPool, PooledLoadMatchesVectorLoad)
+{
+  wchar_t tempDir[MAX_PATH]{};
+  GetTempPath(MAX_PATH, tempDir);
+  wchar_t tempFile[MAX_PATH]{};
+  GetTempFileName(tempDir, L"rcp", 0, tempFile);
+  const std::string content = "VS_VERSION_INFO VERSIONINFO\r\n FILEVERSION 1,2,3,4\r\n";
+  FILE* file = _wfopen(tempFile, L"wb");
+  ASSERT_NE(nullptr, file);
+  fwrite(content.c_str(), 1, content.length(), file);
+  fclose(file);
+
+  TestLogger logger;
+  RCBufferPool pool;
+  RCFileHandler handler{logger};
+  handler.Pool(&pool);
+
+  std::vector<unsigned char> vector;
+  RCBuffer buffer;
+  EXPECT_TRUE(handler.LoadFile(tempFile, 100, vector));
+  EXPECT_TRUE(handler.LoadFile(tempFile, 100, buffer));
+  ASSERT_EQ(vector.size(), buffer.size());
+  EXPECT_EQ(0, memcmp(vector.data(), buffer.data(), vector.size()));
+
+  DeleteFile(tempFile);
+}
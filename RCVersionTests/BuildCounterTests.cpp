@@ -0,0 +1,141 @@
+#include "stdafx.h"
+#include "RCBuildCounter.h"
+#include "TestLogger.h"
+#include <algorithm>
+#include <thread>
+
+class BuildCounterTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rcc", 0, tempFile);
+    path = tempFile;
+  }
+
+  void TearDown() override
+  {
+    DeleteFile(path.c_str());
+  }
+
+  void WriteText(const std::string& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring path;
+};
+
+TEST_F(BuildCounterTests, NewFileStartsAtOne)
+{
+  DeleteFile(path.c_str());
+  RCBuildCounter counter{*logger};
+  int build{};
+  ASSERT_TRUE(counter.Next(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(1, build);
+  ASSERT_TRUE(counter.Next(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(2, build);
+}
+
+TEST_F(BuildCounterTests, TextFileSeedsCounter)
+{
+  WriteText("1000 \r\n");
+  RCBuildCounter counter{*logger};
+  int build{};
+  ASSERT_TRUE(counter.Next(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(1001, build);
+  ASSERT_TRUE(counter.Next(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(1002, build);
+}
+
+TEST_F(BuildCounterTests, PeekDoesNotAdvance)
+{
+  DeleteFile(path.c_str());
+  RCBuildCounter counter{*logger};
+  int build{};
+  ASSERT_TRUE(counter.Peek(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(1, build);
+  EXPECT_EQ(INVALID_FILE_ATTRIBUTES, GetFileAttributes(path.c_str()));
+
+  WriteText("1000\r\n");
+  ASSERT_TRUE(counter.Peek(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(1001, build);
+  ASSERT_TRUE(counter.Next(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(1001, build);
+  ASSERT_TRUE(counter.Peek(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(1002, build);
+  ASSERT_TRUE(counter.Next(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(1002, build);
+}
+
+TEST_F(BuildCounterTests, OtherFilesAreNotTouched)
+{
+  WriteText("VS_VERSION_INFO VERSIONINFO\r\n");
+  RCBuildCounter counter{*logger};
+  int build{-1};
+  EXPECT_FALSE(counter.Next(path.c_str(), build));
+  EXPECT_EQ(unsigned(ERROR_INVALID_DATA), counter.Error());
+  EXPECT_EQ(-1, build);
+}
+
+TEST_F(BuildCounterTests, CounterStopsAtMaximum)
+{
+  WriteText("65534");
+  RCBuildCounter counter{*logger};
+  int build{};
+  ASSERT_TRUE(counter.Next(path.c_str(), build)) << logger->messages;
+  EXPECT_EQ(RCBuildCounter::MaxBuild, build);
+  EXPECT_FALSE(counter.Next(path.c_str(), build));
+  EXPECT_EQ(unsigned(ERROR_ARITHMETIC_OVERFLOW), counter.Error());
+}
+
+TEST_F(BuildCounterTests, ConcurrentNumbersAreUnique)
+{
+  const int threadCount = 4;
+  const int takes = 50;
+  std::vector<std::vector<int>> builds(threadCount);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      TestLogger threadLogger;
+      RCBuildCounter counter{threadLogger};
+      for (int n = 0; n < takes; ++n)
+      {
+        int build{};
+        if (counter.Next(path.c_str(), build))
+        {
+          builds[t].push_back(build);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  std::vector<int> all;
+  for (const auto& taken : builds)
+  {
+    // Each process sees increasing numbers
+    EXPECT_TRUE(std::is_sorted(taken.begin(), taken.end()));
+    all.insert(all.end(), taken.begin(), taken.end());
+  }
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(size_t(threadCount * takes), all.size());
+  for (size_t n = 0; n < all.size(); ++n)
+  {
+    EXPECT_EQ(int(n) + 1, all[n]);
+  }
+}
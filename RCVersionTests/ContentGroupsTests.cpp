@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "RCContentGroups.h"
+#include "RCCommand.h"
+#include "RCFileHandler.h"
+#include "RCVersionOptions.h"
+#include "TestLogger.h"
+
+class ContentGroupsTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    directory = std::wstring(tempDir) + L"rccontentgroups";
+    CreateDirectory(directory.c_str(), nullptr);
+  }
+
+  void TearDown() override
+  {
+    for (const auto& file : files)
+    {
+      DeleteFile(file.c_str());
+    }
+    RemoveDirectory(directory.c_str());
+  }
+
+  std::wstring WriteText(const wchar_t* name, const std::string& content)
+  {
+    std::wstring path = directory + L"\\" + name;
+    files.push_back(path);
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+    return path;
+  }
+
+  static std::string ReadText(const std::wstring& path)
+  {
+    std::string content;
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file)
+    {
+      char buffer[4096];
+      size_t bytes;
+      while (0 < (bytes = fread(buffer, 1, sizeof(buffer), file)))
+      {
+        content.append(buffer, bytes);
+      }
+      fclose(file);
+    }
+    return content;
+  }
+
+  static std::string Script(int build)
+  {
+    std::string version = "1, 0, " + std::to_string(build) + ", 0";
+    return "VS_VERSION_INFO VERSIONINFO\r\n FILEVERSION " + version + "\r\n PRODUCTVERSION " + version + "\r\n";
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring directory;
+  std::vector<std::wstring> files;
+};
+
+TEST_F(ContentGroupsTests, FindsOnlyEqualContent)
+{
+  RCContentGroups contents;
+  const unsigned char input[] = "FILEVERSION 1,2,3,4";
+  const unsigned char other[] = "FILEVERSION 1,2,3,5";
+  const unsigned char output[] = "FILEVERSION 1,2,9,4";
+  std::vector<size_t> offsets{12};
+
+  RCBuffer buffer;
+  size_t bytes{};
+  std::vector<size_t> found;
+  EXPECT_FALSE(contents.Find(input, sizeof(input) - 1, "1.2.9.4", buffer, bytes, found));
+
+  contents.Add(input, sizeof(input) - 1, "1.2.9.4", output, sizeof(output) - 1, offsets);
+  ASSERT_TRUE(contents.Find(input, sizeof(input) - 1, "1.2.9.4", buffer, bytes, found));
+  ASSERT_EQ(sizeof(output) - 1, bytes);
+  EXPECT_EQ(0, memcmp(output, buffer.data(), bytes));
+  EXPECT_EQ(0, buffer.data()[bytes]);
+  EXPECT_EQ(offsets, found);
+
+  // Same size, other bytes or other arguments
+  EXPECT_FALSE(contents.Find(other, sizeof(other) - 1, "1.2.9.4", buffer, bytes, found));
+  EXPECT_FALSE(contents.Find(input, sizeof(input) - 1, "1.2.8.4", buffer, bytes, found));
+
+  // A second update of the same content keeps the first
+  contents.Add(input, sizeof(input) - 1, "1.2.9.4", output, sizeof(output) - 1, offsets);
+  RCContentGroups::Statistics stats = contents.Stats();
+  EXPECT_EQ(1u, stats.unique);
+  EXPECT_EQ(1u, stats.copies);
+  EXPECT_EQ(sizeof(input) - 1 + sizeof(output) - 1, stats.bytes);
+
+  // Nothing kept beyond the limit
+  RCContentGroups small{16};
+  small.Add(input, sizeof(input) - 1, "1.2.9.4", output, sizeof(output) - 1, offsets);
+  EXPECT_FALSE(small.Find(input, sizeof(input) - 1, "1.2.9.4", buffer, bytes, found));
+  EXPECT_EQ(0u, small.Stats().unique);
+}
+
+TEST_F(ContentGroupsTests, CopiesUpdatedOnce)
+{
+  std::vector<std::wstring> paths{WriteText(L"first.rc", Script(176)), WriteText(L"second.rc", Script(176)), WriteText(L"other.rc", Script(175)),
+    WriteText(L"third.rc", Script(176))};
+
+  RCContentGroups contents;
+  RCFileHandler handler{*logger};
+  handler.ContentGroups(&contents);
+  ASSERT_TRUE(handler.UpdateFiles(paths, -1, -1, 177, -1)) << logger->messages;
+
+  for (const auto& path : paths)
+  {
+    EXPECT_EQ(Script(177), ReadText(path));
+  }
+  RCContentGroups::Statistics stats = contents.Stats();
+  EXPECT_EQ(2u, stats.unique);
+  EXPECT_EQ(2u, stats.copies);
+}
+
+TEST_F(ContentGroupsTests, PipelineSharesUpdates)
+{
+  for (int n = 0; n < 8; ++n)
+  {
+    WriteText((L"copy" + std::to_wstring(n) + L".rc").c_str(), Script(176));
+  }
+
+  TestLogger output{};
+  RCVersionOptions options{output};
+  const wchar_t* argv[] = {L"", L"/v:3", L"/b:1000", L"/pipeline", L"/dedup"};
+  ASSERT_TRUE(options.Parse(_countof(argv), argv));
+  options.searchDirectories.push_back(directory);
+  ASSERT_TRUE(options.Validate()) << output.messages;
+
+  RCCommand command{output};
+  EXPECT_EQ(0u, command.Execute(options)) << output.messages;
+  for (const auto& path : files)
+  {
+    EXPECT_EQ(Script(1000), ReadText(path));
+  }
+  EXPECT_NE(std::wstring::npos, output.messages.find(L"Duplicates: 1 unique contents,")) << output.messages;
+}
@@ -0,0 +1,204 @@
+#include "stdafx.h"
+#include "RCDiffWriter.h"
+#include "RCFileHandler.h"
+#include "RCCommand.h"
+#include "TestLogger.h"
+
+class DiffWriterTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    rcPath = std::wstring(tempDir) + L"rcdiff.rc";
+    diffPath = std::wstring(tempDir) + L"rcdiff.patch";
+  }
+
+  void TearDown() override
+  {
+    DeleteFile(rcPath.c_str());
+    DeleteFile(diffPath.c_str());
+  }
+
+  static void WriteText(const std::wstring& path, const std::string& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+  }
+
+  static std::string ReadText(const std::wstring& path)
+  {
+    std::string content;
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file)
+    {
+      char buffer[4096];
+      size_t bytes;
+      while (0 < (bytes = fread(buffer, 1, sizeof(buffer), file)))
+      {
+        content.append(buffer, bytes);
+      }
+      fclose(file);
+    }
+    return content;
+  }
+
+  // Updated as RCFileHandler updates a loaded file, 'offsets' those of the new text
+  std::string Update(const std::string& before, int build, std::vector<size_t>& offsets)
+  {
+    std::vector<char> buffer(before.begin(), before.end());
+    buffer.resize(before.size() + 1024);
+    RCFileHandler handler{*logger};
+    handler.Verbosity(0);
+    EXPECT_LT(0u, handler.UpdateBuffer(buffer.data(), buffer.size(), offsets, -1, -1, build, -1));
+    return buffer.data();
+  }
+
+  std::string Hunks(const std::string& before, int build)
+  {
+    std::vector<size_t> offsets;
+    std::string after = Update(before, build, offsets);
+    return RCDiffWriter::Hunks(before.data(), before.size(), after.data(), after.size(), offsets);
+  }
+
+  static const char* Script()
+  {
+    return
+      "// Version\r\n"
+      "VS_VERSION_INFO VERSIONINFO\r\n"
+      " FILEVERSION 1, 0, 176, 0\r\n"
+      " PRODUCTVERSION 1, 0, 176, 0\r\n"
+      " FILEFLAGSMASK 0x3fL\r\n"
+      "BEGIN\r\n"
+      "    BLOCK \"StringFileInfo\"\r\n"
+      "    BEGIN\r\n"
+      "        BLOCK \"040904b0\"\r\n"
+      "        BEGIN\r\n"
+      "            VALUE \"CompanyName\", \"Contoso\"\r\n"
+      "            VALUE \"FileVersion\", \"1, 0, 176, 0\"\r\n"
+      "        END\r\n"
+      "    END\r\n"
+      "END\r\n";
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring rcPath;
+  std::wstring diffPath;
+};
+
+TEST_F(DiffWriterTests, HunksAroundChangedLines)
+{
+  // Lines 3 and 4 share a hunk, line 12 is more than twice the context away
+  EXPECT_EQ(
+    "@@ -1,7 +1,7 @@\n"
+    " // Version\r\n"
+    " VS_VERSION_INFO VERSIONINFO\r\n"
+    "- FILEVERSION 1, 0, 176, 0\r\n"
+    "- PRODUCTVERSION 1, 0, 176, 0\r\n"
+    "+ FILEVERSION 1, 0, 1000, 0\r\n"
+    "+ PRODUCTVERSION 1, 0, 1000, 0\r\n"
+    "  FILEFLAGSMASK 0x3fL\r\n"
+    " BEGIN\r\n"
+    "     BLOCK \"StringFileInfo\"\r\n"
+    "@@ -9,7 +9,7 @@\n"
+    "         BLOCK \"040904b0\"\r\n"
+    "         BEGIN\r\n"
+    "             VALUE \"CompanyName\", \"Contoso\"\r\n"
+    "-            VALUE \"FileVersion\", \"1, 0, 176, 0\"\r\n"
+    "+            VALUE \"FileVersion\", \"1, 0, 1000, 0\"\r\n"
+    "         END\r\n"
+    "     END\r\n"
+    " END\r\n",
+    Hunks(Script(), 1000));
+}
+
+TEST_F(DiffWriterTests, UnchangedAndLastLines)
+{
+  // The same version again changes nothing
+  EXPECT_EQ("", Hunks(Script(), 176));
+
+  EXPECT_EQ(
+    "@@ -1,2 +1,2 @@\n"
+    " VS_VERSION_INFO VERSIONINFO\n"
+    "- FILEVERSION 1, 2, 3, 4\n"
+    "\\ No newline at end of file\n"
+    "+ FILEVERSION 1, 2, 9, 4\n"
+    "\\ No newline at end of file\n",
+    Hunks("VS_VERSION_INFO VERSIONINFO\n FILEVERSION 1, 2, 3, 4", 9));
+}
+
+TEST_F(DiffWriterTests, PatchPath)
+{
+  EXPECT_EQ("src/app/app.rc", RCDiffWriter::PatchPath(L"C:\\repo\\src\\app\\app.rc", L"C:\\Repo"));
+  EXPECT_EQ("src/app.rc", RCDiffWriter::PatchPath(L"C:\\repo\\src\\app.rc", L"C:\\repo\\"));
+  EXPECT_EQ("C:/other/app.rc", RCDiffWriter::PatchPath(L"C:\\other\\app.rc", L"C:\\repo"));
+  EXPECT_EQ("C:/repository/app.rc", RCDiffWriter::PatchPath(L"C:\\repository\\app.rc", L"C:\\repo"));
+
+  EXPECT_EQ(L"C:\\repo\\src", RCDiffWriter::CommonDirectory({L"C:\\repo\\src\\app\\app.rc", L"C:\\Repo\\src\\lib.rc"}));
+  EXPECT_EQ(L"C:\\repo", RCDiffWriter::CommonDirectory({L"C:\\repo\\src\\app.rc", L"C:\\repo\\srcs\\app.rc"}));
+  EXPECT_EQ(L"C:\\", RCDiffWriter::CommonDirectory({L"C:\\repo\\app.rc", L"C:\\other\\app.rc"}));
+  EXPECT_EQ(L"", RCDiffWriter::CommonDirectory({L"C:\\repo\\app.rc", L"D:\\repo\\app.rc"}));
+}
+
+TEST_F(DiffWriterTests, CommandWritesNoFile)
+{
+  WriteText(rcPath, Script());
+
+  TestLogger output{};
+  RCVersionOptions options{output};
+  const wchar_t* argv[] = {L"", L"/v:0", L"/b:1000", L"/diff"};
+  ASSERT_TRUE(options.Parse(_countof(argv), argv));
+  options.inputFile = rcPath;
+  options.diffFile = diffPath;
+  ASSERT_TRUE(options.Validate()) << output.messages;
+
+  RCCommand command{output};
+  EXPECT_EQ(0u, command.Execute(options)) << output.messages;
+  EXPECT_EQ(Script(), ReadText(rcPath));
+
+  std::string diff = ReadText(diffPath);
+  // The temporary directory lies outside the current one, it becomes the root
+  std::string name = RCDiffWriter::PatchPath(rcPath.c_str(), RCDiffWriter::CommonDirectory({rcPath}).c_str());
+  EXPECT_EQ(std::string::npos, name.find_first_of(":/")) << name;
+  EXPECT_EQ(0u, diff.find("diff --git a/" + name + " b/" + name + "\n--- a/" + name + "\n+++ b/" + name + "\n@@ -1,7 +1,7 @@\n")) << diff;
+  EXPECT_EQ(Hunks(Script(), 1000), diff.substr(diff.find("@@")));
+}
+
+TEST_F(DiffWriterTests, PipelineDiffsEveryFile)
+{
+  wchar_t tempDir[MAX_PATH]{};
+  GetTempPath(MAX_PATH, tempDir);
+  std::wstring directory = std::wstring(tempDir) + L"rcdifftree";
+  CreateDirectory(directory.c_str(), nullptr);
+  std::wstring first = directory + L"\\first.rc";
+  std::wstring second = directory + L"\\second.rc";
+  WriteText(first, Script());
+  WriteText(second, Script());
+
+  TestLogger output{};
+  RCVersionOptions options{output};
+  const wchar_t* argv[] = {L"", L"/v:0", L"/b:1000", L"/pipeline", L"/diff"};
+  ASSERT_TRUE(options.Parse(_countof(argv), argv));
+  options.searchDirectories.push_back(directory);
+  options.diffFile = diffPath;
+  ASSERT_TRUE(options.Validate()) << output.messages;
+
+  RCCommand command{output};
+  EXPECT_EQ(0u, command.Execute(options)) << output.messages;
+  EXPECT_EQ(Script(), ReadText(first));
+  EXPECT_EQ(Script(), ReadText(second));
+
+  std::string diff = ReadText(diffPath);
+  EXPECT_NE(std::string::npos, diff.find("--- a/first.rc\n+++ b/first.rc\n")) << diff;
+  EXPECT_NE(std::string::npos, diff.find("--- a/second.rc\n+++ b/second.rc\n")) << diff;
+
+  DeleteFile(first.c_str());
+  DeleteFile(second.c_str());
+  RemoveDirectory(directory.c_str());
+}
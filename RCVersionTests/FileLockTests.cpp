@@ -0,0 +1,155 @@
+#include "stdafx.h"
+#include "RCFileLock.h"
+#include "RCFileHandler.h"
+#include "TestLogger.h"
+#include <thread>
+
+class FileLockTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+  }
+
+  void TearDown() override
+  {
+    for (const auto& file : tempFiles)
+    {
+      DeleteFile(file.c_str());
+    }
+  }
+
+  std::wstring CreateTempRCFile(const std::string& content)
+  {
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rcl", 0, tempFile);
+    tempFiles.push_back(tempFile);
+    WriteText(tempFile, content);
+    return tempFile;
+  }
+
+  void WriteText(const std::wstring& path, const std::string& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+  }
+
+  std::string ReadText(const std::wstring& path)
+  {
+    RCFileHandler reader{*logger};
+    std::vector<unsigned char> buffer;
+    reader.LoadFile(path.c_str(), 2, buffer);
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  const std::string rcContent =
+    "VS_VERSION_INFO VERSIONINFO\r\n"
+    " FILEVERSION 1,2,3,4\r\n"
+    "BEGIN\r\n"
+    "END\r\n";
+
+  std::unique_ptr<TestLogger> logger;
+  std::vector<std::wstring> tempFiles;
+};
+
+TEST_F(FileLockTests, NameIgnoresCase)
+{
+  EXPECT_EQ(RCFileLock::Name(L"C:\\Projects\\Product\\Product.rc"), RCFileLock::Name(L"c:\\projects\\PRODUCT\\product.RC"));
+  EXPECT_NE(RCFileLock::Name(L"C:\\Projects\\Product\\Product.rc"), RCFileLock::Name(L"C:\\Projects\\Product\\Other.rc"));
+  EXPECT_EQ(0u, RCFileLock::Name(L"C:\\Product.rc").find(L"Local\\RCVersion."));
+}
+
+TEST_F(FileLockTests, HeldLockTimesOut)
+{
+  std::wstring path = CreateTempRCFile(rcContent);
+  RCFileLock held{*logger};
+  ASSERT_TRUE(held.Acquire(path.c_str())) << logger->messages;
+
+  // The mutex belongs to the thread, a second owner must be another thread
+  bool acquired{true};
+  unsigned error{};
+  std::thread([&]() {
+    TestLogger threadLogger;
+    RCFileLock other{threadLogger};
+    acquired = other.Acquire(path.c_str(), 50);
+    error = other.Error();
+  }).join();
+  EXPECT_FALSE(acquired);
+  EXPECT_EQ(unsigned(ERROR_TIMEOUT), error);
+
+  held.Release();
+  std::thread([&]() {
+    TestLogger threadLogger;
+    RCFileLock other{threadLogger};
+    acquired = other.Acquire(path.c_str(), 50);
+  }).join();
+  EXPECT_TRUE(acquired);
+}
+
+TEST_F(FileLockTests, ChangedFileIsNotReplaced)
+{
+  std::wstring path = CreateTempRCFile("old");
+  RCFileHandler reader{*logger};
+  std::vector<unsigned char> buffer;
+  ASSERT_TRUE(reader.LoadFile(path.c_str(), 2, buffer));
+  RCOutputFiles::FileState loaded{reader.LoadedSize(), reader.LoadedWriteTime()};
+
+  RCOutputFiles output{*logger};
+  std::wstring temp;
+  unsigned code{};
+  {
+    wil::unique_hfile hFile(output.Open(path.c_str(), 0, temp, code));
+    ASSERT_TRUE(hFile) << code;
+    DWORD written{};
+    WriteFile(hFile.get(), "new", 3, &written, nullptr);
+  }
+  output.Written(path, temp, 0, &loaded);
+
+  // Another process rewrites the file in the meantime
+  WriteText(path, "edited by another process");
+
+  std::vector<unsigned> codes(1, 0);
+  EXPECT_FALSE(output.Commit([&codes](size_t tag, unsigned code) { codes[tag] = code; }));
+  EXPECT_EQ(unsigned(ERROR_RETRY), codes[0]);
+  EXPECT_EQ("edited by another process", ReadText(path));
+  EXPECT_EQ(INVALID_FILE_ATTRIBUTES, GetFileAttributes(temp.c_str()));
+}
+
+TEST_F(FileLockTests, ConcurrentUpdatesAreNotLost)
+{
+  std::wstring path = CreateTempRCFile(rcContent);
+  const int threadCount = 4;
+  const int updates = 10;
+
+  std::vector<std::thread> threads;
+  std::vector<int> failures(threadCount, 0);
+  for (int t = 0; t < threadCount; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      TestLogger threadLogger;
+      RCFileHandler handler{threadLogger};
+      for (int n = 0; n < updates; ++n)
+      {
+        failures[t] += handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1) ? 0 : 1;
+      }
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  for (int t = 0; t < threadCount; ++t)
+  {
+    EXPECT_EQ(0, failures[t]);
+  }
+  // Every increment of the build number is kept
+  EXPECT_NE(std::string::npos, ReadText(path).find("FILEVERSION 1, 2, 43, 4")) << ReadText(path);
+}
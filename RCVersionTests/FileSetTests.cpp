@@ -0,0 +1,156 @@
+#include "stdafx.h"
+#include "RCFileSet.h"
+#include "TestLogger.h"
+
+class FileSetTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    fileSet = std::make_unique<RCFileSet>(*logger);
+  }
+
+  void AddFiles(RCFileSet& set, unsigned count)
+  {
+    for (unsigned n = 0; n < count; ++n)
+    {
+      wchar_t key[64]{};
+      _snwprintf_s(key, _TRUNCATE, L"src\\project%u\\project%u.rc", n, n);
+      set.Add(std::wstring(L"C:\\build\\") + key, key, 1000 + (n % 7) * 50000);
+    }
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::unique_ptr<RCFileSet> fileSet;
+};
+
+TEST_F(FileSetTests, NormalizeKey)
+{
+  EXPECT_EQ(L"src\\app\\app.rc", RCFileSet::NormalizeKey(L"  .\\Src/App//APP.rc \r"));
+  EXPECT_EQ(L"src\\app\\app.rc", RCFileSet::NormalizeKey(L"src\\.\\app\\app.rc"));
+  EXPECT_EQ(L"", RCFileSet::NormalizeKey(nullptr));
+}
+
+TEST_F(FileSetTests, KeyHashIsStable)
+{
+  // FNV-1a offset basis for an empty key
+  EXPECT_EQ(14695981039346656037ULL, RCFileSet::KeyHash(L""));
+  EXPECT_EQ(RCFileSet::KeyHash(RCFileSet::NormalizeKey(L"Src/App.rc")), RCFileSet::KeyHash(RCFileSet::NormalizeKey(L"src\\app.rc")));
+  EXPECT_NE(RCFileSet::KeyHash(L"src\\a.rc"), RCFileSet::KeyHash(L"src\\b.rc"));
+}
+
+TEST_F(FileSetTests, DuplicatesIgnored)
+{
+  fileSet->Add(L"C:\\build\\a.rc", L"a.rc", 10);
+  fileSet->Add(L"c:/BUILD/a.rc", L"a.rc", 10);
+  EXPECT_EQ(1u, fileSet->Count());
+}
+
+TEST_F(FileSetTests, ShardsAreDisjointAndComplete)
+{
+  const unsigned count = 4;
+  std::vector<std::wstring> all;
+  for (unsigned index = 1; index <= count; ++index)
+  {
+    RCFileSet shard{*logger};
+    AddFiles(shard, 200);
+    ASSERT_TRUE(shard.Shard(index, count, false));
+    EXPECT_GT(shard.Count(), 20u) << "Shard " << index << " is badly unbalanced";
+    for (const auto& path : shard.Paths())
+    {
+      all.push_back(path);
+    }
+  }
+
+  std::sort(all.begin(), all.end());
+  EXPECT_EQ(200u, all.size());
+  EXPECT_EQ(all.end(), std::adjacent_find(all.begin(), all.end()));
+}
+
+TEST_F(FileSetTests, ShardIsIndependentOfOtherFiles)
+{
+  RCFileSet small{*logger};
+  small.Add(L"C:\\build\\src\\project5\\project5.rc", L"src\\project5\\project5.rc", 1);
+  ASSERT_TRUE(small.Shard(1, 3, false));
+  bool inFirst = 1 == small.Count();
+
+  RCFileSet large{*logger};
+  AddFiles(large, 50);
+  ASSERT_TRUE(large.Shard(1, 3, false));
+  auto paths = large.Paths();
+  bool found = paths.end() != std::find(paths.begin(), paths.end(), L"C:\\build\\src\\project5\\project5.rc");
+  EXPECT_EQ(inFirst, found);
+}
+
+TEST_F(FileSetTests, ShardBySizeBalancesBytes)
+{
+  const unsigned count = 3;
+  unsigned long long minBytes = ~0ULL;
+  unsigned long long maxBytes = 0;
+  size_t total{};
+  for (unsigned index = 1; index <= count; ++index)
+  {
+    RCFileSet shard{*logger};
+    AddFiles(shard, 90);
+    shard.Add(L"C:\\build\\huge.rc", L"huge.rc", 400000);
+    ASSERT_TRUE(shard.Shard(index, count, true));
+    unsigned long long bytes{};
+    for (const auto& entry : shard.files)
+    {
+      bytes += entry.size;
+    }
+    minBytes = min(minBytes, bytes);
+    maxBytes = max(maxBytes, bytes);
+    total += shard.Count();
+  }
+
+  EXPECT_EQ(91u, total);
+  EXPECT_LT(maxBytes - minBytes, 400000ULL);
+}
+
+TEST_F(FileSetTests, InvalidShard)
+{
+  AddFiles(*fileSet, 3);
+  EXPECT_FALSE(fileSet->Shard(0, 3, false));
+  EXPECT_FALSE(fileSet->Shard(4, 3, false));
+  EXPECT_FALSE(fileSet->Shard(1, 0, false));
+  EXPECT_EQ(unsigned(ERROR_INVALID_PARAMETER), fileSet->Error());
+}
+
+TEST_F(FileSetTests, AddMissingFile)
+{
+  EXPECT_FALSE(fileSet->AddFile(L"Z:\\does\\not\\exist\\missing.rc"));
+  EXPECT_EQ(0u, fileSet->Count());
+}
+
+TEST_F(FileSetTests, DirectoryFindsRcAndAssemblyInfo)
+{
+  wchar_t tempDir[MAX_PATH]{};
+  GetTempPath(MAX_PATH, tempDir);
+  std::wstring directory = std::wstring(tempDir) + L"rcfileset.dir";
+  std::wstring properties = directory + L"\\Properties";
+  CreateDirectory(directory.c_str(), nullptr);
+  CreateDirectory(properties.c_str(), nullptr);
+  const std::wstring files[] = {directory + L"\\app.rc", directory + L"\\Program.cs", properties + L"\\AssemblyInfo.cs"};
+  for (const auto& file : files)
+  {
+    FILE* stream = _wfopen(file.c_str(), L"wb");
+    if (stream)
+    {
+      fclose(stream);
+    }
+  }
+
+  EXPECT_TRUE(fileSet->AddDirectory(directory.c_str())) << logger->messages;
+  ASSERT_EQ(2u, fileSet->Count());
+  EXPECT_EQ(L"app.rc", fileSet->files[0].key);
+  EXPECT_EQ(L"properties\\assemblyinfo.cs", fileSet->files[1].key);
+
+  for (const auto& file : files)
+  {
+    DeleteFile(file.c_str());
+  }
+  RemoveDirectory(properties.c_str());
+  RemoveDirectory(directory.c_str());
+}
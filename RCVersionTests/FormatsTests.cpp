@@ -0,0 +1,291 @@
+#include "stdafx.h"
+#include "RCFormats.h"
+#include "RCFileHandler.h"
+#include "RCResFile.h"
+#include "TestLogger.h"
+
+class FormatsTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    directory = tempDir;
+  }
+
+  void TearDown() override
+  {
+    for (const auto& file : files)
+    {
+      DeleteFile(file.c_str());
+    }
+  }
+
+  std::wstring WriteFile(const wchar_t* name, const std::vector<uint8_t>& content)
+  {
+    std::wstring path = directory + name;
+    files.push_back(path);
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.data(), 1, content.size(), file);
+      fclose(file);
+    }
+    return path;
+  }
+
+  std::vector<uint8_t> ReadFile(const std::wstring& path)
+  {
+    std::vector<uint8_t> content;
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file)
+    {
+      uint8_t buffer[4096];
+      size_t bytes;
+      while (0 < (bytes = fread(buffer, 1, sizeof(buffer), file)))
+      {
+        content.insert(content.end(), buffer, buffer + bytes);
+      }
+      fclose(file);
+    }
+    return content;
+  }
+
+  static std::vector<uint8_t> Bytes(const char* text)
+  {
+    return std::vector<uint8_t>(text, text + strlen(text));
+  }
+
+  // A .res file with one version resource, FileVersion "1.2.3.4"
+  static std::vector<uint8_t> Resources()
+  {
+    RCVersionInfo info;
+    info.root.key = u"VS_VERSION_INFO";
+    info.root.type = 0;
+    info.root.value.resize(RCVersionInfo::FixedSize);
+    RCVersionInfo::Write32(&info.root.value[0], RCVersionInfo::FixedSignature);
+    RCVersionInfo::Write32(&info.root.value[8], 0x00010002);
+    RCVersionInfo::Write32(&info.root.value[12], 0x00030004);
+
+    RCVersionInfo::Block value;
+    value.key = u"FileVersion";
+    for (char16_t c : std::u16string(u"1.2.3.4"))
+    {
+      value.value.push_back(uint8_t(c));
+      value.value.push_back(0);
+    }
+    value.value.insert(value.value.end(), {0, 0});
+    RCVersionInfo::Block table;
+    table.key = u"040904b0";
+    table.children.push_back(value);
+    RCVersionInfo::Block strings;
+    strings.key = u"StringFileInfo";
+    strings.children.push_back(table);
+    info.root.children.push_back(strings);
+
+    std::vector<uint8_t> res = RCResFile::Empty();
+    RCResFile::Append(res, RCResFile::ResourceVersion, std::u16string(), 1, 0x0030, 0x0409, info.Serialize());
+    return res;
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring directory;
+  std::vector<std::wstring> files;
+};
+
+TEST_F(FormatsTests, DetectByPathAndContent)
+{
+  const RCFormats& formats = RCFormats::Default();
+  EXPECT_STREQ(L"RC", formats.ByPath(L"C:\\src\\app.rc").Name());
+  EXPECT_STREQ(L"RC", formats.ByPath(L"C:\\src\\version.h").Name());
+  EXPECT_STREQ(L"C#", formats.ByPath(L"C:\\src\\Properties\\AssemblyInfo.cs").Name());
+  EXPECT_STREQ(L"Manifest", formats.ByPath(L"C:\\bin\\app.exe.manifest").Name());
+  EXPECT_STREQ(L"PE", formats.ByPath(L"C:\\bin\\app.DLL").Name());
+  EXPECT_TRUE(formats.ByPath(L"C:\\bin\\app.exe").Mapped());
+  EXPECT_STREQ(L"RES", formats.ByPath(L"C:\\obj\\app.res").Name());
+  EXPECT_FALSE(formats.ByPath(L"C:\\obj\\app.res").Mapped());
+
+  // The loaded bytes decide before the extension
+  std::vector<uint8_t> res = Resources();
+  EXPECT_STREQ(L"RES", formats.Detect(L"C:\\obj\\version.bin", res.data(), res.size()).Name());
+  std::vector<uint8_t> text = Bytes("VS_VERSION_INFO VERSIONINFO\r\n");
+  EXPECT_STREQ(L"RC", formats.Detect(L"C:\\obj\\version.txt", text.data(), text.size()).Name());
+  EXPECT_STREQ(L"C#", formats.Detect(L"C:\\src\\AssemblyInfo.cs", text.data(), text.size()).Name());
+}
+
+TEST_F(FormatsTests, TextFormatsFoundByContent)
+{
+  const RCFormats& formats = RCFormats::Default();
+  std::vector<uint8_t> attributes = Bytes("using System.Reflection;\r\n[assembly: AssemblyVersion(\"1.2.3.4\")]\r\n");
+  EXPECT_STREQ(L"C#", formats.Detect(L"C:\\src\\Version.inc", attributes.data(), attributes.size()).Name());
+
+  const char16_t manifest[] = u"<assembly xmlns=\"urn:schemas-microsoft-com:asm.v1\"><assemblyIdentity version=\"1.2.3.4\"/></assembly>";
+  const uint8_t* wide = reinterpret_cast<const uint8_t*>(manifest);
+  EXPECT_STREQ(L"Manifest", formats.Detect(L"C:\\bin\\app.xml", wide, sizeof(manifest) - sizeof(char16_t)).Name());
+
+  // The versions are found and written in the syntax of the content
+  std::wstring path = WriteFile(L"rcformats.inc", attributes);
+  RCFileHandler handler{*logger};
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 9, -1)) << logger->messages;
+  EXPECT_EQ(Bytes("using System.Reflection;\r\n[assembly: AssemblyVersion(\"1.2.9.4\")]\r\n"), ReadFile(path));
+}
+
+TEST_F(FormatsTests, ResourcesFoundByContent)
+{
+  std::wstring path = WriteFile(L"rcformats.bin", Resources());
+
+  RCFileHandler handler{*logger};
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 7, -1)) << logger->messages;
+
+  std::vector<uint8_t> content = ReadFile(path);
+  ASSERT_TRUE(RCResFile::IsResources(content.data(), content.size()));
+  RCVersionInfo info;
+  uint32_t headerSize = RCVersionInfo::Read32(&content[32 + 4]);
+  ASSERT_TRUE(info.Parse(&content[32 + headerSize], RCVersionInfo::Read32(&content[32])));
+  EXPECT_EQ(0x00070004u, RCVersionInfo::Read32(&info.root.value[12]));
+}
+
+TEST_F(FormatsTests, RegisteredFormat)
+{
+  // Assembly attributes in a file without the .cs extension
+  class AttributesFormat : public RCFormat
+  {
+  public:
+    const wchar_t* Name() const override { return L"Attributes"; }
+    bool MatchPath(const wchar_t* path) const override { return nullptr != wcsstr(path, L".attributes"); }
+    bool Find(RCUpdater<char>& updater, char* text, std::vector<size_t>& offsets) const override { return CSharp().Find(updater, text, offsets); }
+    bool Find(RCUpdater<wchar_t>& updater, wchar_t* text, std::vector<size_t>& offsets) const override { return CSharp().Find(updater, text, offsets); }
+    bool Dotted() const override { return true; }
+    static const RCFormat& CSharp() { return RCFormats::Default().ByPath(L"AssemblyInfo.cs"); }
+  };
+
+  RCFormats formats;
+  formats.Register(std::make_unique<AttributesFormat>());
+  std::wstring path = WriteFile(L"rcformats.attributes", Bytes("[assembly: AssemblyVersion(\"1.2.3.4\")]\r\n"));
+
+  RCFileHandler handler{*logger};
+  handler.Formats(&formats);
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 9, -1)) << logger->messages;
+  EXPECT_EQ(Bytes("[assembly: AssemblyVersion(\"1.2.9.4\")]\r\n"), ReadFile(path));
+}
+
+TEST_F(FormatsTests, ManifestVersionPatched)
+{
+  const char* before =
+    "\xEF\xBB\xBF<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<assembly xmlns=\"urn:schemas-microsoft-com:asm.v1\" manifestVersion=\"1.0\">\n"
+    "  <assemblyIdentity version=\"1.2.3.4\" name=\"Contoso.App\" type=\"win32\"/>\n"
+    "  <dependency><dependentAssembly>\n"
+    "    <assemblyIdentity type=\"win32\" name=\"Microsoft.Windows.Common-Controls\" version=\"6.0.0.0\"/>\n"
+    "  </dependentAssembly></dependency>\n"
+    "</assembly>\n";
+  std::wstring path = WriteFile(L"rcformats.exe.manifest", Bytes(before));
+
+  RCFileHandler handler{*logger};
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 5, -1)) << logger->messages;
+
+  std::string after = before;
+  after.replace(after.find("1.2.3.4"), 7, "1.2.5.4");
+  EXPECT_EQ(Bytes(after.c_str()), ReadFile(path));
+}
+
+TEST(RCFormat, FindAssemblyVersionsChar)
+{
+  char s1[] =
+    "using System.Reflection;"
+    "\r\n// [assembly: AssemblyVersion(\"1.0.*\")]"
+    "\r\n[assembly: AssemblyTitle(\"1.2.3.4\")]"
+    "\r\n[assembly: AssemblyVersion(\"1.2.3.4\")]"
+    "\r\n  [ assembly : AssemblyFileVersion ( \"5.6.7.8\" )]"
+    "\r\n[assembly: AssemblyInformationalVersionAttribute(\"9.10.11.12-beta\")]"
+    "\r\n[assembly: AssemblyFileVersion(\"1.0.*\")]"
+    "\r\n"
+    ;
+  TestLogger logger{};
+  RCUpdater<char> updater{logger};
+  std::vector<size_t> offsets;
+  EXPECT_FALSE(RCFormats::Default().ByPath(L"AssemblyInfo.rc").Find(updater, s1, offsets));
+
+  const RCFormat& format = RCFormats::Default().ByPath(L"AssemblyInfo.cs");
+  ASSERT_TRUE(format.Find(updater, s1, offsets));
+  ASSERT_EQ(3u, offsets.size());
+  EXPECT_EQ(0, strncmp("1.2.3.4\"", s1 + offsets[0], 8));
+  EXPECT_EQ(0, strncmp("5.6.7.8\"", s1 + offsets[1], 8));
+  EXPECT_EQ(0, strncmp("9.10.11.12-beta\"", s1 + offsets[2], 16));
+
+  char s2[] = "[assembly: AssemblyVersion(\"1.0.*\")]\r\n";
+  offsets.clear();
+  EXPECT_FALSE(format.Find(updater, s2, offsets));
+  EXPECT_EQ(unsigned(ERROR_FILE_CORRUPT), updater.error);
+}
+
+TEST(RCFormat, UpdateAssemblyVersionsWchar)
+{
+  wchar_t s1[256] =
+    L"[assembly: AssemblyVersion(\"1.2.3.4\")]"
+    L"\r\n[assembly: AssemblyFileVersion(\"5, 6, 7, 8\")]"
+    L"\r\n[assembly: AssemblyInformationalVersion(\"9.10.11.12-beta\")]"
+    L"\r\n"
+    ;
+  TestLogger logger{};
+  RCUpdater<wchar_t> updater{logger};
+  std::vector<size_t> offsets;
+  EXPECT_EQ(3u, RCFormats::Default().ByPath(L"AssemblyInfo.cs").Update(updater, s1, _countof(s1), offsets, -1, 3, 100, -1));
+  EXPECT_STREQ(
+    L"[assembly: AssemblyVersion(\"1.3.100.4\")]"
+    L"\r\n[assembly: AssemblyFileVersion(\"5.3.100.8\")]"
+    L"\r\n[assembly: AssemblyInformationalVersion(\"9.3.100.12-beta\")]"
+    L"\r\n",
+    s1);
+}
+
+TEST(RCFormat, FindManifestVersionsChar)
+{
+  char s1[] =
+    "<?xml version=\"1.0.0.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+    "\r\n<assembly xmlns=\"urn:schemas-microsoft-com:asm.v1\" manifestVersion=\"1.0\">"
+    "\r\n  <!-- <assemblyIdentity version=\"9.9.9.9\"/> -->"
+    "\r\n  <assemblyIdentity type=\"win32\" name=\"Contoso.App\""
+    "\r\n                    version = '1.2.3.4' processorArchitecture=\"amd64\"/>"
+    "\r\n  <dependency>"
+    "\r\n    <dependentAssembly>"
+    "\r\n      <assemblyIdentity type=\"win32\" name=\"Microsoft.Windows.Common-Controls\" version=\"6.0.0.0\"/>"
+    "\r\n    </dependentAssembly>"
+    "\r\n  </dependency>"
+    "\r\n  <asmv3:assemblyIdentity fileVersion=\"7.7.7.7\" version=\"5.6.7.8\"></asmv3:assemblyIdentity>"
+    "\r\n</assembly>"
+    "\r\n"
+    ;
+  TestLogger logger{};
+  RCUpdater<char> updater{logger};
+  const RCFormat& format = RCFormats::Default().ByPath(L"App.exe.manifest");
+  std::vector<size_t> offsets;
+  ASSERT_TRUE(format.Find(updater, s1, offsets));
+  ASSERT_EQ(2u, offsets.size());
+  EXPECT_EQ(0, strncmp("1.2.3.4'", s1 + offsets[0], 8));
+  EXPECT_EQ(0, strncmp("5.6.7.8\"", s1 + offsets[1], 8));
+
+  char s2[] = "<assembly><dependency><assemblyIdentity version=\"6.0.0.0\"/></dependency></assembly>";
+  offsets.clear();
+  EXPECT_FALSE(format.Find(updater, s2, offsets));
+}
+
+TEST(RCFormat, UpdateManifestVersionsWchar)
+{
+  wchar_t s1[256] =
+    L"<assembly manifestVersion=\"1.0\">"
+    L"\n\t<assemblyIdentity name=\"Contoso.App\" version=\"1.2.3.4\" type=\"win32\" />"
+    L"\n</assembly>"
+    ;
+  TestLogger logger{};
+  RCUpdater<wchar_t> updater{logger};
+  std::vector<size_t> offsets;
+  EXPECT_EQ(1u, RCFormats::Default().ByPath(L"App.exe.manifest").Update(updater, s1, _countof(s1), offsets, -1, -1, 10, -1));
+  EXPECT_STREQ(
+    L"<assembly manifestVersion=\"1.0\">"
+    L"\n\t<assemblyIdentity name=\"Contoso.App\" version=\"1.2.10.4\" type=\"win32\" />"
+    L"\n</assembly>",
+    s1);
+}
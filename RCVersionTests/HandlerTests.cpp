@@ -300,3 +300,46 @@ TEST(RCFileHandler, UpdateCharFileWithNoBom)
 
    EXPECT_STREQ(after, buffer) << logger.messages;
 }
+
+TEST(RCFileHandler, UpdateCSharpFile)
+{
+   char before[] =
+      "\xEF\xBB\xBF"
+      "using System.Reflection;"
+      "\r\n"
+      "\r\n// [assembly: AssemblyVersion(\"1.0.*\")]"
+      "\r\n[assembly: AssemblyVersion(\"1.2.3.4\")]"
+      "\r\n[ assembly : AssemblyFileVersion(\"5.6.7.8\")]"
+      "\r\n"
+      ;
+   char after[] =
+      "\xEF\xBB\xBF"
+      "using System.Reflection;"
+      "\r\n"
+      "\r\n// [assembly: AssemblyVersion(\"1.0.*\")]"
+      "\r\n[assembly: AssemblyVersion(\"1.2.4.4\")]"
+      "\r\n[ assembly : AssemblyFileVersion(\"5.6.8.8\")]"
+      "\r\n"
+      ;
+
+   wchar_t temp[MAX_PATH + 1]{};
+   AutoDeleteFiles adf{};
+   adf.MakeTempFileName(temp, _countof(temp));
+   wcscat_s(temp, L".cs");
+   adf.Add(temp);
+
+   FILE*ofile = _wfopen(temp, L"wb");
+   fwrite(before, 1, sizeof(before) - sizeof(before[0]), ofile);
+   fclose(ofile);
+
+   TestLogger logger{};
+   RCFileHandler handler{logger};
+   EXPECT_TRUE(handler.UpdateFile(temp, temp, -1, -1, -1, -1)) << logger.messages;
+
+   char buffer[_countof(after) + 256]{};
+   FILE*ifile = _wfopen(temp, L"rb");
+   fread(buffer, 1, sizeof(buffer), ifile);
+   fclose(ifile);
+
+   EXPECT_STREQ(after, buffer) << logger.messages;
+}
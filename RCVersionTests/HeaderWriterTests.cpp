@@ -0,0 +1,114 @@
+#include "stdafx.h"
+#include "RCHeaderWriter.h"
+#include "RCCommand.h"
+#include "TestLogger.h"
+
+class HeaderWriterTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    rcPath = std::wstring(tempDir) + L"rcheader.rc";
+    headerPath = std::wstring(tempDir) + L"rcheader.h";
+  }
+
+  void TearDown() override
+  {
+    DeleteFile(rcPath.c_str());
+    DeleteFile(headerPath.c_str());
+  }
+
+  static void WriteText(const std::wstring& path, const std::string& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+  }
+
+  static std::string ReadText(const std::wstring& path)
+  {
+    std::string content;
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file)
+    {
+      char buffer[4096];
+      size_t bytes;
+      while (0 < (bytes = fread(buffer, 1, sizeof(buffer), file)))
+      {
+        content.append(buffer, bytes);
+      }
+      fclose(file);
+    }
+    return content;
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring rcPath;
+  std::wstring headerPath;
+};
+
+TEST_F(HeaderWriterTests, MacrosAndStruct)
+{
+  std::string text = RCHeaderWriter::Text(1, 2, 345, 0);
+  EXPECT_NE(std::string::npos, text.find("#pragma once\r\n"));
+  EXPECT_NE(std::string::npos, text.find("#define VERSION_MAJOR 1\r\n"));
+  EXPECT_NE(std::string::npos, text.find("#define VERSION_MINOR 2\r\n"));
+  EXPECT_NE(std::string::npos, text.find("#define VERSION_BUILD 345\r\n"));
+  EXPECT_NE(std::string::npos, text.find("#define VERSION_REVISION 0\r\n"));
+  EXPECT_NE(std::string::npos, text.find("#define VERSION_NUMBERS 1,2,345,0\r\n"));
+  EXPECT_NE(std::string::npos, text.find("#define VERSION_STRING \"1.2.345.0\"\r\n"));
+  EXPECT_NE(std::string::npos, text.find("constexpr VersionNumbers Version{1, 2, 345, 0};\r\n"));
+}
+
+TEST_F(HeaderWriterTests, WrittenOnlyWhenChanged)
+{
+  RCHeaderWriter writer{*logger};
+  ASSERT_TRUE(writer.Write(headerPath.c_str(), 1, 2, 3, 4)) << logger->messages;
+  EXPECT_TRUE(writer.Changed());
+  EXPECT_EQ(RCHeaderWriter::Text(1, 2, 3, 4), ReadText(headerPath));
+
+  ASSERT_TRUE(writer.Write(headerPath.c_str(), 1, 2, 3, 4)) << logger->messages;
+  EXPECT_FALSE(writer.Changed());
+
+  ASSERT_TRUE(writer.Write(headerPath.c_str(), 1, 2, 4, 0)) << logger->messages;
+  EXPECT_TRUE(writer.Changed());
+  EXPECT_EQ(RCHeaderWriter::Text(1, 2, 4, 0), ReadText(headerPath));
+
+  // A header edited by hand is replaced
+  WriteText(headerPath, "#pragma once\r\n");
+  ASSERT_TRUE(writer.Write(headerPath.c_str(), 1, 2, 4, 0)) << logger->messages;
+  EXPECT_TRUE(writer.Changed());
+}
+
+TEST_F(HeaderWriterTests, CommandWritesUpdatedVersion)
+{
+  WriteText(rcPath,
+    "VS_VERSION_INFO VERSIONINFO\r\n"
+    " FILEVERSION 1,0,176,0\r\n"
+    " PRODUCTVERSION 1,0,176,0\r\n"
+    "BEGIN\r\n"
+    "END\r\n");
+
+  TestLogger output{};
+  RCVersionOptions options{output};
+  const wchar_t* argv[] = {L"", L"/v:0", L"/b:177"};
+  ASSERT_TRUE(options.Parse(_countof(argv), argv));
+  options.inputFile = rcPath;
+  options.headerFile = headerPath;
+  ASSERT_TRUE(options.Validate()) << output.messages;
+
+  RCCommand command{output};
+  EXPECT_EQ(0u, command.Execute(options)) << output.messages;
+  EXPECT_EQ(RCHeaderWriter::Text(1, 0, 177, 0), ReadText(headerPath));
+
+  // The same version again leaves the header alone
+  RCHeaderWriter writer{output};
+  ASSERT_TRUE(writer.Write(rcPath.c_str(), headerPath.c_str())) << output.messages;
+  EXPECT_FALSE(writer.Changed());
+}
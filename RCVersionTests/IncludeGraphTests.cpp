@@ -0,0 +1,175 @@
+#include "stdafx.h"
+#include "RCIncludeGraph.h"
+#include "RCCommand.h"
+#include "RCFileSet.h"
+#include "TestLogger.h"
+
+class IncludeGraphTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    directory = std::wstring(tempDir) + L"rcinclude.dir\\";
+    common = directory + L"common\\";
+    CreateDirectory(directory.c_str(), nullptr);
+    CreateDirectory(common.c_str(), nullptr);
+  }
+
+  void TearDown() override
+  {
+    for (const auto& file : files)
+    {
+      DeleteFile(file.c_str());
+    }
+    RemoveDirectory(common.c_str());
+    RemoveDirectory(directory.c_str());
+  }
+
+  std::wstring WriteText(const std::wstring& path, const std::string& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+    files.push_back(path);
+    return path;
+  }
+
+  std::string ReadText(const std::wstring& path)
+  {
+    RCFileHandler reader{*logger};
+    std::vector<unsigned char> buffer;
+    reader.LoadFile(path.c_str(), 2, buffer);
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  static std::string Version(const char* version)
+  {
+    return std::string("VS_VERSION_INFO VERSIONINFO\r\n FILEVERSION ") + version + "\r\nBEGIN\r\nEND\r\n";
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring directory;
+  std::wstring common;
+  std::vector<std::wstring> files;
+};
+
+TEST_F(IncludeGraphTests, ParseIncludes)
+{
+  std::vector<RCIncludeCache::Include> includes;
+  RCIncludeGraph::ParseIncludes(
+    L"#include \"resource.h\"\r\n"
+    L"  #  include <afxres.h>\r\n"
+    L"// #include \"commented.h\"\r\n"
+    L"#includes \"not.h\"\r\n"
+    L"#include \"unterminated.h\r\n"
+    L"    \"#include \"\"res\\\\app.rc2\"\"\\r\\n\"\r\n"
+    L"#include \"res\\version.rc2\"", includes);
+
+  ASSERT_EQ(3u, includes.size());
+  EXPECT_EQ(L"resource.h", includes[0].name);
+  EXPECT_TRUE(includes[0].quoted);
+  EXPECT_EQ(L"afxres.h", includes[1].name);
+  EXPECT_FALSE(includes[1].quoted);
+  EXPECT_EQ(L"res\\version.rc2", includes[2].name);
+}
+
+TEST_F(IncludeGraphTests, SharedIncludeResolvedOnce)
+{
+  std::wstring version = WriteText(common + L"version.rc2", Version("1,2,3,4"));
+  std::wstring a = WriteText(directory + L"a.rc", "#include \"resource.h\"\r\n#include <version.rc2>\r\n");
+  std::wstring b = WriteText(directory + L"b.rc", "#include \"common\\version.rc2\"\r\n");
+  std::wstring c = WriteText(directory + L"c.rc", Version("5,6,7,8") + "#include <windows.h>\r\n");
+  std::wstring d = WriteText(directory + L"d.rc", "#include \"missing.rc2\"\r\n");
+
+  RCIncludeGraph graph{*logger};
+  graph.Directories({common});
+  std::vector<std::wstring> paths = graph.Resolve({a, b, c, d});
+
+  // a and b get their version from the include, d has none and stays to report it
+  ASSERT_EQ(3u, paths.size()) << logger->messages;
+  EXPECT_EQ(c, paths[0]);
+  EXPECT_EQ(d, paths[1]);
+  EXPECT_EQ(RCFileSet::NormalizeKey(version.c_str()), RCFileSet::NormalizeKey(paths[2].c_str()));
+}
+
+TEST_F(IncludeGraphTests, CacheKeepsUnchangedFiles)
+{
+  WriteText(common + L"version.rc2", Version("1,2,3,4"));
+  std::wstring a = WriteText(directory + L"a.rc", "#include \"common\\version.rc2\"\r\n");
+
+  RCIncludeCache cache;
+  RCIncludeGraph graph{*logger};
+  graph.Cache(&cache);
+  EXPECT_EQ(1u, graph.Resolve({a}).size());
+  EXPECT_EQ(0u, cache.Hits());
+  EXPECT_EQ(2u, cache.Count());
+
+  EXPECT_EQ(1u, graph.Resolve({a}).size());
+  EXPECT_EQ(2u, cache.Hits());
+}
+
+TEST_F(IncludeGraphTests, IncludedVersionUpdatedOnce)
+{
+  std::wstring version = WriteText(common + L"version.rc2", Version("1,2,3,4"));
+  std::wstring list = directory + L"files.txt";
+  std::string names;
+  for (int n = 0; n < 8; ++n)
+  {
+    std::string name = "app" + std::to_string(n) + ".rc";
+    WriteText(directory + std::wstring(name.begin(), name.end()), "#include \"common\\version.rc2\"\r\n");
+    names += name + "\r\n";
+  }
+  WriteText(list, names);
+
+  TestLogger output{};
+  RCVersionOptions options{output};
+  const wchar_t* argv[] = {L"", L"/include", L"/v:0"};
+  ASSERT_TRUE(options.Parse(_countof(argv), argv));
+  options.listFiles.push_back(list);
+
+  RCCommand command{output};
+  EXPECT_EQ(0u, command.Execute(options)) << output.messages;
+  EXPECT_EQ(Version("1, 2, 4, 4"), ReadText(version));
+  EXPECT_EQ("#include \"common\\version.rc2\"\r\n", ReadText(directory + L"app0.rc"));
+}
+
+TEST_F(IncludeGraphTests, IncludeAfterByteOrderMark)
+{
+  std::vector<RCIncludeCache::Include> includes;
+  RCIncludeGraph::ParseIncludes(L"\xFEFF#include \"resource.h\"\r\n", includes);
+  ASSERT_EQ(1u, includes.size());
+  EXPECT_EQ(L"resource.h", includes[0].name);
+
+  std::wstring version = WriteText(common + L"version.rc2", Version("1,2,3,4"));
+  std::wstring a = WriteText(directory + L"a.rc", "\xEF\xBB\xBF#include \"common\\version.rc2\"\r\n");
+  RCIncludeGraph graph{*logger};
+  std::vector<std::wstring> paths = graph.Resolve({a});
+  ASSERT_EQ(1u, paths.size()) << logger->messages;
+  EXPECT_EQ(RCFileSet::NormalizeKey(version.c_str()), RCFileSet::NormalizeKey(paths[0].c_str()));
+}
+
+TEST_F(IncludeGraphTests, OutputWrittenWhenVersionIsIncluded)
+{
+  std::wstring version = WriteText(common + L"version.rc2", Version("1,2,3,4"));
+  std::wstring input = WriteText(directory + L"app.rc", "#include \"common\\version.rc2\"\r\n");
+  std::wstring output = directory + L"app.out.rc";
+  files.push_back(output);
+
+  TestLogger messages{};
+  RCVersionOptions options{messages};
+  const wchar_t* argv[] = {L"", L"/include", L"/v:0"};
+  ASSERT_TRUE(options.Parse(_countof(argv), argv));
+  options.inputFile = input;
+  options.outputFile = output;
+
+  RCCommand command{messages};
+  EXPECT_EQ(0u, command.Execute(options)) << messages.messages;
+  EXPECT_EQ(Version("1, 2, 4, 4"), ReadText(version));
+  EXPECT_EQ("#include \"common\\version.rc2\"\r\n", ReadText(output));
+}
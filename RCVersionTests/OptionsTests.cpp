@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "RCVersionOptions.h"
+#include "RCBatchIO.h"
 #include "TestLogger.h"
 
 TEST(RCVersionOptions, AllOptions1)
@@ -125,3 +126,420 @@ TEST(RCVersionOptions, MissingFileName)
    EXPECT_TRUE(vo.Parse(_countof(argv), argv));
    EXPECT_FALSE(vo.Validate());
 }
+
+TEST(RCVersionOptions, ShardOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"/d:src",
+      L"/l:files.txt",
+      L"/shard:2/5:size",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv)) << logger.messages;
+   EXPECT_TRUE(vo.Validate()) << logger.messages;
+   EXPECT_TRUE(vo.MultiFile());
+   EXPECT_EQ(2u, vo.shardIndex);
+   EXPECT_EQ(5u, vo.shardCount);
+   EXPECT_TRUE(vo.shardBySize);
+   EXPECT_EQ(1u, vo.searchDirectories.size());
+   EXPECT_EQ(1u, vo.listFiles.size());
+}
+
+TEST(RCVersionOptions, BadShardOption)
+{
+   const wchar_t* values[] = { L"/shard:0/4", L"/shard:5/4", L"/shard:1", L"/shard:1/4:count", L"/shard" };
+   for (auto value : values)
+   {
+      TestLogger logger{};
+      RCVersionOptions vo{logger};
+      const wchar_t* argv[] = { L"", L"..\\test-in.rc", value };
+      EXPECT_FALSE(vo.Parse(_countof(argv), argv)) << value;
+   }
+}
+
+TEST(RCVersionOptions, OutputFileWithMultipleFiles)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"/l:files.txt",
+      L"/o:outfile.txt",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_FALSE(vo.Validate());
+}
+
+TEST(RCVersionOptions, ServerOptions)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"/server:stop",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.Validate());
+   EXPECT_TRUE(vo.server);
+   EXPECT_TRUE(vo.serverStop);
+   EXPECT_FALSE(vo.local);
+}
+
+TEST(RCVersionOptions, ArgumentsRoundTrip)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"C:\\src\\app.rc",
+      L"/o:C:\\out\\app.rc",
+      L"/b:33",
+      L"/r:0",
+      L"/local",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.Validate());
+   EXPECT_TRUE(vo.local);
+
+   auto args = vo.Arguments();
+   std::vector<const wchar_t*> argv2{L""};
+   for (const auto& arg : args)
+   {
+      argv2.push_back(arg.c_str());
+   }
+
+   RCVersionOptions vo2{logger};
+   EXPECT_TRUE(vo2.Parse(int(argv2.size()), argv2.data()));
+   EXPECT_TRUE(vo2.Validate());
+   EXPECT_EQ(vo.inputFile, vo2.inputFile);
+   EXPECT_EQ(vo.outputFile, vo2.outputFile);
+   EXPECT_EQ(-1, vo2.majorVersion);
+   EXPECT_EQ(33, vo2.buildNumber);
+   EXPECT_EQ(0, vo2.revision);
+   EXPECT_EQ(vo.verbosity, vo2.verbosity);
+}
+
+TEST(RCVersionOptions, WatchOptions)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"app.rc",
+      L"/watch:250",
+      L"/version:version.txt",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.Validate());
+   EXPECT_TRUE(vo.watch);
+   EXPECT_EQ(250u, vo.watchDelay);
+   EXPECT_EQ(L"version.txt", vo.versionFile);
+   EXPECT_TRUE(vo.MultiFile());
+}
+
+TEST(RCVersionOptions, WatchNeedsFixedVersion)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"app.rc",
+      L"/watch",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_FALSE(vo.Validate());
+   EXPECT_EQ(500u, vo.watchDelay);
+}
+
+TEST(RCVersionOptions, MemoryOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"/d:src",
+      L"/memory:64",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.Validate());
+   EXPECT_EQ(size_t(64) * 1024 * 1024, vo.memoryLimit);
+
+   // A forwarded command line keeps the limit, the default is not written
+   std::vector<std::wstring> args = vo.Arguments();
+   EXPECT_NE(args.end(), std::find(args.begin(), args.end(), std::wstring(L"/memory:64")));
+   std::vector<const wchar_t*> forwarded{L""};
+   for (const auto& arg : args)
+   {
+      forwarded.push_back(arg.c_str());
+   }
+   RCVersionOptions server{logger};
+   EXPECT_TRUE(server.Parse(int(forwarded.size()), forwarded.data()));
+   EXPECT_EQ(vo.memoryLimit, server.memoryLimit);
+
+   RCVersionOptions defaults{logger};
+   const wchar_t* plain[] = {L"", L"/d:src"};
+   EXPECT_TRUE(defaults.Parse(_countof(plain), plain));
+   std::vector<std::wstring> plainArgs = defaults.Arguments();
+   EXPECT_EQ(plainArgs.end(), std::find_if(plainArgs.begin(), plainArgs.end(), [](const std::wstring& arg) { return 0 == arg.find(L"/memory:"); }));
+
+   const wchar_t* bad[] = {
+      L"",
+      L"/d:src",
+      L"/memory:0",
+   };
+   EXPECT_FALSE(vo.Parse(_countof(bad), bad));
+}
+
+TEST(RCVersionOptions, IoAndStatsOptions)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"/d:src",
+      L"/io:threads",
+      L"/stats",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.Validate());
+   EXPECT_EQ(int(RCBatchIO::Threads), vo.ioBackend);
+   EXPECT_TRUE(vo.stats);
+
+   const wchar_t* bad[] = {
+      L"",
+      L"/d:src",
+      L"/io:uring",
+   };
+   EXPECT_FALSE(vo.Parse(_countof(bad), bad));
+}
+
+TEST(RCVersionOptions, TransactionOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"/d:src",
+      L"/transaction",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.Validate());
+   EXPECT_TRUE(vo.transaction);
+
+   std::vector<std::wstring> args = vo.Arguments();
+   EXPECT_NE(args.end(), std::find(args.begin(), args.end(), std::wstring(L"/transaction")));
+}
+
+TEST(RCVersionOptions, BuildCounterOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"test.rc",
+      L"/b:@build.counter",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.Validate());
+   EXPECT_EQ(L"build.counter", vo.buildCounter);
+   EXPECT_EQ(-1, vo.buildNumber);
+
+   std::vector<std::wstring> args = vo.Arguments();
+   EXPECT_NE(args.end(), std::find(args.begin(), args.end(), std::wstring(L"/b:@build.counter")));
+
+   RCVersionOptions missing{logger};
+   const wchar_t* bad[] = {L"", L"test.rc", L"/b:@"};
+   EXPECT_FALSE(missing.Parse(_countof(bad), bad));
+}
+
+TEST(RCVersionOptions, ValueOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"test.rc",
+      L"/value:Assembly Version",
+      L"/value:PrivateBuild",
+      L"/value:@names.txt",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.Validate());
+   ASSERT_EQ(2u, vo.valueNames.size());
+   EXPECT_EQ(L"Assembly Version", vo.valueNames[0]);
+   EXPECT_EQ(L"PrivateBuild", vo.valueNames[1]);
+   ASSERT_EQ(1u, vo.valueFiles.size());
+   EXPECT_EQ(L"names.txt", vo.valueFiles[0]);
+
+   std::vector<std::wstring> args = vo.Arguments();
+   EXPECT_NE(args.end(), std::find(args.begin(), args.end(), std::wstring(L"/value:Assembly Version")));
+   EXPECT_NE(args.end(), std::find(args.begin(), args.end(), std::wstring(L"/value:@names.txt")));
+
+   RCVersionOptions missing{logger};
+   const wchar_t* bad[] = {L"", L"test.rc", L"/value:@"};
+   EXPECT_FALSE(missing.Parse(_countof(bad), bad));
+}
+
+TEST(RCVersionOptions, IncludeOptions)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {L"", L"test.rc", L"/include"};
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.includes);
+   EXPECT_TRUE(vo.includeDirectories.empty());
+
+   RCVersionOptions dirs{logger};
+   const wchar_t* argv2[] = {L"", L"test.rc", L"/i:shared", L"/i:sdk"};
+   EXPECT_TRUE(dirs.Parse(_countof(argv2), argv2));
+   EXPECT_TRUE(dirs.includes);
+   ASSERT_EQ(2u, dirs.includeDirectories.size());
+   EXPECT_EQ(L"shared", dirs.includeDirectories[0]);
+
+   std::vector<std::wstring> args = dirs.Arguments();
+   EXPECT_NE(args.end(), std::find(args.begin(), args.end(), std::wstring(L"/include")));
+   EXPECT_NE(args.end(), std::find(args.begin(), args.end(), std::wstring(L"/i:sdk")));
+}
+
+TEST(RCVersionOptions, ResOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {L"", L"test.rc", L"/res:version.res"};
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_EQ(L"version.res", vo.resFile);
+
+   RCVersionOptions many{logger};
+   const wchar_t* argv2[] = {L"", L"/d:projects", L"/res:version.res"};
+   EXPECT_TRUE(many.Parse(_countof(argv2), argv2));
+   EXPECT_FALSE(many.Validate());
+}
+
+TEST(RCVersionOptions, HeaderOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {L"", L"test.rc", L"/header:version.h"};
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_EQ(L"version.h", vo.headerFile);
+
+   RCVersionOptions many{logger};
+   const wchar_t* argv2[] = {L"", L"/d:projects", L"/header:version.h"};
+   EXPECT_TRUE(many.Parse(_countof(argv2), argv2));
+   EXPECT_FALSE(many.Validate());
+}
+
+TEST(RCVersionOptions, CacheOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {L"", L"/d:projects", L"/cache:outputs"};
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_EQ(L"outputs", vo.cacheDirectory);
+   EXPECT_TRUE(vo.Validate());
+
+   RCVersionOptions empty{logger};
+   const wchar_t* argv2[] = {L"", L"test.rc", L"/cache:"};
+   EXPECT_FALSE(empty.Parse(_countof(argv2), argv2));
+}
+
+TEST(RCVersionOptions, DedupOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {L"", L"/d:projects", L"/dedup"};
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.dedup);
+   EXPECT_TRUE(vo.Validate());
+   std::vector<std::wstring> args = vo.Arguments();
+   EXPECT_NE(args.end(), std::find(args.begin(), args.end(), L"/dedup"));
+
+   RCVersionOptions value{logger};
+   const wchar_t* argv2[] = {L"", L"test.rc", L"/dedup:yes"};
+   EXPECT_FALSE(value.Parse(_countof(argv2), argv2));
+}
+
+TEST(RCVersionOptions, DiffOption)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {L"", L"/d:projects", L"/diff"};
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.diff);
+   EXPECT_TRUE(vo.diffFile.empty());
+   EXPECT_TRUE(vo.Validate());
+
+   RCVersionOptions file{logger};
+   const wchar_t* argv2[] = {L"", L"test.rc", L"/diff:version.patch", L"/o:other.rc"};
+   EXPECT_TRUE(file.Parse(_countof(argv2), argv2));
+   EXPECT_EQ(L"version.patch", file.diffFile);
+   EXPECT_FALSE(file.Validate());
+
+   RCVersionOptions res{logger};
+   const wchar_t* argv3[] = {L"", L"test.rc", L"/diff", L"/res:version.res"};
+   EXPECT_TRUE(res.Parse(_countof(argv3), argv3));
+   EXPECT_FALSE(res.Validate());
+}
+
+TEST(RCVersionOptions, PipelineOptions)
+{
+   TestLogger logger{};
+   RCVersionOptions vo{logger};
+
+   const wchar_t* argv[] = {
+      L"",
+      L"/d:src",
+      L"/pipeline:2,,8",
+   };
+
+   EXPECT_TRUE(vo.Parse(_countof(argv), argv));
+   EXPECT_TRUE(vo.Validate());
+   EXPECT_TRUE(vo.pipeline);
+   EXPECT_EQ(2u, vo.pipelineWorkers[0]);
+   EXPECT_EQ(0u, vo.pipelineWorkers[1]);
+   EXPECT_EQ(8u, vo.pipelineWorkers[2]);
+
+   auto args = vo.Arguments();
+   EXPECT_NE(args.end(), std::find(args.begin(), args.end(), std::wstring(L"/pipeline:2,,8")));
+
+   RCVersionOptions plain{logger};
+   const wchar_t* defaults[] = {L"", L"/d:src", L"/pipeline"};
+   EXPECT_TRUE(plain.Parse(_countof(defaults), defaults));
+   EXPECT_TRUE(plain.pipeline);
+   EXPECT_EQ(0u, plain.pipelineWorkers[0]);
+
+   const wchar_t* bad[] = {L"", L"/d:src", L"/pipeline:1,2,3,4"};
+   EXPECT_FALSE(vo.Parse(_countof(bad), bad));
+   const wchar_t* zero[] = {L"", L"/d:src", L"/pipeline:0"};
+   EXPECT_FALSE(vo.Parse(_countof(zero), zero));
+}
@@ -0,0 +1,139 @@
+#include "stdafx.h"
+#include "RCOutputCache.h"
+#include "RCFileHandler.h"
+#include "TestLogger.h"
+
+class OutputCacheTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    directory = std::wstring(tempDir) + L"rcoutputcache";
+    rcPath = std::wstring(tempDir) + L"rcoutputcache.rc";
+  }
+
+  void TearDown() override
+  {
+    DeleteFile(rcPath.c_str());
+    for (const auto& entry : Entries())
+    {
+      DeleteFile((directory + L"\\" + entry).c_str());
+    }
+    RemoveDirectory(directory.c_str());
+  }
+
+  std::vector<std::wstring> Entries() const
+  {
+    std::vector<std::wstring> entries;
+    WIN32_FIND_DATA data{};
+    HANDLE hFind = FindFirstFile((directory + L"\\*").c_str(), &data);
+    if (INVALID_HANDLE_VALUE != hFind)
+    {
+      do
+      {
+        if (!(FILE_ATTRIBUTE_DIRECTORY & data.dwFileAttributes))
+        {
+          entries.push_back(data.cFileName);
+        }
+      } while (FindNextFile(hFind, &data));
+      FindClose(hFind);
+    }
+    return entries;
+  }
+
+  static void WriteText(const std::wstring& path, const std::string& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+  }
+
+  static std::string ReadText(const std::wstring& path)
+  {
+    std::string content;
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file)
+    {
+      char buffer[4096];
+      size_t bytes;
+      while (0 < (bytes = fread(buffer, 1, sizeof(buffer), file)))
+      {
+        content.append(buffer, bytes);
+      }
+      fclose(file);
+    }
+    return content;
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring directory;
+  std::wstring rcPath;
+};
+
+TEST_F(OutputCacheTests, KeysAndEntries)
+{
+  RCOutputCache outputs{*logger};
+  ASSERT_TRUE(outputs.Open(directory.c_str())) << logger->messages;
+
+  const unsigned char data[] = "FILEVERSION 1,2,3,4";
+  std::wstring key = outputs.Key(data, sizeof(data) - 1, "1.2.-1.4");
+  ASSERT_EQ(64u, key.size());
+  EXPECT_EQ(std::wstring::npos, key.find_first_not_of(L"0123456789abcdef"));
+  EXPECT_EQ(key, outputs.Key(data, sizeof(data) - 1, "1.2.-1.4"));
+  EXPECT_NE(key, outputs.Key(data, sizeof(data) - 1, "1.2.-1.5"));
+  EXPECT_NE(key, outputs.Key(data, sizeof(data) - 2, "1.2.-1.4"));
+
+  RCBuffer buffer;
+  size_t bytes{};
+  EXPECT_FALSE(outputs.Find(key, buffer, bytes));
+
+  const unsigned char updated[] = "FILEVERSION 1,2,4,4";
+  outputs.Store(key, updated, sizeof(updated) - 1);
+  ASSERT_TRUE(outputs.Find(key, buffer, bytes)) << logger->messages;
+  ASSERT_EQ(sizeof(updated) - 1, bytes);
+  EXPECT_EQ(0, memcmp(updated, buffer.data(), bytes));
+
+  RCOutputCache::Statistics stats = outputs.Stats();
+  EXPECT_EQ(2u, stats.lookups);
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.stores);
+}
+
+TEST_F(OutputCacheTests, SecondRunTakesStoredOutput)
+{
+  const std::string before = "VS_VERSION_INFO VERSIONINFO\r\n FILEVERSION 1, 0, 176, 0\r\n PRODUCTVERSION 1, 0, 176, 0\r\n";
+  const std::string after = "VS_VERSION_INFO VERSIONINFO\r\n FILEVERSION 1, 0, 177, 0\r\n PRODUCTVERSION 1, 0, 177, 0\r\n";
+  WriteText(rcPath, before);
+
+  RCOutputCache outputs{*logger};
+  ASSERT_TRUE(outputs.Open(directory.c_str())) << logger->messages;
+  RCFileHandler handler{*logger};
+  handler.OutputCache(&outputs);
+  ASSERT_TRUE(handler.UpdateFile(rcPath.c_str(), rcPath.c_str(), -1, -1, 177, -1)) << logger->messages;
+  EXPECT_EQ(after, ReadText(rcPath));
+
+  std::vector<std::wstring> entries = Entries();
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ(0u, outputs.Stats().hits);
+  EXPECT_EQ(1u, outputs.Stats().stores);
+
+  // Another tree with the same content: the entry is written without parsing
+  WriteText(directory + L"\\" + entries[0], "from the cache\r\n");
+  WriteText(rcPath, before);
+  ASSERT_TRUE(handler.UpdateFile(rcPath.c_str(), rcPath.c_str(), -1, -1, 177, -1)) << logger->messages;
+  EXPECT_EQ("from the cache\r\n", ReadText(rcPath));
+  EXPECT_EQ(1u, outputs.Stats().hits);
+
+  // Other arguments miss
+  WriteText(rcPath, before);
+  ASSERT_TRUE(handler.UpdateFile(rcPath.c_str(), rcPath.c_str(), -1, -1, 178, -1)) << logger->messages;
+  EXPECT_NE(std::string::npos, ReadText(rcPath).find("1, 0, 178, 0"));
+  EXPECT_EQ(1u, outputs.Stats().hits);
+  EXPECT_EQ(2u, Entries().size());
+}
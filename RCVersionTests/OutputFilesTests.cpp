@@ -0,0 +1,212 @@
+#include "stdafx.h"
+#include "RCOutputFiles.h"
+#include "RCFileHandler.h"
+#include "TestLogger.h"
+
+class OutputFilesTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    GetTempPath(MAX_PATH, tempDir);
+  }
+
+  void TearDown() override
+  {
+    for (const auto& file : tempFiles)
+    {
+      DeleteFile(file.c_str());
+    }
+  }
+
+  std::wstring CreateTempFile(const std::string& content)
+  {
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rco", 0, tempFile);
+    tempFiles.push_back(tempFile);
+    WriteText(tempFile, content);
+    return tempFile;
+  }
+
+  void WriteText(const std::wstring& path, const std::string& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+  }
+
+  std::string ReadText(const std::wstring& path)
+  {
+    RCFileHandler reader{*logger};
+    std::vector<unsigned char> buffer;
+    reader.LoadFile(path.c_str(), 2, buffer);
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  bool Exists(const std::wstring& path)
+  {
+    return INVALID_FILE_ATTRIBUTES != GetFileAttributes(path.c_str());
+  }
+
+  std::wstring Write(RCOutputFiles& output, const std::wstring& path, const std::string& content)
+  {
+    std::wstring temp;
+    unsigned code{};
+    wil::unique_hfile hFile(output.Open(path.c_str(), 0, temp, code));
+    EXPECT_TRUE(hFile) << code;
+    DWORD written{};
+    EXPECT_TRUE(WriteFile(hFile.get(), content.c_str(), DWORD(content.size()), &written, nullptr));
+    return temp;
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  wchar_t tempDir[MAX_PATH]{};
+  std::vector<std::wstring> tempFiles;
+};
+
+TEST_F(OutputFilesTests, CommitReplacesAllFiles)
+{
+  std::vector<std::wstring> paths{CreateTempFile("old 0"), CreateTempFile("old 1"), CreateTempFile("old 2")};
+  RCOutputFiles output{*logger};
+
+  std::vector<std::wstring> temps;
+  for (size_t n = 0; n < paths.size(); ++n)
+  {
+    temps.push_back(Write(output, paths[n], "new " + std::to_string(n)));
+    EXPECT_TRUE(Exists(temps.back()));
+    output.Written(paths[n], temps.back(), n);
+  }
+
+  // Nothing is replaced before the commit
+  EXPECT_EQ("old 1", ReadText(paths[1]));
+
+  std::vector<unsigned> codes(paths.size(), 1);
+  ASSERT_TRUE(output.Commit([&codes](size_t tag, unsigned code) { codes[tag] = code; })) << logger->messages;
+  for (size_t n = 0; n < paths.size(); ++n)
+  {
+    EXPECT_EQ(0u, codes[n]);
+    EXPECT_EQ("new " + std::to_string(n), ReadText(paths[n]));
+    EXPECT_FALSE(Exists(temps[n]));
+  }
+  EXPECT_EQ(3u, output.Stats().files);
+  // The volume is flushed once when the process may do that
+  EXPECT_TRUE(3u == output.Stats().fileFlushes || 1u == output.Stats().volumeFlushes);
+}
+
+TEST_F(OutputFilesTests, UncommittedFilesAreDiscarded)
+{
+  std::wstring path = CreateTempFile("old");
+  std::wstring temp;
+  {
+    RCOutputFiles output{*logger};
+    temp = Write(output, path, "new");
+    output.Written(path, temp, 0);
+  }
+  EXPECT_EQ("old", ReadText(path));
+  EXPECT_FALSE(Exists(temp));
+}
+
+TEST_F(OutputFilesTests, FailedReplaceKeepsOthers)
+{
+  std::wstring good = CreateTempFile("old");
+  std::wstring directory = std::wstring(tempDir) + L"rcoutput.dir";
+  CreateDirectory(directory.c_str(), nullptr);
+
+  RCOutputFiles output{*logger};
+  std::wstring badTemp = Write(output, directory, "new");
+  output.Written(directory, badTemp, 0);
+  output.Written(good, Write(output, good, "new"), 1);
+
+  std::vector<unsigned> codes(2, 0);
+  EXPECT_FALSE(output.Commit([&codes](size_t tag, unsigned code) { codes[tag] = code; }));
+  RemoveDirectory(directory.c_str());
+
+  EXPECT_NE(0u, codes[0]);
+  EXPECT_EQ(codes[0], output.Error());
+  EXPECT_EQ(0u, codes[1]);
+  EXPECT_EQ("new", ReadText(good));
+  EXPECT_FALSE(Exists(badTemp));
+}
+
+TEST_F(OutputFilesTests, TransactionCommitsAllFiles)
+{
+  std::wstring existing = CreateTempFile("old");
+  std::wstring created = std::wstring(tempDir) + L"rcoutput.new";
+  tempFiles.push_back(created);
+  DeleteFile(created.c_str());
+
+  RCOutputFiles output{*logger};
+  output.Transaction(true);
+  output.Written(existing, Write(output, existing, "new"), 0);
+  output.Written(created, Write(output, created, "created"), 1);
+
+  ASSERT_TRUE(output.Commit()) << logger->messages;
+  EXPECT_EQ("new", ReadText(existing));
+  EXPECT_EQ("created", ReadText(created));
+  EXPECT_FALSE(Exists(existing + L".rcbak"));
+  EXPECT_FALSE(Exists(created + L".rcbak"));
+}
+
+TEST_F(OutputFilesTests, TransactionFailureChangesNoFile)
+{
+  std::wstring first = CreateTempFile("old 0");
+  std::wstring second = CreateTempFile("old 1");
+
+  // A link left by an interrupted transaction is not overwritten
+  std::wstring stale = second + L".rcbak";
+  tempFiles.push_back(stale);
+  WriteText(stale, "older");
+
+  RCOutputFiles output{*logger};
+  output.Transaction(true);
+  std::vector<std::wstring> temps{Write(output, first, "new 0"), Write(output, second, "new 1")};
+  output.Written(first, temps[0], 0);
+  output.Written(second, temps[1], 1);
+
+  std::vector<unsigned> codes(2, 0);
+  EXPECT_FALSE(output.Commit([&codes](size_t tag, unsigned code) { codes[tag] = code; }));
+  EXPECT_EQ(unsigned(ERROR_CANCELLED), codes[0]);
+  EXPECT_NE(0u, codes[1]);
+  EXPECT_EQ(codes[1], output.Error());
+
+  EXPECT_EQ("old 0", ReadText(first));
+  EXPECT_EQ("old 1", ReadText(second));
+  EXPECT_EQ("older", ReadText(stale));
+  EXPECT_FALSE(Exists(first + L".rcbak"));
+  EXPECT_FALSE(Exists(temps[0]));
+  EXPECT_FALSE(Exists(temps[1]));
+}
+
+TEST_F(OutputFilesTests, AbortDiscardsWrittenFiles)
+{
+  std::wstring path = CreateTempFile("old");
+  RCOutputFiles output{*logger};
+  std::wstring temp = Write(output, path, "new");
+  output.Written(path, temp, 0);
+
+  output.Abort();
+  EXPECT_FALSE(Exists(temp));
+  EXPECT_TRUE(output.Commit());
+  EXPECT_EQ("old", ReadText(path));
+}
+
+TEST_F(OutputFilesTests, SaveFileLeavesNoTemporaryFile)
+{
+  std::wstring path = CreateTempFile("old");
+  RCFileHandler handler{*logger};
+  char text[] = "new content";
+  ASSERT_TRUE(handler.SaveFile(path.c_str(), text, strlen(text))) << logger->messages;
+  EXPECT_EQ("new content", ReadText(path));
+
+  WIN32_FIND_DATA data{};
+  HANDLE hFind = FindFirstFile((std::wstring(tempDir) + L"rcv*.tmp").c_str(), &data);
+  EXPECT_EQ(INVALID_HANDLE_VALUE, hFind) << data.cFileName;
+  if (INVALID_HANDLE_VALUE != hFind)
+  {
+    FindClose(hFind);
+  }
+}
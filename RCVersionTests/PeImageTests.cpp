@@ -0,0 +1,368 @@
+#include "stdafx.h"
+#include "RCPeImage.h"
+#include "RCFileHandler.h"
+#include "RCPipeline.h"
+#include "TestLogger.h"
+
+class PeImageTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    path = std::wstring(tempDir) + L"rcpe.dll";
+  }
+
+  void TearDown() override
+  {
+    DeleteFile(path.c_str());
+  }
+
+  static void Append16(std::vector<uint8_t>& bytes, const char16_t* text)
+  {
+    for (; *text; ++text)
+    {
+      bytes.push_back(uint8_t(*text));
+      bytes.push_back(uint8_t(*text >> 8));
+    }
+    bytes.push_back(0);
+    bytes.push_back(0);
+  }
+
+  static RCVersionInfo::Block Text(const char16_t* key, const char16_t* value)
+  {
+    RCVersionInfo::Block block;
+    block.key = key;
+    Append16(block.value, value);
+    return block;
+  }
+
+  static RCVersionInfo Version(const char16_t* fileVersion, const char16_t* productVersion)
+  {
+    RCVersionInfo info;
+    info.root.key = u"VS_VERSION_INFO";
+    info.root.type = 0;
+    info.root.value.resize(RCVersionInfo::FixedSize);
+    RCVersionInfo::Write32(&info.root.value[0], RCVersionInfo::FixedSignature);
+    RCVersionInfo::Write32(&info.root.value[8], 0x00010002);
+    RCVersionInfo::Write32(&info.root.value[12], 0x00030004);
+    RCVersionInfo::Write32(&info.root.value[16], 0x00010002);
+    RCVersionInfo::Write32(&info.root.value[20], 0x00030004);
+
+    RCVersionInfo::Block table;
+    table.key = u"040904b0";
+    table.children.push_back(Text(u"CompanyName", u"Contoso"));
+    table.children.push_back(Text(u"FileVersion", fileVersion));
+    table.children.push_back(Text(u"ProductVersion", productVersion));
+    RCVersionInfo::Block strings;
+    strings.key = u"StringFileInfo";
+    strings.children.push_back(table);
+    info.root.children.push_back(strings);
+
+    RCVersionInfo::Block translation;
+    translation.key = u"Translation";
+    translation.type = 0;
+    translation.value = {0x09, 0x04, 0xb0, 0x04};
+    RCVersionInfo::Block vars;
+    vars.key = u"VarFileInfo";
+    vars.children.push_back(translation);
+    info.root.children.push_back(vars);
+    return info;
+  }
+
+  // ---------------------------------------------------------------------------
+  // The smallest PE32 image with one .rsrc section at RVA 0x1000 holding one
+  // RT_VERSION resource at RVA 0x1058, 'slack' bytes of padding after it
+  // ---------------------------------------------------------------------------
+  static std::vector<uint8_t> Image(const std::vector<uint8_t>& resource, size_t slack, uint32_t checksum)
+  {
+    const size_t rsrc = 0x200;
+    uint32_t sectionSize = uint32_t(0x58 + resource.size() + slack);
+    std::vector<uint8_t> image(rsrc + ((sectionSize + 0x1FF) & ~0x1FFu));
+    uint8_t* p = image.data();
+    p[0] = 'M';
+    p[1] = 'Z';
+    RCVersionInfo::Write32(p + 0x3C, 0x40);
+    memcpy(p + 0x40, "PE\0\0", 4);
+    RCVersionInfo::Write16(p + 0x44, 0x14C);
+    RCVersionInfo::Write16(p + 0x46, 1);
+    RCVersionInfo::Write16(p + 0x54, 0xE0);
+    uint8_t* optional = p + 0x58;
+    RCVersionInfo::Write16(optional, 0x10B);
+    RCVersionInfo::Write32(optional + 64, checksum);
+    RCVersionInfo::Write32(optional + 92, 16);
+    RCVersionInfo::Write32(optional + 96 + 2 * 8, 0x1000);
+    RCVersionInfo::Write32(optional + 96 + 2 * 8 + 4, sectionSize);
+
+    uint8_t* section = optional + 0xE0;
+    memcpy(section, ".rsrc", 5);
+    RCVersionInfo::Write32(section + 8, sectionSize);
+    RCVersionInfo::Write32(section + 12, 0x1000);
+    RCVersionInfo::Write32(section + 16, uint32_t(image.size() - rsrc));
+    RCVersionInfo::Write32(section + 20, rsrc);
+
+    // Type, name and language directories with one id entry each
+    uint8_t* tree = p + rsrc;
+    const uint32_t targets[] = {0x80000018, 0x80000030, 0x48};
+    const uint32_t ids[] = {16, 1, 0x409};
+    for (int level = 0; level < 3; ++level)
+    {
+      RCVersionInfo::Write16(tree + 0x18 * level + 14, 1);
+      RCVersionInfo::Write32(tree + 0x18 * level + 16, ids[level]);
+      RCVersionInfo::Write32(tree + 0x18 * level + 20, targets[level]);
+    }
+    RCVersionInfo::Write32(tree + 0x48, 0x1058);
+    RCVersionInfo::Write32(tree + 0x4C, uint32_t(resource.size()));
+    memcpy(tree + 0x58, resource.data(), resource.size());
+    return image;
+  }
+
+  void WriteImage(const std::vector<uint8_t>& image)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(image.data(), 1, image.size(), file);
+      fclose(file);
+    }
+  }
+
+  std::vector<uint8_t> ReadImage()
+  {
+    std::vector<uint8_t> image;
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file)
+    {
+      uint8_t buffer[4096];
+      size_t bytes;
+      while (0 < (bytes = fread(buffer, 1, sizeof(buffer), file)))
+      {
+        image.insert(image.end(), buffer, buffer + bytes);
+      }
+      fclose(file);
+    }
+    return image;
+  }
+
+  // The version resource of an image made by Image()
+  static bool Resource(const std::vector<uint8_t>& image, RCVersionInfo& info)
+  {
+    return info.Parse(image.data() + 0x258, RCVersionInfo::Read32(image.data() + 0x24C));
+  }
+
+  static std::u16string Value(const RCVersionInfo& info, size_t index)
+  {
+    const std::vector<uint8_t>& value = info.root.children[0].children[0].children[index].value;
+    std::u16string text;
+    for (size_t n = 0; n + 1 < value.size() && (value[n] || value[n + 1]); n += 2)
+    {
+      text += char16_t(RCVersionInfo::Read16(&value[n]));
+    }
+    return text;
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring path;
+};
+
+TEST_F(PeImageTests, VersionInfoLayout)
+{
+  // Header and "FileVersion" end at 30, the value starts at 32 and has four characters
+  RCVersionInfo single;
+  single.root = Text(u"FileVersion", u"1.0");
+  std::vector<uint8_t> bytes = single.Serialize();
+  ASSERT_EQ(40u, bytes.size());
+  EXPECT_EQ(40u, RCVersionInfo::Read16(&bytes[0]));
+  EXPECT_EQ(4u, RCVersionInfo::Read16(&bytes[2]));
+  EXPECT_EQ(1u, RCVersionInfo::Read16(&bytes[4]));
+  EXPECT_EQ(u'1', RCVersionInfo::Read16(&bytes[32]));
+
+  std::vector<uint8_t> resource = Version(u"1.2.3.4", u"1, 2, 3, 4").Serialize();
+  RCVersionInfo parsed;
+  ASSERT_TRUE(parsed.Parse(resource.data(), resource.size()));
+  EXPECT_EQ(resource, parsed.Serialize());
+  EXPECT_EQ(u"Translation", parsed.root.children[1].children[0].key);
+}
+
+TEST_F(PeImageTests, UpdateFixedAndStringVersions)
+{
+  std::vector<uint8_t> resource = Version(u"1.2.3.4", u"1, 2, 3, 4 beta").Serialize();
+  WriteImage(Image(resource, 0, 0x1234));
+
+  RCFileHandler handler{*logger};
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1)) << logger->messages;
+
+  std::vector<uint8_t> image = ReadImage();
+  RCVersionInfo info;
+  ASSERT_TRUE(Resource(image, info));
+  EXPECT_EQ(0x00010002u, RCVersionInfo::Read32(&info.root.value[8]));
+  EXPECT_EQ(0x00040004u, RCVersionInfo::Read32(&info.root.value[12]));
+  EXPECT_EQ(0x00040004u, RCVersionInfo::Read32(&info.root.value[20]));
+  EXPECT_EQ(u"Contoso", Value(info, 0));
+  EXPECT_EQ(u"1.2.4.4", Value(info, 1));
+  EXPECT_EQ(u"1, 2, 4, 4 beta", Value(info, 2));
+
+  size_t checksumOffset = 0x58 + 64;
+  EXPECT_EQ(RCPeImage::CheckSum(image.data(), image.size(), checksumOffset), RCVersionInfo::Read32(&image[checksumOffset]));
+}
+
+TEST_F(PeImageTests, StringKeepsItsSeparators)
+{
+  WriteImage(Image(Version(u"1.2.3.4", u"1,2,3,4").Serialize(), 0, 0));
+
+  RCFileHandler handler{*logger};
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 5, -1)) << logger->messages;
+
+  RCVersionInfo info;
+  ASSERT_TRUE(Resource(ReadImage(), info));
+  EXPECT_EQ(u"1.2.5.4", Value(info, 1));
+  EXPECT_EQ(u"1,2,5,4", Value(info, 2));
+}
+
+TEST_F(PeImageTests, GrowsIntoPadding)
+{
+  std::vector<uint8_t> resource = Version(u"1.2.9.4", u"1.2.9.4").Serialize();
+  WriteImage(Image(resource, 16, 0));
+
+  RCFileHandler handler{*logger};
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1)) << logger->messages;
+
+  std::vector<uint8_t> image = ReadImage();
+  RCVersionInfo info;
+  ASSERT_TRUE(Resource(image, info));
+  EXPECT_EQ(u"1.2.10.4", Value(info, 1));
+  EXPECT_EQ(Version(u"1.2.10.4", u"1.2.10.4").Serialize().size(), RCVersionInfo::Read32(&image[0x24C]));
+  // No checksum before, none after
+  EXPECT_EQ(0u, RCVersionInfo::Read32(&image[0x58 + 64]));
+}
+
+TEST_F(PeImageTests, NoRoomLeavesFileUnchanged)
+{
+  std::vector<uint8_t> original = Image(Version(u"1.2.9.4", u"1.2.9.4").Serialize(), 0, 0);
+  WriteImage(original);
+
+  RCFileHandler handler{*logger};
+  EXPECT_FALSE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1));
+  EXPECT_EQ(unsigned(ERROR_INSUFFICIENT_BUFFER), handler.Error());
+  EXPECT_EQ(original, ReadImage());
+}
+
+TEST_F(PeImageTests, NoRoomLeavesNoCopy)
+{
+  std::vector<uint8_t> original = Image(Version(u"1.2.9.4", u"1.2.9.4").Serialize(), 0, 0);
+  WriteImage(original);
+  std::wstring outpath = path.substr(0, path.rfind(L'.')) + L"-out.dll";
+  DeleteFile(outpath.c_str());
+
+  RCFileHandler handler{*logger};
+  EXPECT_FALSE(handler.UpdateFile(path.c_str(), outpath.c_str(), -1, -1, -1, -1));
+  EXPECT_EQ(unsigned(ERROR_INSUFFICIENT_BUFFER), handler.Error());
+  EXPECT_EQ(INVALID_FILE_ATTRIBUTES, GetFileAttributes(outpath.c_str()));
+
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), outpath.c_str(), -1, -1, 3, -1)) << logger->messages;
+  EXPECT_EQ(original, ReadImage());
+  EXPECT_NE(INVALID_FILE_ATTRIBUTES, GetFileAttributes(outpath.c_str()));
+  DeleteFile(outpath.c_str());
+}
+
+TEST_F(PeImageTests, BuildOverflowFails)
+{
+  std::vector<uint8_t> original = Image(Version(u"1.2.3.4", u"1.2.3.4").Serialize(), 0, 0);
+  WriteImage(original);
+
+  RCFileHandler handler{*logger};
+  EXPECT_FALSE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 65536, -1));
+  EXPECT_EQ(unsigned(ERROR_ARITHMETIC_OVERFLOW), handler.Error());
+  EXPECT_EQ(original, ReadImage());
+}
+
+TEST_F(PeImageTests, CurrentVersionNotRewritten)
+{
+  RCVersionInfo info = Version(u"1.2.3.4", u"1, 2, 3, 4");
+  unsigned changes{};
+  EXPECT_EQ(RCVersionInfo::Unchanged, info.Update(1, 2, 3, 4, RCVersionInfo::DefaultNames(), changes));
+  EXPECT_EQ(0u, changes);
+  EXPECT_EQ(RCVersionInfo::Updated, info.Update(1, 2, 3, 5, RCVersionInfo::DefaultNames(), changes));
+  EXPECT_EQ(4u, changes);
+
+  // The stale checksum shows that nothing was written
+  std::vector<uint8_t> original = Image(Version(u"1.2.3.4", u"1, 2, 3, 4").Serialize(), 0, 0x1234);
+  WriteImage(original);
+  RCFileHandler handler{*logger};
+  handler.Verbosity(9);
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), 1, 2, 3, 4)) << logger->messages;
+  EXPECT_EQ(original, ReadImage());
+  EXPECT_NE(std::wstring::npos, logger->messages.find(L"not modified")) << logger->messages;
+}
+
+TEST_F(PeImageTests, NotAnImage)
+{
+  WriteImage(std::vector<uint8_t>{'M', 'Z', 0, 0});
+  RCFileHandler handler{*logger};
+  EXPECT_FALSE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1));
+  EXPECT_EQ(unsigned(ERROR_BAD_EXE_FORMAT), handler.Error());
+}
+
+TEST_F(PeImageTests, PipelineTransactionStagesImage)
+{
+  std::vector<uint8_t> original = Image(Version(u"1.2.3.4", u"1.2.3.4").Serialize(), 0, 0);
+  WriteImage(original);
+  std::wstring rcPath = path.substr(0, path.rfind(L'.')) + L".rc";
+  FILE* file = _wfopen(rcPath.c_str(), L"wb");
+  ASSERT_NE(nullptr, file);
+  fputs("no version here\r\n", file);
+  fclose(file);
+
+  // A failed text file rolls back the run, the image is not touched
+  std::vector<std::wstring> paths{path, rcPath};
+  RCPipeline pipeline{*logger};
+  pipeline.Transaction(true);
+  EXPECT_FALSE(pipeline.Run(paths, -1, -1, 7, -1));
+  EXPECT_EQ(unsigned(ERROR_FILE_CORRUPT), pipeline.Error());
+  EXPECT_EQ(original, ReadImage());
+
+  file = _wfopen(rcPath.c_str(), L"wb");
+  ASSERT_NE(nullptr, file);
+  fputs("VS_VERSION_INFO VERSIONINFO\r\n FILEVERSION 1,2,3,4\r\n", file);
+  fclose(file);
+  ASSERT_TRUE(pipeline.Run(paths, -1, -1, 7, -1)) << logger->messages;
+  RCVersionInfo info;
+  ASSERT_TRUE(Resource(ReadImage(), info));
+  EXPECT_EQ(u"1.2.7.4", Value(info, 1));
+  DeleteFile(rcPath.c_str());
+}
+
+TEST_F(PeImageTests, FailedImageRollsBackTransaction)
+{
+  std::vector<uint8_t> original = Image(Version(u"1.2.9.4", u"1.2.9.4").Serialize(), 0, 0);
+  WriteImage(original);
+  std::wstring rcPath = path.substr(0, path.rfind(L'.')) + L".rc";
+  const char* rc = "VS_VERSION_INFO VERSIONINFO\r\n FILEVERSION 1,2,9,4\r\n";
+  FILE* file = _wfopen(rcPath.c_str(), L"wb");
+  ASSERT_NE(nullptr, file);
+  fputs(rc, file);
+  fclose(file);
+
+  // No room for the longer string, the RC file stays as it is on both paths
+  std::vector<std::wstring> paths{rcPath, path};
+  RCPipeline pipeline{*logger};
+  pipeline.Transaction(true);
+  EXPECT_FALSE(pipeline.Run(paths, -1, -1, -1, -1));
+  EXPECT_EQ(unsigned(ERROR_INSUFFICIENT_BUFFER), pipeline.Error());
+
+  RCFileHandler handler{*logger};
+  handler.Transaction(true);
+  EXPECT_FALSE(handler.UpdateFiles(paths, -1, -1, -1, -1));
+  EXPECT_EQ(unsigned(ERROR_INSUFFICIENT_BUFFER), handler.Error());
+
+  EXPECT_EQ(original, ReadImage());
+  file = _wfopen(rcPath.c_str(), L"rb");
+  ASSERT_NE(nullptr, file);
+  char text[128]{};
+  fread(text, 1, sizeof(text) - 1, file);
+  fclose(file);
+  EXPECT_STREQ(rc, text);
+  DeleteFile(rcPath.c_str());
+}
@@ -0,0 +1,205 @@
+#include "stdafx.h"
+#include "RCPipeline.h"
+#include "RCFileHandler.h"
+#include "TestLogger.h"
+#include <thread>
+
+TEST(RCQueue, BoundedCapacity)
+{
+  RCQueue<int> queue{3};
+  EXPECT_EQ(4u, queue.Capacity());
+
+  for (int n = 0; n < 4; ++n)
+  {
+    EXPECT_TRUE(queue.TryPush(n));
+  }
+  int extra{4};
+  EXPECT_FALSE(queue.TryPush(extra));
+  EXPECT_EQ(4u, queue.Depth());
+
+  int item{};
+  for (int n = 0; n < 4; ++n)
+  {
+    ASSERT_TRUE(queue.TryPop(item));
+    EXPECT_EQ(n, item);
+  }
+  EXPECT_FALSE(queue.TryPop(item));
+}
+
+TEST(RCQueue, ManyProducersAndConsumers)
+{
+  RCQueue<unsigned> queue{16};
+  const unsigned perProducer = 20000;
+  std::atomic<unsigned long long> sum{0};
+  std::atomic<unsigned> popped{0};
+
+  std::vector<std::thread> threads;
+  for (unsigned p = 0; p < 4; ++p)
+  {
+    threads.emplace_back([&queue, p, perProducer]() {
+      for (unsigned n = 1; n <= perProducer; ++n)
+      {
+        unsigned item = p * perProducer + n;
+        while (!queue.TryPush(item))
+        {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (unsigned c = 0; c < 4; ++c)
+  {
+    threads.emplace_back([&]() {
+      unsigned item{};
+      while (popped < 4 * perProducer)
+      {
+        if (queue.TryPop(item))
+        {
+          sum += item;
+          ++popped;
+        }
+        else
+        {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  unsigned long long count = 4ull * perProducer;
+  EXPECT_EQ(count * (count + 1) / 2, sum.load());
+}
+
+class PipelineTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+  }
+
+  void TearDown() override
+  {
+    for (const auto& file : tempFiles)
+    {
+      DeleteFile(file.c_str());
+    }
+  }
+
+  std::wstring CreateTempRCFile(const std::string& content)
+  {
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rcq", 0, tempFile);
+    tempFiles.push_back(tempFile);
+
+    FILE* file = _wfopen(tempFile, L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+    return tempFile;
+  }
+
+  std::string ReadText(const std::wstring& path)
+  {
+    RCFileHandler reader{*logger};
+    std::vector<unsigned char> buffer;
+    reader.LoadFile(path.c_str(), 2, buffer);
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  const std::string rcContent =
+    "VS_VERSION_INFO VERSIONINFO\r\n"
+    " FILEVERSION 1,2,3,4\r\n"
+    " PRODUCTVERSION 1,2,3,4\r\n"
+    "BEGIN\r\n"
+    " VALUE \"FileVersion\", \"1.2.3.4\"\r\n"
+    "END\r\n";
+
+  std::unique_ptr<TestLogger> logger;
+  std::vector<std::wstring> tempFiles;
+};
+
+TEST_F(PipelineTests, UpdatesAllFiles)
+{
+  std::vector<std::wstring> paths;
+  for (int n = 0; n < 100; ++n)
+  {
+    paths.push_back(CreateTempRCFile(rcContent));
+  }
+
+  // Fewer buffers than files in flight, readers wait for writers
+  RCBufferPool pool{64 * 1024};
+  RCPipeline pipeline{*logger};
+  pipeline.Pool(&pool);
+  pipeline.Workers(3, 2, 2);
+
+  ASSERT_TRUE(pipeline.Run(paths, -1, -1, 42, -1)) << logger->messages;
+  for (const auto& path : paths)
+  {
+    EXPECT_NE(std::string::npos, ReadText(path).find("FILEVERSION 1, 2, 42, 4"));
+  }
+
+  EXPECT_EQ(3u, pipeline.Stats(RCPipeline::Read).workers);
+  for (int stage = 0; stage < RCPipeline::StageCount; ++stage)
+  {
+    EXPECT_EQ(100u, pipeline.Stats(RCPipeline::Stage(stage)).items);
+  }
+  EXPECT_GE(RCPipeline::QueueDepth, pipeline.Stats(RCPipeline::Parse).maxDepth);
+  EXPECT_GE(64u * 1024u, pool.Stats().peakBytes);
+}
+
+TEST_F(PipelineTests, FirstErrorInPathOrder)
+{
+  std::vector<std::wstring> paths{
+    CreateTempRCFile(rcContent),
+    L"Z:\\does\\not\\exist\\missing.rc",
+    CreateTempRCFile("no version here\r\n"),
+    CreateTempRCFile(rcContent),
+  };
+
+  RCPipeline pipeline{*logger};
+  EXPECT_FALSE(pipeline.Run(paths, -1, -1, 7, -1));
+  EXPECT_NE(unsigned(ERROR_FILE_CORRUPT), pipeline.Error());
+  EXPECT_NE(0u, pipeline.Error());
+  EXPECT_NE(std::string::npos, ReadText(paths[0]).find("FILEVERSION 1, 2, 7, 4"));
+  EXPECT_NE(std::string::npos, ReadText(paths[3]).find("FILEVERSION 1, 2, 7, 4"));
+  EXPECT_EQ(2u, pipeline.Stats(RCPipeline::Write).items);
+}
+
+TEST_F(PipelineTests, TransactionChangesNoFileOnFailure)
+{
+  std::vector<std::wstring> paths{
+    CreateTempRCFile(rcContent),
+    CreateTempRCFile("no version here\r\n"),
+    CreateTempRCFile(rcContent),
+  };
+
+  RCPipeline pipeline{*logger};
+  pipeline.Transaction(true);
+  EXPECT_FALSE(pipeline.Run(paths, -1, -1, 7, -1));
+  EXPECT_EQ(unsigned(ERROR_FILE_CORRUPT), pipeline.Error());
+  EXPECT_EQ(rcContent, ReadText(paths[0]));
+  EXPECT_EQ(rcContent, ReadText(paths[2]));
+}
+
+TEST_F(PipelineTests, UnchangedFilesAreNotWritten)
+{
+  std::vector<std::wstring> paths{CreateTempRCFile(rcContent), CreateTempRCFile(rcContent)};
+
+  RCPipeline pipeline{*logger};
+  pipeline.SkipUnchanged(true);
+  ASSERT_TRUE(pipeline.Run(paths, 1, 2, 3, 4)) << logger->messages;
+  EXPECT_EQ(2u, pipeline.Stats(RCPipeline::Write).items);
+
+  ASSERT_TRUE(pipeline.Run(paths, 1, 2, 3, 4)) << logger->messages;
+  EXPECT_EQ(2u, pipeline.Stats(RCPipeline::Parse).items);
+  EXPECT_EQ(0u, pipeline.Stats(RCPipeline::Write).items);
+}
@@ -130,20 +130,66 @@ TEST_F(RCUpdaterEdgeCaseTests, UpdateVersion_CommentsWithUnicode)
 
 TEST_F(RCUpdaterEdgeCaseTests, UpdateVersion_MultipleVersionInfoBlocks)
 {
-  char buffer[] = "VS_VERSION_INFO VERSIONINFO\r\n"
-                  "FILEVERSION 1,2,3,4\r\n"
-                  "BEGIN\r\n"
-                  "END\r\n"
-                  "// Another resource\r\n"
-                  "VS_VERSION_INFO VERSIONINFO\r\n"
-                  "FILEVERSION 5,6,7,8\r\n"
-                  "BEGIN\r\n"
-                  "END\r\n";
+  char buffer[1000] = "VS_VERSION_INFO VERSIONINFO\r\n"
+                      "FILEVERSION 1,2,3,4\r\n"
+                      "BEGIN\r\n"
+                      "END\r\n"
+                      "// Another resource\r\n"
+                      "VS_VERSION_INFO VERSIONINFO\r\n"
+                      "FILEVERSION 5,6,7,8\r\n"
+                      "BEGIN\r\n"
+                      "END\r\n";
   
   unsigned result = updater->UpdateVersion(buffer, sizeof(buffer), 9, 10, 11, 12);
   
-  // Multiple VERSIONINFO blocks may cause parsing issues
-  EXPECT_TRUE(result == 0 || result >= 1);
+  EXPECT_EQ(2, result);
+  EXPECT_NE(nullptr, strstr(buffer, "FILEVERSION 9, 10, 11, 12\r\nBEGIN\r\nEND\r\n// Another"));
+  EXPECT_NE(nullptr, strstr(buffer, "resource\r\nVS_VERSION_INFO VERSIONINFO\r\nFILEVERSION 9, 10, 11, 12\r\n"));
+}
+
+TEST_F(RCUpdaterEdgeCaseTests, UpdateVersion_VersionInfoUnderIfdef)
+{
+  char buffer[1000] = "#include \"resource.h\"\r\n"
+                      "#ifdef _WIN64\r\n"
+                      "VS_VERSION_INFO VERSIONINFO\r\n"
+                      " FILEVERSION 1,2,3,4\r\n"
+                      " PRODUCTVERSION 1,2,3,4\r\n"
+                      "BEGIN\r\n"
+                      "    BLOCK \"StringFileInfo\"\r\n"
+                      "    BEGIN\r\n"
+                      "        BLOCK \"040904b0\"\r\n"
+                      "        BEGIN\r\n"
+                      "            VALUE \"FileVersion\", \"1.2.3.4\"\r\n"
+                      "        END\r\n"
+                      "    END\r\n"
+                      "END\r\n"
+                      "#else\r\n"
+                      "IDI_ICON1 ICON \"app.ico\"\r\n"
+                      "VS_VERSION_INFO VERSIONINFO\r\n"
+                      " FILEVERSION 1,2,30,4\r\n"
+                      " PRODUCTVERSION 1,2,30,4\r\n"
+                      "BEGIN\r\n"
+                      "    BLOCK \"StringFileInfo\"\r\n"
+                      "    BEGIN\r\n"
+                      "        BLOCK \"040904b0\"\r\n"
+                      "        BEGIN\r\n"
+                      "            VALUE \"FileVersion\", \"1.2.30.4\"\r\n"
+                      "        END\r\n"
+                      "    END\r\n"
+                      "END\r\n"
+                      "#endif\r\n";
+
+  std::vector<size_t> offsets;
+  ASSERT_TRUE(updater->FindVersion(buffer, offsets));
+  EXPECT_EQ(6u, offsets.size());
+
+  unsigned result = updater->UpdateVersion(buffer, sizeof(buffer), offsets, -1, -1, -1, -1);
+
+  EXPECT_EQ(6, result);
+  EXPECT_NE(nullptr, strstr(buffer, " FILEVERSION 1, 2, 4, 4\r\n PRODUCTVERSION 1, 2, 4, 4\r\n"));
+  EXPECT_NE(nullptr, strstr(buffer, "\"FileVersion\", \"1, 2, 4, 4\""));
+  EXPECT_NE(nullptr, strstr(buffer, " FILEVERSION 1, 2, 31, 4\r\n PRODUCTVERSION 1, 2, 31, 4\r\n"));
+  EXPECT_NE(nullptr, strstr(buffer, "\"FileVersion\", \"1, 2, 31, 4\""));
 }
 
 TEST_F(RCUpdaterEdgeCaseTests, UpdateVersion_ExtremelyLargeVersionNumbers)
@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include "RCResFile.h"
+#include "RCFileHandler.h"
+#include "TestLogger.h"
+
+class ResFileTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    path = std::wstring(tempDir) + L"rcres.res";
+  }
+
+  void TearDown() override
+  {
+    DeleteFile(path.c_str());
+  }
+
+  static void Append16(std::vector<uint8_t>& bytes, const char16_t* text)
+  {
+    for (; *text; ++text)
+    {
+      bytes.push_back(uint8_t(*text));
+      bytes.push_back(uint8_t(*text >> 8));
+    }
+    bytes.push_back(0);
+    bytes.push_back(0);
+  }
+
+  static std::vector<uint8_t> Version(const char16_t* fileVersion)
+  {
+    RCVersionInfo info;
+    info.root.key = u"VS_VERSION_INFO";
+    info.root.type = 0;
+    info.root.value.resize(RCVersionInfo::FixedSize);
+    RCVersionInfo::Write32(&info.root.value[0], RCVersionInfo::FixedSignature);
+    RCVersionInfo::Write32(&info.root.value[8], 0x00010002);
+    RCVersionInfo::Write32(&info.root.value[12], 0x00090004);
+
+    RCVersionInfo::Block value;
+    value.key = u"FileVersion";
+    Append16(value.value, fileVersion);
+    RCVersionInfo::Block table;
+    table.key = u"040904b0";
+    table.children.push_back(value);
+    RCVersionInfo::Block strings;
+    strings.key = u"StringFileInfo";
+    strings.children.push_back(table);
+    info.root.children.push_back(strings);
+    return info.Serialize();
+  }
+
+  // A resource with an id type and either an id or a string name
+  static void Append(std::vector<uint8_t>& res, uint16_t type, uint16_t id, const char16_t* name, const std::vector<uint8_t>& data)
+  {
+    std::vector<uint8_t> header(8);
+    header.insert(header.end(), {0xFF, 0xFF, uint8_t(type), uint8_t(type >> 8)});
+    if (name)
+    {
+      Append16(header, name);
+    }
+    else
+    {
+      header.insert(header.end(), {0xFF, 0xFF, uint8_t(id), uint8_t(id >> 8)});
+    }
+    header.resize(RCVersionInfo::Align4(header.size()) + 16);
+    RCVersionInfo::Write32(&header[0], uint32_t(data.size()));
+    RCVersionInfo::Write32(&header[4], uint32_t(header.size()));
+    RCVersionInfo::Write16(&header[header.size() - 12], 0x1030);
+    RCVersionInfo::Write16(&header[header.size() - 10], 0x0409);
+
+    res.insert(res.end(), header.begin(), header.end());
+    res.insert(res.end(), data.begin(), data.end());
+    res.resize(RCVersionInfo::Align4(res.size()));
+  }
+
+  static std::vector<uint8_t> Resources(const std::vector<uint8_t>& version)
+  {
+    std::vector<uint8_t> res;
+    Append(res, 0, 0, nullptr, {});
+    std::fill(res.begin() + 16, res.end(), uint8_t(0));
+    Append(res, 10, 0, u"APPDATA", {1, 2, 3, 4, 5});
+    Append(res, 16, 1, nullptr, version);
+    Append(res, 24, 1, nullptr, {'<', '/', '>'});
+    return res;
+  }
+
+  void WriteFile(const std::vector<uint8_t>& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.data(), 1, content.size(), file);
+      fclose(file);
+    }
+  }
+
+  std::vector<uint8_t> ReadFile()
+  {
+    std::vector<uint8_t> content;
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file)
+    {
+      uint8_t buffer[4096];
+      size_t bytes;
+      while (0 < (bytes = fread(buffer, 1, sizeof(buffer), file)))
+      {
+        content.insert(content.end(), buffer, buffer + bytes);
+      }
+      fclose(file);
+    }
+    return content;
+  }
+
+  // dwFileVersionMS in a file made by Resources(): the empty resource, APPDATA
+  // with its header and padding, the version header, VS_VERSION_INFO
+  static const size_t FixedOffset = 32 + 44 + 8 + 32 + 40 + 8;
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring path;
+};
+
+TEST_F(ResFileTests, VersionGrowsOtherResourcesKept)
+{
+  WriteFile(Resources(Version(u"1.2.9.4")));
+
+  RCFileHandler handler{*logger};
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1)) << logger->messages;
+
+  std::vector<uint8_t> expected = Resources(Version(u"1.2.10.4"));
+  RCVersionInfo::Write32(&expected[FixedOffset + 4], 0x000A0004);
+  RCVersionInfo::Write32(&expected[FixedOffset + 12], 0x00010000);
+  EXPECT_EQ(expected, ReadFile());
+}
+
+TEST_F(ResFileTests, UpdateInMemory)
+{
+  std::vector<uint8_t> res = Resources(Version(u"1.2.9.4"));
+  RCResFile file{res};
+  unsigned changes{};
+  EXPECT_EQ(RCResFile::Patched, file.UpdateVersion(3, -1, 7, -1, RCVersionInfo::DefaultNames(), changes));
+  EXPECT_EQ(3u, changes);
+
+  std::vector<uint8_t> expected = Resources(Version(u"3.2.7.4"));
+  ASSERT_EQ(expected.size(), res.size());
+  RCVersionInfo::Write32(&expected[FixedOffset], 0x00030002);
+  RCVersionInfo::Write32(&expected[FixedOffset + 4], 0x00070004);
+  RCVersionInfo::Write32(&expected[FixedOffset + 8], 0x00030000);
+  RCVersionInfo::Write32(&expected[FixedOffset + 12], 0x00070000);
+  EXPECT_EQ(expected, res);
+}
+
+TEST_F(ResFileTests, NoVersionResource)
+{
+  std::vector<uint8_t> res = Resources(Version(u"1.2.9.4"));
+  res.resize(32 + 44 + 8);
+  WriteFile(res);
+
+  RCFileHandler handler{*logger};
+  EXPECT_FALSE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1));
+  EXPECT_EQ(unsigned(ERROR_RESOURCE_TYPE_NOT_FOUND), handler.Error());
+  EXPECT_EQ(res, ReadFile());
+}
+
+TEST_F(ResFileTests, NotResourceFile)
+{
+  WriteFile({'V', 'S', '_', 'V', 'E', 'R', 'S', 'I', 'O', 'N', '_', 'I', 'N', 'F', 'O'});
+  RCFileHandler handler{*logger};
+  EXPECT_FALSE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1));
+  EXPECT_EQ(unsigned(ERROR_BAD_FORMAT), handler.Error());
+}
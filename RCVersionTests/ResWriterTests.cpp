@@ -0,0 +1,220 @@
+#include "stdafx.h"
+#include "RCResWriter.h"
+#include "RCResFile.h"
+#include "RCCommand.h"
+#include "TestLogger.h"
+
+class ResWriterTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    rcPath = std::wstring(tempDir) + L"rcwriter.rc";
+    resPath = std::wstring(tempDir) + L"rcwriter.res";
+  }
+
+  void TearDown() override
+  {
+    DeleteFile(rcPath.c_str());
+    DeleteFile(resPath.c_str());
+  }
+
+  void WriteText(const std::string& content)
+  {
+    FILE* file = _wfopen(rcPath.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+  }
+
+  std::vector<uint8_t> ReadRes()
+  {
+    std::vector<uint8_t> content;
+    FILE* file = _wfopen(resPath.c_str(), L"rb");
+    if (file)
+    {
+      uint8_t buffer[4096];
+      size_t bytes;
+      while (0 < (bytes = fread(buffer, 1, sizeof(buffer), file)))
+      {
+        content.insert(content.end(), buffer, buffer + bytes);
+      }
+      fclose(file);
+    }
+    return content;
+  }
+
+  // The parts of a resource script generated by Visual Studio around the version
+  static std::string Script(const char* fileVersion)
+  {
+    return std::string(
+      "// Microsoft Visual C++ generated resource script.\r\n"
+      "//\r\n"
+      "#include \"resource.h\"\r\n"
+      "#define APSTUDIO_READONLY_SYMBOLS\r\n"
+      "#include \"afxres.h\"\r\n"
+      "#undef APSTUDIO_READONLY_SYMBOLS\r\n"
+      "\r\n"
+      "#if !defined(AFX_RESOURCE_DLL) || defined(AFX_TARG_ENU)\r\n"
+      "LANGUAGE LANG_ENGLISH, SUBLANG_ENGLISH_US\r\n"
+      "\r\n"
+      "#ifdef APSTUDIO_INVOKED\r\n"
+      "1 TEXTINCLUDE \r\n"
+      "BEGIN\r\n"
+      "    \"resource.h\\0\"\r\n"
+      "END\r\n"
+      "#endif    // APSTUDIO_INVOKED\r\n"
+      "\r\n"
+      "IDI_ICON1               ICON                    \"app.ico\"\r\n"
+      "\r\n"
+      "VS_VERSION_INFO VERSIONINFO\r\n"
+      " FILEVERSION ") + fileVersion + "\r\n"
+      " PRODUCTVERSION " + fileVersion + "\r\n"
+      " FILEFLAGSMASK 0x3fL\r\n"
+      "#ifdef _DEBUG\r\n"
+      " FILEFLAGS 0x1L\r\n"
+      "#else\r\n"
+      " FILEFLAGS 0x0L\r\n"
+      "#endif\r\n"
+      " FILEOS 0x40004L\r\n"
+      " FILETYPE 0x1L\r\n"
+      " FILESUBTYPE 0x0L\r\n"
+      "BEGIN\r\n"
+      "    BLOCK \"StringFileInfo\"\r\n"
+      "    BEGIN\r\n"
+      "        BLOCK \"040904b0\"\r\n"
+      "        BEGIN\r\n"
+      "            VALUE \"CompanyName\", \"JurekM\"\r\n"
+      "            VALUE \"FileDescription\", \"RCVersion.exe\"\r\n"
+      "            VALUE \"FileVersion\", \"" + fileVersion + "\"\r\n"
+      "            VALUE \"ProductVersion\", \"" + fileVersion + "\"\r\n"
+      "        END\r\n"
+      "    END\r\n"
+      "    BLOCK \"VarFileInfo\"\r\n"
+      "    BEGIN\r\n"
+      "        VALUE \"Translation\", 0x409, 1200\r\n"
+      "    END\r\n"
+      "END\r\n"
+      "\r\n"
+      "#endif    // English (United States) resources\r\n";
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring rcPath;
+  std::wstring resPath;
+};
+
+TEST_F(ResWriterTests, StandardLayout)
+{
+  // rc.exe output for Script("1, 0, 177, 0")
+  static const uint8_t expected[] = {
+    0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0xff, 0xff, 0x00, 0x00, 0xff, 0xff, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xcc, 0x01, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0xff, 0xff, 0x10, 0x00, 0xff, 0xff, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x09, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xcc, 0x01, 0x34, 0x00, 0x00, 0x00, 0x56, 0x00, 0x53, 0x00, 0x5f, 0x00, 0x56, 0x00, 0x45, 0x00,
+    0x52, 0x00, 0x53, 0x00, 0x49, 0x00, 0x4f, 0x00, 0x4e, 0x00, 0x5f, 0x00, 0x49, 0x00, 0x4e, 0x00,
+    0x46, 0x00, 0x4f, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbd, 0x04, 0xef, 0xfe, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0xb1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0xb1, 0x00,
+    0x3f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2a, 0x01, 0x00, 0x00,
+    0x01, 0x00, 0x53, 0x00, 0x74, 0x00, 0x72, 0x00, 0x69, 0x00, 0x6e, 0x00, 0x67, 0x00, 0x46, 0x00,
+    0x69, 0x00, 0x6c, 0x00, 0x65, 0x00, 0x49, 0x00, 0x6e, 0x00, 0x66, 0x00, 0x6f, 0x00, 0x00, 0x00,
+    0x06, 0x01, 0x00, 0x00, 0x01, 0x00, 0x30, 0x00, 0x34, 0x00, 0x30, 0x00, 0x39, 0x00, 0x30, 0x00,
+    0x34, 0x00, 0x62, 0x00, 0x30, 0x00, 0x00, 0x00, 0x2e, 0x00, 0x07, 0x00, 0x01, 0x00, 0x43, 0x00,
+    0x6f, 0x00, 0x6d, 0x00, 0x70, 0x00, 0x61, 0x00, 0x6e, 0x00, 0x79, 0x00, 0x4e, 0x00, 0x61, 0x00,
+    0x6d, 0x00, 0x65, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x75, 0x00, 0x72, 0x00, 0x65, 0x00,
+    0x6b, 0x00, 0x4d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x44, 0x00, 0x0e, 0x00, 0x01, 0x00, 0x46, 0x00,
+    0x69, 0x00, 0x6c, 0x00, 0x65, 0x00, 0x44, 0x00, 0x65, 0x00, 0x73, 0x00, 0x63, 0x00, 0x72, 0x00,
+    0x69, 0x00, 0x70, 0x00, 0x74, 0x00, 0x69, 0x00, 0x6f, 0x00, 0x6e, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x52, 0x00, 0x43, 0x00, 0x56, 0x00, 0x65, 0x00, 0x72, 0x00, 0x73, 0x00, 0x69, 0x00, 0x6f, 0x00,
+    0x6e, 0x00, 0x2e, 0x00, 0x65, 0x00, 0x78, 0x00, 0x65, 0x00, 0x00, 0x00, 0x3a, 0x00, 0x0d, 0x00,
+    0x01, 0x00, 0x46, 0x00, 0x69, 0x00, 0x6c, 0x00, 0x65, 0x00, 0x56, 0x00, 0x65, 0x00, 0x72, 0x00,
+    0x73, 0x00, 0x69, 0x00, 0x6f, 0x00, 0x6e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x31, 0x00, 0x2c, 0x00,
+    0x20, 0x00, 0x30, 0x00, 0x2c, 0x00, 0x20, 0x00, 0x31, 0x00, 0x37, 0x00, 0x37, 0x00, 0x2c, 0x00,
+    0x20, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3e, 0x00, 0x0d, 0x00, 0x01, 0x00, 0x50, 0x00,
+    0x72, 0x00, 0x6f, 0x00, 0x64, 0x00, 0x75, 0x00, 0x63, 0x00, 0x74, 0x00, 0x56, 0x00, 0x65, 0x00,
+    0x72, 0x00, 0x73, 0x00, 0x69, 0x00, 0x6f, 0x00, 0x6e, 0x00, 0x00, 0x00, 0x31, 0x00, 0x2c, 0x00,
+    0x20, 0x00, 0x30, 0x00, 0x2c, 0x00, 0x20, 0x00, 0x31, 0x00, 0x37, 0x00, 0x37, 0x00, 0x2c, 0x00,
+    0x20, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x44, 0x00, 0x00, 0x00, 0x01, 0x00, 0x56, 0x00,
+    0x61, 0x00, 0x72, 0x00, 0x46, 0x00, 0x69, 0x00, 0x6c, 0x00, 0x65, 0x00, 0x49, 0x00, 0x6e, 0x00,
+    0x66, 0x00, 0x6f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x00, 0x04, 0x00, 0x00, 0x00, 0x54, 0x00,
+    0x72, 0x00, 0x61, 0x00, 0x6e, 0x00, 0x73, 0x00, 0x6c, 0x00, 0x61, 0x00, 0x74, 0x00, 0x69, 0x00,
+    0x6f, 0x00, 0x6e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x04, 0xb0, 0x04,
+  };
+
+  std::string script = Script("1, 0, 177, 0");
+  RCResWriter writer{*logger};
+  std::vector<uint8_t> res;
+  ASSERT_TRUE(writer.Compile(std::wstring(script.begin(), script.end()), L"test.rc", res)) << logger->messages;
+  EXPECT_EQ(std::vector<uint8_t>(expected, expected + sizeof(expected)), res);
+}
+
+TEST_F(ResWriterTests, NamedResourceInOtherLanguage)
+{
+  std::wstring script =
+    L"LANGUAGE LANG_GERMAN, SUBLANG_GERMAN\r\n"
+    L"AppVersion VERSIONINFO FILEVERSION 2,0,0,1 FILEFLAGS VS_FF_PRERELEASE|VS_FF_PRIVATEBUILD FILETYPE VFT_DLL\r\n"
+    L"{ BLOCK \"StringFileInfo\" { BLOCK \"040704b0\" { VALUE \"Comments\", \"say \"\"hi\"\"\" } } }\r\n";
+  RCResWriter writer{*logger};
+  std::vector<uint8_t> res;
+  ASSERT_TRUE(writer.Compile(script, L"test.rc", res)) << logger->messages;
+
+  // Empty resource, header with the type, "APPVERSION", the language
+  ASSERT_LT(32u + 64u, res.size());
+  EXPECT_EQ(16u, RCVersionInfo::Read16(&res[32 + 10]));
+  EXPECT_EQ(u'A', RCVersionInfo::Read16(&res[32 + 12]));
+  EXPECT_EQ(u'V', RCVersionInfo::Read16(&res[32 + 18]));
+  EXPECT_EQ(0x0407u, RCVersionInfo::Read16(&res[32 + 42]));
+
+  RCVersionInfo info;
+  uint32_t headerSize = RCVersionInfo::Read32(&res[32 + 4]);
+  ASSERT_TRUE(info.Parse(&res[32 + headerSize], RCVersionInfo::Read32(&res[32])));
+  EXPECT_EQ(0x00020000u, RCVersionInfo::Read32(&info.root.value[8]));
+  EXPECT_EQ(0x0Au, RCVersionInfo::Read32(&info.root.value[28]));
+  EXPECT_EQ(2u, RCVersionInfo::Read32(&info.root.value[36]));
+  const RCVersionInfo::Block& comments = info.root.children[0].children[0].children[0];
+  EXPECT_EQ(u"Comments", comments.key);
+  EXPECT_EQ(18u, comments.value.size());
+}
+
+TEST_F(ResWriterTests, MissingOrBrokenVersion)
+{
+  RCResWriter writer{*logger};
+  std::vector<uint8_t> res;
+  EXPECT_FALSE(writer.Compile(L"IDI_ICON1 ICON \"app.ico\"\r\n", L"test.rc", res));
+  EXPECT_EQ(unsigned(ERROR_RESOURCE_TYPE_NOT_FOUND), writer.Error());
+
+  EXPECT_FALSE(writer.Compile(L"1 VERSIONINFO FILEOS VOS_UNKNOWN_OS BEGIN END", L"test.rc", res));
+  EXPECT_EQ(unsigned(ERROR_INVALID_DATA), writer.Error());
+
+  EXPECT_FALSE(writer.Compile(L"1 VERSIONINFO BEGIN BLOCK \"StringFileInfo\" BEGIN END", L"test.rc", res));
+  EXPECT_EQ(unsigned(ERROR_INVALID_DATA), writer.Error());
+}
+
+TEST_F(ResWriterTests, CommandWritesUpdatedVersion)
+{
+  WriteText(Script("1, 0, 176, 0"));
+
+  TestLogger output{};
+  RCVersionOptions options{output};
+  const wchar_t* argv[] = {L"", L"/v:0"};
+  ASSERT_TRUE(options.Parse(_countof(argv), argv));
+  options.inputFile = rcPath;
+  options.resFile = resPath;
+  ASSERT_TRUE(options.Validate()) << output.messages;
+
+  RCCommand command{output};
+  EXPECT_EQ(0u, command.Execute(options)) << output.messages;
+
+  std::string script = Script("1, 0, 177, 0");
+  RCResWriter writer{*logger};
+  std::vector<uint8_t> expected;
+  ASSERT_TRUE(writer.Compile(std::wstring(script.begin(), script.end()), L"test.rc", expected));
+  EXPECT_EQ(expected, ReadRes());
+}
@@ -0,0 +1,150 @@
+#include "stdafx.h"
+#include "RCServer.h"
+#include "RCFileHandler.h"
+#include "RCUpdater.h"
+#include "TestLogger.h"
+#include <thread>
+
+class ServerTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+  }
+
+  void TearDown() override
+  {
+    for (const auto& file : tempFiles)
+    {
+      DeleteFile(file.c_str());
+    }
+  }
+
+  std::wstring CreateTempRCFile(const std::string& content)
+  {
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rcs", 0, tempFile);
+    tempFiles.push_back(tempFile);
+
+    FILE* file = _wfopen(tempFile, L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+    return tempFile;
+  }
+
+  std::string ReadFile(const std::wstring& path)
+  {
+    RCFileHandler reader{*logger};
+    std::vector<unsigned char> buffer;
+    reader.LoadFile(path.c_str(), 2, buffer);
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  const std::string rcContent =
+    "VS_VERSION_INFO VERSIONINFO\r\n"
+    " FILEVERSION 1,2,3,4\r\n"
+    " PRODUCTVERSION 1,2,3,4\r\n"
+    "BEGIN\r\n"
+    " VALUE \"FileVersion\", \"1.2.3.4\"\r\n"
+    "END\r\n";
+
+  std::unique_ptr<TestLogger> logger;
+  std::vector<std::wstring> tempFiles;
+};
+
+TEST_F(ServerTests, UpdaterOffsetsFollowReplacements)
+{
+  char buffer[512]{};
+  strcpy_s(buffer, rcContent.c_str());
+
+  RCUpdater<char> updater{*logger};
+  std::vector<size_t> offsets;
+  ASSERT_TRUE(updater.FindVersion(buffer, offsets));
+  EXPECT_EQ(3u, updater.UpdateVersion(buffer, sizeof(buffer), offsets, 10, 20, 3000, 40));
+
+  // Offsets now point at the new, longer versions
+  std::vector<size_t> rescanned;
+  ASSERT_TRUE(updater.FindVersion(buffer, rescanned));
+  EXPECT_EQ(rescanned, offsets);
+  EXPECT_TRUE(RCUpdater<char>::ValidOffsets(buffer, sizeof(buffer), offsets));
+
+  std::vector<size_t> stale{1, 2};
+  EXPECT_FALSE(RCUpdater<char>::ValidOffsets(buffer, sizeof(buffer), stale));
+}
+
+TEST_F(ServerTests, OffsetCacheHitAfterWrite)
+{
+  std::wstring path = CreateTempRCFile(rcContent);
+  RCOffsetCache cache;
+  RCFileHandler handler{*logger};
+  handler.Cache(&cache);
+
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 7, -1)) << logger->messages;
+  EXPECT_EQ(1u, cache.Count());
+  EXPECT_EQ(0u, cache.Hits());
+
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1)) << logger->messages;
+  EXPECT_EQ(1u, cache.Hits());
+  EXPECT_NE(std::string::npos, ReadFile(path).find("FILEVERSION 1, 2, 8, 4"));
+  EXPECT_NE(std::string::npos, ReadFile(path).find("\"1, 2, 8, 4\""));
+}
+
+TEST_F(ServerTests, OffsetCacheMissAfterExternalEdit)
+{
+  std::wstring path = CreateTempRCFile(rcContent);
+  RCOffsetCache cache;
+  RCFileHandler handler{*logger};
+  handler.Cache(&cache);
+
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 7, -1));
+  FILE* file = _wfopen(path.c_str(), L"wb");
+  ASSERT_NE(nullptr, file);
+  std::string edited = "// edited\r\n" + rcContent;
+  fwrite(edited.c_str(), 1, edited.length(), file);
+  fclose(file);
+
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 9, -1)) << logger->messages;
+  EXPECT_EQ(0u, cache.Hits());
+  EXPECT_NE(std::string::npos, ReadFile(path).find("FILEVERSION 1, 2, 9, 4"));
+}
+
+TEST_F(ServerTests, ForwardWithoutServer)
+{
+  unsigned result{12345};
+  std::vector<std::wstring> args{L"test.rc"};
+  EXPECT_FALSE(RCServer::Forward(L"\\\\.\\pipe\\RCVersionTests-none", args, *logger, result));
+  EXPECT_EQ(12345u, result);
+}
+
+TEST_F(ServerTests, ForwardToServer)
+{
+  const wchar_t pipeName[] = L"\\\\.\\pipe\\RCVersionTests-server";
+  std::wstring path = CreateTempRCFile(rcContent);
+
+  TestLogger serverLogger;
+  RCServer server{serverLogger, pipeName};
+  std::thread worker([&server]() { server.Run(2); });
+
+  for (int wait = 0; wait < 100 && !WaitNamedPipe(pipeName, 0); ++wait)
+  {
+    Sleep(10);
+  }
+
+  unsigned result{12345};
+  std::vector<std::wstring> args{path, L"/b:55", L"/v:3"};
+  EXPECT_TRUE(RCServer::Forward(pipeName, args, *logger, result));
+  EXPECT_EQ(0u, result) << logger->messages;
+  EXPECT_NE(std::wstring::npos, logger->messages.find(L"Replacing"));
+  EXPECT_NE(std::string::npos, ReadFile(path).find("FILEVERSION 1, 2, 55, 4"));
+
+  std::vector<std::wstring> stop{L"/server:stop"};
+  EXPECT_TRUE(RCServer::Forward(pipeName, stop, *logger, result));
+  EXPECT_EQ(0u, result);
+  worker.join();
+}
@@ -0,0 +1,183 @@
+#include "stdafx.h"
+#include "RCValueNames.h"
+#include "RCFileHandler.h"
+#include "RCUpdater.h"
+#include "TestLogger.h"
+
+class ValueNamesTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rcn", 0, tempFile);
+    path = tempFile;
+  }
+
+  void TearDown() override
+  {
+    DeleteFile(path.c_str());
+  }
+
+  void WriteText(const std::string& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+  }
+
+  std::string ReadText()
+  {
+    std::string content;
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file)
+    {
+      char buffer[4096];
+      size_t bytes;
+      while (0 < (bytes = fread(buffer, 1, sizeof(buffer), file)))
+      {
+        content.append(buffer, bytes);
+      }
+      fclose(file);
+    }
+    return content;
+  }
+
+  static const char* Resource()
+  {
+    return
+      "VS_VERSION_INFO VERSIONINFO\r\n"
+      " FILEVERSION 1,2,3,4\r\n"
+      "BEGIN\r\n"
+      "    BLOCK \"StringFileInfo\"\r\n"
+      "    BEGIN\r\n"
+      "        BLOCK \"040904b0\"\r\n"
+      "        BEGIN\r\n"
+      "            VALUE \"FileVersion\", \"1.2.3.4\"\r\n"
+      "            VALUE \"Assembly Version\", \"1.2.3.4\"\r\n"
+      "            VALUE \"PrivateBuild\", \"1.2.3.4\"\r\n"
+      "            VALUE \"Comments\", \"1.2.3.4\"\r\n"
+      "        END\r\n"
+      "    END\r\n"
+      "END\r\n";
+  }
+
+  std::unique_ptr<TestLogger> logger;
+  std::wstring path;
+};
+
+TEST_F(ValueNamesTests, TrieMatchesLongestName)
+{
+  const char* table[] = {"FILEFLAGS", "FILEFLAGSMASK", "FILEOS", nullptr};
+  RCNameTrie<char> trie{table};
+
+  size_t length{};
+  EXPECT_EQ(1u, trie.Match("FILEFLAGSMASK 0x3fL", length));
+  EXPECT_EQ(13u, length);
+  EXPECT_EQ(0u, trie.Match("FILEFLAGS 0x0L", length));
+  EXPECT_EQ(9u, length);
+  EXPECT_EQ(2u, trie.Match("FILEOS", length));
+  EXPECT_EQ(6u, length);
+  EXPECT_TRUE(RCNameTrie<char>::NotFound == trie.Match("FILE", length));
+  EXPECT_TRUE(RCNameTrie<char>::NotFound == trie.Match("fileos", length));
+  EXPECT_TRUE(RCNameTrie<char>::NotFound == trie.Match("", length));
+}
+
+TEST_F(ValueNamesTests, DefaultNamesOnly)
+{
+  RCValueNames names{*logger};
+  EXPECT_EQ(2u, names.Names().size());
+  EXPECT_EQ(0u, names.Key());
+
+  // The defaults again change nothing
+  EXPECT_TRUE(names.Add(L"FileVersion"));
+  EXPECT_EQ(0u, names.Key());
+
+  char buffer[2048]{};
+  strcpy_s(buffer, Resource());
+  RCUpdater<char> updater{*logger};
+  updater.valueNames = &names.Narrow();
+  EXPECT_EQ(2u, updater.UpdateVersion(buffer, sizeof(buffer), -1, -1, -1, -1));
+  EXPECT_NE(nullptr, strstr(buffer, "\"FileVersion\", \"1, 2, 4, 4\""));
+  EXPECT_NE(nullptr, strstr(buffer, "\"PrivateBuild\", \"1.2.3.4\""));
+}
+
+TEST_F(ValueNamesTests, AddedNamesAreUpdated)
+{
+  RCValueNames names{*logger};
+  EXPECT_TRUE(names.Add(L"Assembly Version"));
+  EXPECT_TRUE(names.Add(L"PrivateBuild"));
+  EXPECT_NE(0u, names.Key());
+
+  RCValueNames reversed{*logger};
+  EXPECT_TRUE(reversed.Add(L"PrivateBuild"));
+  EXPECT_TRUE(reversed.Add(L"Assembly Version"));
+  EXPECT_EQ(names.Key(), reversed.Key());
+
+  char buffer[2048]{};
+  strcpy_s(buffer, Resource());
+  RCUpdater<char> updater{*logger};
+  updater.valueNames = &names.Narrow();
+  EXPECT_EQ(4u, updater.UpdateVersion(buffer, sizeof(buffer), -1, -1, -1, -1));
+  EXPECT_NE(nullptr, strstr(buffer, "\"Assembly Version\", \"1, 2, 4, 4\""));
+  EXPECT_NE(nullptr, strstr(buffer, "\"PrivateBuild\", \"1, 2, 4, 4\""));
+  EXPECT_NE(nullptr, strstr(buffer, "\"Comments\", \"1.2.3.4\""));
+
+  wchar_t wide[2048]{};
+  for (size_t n = 0; Resource()[n]; ++n)
+  {
+    wide[n] = wchar_t(Resource()[n]);
+  }
+  RCUpdater<wchar_t> wideUpdater{*logger};
+  wideUpdater.valueNames = &names.Wide();
+  EXPECT_EQ(4u, wideUpdater.UpdateVersion(wide, _countof(wide), -1, -1, -1, -1));
+  EXPECT_NE(nullptr, wcsstr(wide, L"\"Assembly Version\", \"1, 2, 4, 4\""));
+}
+
+TEST_F(ValueNamesTests, InvalidNameFails)
+{
+  RCValueNames names{*logger};
+  EXPECT_FALSE(names.Add(L""));
+  EXPECT_FALSE(names.Add(L"Bad\"Name"));
+  EXPECT_EQ(unsigned(ERROR_INVALID_DATA), names.Error());
+  EXPECT_EQ(2u, names.Names().size());
+}
+
+TEST_F(ValueNamesTests, NamesFromFile)
+{
+  WriteText("# company values\r\nPrivateBuild\r\n\r\n\"Assembly Version\"\r\n");
+  RCValueNames names{*logger};
+  ASSERT_TRUE(names.AddFile(path.c_str())) << logger->messages;
+  ASSERT_EQ(4u, names.Names().size());
+  EXPECT_EQ(L"PrivateBuild", names.Names()[2]);
+  EXPECT_EQ(L"Assembly Version", names.Names()[3]);
+
+  RCValueNames missing{*logger};
+  DeleteFile(path.c_str());
+  EXPECT_FALSE(missing.AddFile(path.c_str()));
+}
+
+TEST_F(ValueNamesTests, CachedOffsetsNeedSameNames)
+{
+  WriteText(Resource());
+  RCOffsetCache cache;
+  RCFileHandler handler{*logger};
+  handler.Cache(&cache);
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1)) << logger->messages;
+
+  // Offsets cached for the default names must not be used for more names
+  RCValueNames names{*logger};
+  ASSERT_TRUE(names.Add(L"Comments"));
+  handler.ValueNames(&names);
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, -1, -1)) << logger->messages;
+
+  std::string text = ReadText();
+  EXPECT_NE(std::string::npos, text.find("\"FileVersion\", \"1, 2, 5, 4\""));
+  EXPECT_NE(std::string::npos, text.find("\"Comments\", \"1, 2, 4, 4\""));
+}
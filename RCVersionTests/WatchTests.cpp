@@ -0,0 +1,172 @@
+#include "stdafx.h"
+#include "RCWatcher.h"
+#include "RCFileHandler.h"
+#include "TestLogger.h"
+#include <thread>
+
+class WatchTests : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    logger = std::make_unique<TestLogger>();
+  }
+
+  void TearDown() override
+  {
+    for (const auto& file : tempFiles)
+    {
+      DeleteFile(file.c_str());
+    }
+  }
+
+  std::wstring CreateTempFile(const std::string& content)
+  {
+    wchar_t tempDir[MAX_PATH]{};
+    GetTempPath(MAX_PATH, tempDir);
+    wchar_t tempFile[MAX_PATH]{};
+    GetTempFileName(tempDir, L"rcw", 0, tempFile);
+    tempFiles.push_back(tempFile);
+    WriteText(tempFile, content);
+    return tempFile;
+  }
+
+  static void WriteText(const std::wstring& path, const std::string& content)
+  {
+    FILE* file = _wfopen(path.c_str(), L"wb");
+    if (file)
+    {
+      fwrite(content.c_str(), 1, content.length(), file);
+      fclose(file);
+    }
+  }
+
+  std::string ReadText(const std::wstring& path)
+  {
+    RCFileHandler reader{*logger};
+    std::vector<unsigned char> buffer;
+    if (!reader.LoadFile(path.c_str(), 2, buffer))
+    {
+      return std::string();
+    }
+    return reinterpret_cast<const char*>(buffer.data());
+  }
+
+  bool WaitForText(const std::wstring& path, const std::string& text)
+  {
+    for (int wait = 0; wait < 500; ++wait)
+    {
+      if (std::string::npos != ReadText(path).find(text))
+      {
+        return true;
+      }
+      Sleep(10);
+    }
+    return false;
+  }
+
+  const std::string rcContent =
+    "VS_VERSION_INFO VERSIONINFO\r\n"
+    " FILEVERSION 1,2,3,4\r\n"
+    " PRODUCTVERSION 1,2,3,4\r\n"
+    "BEGIN\r\n"
+    " VALUE \"FileVersion\", \"1.2.3.4\"\r\n"
+    "END\r\n";
+
+  std::unique_ptr<TestLogger> logger;
+  std::vector<std::wstring> tempFiles;
+};
+
+TEST_F(WatchTests, ReadVersionFromText)
+{
+  std::wstring path = CreateTempFile("# product version\r\nversion=5.6.7.8\r\n");
+  RCFileHandler handler{*logger};
+  int major{-1}, minor{-1}, build{-1}, revision{-1};
+  ASSERT_TRUE(handler.ReadVersion(path.c_str(), major, minor, build, revision)) << logger->messages;
+  EXPECT_EQ(5, major);
+  EXPECT_EQ(6, minor);
+  EXPECT_EQ(7, build);
+  EXPECT_EQ(8, revision);
+}
+
+TEST_F(WatchTests, ReadVersionFromRCFile)
+{
+  std::wstring path = CreateTempFile("// 9.9.9.9 in a comment\r\n" + rcContent);
+  RCFileHandler handler{*logger};
+  int major{-1}, minor{-1}, build{-1}, revision{-1};
+  ASSERT_TRUE(handler.ReadVersion(path.c_str(), major, minor, build, revision)) << logger->messages;
+  EXPECT_EQ(1, major);
+  EXPECT_EQ(4, revision);
+}
+
+TEST_F(WatchTests, ReadVersionMissing)
+{
+  std::wstring path = CreateTempFile("no version 1.2 here\r\n");
+  RCFileHandler handler{*logger};
+  int major{-1}, minor{-1}, build{-1}, revision{-1};
+  EXPECT_FALSE(handler.ReadVersion(path.c_str(), major, minor, build, revision));
+  EXPECT_EQ(unsigned(ERROR_INVALID_DATA), handler.Error());
+}
+
+TEST_F(WatchTests, UnchangedFileNotWritten)
+{
+  std::wstring path = CreateTempFile(rcContent);
+  RCFileHandler handler{*logger};
+  handler.Verbosity(2);
+  handler.SkipUnchanged(true);
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 7, -1));
+
+  WIN32_FILE_ATTRIBUTE_DATA before{};
+  ASSERT_TRUE(GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &before));
+  Sleep(20);
+  ASSERT_TRUE(handler.UpdateFile(path.c_str(), path.c_str(), -1, -1, 7, -1)) << logger->messages;
+
+  WIN32_FILE_ATTRIBUTE_DATA after{};
+  ASSERT_TRUE(GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &after));
+  EXPECT_EQ(0, CompareFileTime(&before.ftLastWriteTime, &after.ftLastWriteTime));
+  EXPECT_NE(std::wstring::npos, logger->messages.find(L"not modified"));
+}
+
+TEST_F(WatchTests, EditedFileStampedAgain)
+{
+  std::wstring path = CreateTempFile(rcContent);
+
+  TestLogger watchLogger;
+  RCWatcher watcher{watchLogger};
+  std::thread worker([&]() { watcher.Run({path}, nullptr, -1, -1, 77, -1, 50); });
+
+  EXPECT_TRUE(WaitForText(path, "FILEVERSION 1, 2, 77, 4"));
+
+  // The resource editor saves the file with the old version
+  Sleep(100);
+  WriteText(path, rcContent);
+  EXPECT_TRUE(WaitForText(path, "FILEVERSION 1, 2, 77, 4")) << watchLogger.messages;
+
+  watcher.Stop();
+  worker.join();
+  EXPECT_EQ(0u, watcher.Error()) << watchLogger.messages;
+}
+
+TEST_F(WatchTests, VersionFileChangeUpdatesAllFiles)
+{
+  std::wstring first = CreateTempFile(rcContent);
+  std::wstring second = CreateTempFile(rcContent);
+  std::wstring version = CreateTempFile("2.0.5.1\r\n");
+
+  TestLogger watchLogger;
+  RCWatcher watcher{watchLogger};
+  std::thread worker([&]() { watcher.Run({first, second}, version.c_str(), -1, -1, -1, 0, 50); });
+
+  EXPECT_TRUE(WaitForText(first, "FILEVERSION 2, 0, 5, 0"));
+  EXPECT_TRUE(WaitForText(second, "FILEVERSION 2, 0, 5, 0"));
+
+  WriteText(version, "2.0.6.1\r\n");
+  EXPECT_TRUE(WaitForText(first, "FILEVERSION 2, 0, 6, 0")) << watchLogger.messages;
+  EXPECT_TRUE(WaitForText(second, "\"2, 0, 6, 0\"")) << watchLogger.messages;
+
+  watcher.Stop();
+  worker.join();
+
+  // Neither file changed since it was written, the offsets came from the cache
+  EXPECT_LE(2u, watcher.Cache().Hits());
+}
@@ -5,3 +5,29 @@
 
 #include "RCVersionOptions.cpp"
 #include "RCFileHandler.cpp"
+#include "RCFileSet.cpp"
+#include "RCOffsetCache.cpp"
+#include "RCServer.cpp"
+#include "RCCommand.cpp"
+#include "RCWatcher.cpp"
+#include "RCBufferPool.cpp"
+#include "RCBatchIO.cpp"
+#include "RCPipeline.cpp"
+#include "RCAsyncFile.cpp"
+#include "RCVersionApi.cpp"
+#include "RCOutputFiles.cpp"
+#include "RCFileLock.cpp"
+#include "RCBuildCounter.cpp"
+#include "RCValueNames.cpp"
+#include "RCIncludeCache.cpp"
+#include "RCIncludeGraph.cpp"
+#include "RCVersionInfo.cpp"
+#include "RCPeImage.cpp"
+#include "RCBinaryFile.cpp"
+#include "RCFormats.cpp"
+#include "RCResFile.cpp"
+#include "RCResWriter.cpp"
+#include "RCHeaderWriter.cpp"
+#include "RCDiffWriter.cpp"
+#include "RCOutputCache.cpp"
+#include "RCContentGroups.cpp"